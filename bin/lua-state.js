@@ -2,6 +2,7 @@
 
 const { Command, Option } = require('commander')
 const { spawnSync } = require('node:child_process')
+const fs = require('node:fs')
 const path = require('node:path')
 
 const logger = require('../build-tools/logger')
@@ -182,6 +183,49 @@ program
     }
   })
 
+program
+  .command('compile <paths...>')
+  .description('Precompile Lua files into a bytecode bundle')
+  .requiredOption('-o, --output <file>', 'Bundle file to write', resolvePath)
+  .option(
+    '-r, --root <dir>',
+    'Root directory for module names (default: current directory)',
+    resolvePath,
+  )
+  .option('--strip', 'Strip debug information from bytecode', false)
+  .action((paths, options) => {
+    const { LuaState, LuaError } = require('../js/index')
+
+    const root = options.root ?? process.cwd()
+
+    try {
+      const chunks = paths
+        .flatMap((entry) => collectLuaFiles(path.resolve(entry)))
+        .map((filePath) => ({
+          name: toModuleName(path.relative(root, filePath)),
+          path: filePath,
+        }))
+
+      if (chunks.length === 0) {
+        logger.error('Error', 'No Lua files found')
+        process.exit(1)
+      }
+
+      const lua = new LuaState({ libs: null })
+      lua.compileBundle(options.output, chunks, { strip: options.strip })
+      lua.close()
+
+      console.log(`Compiled ${chunks.length} chunks into ${options.output}`)
+    } catch (err) {
+      if (err instanceof LuaError) {
+        logger.error('Lua error', err.message)
+      } else {
+        logger.error('Error', err?.message || String(err))
+      }
+      process.exit(1)
+    }
+  })
+
 program.showHelpAfterError('(use --help for available commands)')
 program.showSuggestionAfterError()
 program.parse(process.argv)
@@ -192,3 +236,33 @@ function resolvePath(pathStr) {
   }
   return path.resolve(pathStr)
 }
+
+function collectLuaFiles(entryPath) {
+  if (!fs.statSync(entryPath).isDirectory()) {
+    return [entryPath]
+  }
+
+  // readdirSync recursive needs Node 18.17, walked by hand for older 18.x
+  const files = []
+  const walk = (dirPath) => {
+    for (const dirent of fs.readdirSync(dirPath, { withFileTypes: true })) {
+      const direntPath = path.join(dirPath, dirent.name)
+      if (dirent.isDirectory()) {
+        walk(direntPath)
+      } else if (dirent.isFile() && dirent.name.endsWith('.lua')) {
+        files.push(direntPath)
+      }
+    }
+  }
+  walk(entryPath)
+
+  return files.sort()
+}
+
+function toModuleName(relativePath) {
+  return relativePath
+    .replace(/\.lua$/, '')
+    .split(path.sep)
+    .join('.')
+    .replace(/\.init$/, '')
+}
@@ -15,12 +15,24 @@
       ],
       "sources": [
         "<@(lua_sources)",
+        "src/conversion/js-buffer-view.cpp",
+        "src/conversion/js-object-ref.cpp",
         "src/conversion/js-to-lua-converter.cpp",
+        "src/conversion/lua-signature.cpp",
         "src/conversion/lua-to-js-converter.cpp",
+        "src/conversion/record-shapes.cpp",
+        "src/core/lua-allocator.cpp",
+        "src/core/lua-bundle.cpp",
+        "src/core/lua-chunk-cache.cpp",
+        "src/core/lua-json.cpp",
         "src/core/lua-state-core.cpp",
         "src/napi/init.cpp",
+        "src/napi/lua-call.cpp",
         "src/napi/lua-error.cpp",
+        "src/napi/lua-path.cpp",
+        "src/napi/lua-state-pool.cpp",
         "src/napi/lua-state.cpp",
+        "src/runtime/lua-gc-scheduler.cpp",
         "src/runtime/lua-js-runtime.cpp"
       ],
       "libraries": [
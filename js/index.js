@@ -1 +1,4 @@
-module.exports = require('../build/Release/lua-state.node')
+const native = require('../build/Release/lua-state.node')
+const { pack, unpack } = require('./lua-pack')
+
+module.exports = { ...native, pack, unpack }
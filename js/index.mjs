@@ -4,4 +4,4 @@ const require = createRequire(import.meta.url)
 const cjsExports = require('./index.js')
 
 export default cjsExports
-export const { LuaState, LuaError } = cjsExports
+export const { LuaState, LuaStatePool, LuaError, pack, unpack } = cjsExports
@@ -0,0 +1,405 @@
+/**
+ * JS side of the packed format of LuaState#getGlobalPacked and
+ * LuaState#setGlobalPacked, the layout is described in src/core/lua-pack.h.
+ *
+ * Values map like in regular conversions: nil becomes null, tables become
+ * objects (sequences become arrays with the sequenceArrays option), dates
+ * become numbers and bigints become strings. Binary data (Buffer, TypedArray,
+ * ArrayBuffer) is packed as a string of its bytes. Functions and other values
+ * without a counterpart are packed as nil.
+ */
+
+const MAGIC = [0x4c, 0x50]
+const FORMAT_VERSION = 1
+const HEADER_SIZE = 3
+const MAX_DEPTH = 1000
+const MAX_REF_STRING_LENGTH = 40
+
+const NIL = 0x00
+const FALSE = 0x01
+const TRUE = 0x02
+const INT32 = 0x03
+const FLOAT64 = 0x04
+const STRING = 0x05
+const STRING_DEF = 0x06
+const STRING_REF = 0x07
+const ARRAY = 0x08
+const MAP = 0x09
+const TABLE_REF = 0x0a
+
+function createPackError(code, message) {
+  const err = new Error(message)
+  err.code = code
+  return err
+}
+
+function invalid(message) {
+  return createPackError('ERR_LUA_PACK_INVALID', message)
+}
+
+function tooDeep() {
+  return createPackError(
+    'ERR_LUA_PACK_TOO_DEEP',
+    `Tables are nested deeper than ${MAX_DEPTH} levels`,
+  )
+}
+
+// Encoding
+
+class Writer {
+  constructor() {
+    this.buf = Buffer.allocUnsafe(1024)
+    this.pos = 0
+    this.tables = new Map()
+    this.strings = new Map()
+  }
+
+  ensure(size) {
+    if (this.pos + size <= this.buf.length) {
+      return
+    }
+
+    const buf = Buffer.allocUnsafe(
+      Math.max(this.buf.length * 2, this.pos + size),
+    )
+    this.buf.copy(buf, 0, 0, this.pos)
+    this.buf = buf
+  }
+
+  tag(tag) {
+    this.ensure(1)
+    this.buf[this.pos++] = tag
+  }
+
+  varUint(value) {
+    this.ensure(10)
+
+    while (value >= 0x80) {
+      this.buf[this.pos++] = (value % 0x80) | 0x80
+      value = Math.floor(value / 0x80)
+    }
+
+    this.buf[this.pos++] = value
+  }
+
+  number(value) {
+    if (
+      Number.isInteger(value) &&
+      value >= -0x80000000 &&
+      value <= 0x7fffffff &&
+      !Object.is(value, -0)
+    ) {
+      this.tag(INT32)
+      this.ensure(4)
+      this.buf.writeInt32LE(value, this.pos)
+      this.pos += 4
+    } else {
+      this.tag(FLOAT64)
+      this.ensure(8)
+      this.buf.writeDoubleLE(value, this.pos)
+      this.pos += 8
+    }
+  }
+
+  string(value) {
+    if (value.length <= MAX_REF_STRING_LENGTH) {
+      const index = this.strings.get(value)
+
+      if (index !== undefined) {
+        this.tag(STRING_REF)
+        this.varUint(index)
+        return
+      }
+
+      this.strings.set(value, this.strings.size)
+      this.tag(STRING_DEF)
+    } else {
+      this.tag(STRING)
+    }
+
+    const size = Buffer.byteLength(value)
+    this.varUint(size)
+    this.ensure(size)
+    this.buf.write(value, this.pos, size, 'utf8')
+    this.pos += size
+  }
+
+  bytes(view) {
+    this.tag(STRING)
+    this.varUint(view.byteLength)
+    this.ensure(view.byteLength)
+    this.buf.set(view, this.pos)
+    this.pos += view.byteLength
+  }
+
+  value(value, depth) {
+    switch (typeof value) {
+      case 'number':
+        this.number(value)
+        break
+      case 'string':
+        this.string(value)
+        break
+      case 'boolean':
+        this.tag(value ? TRUE : FALSE)
+        break
+      case 'bigint':
+        this.string(value.toString())
+        break
+      case 'object':
+        if (value === null) {
+          this.tag(NIL)
+        } else {
+          this.object(value, depth)
+        }
+        break
+      default:
+        this.tag(NIL)
+        break
+    }
+  }
+
+  object(value, depth) {
+    if (value instanceof Date) {
+      this.number(value.getTime())
+      return
+    }
+
+    if (ArrayBuffer.isView(value)) {
+      this.bytes(
+        new Uint8Array(value.buffer, value.byteOffset, value.byteLength),
+      )
+      return
+    }
+
+    if (value instanceof ArrayBuffer) {
+      this.bytes(new Uint8Array(value))
+      return
+    }
+
+    const index = this.tables.get(value)
+
+    if (index !== undefined) {
+      this.tag(TABLE_REF)
+      this.varUint(index)
+      return
+    }
+
+    if (depth >= MAX_DEPTH) {
+      throw tooDeep()
+    }
+
+    this.tables.set(value, this.tables.size)
+
+    if (Array.isArray(value)) {
+      this.tag(ARRAY)
+      this.varUint(value.length)
+
+      for (let i = 0; i < value.length; i++) {
+        this.value(value[i], depth + 1)
+      }
+      return
+    }
+
+    const keys = Object.keys(value)
+
+    this.tag(MAP)
+    this.ensure(4)
+    this.buf.writeUInt32LE(keys.length, this.pos)
+    this.pos += 4
+
+    for (const key of keys) {
+      this.string(key)
+      this.value(value[key], depth + 1)
+    }
+  }
+}
+
+/**
+ * Packs a JS value for LuaState#setGlobalPacked.
+ * @param {unknown} value
+ * @returns {Buffer}
+ */
+function pack(value) {
+  const writer = new Writer()
+
+  writer.ensure(HEADER_SIZE)
+  writer.buf[writer.pos++] = MAGIC[0]
+  writer.buf[writer.pos++] = MAGIC[1]
+  writer.buf[writer.pos++] = FORMAT_VERSION
+
+  writer.value(value, 0)
+
+  return writer.buf.subarray(0, writer.pos)
+}
+
+// Decoding
+
+class Reader {
+  constructor(buf) {
+    this.buf = buf
+    this.pos = HEADER_SIZE
+    this.tables = []
+    this.strings = []
+  }
+
+  require(size) {
+    if (size > this.buf.length - this.pos) {
+      throw invalid('Unexpected end of packed data')
+    }
+  }
+
+  varUint() {
+    let value = 0
+    let scale = 1
+
+    for (let i = 0; i < 10; i++) {
+      this.require(1)
+      const byte = this.buf[this.pos++]
+      value += (byte & 0x7f) * scale
+
+      if (!(byte & 0x80)) {
+        return value
+      }
+
+      scale *= 0x80
+    }
+
+    throw invalid('Malformed varint')
+  }
+
+  utf8(size) {
+    this.require(size)
+    const value = this.buf.toString('utf8', this.pos, this.pos + size)
+    this.pos += size
+    return value
+  }
+
+  count(count) {
+    // every element takes at least one byte
+    this.require(count)
+    return count
+  }
+
+  table(table, depth) {
+    if (depth >= MAX_DEPTH) {
+      throw tooDeep()
+    }
+
+    this.tables.push(table)
+    return table
+  }
+
+  value(depth) {
+    this.require(1)
+    const tag = this.buf[this.pos++]
+
+    switch (tag) {
+      case NIL:
+        return null
+      case FALSE:
+        return false
+      case TRUE:
+        return true
+      case INT32: {
+        this.require(4)
+        const value = this.buf.readInt32LE(this.pos)
+        this.pos += 4
+        return value
+      }
+      case FLOAT64: {
+        this.require(8)
+        const value = this.buf.readDoubleLE(this.pos)
+        this.pos += 8
+        return value
+      }
+      case STRING:
+        return this.utf8(this.varUint())
+      case STRING_DEF: {
+        const value = this.utf8(this.varUint())
+        this.strings.push(value)
+        return value
+      }
+      case STRING_REF: {
+        const index = this.varUint()
+        if (index >= this.strings.length) {
+          throw invalid('Reference to an undefined string')
+        }
+        return this.strings[index]
+      }
+      case TABLE_REF: {
+        const index = this.varUint()
+        if (index >= this.tables.length) {
+          throw invalid('Reference to an undefined table')
+        }
+        return this.tables[index]
+      }
+      case ARRAY: {
+        const length = this.count(this.varUint())
+        const array = this.table(new Array(length), depth)
+
+        for (let i = 0; i < length; i++) {
+          array[i] = this.value(depth + 1)
+        }
+        return array
+      }
+      case MAP: {
+        this.require(4)
+        const count = this.count(this.buf.readUInt32LE(this.pos))
+        this.pos += 4
+        const object = this.table({}, depth)
+
+        for (let i = 0; i < count; i++) {
+          const key = this.value(depth + 1)
+          const value = this.value(depth + 1)
+
+          if (key === '__proto__') {
+            Object.defineProperty(object, key, {
+              value,
+              writable: true,
+              enumerable: true,
+              configurable: true,
+            })
+          } else {
+            object[key] = value
+          }
+        }
+        return object
+      }
+      default:
+        throw invalid(`Unknown tag ${tag}`)
+    }
+  }
+}
+
+/**
+ * Unpacks a value returned by LuaState#getGlobalPacked.
+ * @param {Uint8Array | ArrayBuffer} data
+ * @returns {unknown}
+ */
+function unpack(data) {
+  const buf = Buffer.isBuffer(data)
+    ? data
+    : ArrayBuffer.isView(data)
+      ? Buffer.from(data.buffer, data.byteOffset, data.byteLength)
+      : Buffer.from(data)
+
+  if (buf.length < HEADER_SIZE || buf[0] !== MAGIC[0] || buf[1] !== MAGIC[1]) {
+    throw invalid('Not a packed Lua value')
+  }
+
+  if (buf[2] !== FORMAT_VERSION) {
+    throw invalid(`Unsupported pack format version ${buf[2]}`)
+  }
+
+  const reader = new Reader(buf)
+  const value = reader.value(0)
+
+  if (reader.pos !== buf.length) {
+    throw invalid('Unexpected data after the packed value')
+  }
+
+  return value
+}
+
+module.exports = { pack, unpack }
@@ -1,24 +1,24 @@
 const { performance } = require('node:perf_hooks')
 
-const { LuaState } = require('../js')
+const { LuaState, pack, unpack } = require('../js')
 
 const TEST_COUNT = 50_000
 const WARM_COUNT = 5_000
 const SAMPLES_COUNT = 20
 
-function suite(suiteLabel) {
+function suite(suiteLabel, { count = TEST_COUNT, warm = WARM_COUNT } = {}) {
   const results = []
 
   const bench = (label) => (benchFn) => {
     global?.gc()
 
-    benchFn(WARM_COUNT)
+    benchFn(warm)
 
     const samples = []
 
     for (let i = 0; i < SAMPLES_COUNT; i++) {
       const start = performance.now()
-      benchFn(TEST_COUNT)
+      benchFn(count)
       const end = performance.now()
       samples.push(end - start)
     }
@@ -32,7 +32,7 @@ function suite(suiteLabel) {
       trimmed.length % 2 !== 0
         ? trimmed[midIdx]
         : (trimmed[midIdx - 1] + trimmed[midIdx]) / 2
-    const opsPerSec = Math.round((TEST_COUNT / avg) * 1000)
+    const opsPerSec = Math.round((count / avg) * 1000)
 
     results.push({
       Benchmark: label,
@@ -45,13 +45,17 @@ function suite(suiteLabel) {
   }
 
   const suiteInstance = {
-    case: (caseLabel, setupFn) => {
-      const lua = new LuaState()
+    case: (caseLabel, setupFn, luaOptions) => {
+      const lua = new LuaState(luaOptions)
       setupFn(lua, bench(caseLabel))
       return suiteInstance
     },
     end: () => {
-      console.log(suiteLabel)
+      console.log(
+        count === TEST_COUNT
+          ? suiteLabel
+          : `${suiteLabel} (iterations per bench: ${count})`,
+      )
       console.table(results)
     },
   }
@@ -68,6 +72,8 @@ function createFlatPojo() {
   }
 }
 
+const FLAT_POJO_KEYS = ['id', 'name', 'active', 'score']
+
 function createNestedPojo() {
   return {
     user: {
@@ -85,6 +91,30 @@ function createNestedPojo() {
   }
 }
 
+function createWidePojo() {
+  const value = {}
+  for (let i = 0; i < 32; i++) {
+    value[`field${i}`] = i
+  }
+  return value
+}
+
+const RECORDS_LUA = `
+  value = {}
+  for i = 1, 10000 do
+    value[i] = { id = i, name = 'user' .. i, active = i % 2 == 0, score = i / 2 }
+  end
+`
+
+function createRecords() {
+  return Array.from({ length: 10000 }, (_, i) => ({
+    id: i + 1,
+    name: `user${i + 1}`,
+    active: i % 2 === 1,
+    score: (i + 1) / 2,
+  }))
+}
+
 console.log(`lua-state on ${new LuaState().getVersion()}`)
 console.log(
   `Iterations per bench: ${TEST_COUNT}, Samples: ${SAMPLES_COUNT}, Warmup: ${WARM_COUNT}\n`,
@@ -117,6 +147,32 @@ suite('Call JS from Lua')
       `),
     )
   })
+  .case('Primitive (typed)', (lua, bench) => {
+    const fn = (x) => x + 1
+    lua.setGlobal('fn', fn, { args: ['number'], returns: 'number' })
+    bench(
+      lua.eval(`
+        return function(n)
+          for i = 1, n do
+            fn(i)
+          end
+        end
+      `),
+    )
+  })
+  .case('Primitive (4 args)', (lua, bench) => {
+    const fn = (a, b, c, d) => a
+    lua.setGlobal('fn', fn)
+    bench(
+      lua.eval(`
+        return function(n)
+          for i = 1, n do
+            fn(i, 'key', true, nil)
+          end
+        end
+      `),
+    )
+  })
   .case('Flat POJO', (lua, bench) => {
     const fn = (objArg) => objArg
     lua.setGlobal('fn', fn)
@@ -131,6 +187,21 @@ suite('Call JS from Lua')
       `),
     )
   })
+  .case('Flat POJO (shape)', (lua, bench) => {
+    const fn = (objArg) => objArg
+    lua.defineShape('flat', FLAT_POJO_KEYS)
+    lua.setGlobal('fn', fn)
+    lua.setGlobal('arg', createFlatPojo())
+    bench(
+      lua.eval(`
+        return function(n)
+          for i = 1, n do
+            fn(arg)
+          end
+        end
+      `),
+    )
+  })
   .case('Nested POJO', (lua, bench) => {
     const fn = (objArg) => objArg
     lua.setGlobal('fn', fn)
@@ -167,6 +238,17 @@ suite('Call Lua from JS')
       for (let i = 0; i < n; i++) fn(i)
     })
   })
+  .case('Primitive (typed)', (lua, bench) => {
+    const fn = lua.eval(`
+      return function(n)
+        return n + 1
+      end
+    `)
+    const typed = fn.withSignature({ args: ['number'], returns: 'number' })
+    bench((n) => {
+      for (let i = 0; i < n; i++) typed(i)
+    })
+  })
   .case('Flat POJO', (lua, bench) => {
     const fn = lua.eval(`
       return function(arg)
@@ -178,6 +260,18 @@ suite('Call Lua from JS')
       for (let i = 0; i < n; i++) fn(arg)
     })
   })
+  .case('Flat POJO (shape)', (lua, bench) => {
+    lua.defineShape('flat', FLAT_POJO_KEYS)
+    const fn = lua.eval(`
+      return function(arg)
+        return arg
+      end
+    `)
+    const arg = createFlatPojo()
+    bench((n) => {
+      for (let i = 0; i < n; i++) fn(arg)
+    })
+  })
   .case('Nested POJO', (lua, bench) => {
     const fn = lua.eval(`
       return function(arg)
@@ -215,12 +309,25 @@ suite('Lua to JS Serialization')
       for (let i = 0; i < n; i++) lua.getGlobal('value')
     })
   })
+  .case('Flat POJO (shape)', (lua, bench) => {
+    lua.defineShape('flat', FLAT_POJO_KEYS)
+    lua.setGlobal('value', createFlatPojo())
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobal('value')
+    })
+  })
   .case('Nested POJO', (lua, bench) => {
     lua.setGlobal('value', createNestedPojo())
     bench((n) => {
       for (let i = 0; i < n; i++) lua.getGlobal('value')
     })
   })
+  .case('Wide POJO', (lua, bench) => {
+    lua.setGlobal('value', createWidePojo())
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobal('value')
+    })
+  })
   .end()
 
 suite('JS to Lua Serialization')
@@ -241,6 +348,13 @@ suite('JS to Lua Serialization')
       for (let i = 0; i < n; i++) lua.setGlobal('value', value)
     })
   })
+  .case('Flat POJO (shape)', (lua, bench) => {
+    lua.defineShape('flat', FLAT_POJO_KEYS)
+    const value = createFlatPojo()
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.setGlobal('value', value)
+    })
+  })
   .case('Nested POJO', (lua, bench) => {
     const value = createNestedPojo()
     bench((n) => {
@@ -248,3 +362,200 @@ suite('JS to Lua Serialization')
     })
   })
   .end()
+
+suite('Global Path Access')
+  .case('getGlobal', (lua, bench) => {
+    lua.eval(`config = { limits = { rps = 100 } }`)
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobal('config.limits.rps')
+    })
+  })
+  .case('path().get', (lua, bench) => {
+    lua.eval(`config = { limits = { rps = 100 } }`)
+    const rps = lua.path('config.limits.rps')
+    bench((n) => {
+      for (let i = 0; i < n; i++) rps.get()
+    })
+  })
+  .case('path().set', (lua, bench) => {
+    lua.eval(`config = { limits = { rps = 100 } }`)
+    const rps = lua.path('config.limits.rps')
+    bench((n) => {
+      for (let i = 0; i < n; i++) rps.set(i)
+    })
+  })
+  .end()
+
+suite('Prepared and Batch Calls')
+  .case('function', (lua, bench) => {
+    lua.eval(`function step(x, v, dt) return x + v * dt, v * 0.99 end`)
+    const step = lua.getGlobal('step')
+    bench((n) => {
+      for (let i = 0; i < n; i++) step(i, 10, 0.016)
+    })
+  })
+  .case('prepareCall', (lua, bench) => {
+    lua.eval(`function step(x, v, dt) return x + v * dt, v * 0.99 end`)
+    const args = new Float64Array(3)
+    const results = new Float64Array(2)
+    const step = lua.prepareCall('step', { args, results })
+    bench((n) => {
+      for (let i = 0; i < n; i++) {
+        args[0] = i
+        args[1] = 10
+        args[2] = 0.016
+        step.call()
+      }
+    })
+  })
+  .case('batch', (lua, bench) => {
+    lua.eval(`function step(x, v, dt) return x + v * dt, v * 0.99 end`)
+    const step = lua.getGlobal('step')
+    bench((n) => {
+      const argsList = new Array(n)
+      for (let i = 0; i < n; i++) argsList[i] = [i, 10, 0.016]
+      step.batch(argsList)
+    })
+  })
+  .case('batchColumns', (lua, bench) => {
+    lua.eval(`function step(x, v, dt) return x + v * dt, v * 0.99 end`)
+    const step = lua.getGlobal('step')
+    bench((n) => {
+      const x = new Float64Array(n)
+      const v = new Float64Array(n).fill(10)
+      const dt = new Float64Array(n).fill(0.016)
+      for (let i = 0; i < n; i++) x[i] = i
+      step.batchColumns([x, v, dt], { results: 2 })
+    })
+  })
+  .end()
+
+suite('String Conversion', { count: 200, warm: 20 })
+  .case('Text (1 MB)', (lua, bench) => {
+    lua.eval(`value = string.rep('<td>cell</td>', 80000)`)
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobal('value')
+    })
+  })
+  .case('Bytes (1 MB)', (lua, bench) => {
+    lua.eval(`value = string.rep(string.char(0, 255), 500000)`)
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobal('value')
+    })
+  })
+  .case(
+    'Bytes as Buffer (1 MB)',
+    (lua, bench) => {
+      lua.eval(`value = string.rep(string.char(0, 255), 500000)`)
+      bench((n) => {
+        for (let i = 0; i < n; i++) lua.getGlobal('value')
+      })
+    },
+    { binaryStrings: true },
+  )
+  .end()
+
+suite('Table Traversal', { count: 200, warm: 20 })
+  .case('Wide (10k tables)', (lua, bench) => {
+    lua.eval(`
+      value = {}
+      for i = 1, 10000 do value['k' .. i] = { id = i } end
+    `)
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobal('value')
+    })
+  })
+  .case('Deep (1k levels)', (lua, bench) => {
+    lua.eval(`
+      value = {}
+      local node = value
+      for i = 1, 1000 do node.child = { id = i }; node = node.child end
+    `)
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobal('value')
+    })
+  })
+  .case('Config (10k nodes)', (lua, bench) => {
+    lua.eval(`
+      value = {}
+      for i = 1, 100 do
+        local section = {}
+        for j = 1, 100 do section['opt' .. j] = { enabled = true, weight = j } end
+        value['section' .. i] = section
+      end
+    `)
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobal('value')
+    })
+  })
+  .end()
+
+suite('Packed Transfer', { count: 200, warm: 20 })
+  .case('getGlobal (10k records)', (lua, bench) => {
+    lua.eval(RECORDS_LUA)
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobal('value')
+    })
+  })
+  .case('getGlobalPacked (10k records)', (lua, bench) => {
+    lua.eval(RECORDS_LUA)
+    bench((n) => {
+      for (let i = 0; i < n; i++) unpack(lua.getGlobalPacked('value'))
+    })
+  })
+  .case('setGlobal (10k records)', (lua, bench) => {
+    const value = createRecords()
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.setGlobal('value', value)
+    })
+  })
+  .case('setGlobalPacked (10k records)', (lua, bench) => {
+    const value = createRecords()
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.setGlobalPacked('value', pack(value))
+    })
+  })
+  .case('JSON.stringify(getGlobal) (10k records)', (lua, bench) => {
+    lua.eval(RECORDS_LUA)
+    bench((n) => {
+      for (let i = 0; i < n; i++) JSON.stringify(lua.getGlobal('value'))
+    })
+  })
+  .case('getGlobalJSON (10k records)', (lua, bench) => {
+    lua.eval(RECORDS_LUA)
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobalJSON('value')
+    })
+  })
+  .case('setGlobal(JSON.parse) (10k records)', (lua, bench) => {
+    const json = JSON.stringify(createRecords())
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.setGlobal('value', JSON.parse(json))
+    })
+  })
+  .case('setGlobalJSON (10k records)', (lua, bench) => {
+    const json = JSON.stringify(createRecords())
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.setGlobalJSON('value', json)
+    })
+  })
+  .end()
+
+suite('Sequence Conversion', { count: 20, warm: 2 })
+  .case('Object (100k items)', (lua, bench) => {
+    lua.eval(`value = {} for i = 1, 100000 do value[i] = i end`)
+    bench((n) => {
+      for (let i = 0; i < n; i++) lua.getGlobal('value')
+    })
+  })
+  .case(
+    'Array (100k items)',
+    (lua, bench) => {
+      lua.eval(`value = {} for i = 1, 100000 do value[i] = i end`)
+      bench((n) => {
+        for (let i = 0; i < n; i++) lua.getGlobal('value')
+      })
+    },
+    { sequenceArrays: true },
+  )
+  .end()
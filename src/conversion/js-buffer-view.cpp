@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cmath>
+
+#include "conversion/js-buffer-view.h"
+#include "core/lua-compat-defines.h"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace {
+  int IndexLuaCb(lua_State*);
+  int NewIndexLuaCb(lua_State*);
+  int LenLuaCb(lua_State*);
+  int GcLuaCb(lua_State*);
+  int ToStringLuaCb(lua_State*);
+  int SubLuaCb(lua_State*);
+
+  size_t ElementSize(napi_typedarray_type type) {
+    switch (type) {
+      case napi_int8_array:
+      case napi_uint8_array:
+      case napi_uint8_clamped_array:
+        return 1;
+      case napi_int16_array:
+      case napi_uint16_array:
+        return 2;
+      case napi_int32_array:
+      case napi_uint32_array:
+      case napi_float32_array:
+        return 4;
+      default:
+        return 8;
+    }
+  }
+} // namespace
+
+bool JsBufferView::IsBufferLike(const Napi::Value& value) { return value.IsTypedArray() || value.IsArrayBuffer() || value.IsDataView(); }
+
+void JsBufferView::RegisterMetaTable(LuaStateCore& core) {
+  core.NewMetaTable(MetaTableName);
+
+  core.NewTable(0, 2);
+  core.PushCClosure(ToStringLuaCb, 0);
+  core.SetField(-2, "tostring");
+  core.PushCClosure(SubLuaCb, 0);
+  core.SetField(-2, "sub");
+  // methods table as upvalue of __index
+  core.PushCClosure(IndexLuaCb, 1);
+  core.SetField(-2, "__index");
+
+  core.PushCClosure(NewIndexLuaCb, 0);
+  core.SetField(-2, "__newindex");
+  core.PushCClosure(LenLuaCb, 0);
+  core.SetField(-2, "__len");
+  core.PushCClosure(ToStringLuaCb, 0);
+  core.SetField(-2, "__tostring");
+  core.PushCClosure(GcLuaCb, 0);
+  core.SetField(-2, "__gc");
+
+  core.Pop(1);
+}
+
+void JsBufferView::Push(LuaStateCore& core, const Napi::Object& object) {
+  auto source = Source::ArrayBuffer;
+  auto type = napi_uint8_array;
+
+  if (object.IsTypedArray()) {
+    source = Source::TypedArray;
+    type = object.As<Napi::TypedArray>().TypedArrayType();
+  } else if (object.IsDataView()) {
+    source = Source::DataView;
+  }
+
+  auto* view = static_cast<JsBufferView*>(core.NewUserData(sizeof(JsBufferView)));
+  new (view) JsBufferView{std::make_shared<Napi::ObjectReference>(Napi::Persistent(object)), source, type, 0, WholeLength};
+
+  core.PushMetaTable(MetaTableName);
+  core.SetMetaTable(-2);
+}
+
+bool JsBufferView::Resolve(uint8_t*& data, size_t& length) const {
+  napi_env env = owner->Env();
+  napi_handle_scope scope;
+  if (napi_open_handle_scope(env, &scope) != napi_ok) {
+    return false;
+  }
+
+  napi_value object = nullptr;
+  napi_value array_buffer = nullptr;
+  void* base = nullptr;
+  // in elements
+  size_t total = 0;
+  bool is_detached = true;
+
+  if (napi_get_reference_value(env, *owner, &object) == napi_ok && object) {
+    napi_status status;
+    switch (source) {
+      case Source::TypedArray:
+        status = napi_get_typedarray_info(env, object, nullptr, &total, &base, &array_buffer, nullptr);
+        break;
+      case Source::DataView:
+        status = napi_get_dataview_info(env, object, &total, &base, &array_buffer, nullptr);
+        break;
+      default:
+        array_buffer = object;
+        status = napi_get_arraybuffer_info(env, object, &base, &total);
+        break;
+    }
+
+    if (status != napi_ok || napi_is_detached_arraybuffer(env, array_buffer, &is_detached) != napi_ok) {
+      is_detached = true;
+    }
+  }
+
+  napi_close_handle_scope(env, scope);
+
+  size_t end = count == WholeLength ? total : offset + count;
+  if (is_detached || end > total) {
+    return false;
+  }
+
+  data = static_cast<uint8_t*>(base) + offset * ElementSize(type);
+  length = end - offset;
+  return true;
+}
+
+namespace {
+  JsBufferView* CheckView(lua_State* L) { return static_cast<JsBufferView*>(luaL_checkudata(L, 1, JsBufferView::MetaTableName)); }
+
+  struct ViewMemory {
+    uint8_t* data;
+    // in elements
+    size_t length;
+  };
+
+  // memory of the view, raises if the buffer has been detached
+  ViewMemory CheckMemory(lua_State* L, const JsBufferView* view) {
+    ViewMemory memory{nullptr, 0};
+    if (!view->Resolve(memory.data, memory.length)) {
+      luaL_error(L, "buffer is detached or out of bounds");
+    }
+    return memory;
+  }
+
+  // 1-based index argument, raises if it is outside the view
+  size_t CheckIndex(lua_State* L, const ViewMemory& memory, int arg) {
+    lua_Number index = luaL_checknumber(L, arg);
+    if (index < 1 || index > static_cast<lua_Number>(memory.length) || index != std::floor(index)) {
+      luaL_error(L, "index %f out of range", static_cast<double>(index));
+    }
+    return static_cast<size_t>(index) - 1;
+  }
+
+  // string.sub style range, negative positions count from the end
+  std::pair<size_t, size_t> CheckRange(lua_State* L, const ViewMemory& memory) {
+    auto length = static_cast<lua_Integer>(memory.length);
+    lua_Integer i = luaL_optinteger(L, 2, 1);
+    lua_Integer j = luaL_optinteger(L, 3, -1);
+
+    if (i < 0) {
+      i = std::max<lua_Integer>(length + i + 1, 1);
+    } else if (i == 0) {
+      i = 1;
+    }
+    if (j < 0) {
+      j = length + j + 1;
+    } else if (j > length) {
+      j = length;
+    }
+
+    if (i > j) {
+      return {0, 0};
+    }
+    return {static_cast<size_t>(i - 1), static_cast<size_t>(j - i + 1)};
+  }
+
+  template <typename T> T* Elements(const ViewMemory& memory) { return reinterpret_cast<T*>(memory.data); }
+
+  // same conversion as a JS integer typed array: NaN and infinities store 0, other values wrap modulo 2^bits
+  template <typename T> void StoreInteger(const ViewMemory& memory, size_t i, lua_Number value) {
+    uint64_t bits = 0;
+
+    if (std::isfinite(value)) {
+      double wrapped = std::fmod(std::trunc(value), 0x1p64);
+      if (wrapped >= 0x1p63) {
+        bits = static_cast<uint64_t>(wrapped);
+      } else if (wrapped >= -0x1p63) {
+        bits = static_cast<uint64_t>(static_cast<int64_t>(wrapped));
+      } else {
+        bits = static_cast<uint64_t>(wrapped + 0x1p64);
+      }
+    }
+
+    Elements<T>(memory)[i] = static_cast<T>(bits);
+  }
+
+  int IndexLuaCb(lua_State* L) {
+    auto* view = CheckView(L);
+
+    if (lua_type(L, 2) != LUA_TNUMBER) {
+      lua_pushvalue(L, 2);
+      lua_rawget(L, lua_upvalueindex(1));
+      return 1;
+    }
+
+    auto memory = CheckMemory(L, view);
+    auto i = CheckIndex(L, memory, 2);
+
+    switch (view->type) {
+      case napi_int8_array:
+        lua_pushinteger(L, Elements<int8_t>(memory)[i]);
+        break;
+      case napi_uint8_array:
+      case napi_uint8_clamped_array:
+        lua_pushinteger(L, Elements<uint8_t>(memory)[i]);
+        break;
+      case napi_int16_array:
+        lua_pushinteger(L, Elements<int16_t>(memory)[i]);
+        break;
+      case napi_uint16_array:
+        lua_pushinteger(L, Elements<uint16_t>(memory)[i]);
+        break;
+      case napi_int32_array:
+        lua_pushinteger(L, Elements<int32_t>(memory)[i]);
+        break;
+      case napi_uint32_array:
+        lua_pushnumber(L, Elements<uint32_t>(memory)[i]);
+        break;
+      case napi_float32_array:
+        lua_pushnumber(L, Elements<float>(memory)[i]);
+        break;
+      case napi_float64_array:
+        lua_pushnumber(L, Elements<double>(memory)[i]);
+        break;
+      case napi_bigint64_array:
+        lua_pushnumber(L, static_cast<lua_Number>(Elements<int64_t>(memory)[i]));
+        break;
+      case napi_biguint64_array:
+        lua_pushnumber(L, static_cast<lua_Number>(Elements<uint64_t>(memory)[i]));
+        break;
+      default:
+        lua_pushnil(L);
+        break;
+    }
+
+    return 1;
+  }
+
+  int NewIndexLuaCb(lua_State* L) {
+    auto* view = CheckView(L);
+    lua_Number value = luaL_checknumber(L, 3);
+    auto memory = CheckMemory(L, view);
+    auto i = CheckIndex(L, memory, 2);
+
+    switch (view->type) {
+      case napi_int8_array:
+        StoreInteger<int8_t>(memory, i, value);
+        break;
+      case napi_uint8_array:
+        StoreInteger<uint8_t>(memory, i, value);
+        break;
+      case napi_uint8_clamped_array:
+        Elements<uint8_t>(memory)[i] = std::isnan(value) ? 0 : static_cast<uint8_t>(std::clamp<lua_Number>(std::nearbyint(value), 0, 255));
+        break;
+      case napi_int16_array:
+        StoreInteger<int16_t>(memory, i, value);
+        break;
+      case napi_uint16_array:
+        StoreInteger<uint16_t>(memory, i, value);
+        break;
+      case napi_int32_array:
+        StoreInteger<int32_t>(memory, i, value);
+        break;
+      case napi_uint32_array:
+        StoreInteger<uint32_t>(memory, i, value);
+        break;
+      case napi_float32_array:
+        Elements<float>(memory)[i] = static_cast<float>(value);
+        break;
+      case napi_float64_array:
+        Elements<double>(memory)[i] = value;
+        break;
+      case napi_bigint64_array:
+        StoreInteger<int64_t>(memory, i, value);
+        break;
+      case napi_biguint64_array:
+        StoreInteger<uint64_t>(memory, i, value);
+        break;
+      default:
+        break;
+    }
+
+    return 0;
+  }
+
+  int LenLuaCb(lua_State* L) {
+    // like the length of a detached JS buffer
+    uint8_t* data = nullptr;
+    size_t length = 0;
+    CheckView(L)->Resolve(data, length);
+
+    lua_pushinteger(L, static_cast<lua_Integer>(length));
+    return 1;
+  }
+
+  int GcLuaCb(lua_State* L) {
+    auto* view = static_cast<JsBufferView*>(lua_touserdata(L, 1));
+    if (view) {
+      view->~JsBufferView();
+    }
+    return 0;
+  }
+
+  int ToStringLuaCb(lua_State* L) {
+    auto* view = CheckView(L);
+    auto memory = CheckMemory(L, view);
+    auto [offset, count] = CheckRange(L, memory);
+    auto element_size = ElementSize(view->type);
+
+    lua_pushlstring(L, reinterpret_cast<const char*>(memory.data + offset * element_size), count * element_size);
+    return 1;
+  }
+
+  int SubLuaCb(lua_State* L) {
+    auto* view = CheckView(L);
+    auto memory = CheckMemory(L, view);
+    auto [offset, count] = CheckRange(L, memory);
+
+    auto* sub_view = static_cast<JsBufferView*>(lua_newuserdata(L, sizeof(JsBufferView)));
+    new (sub_view) JsBufferView{view->owner, view->source, view->type, view->offset + offset, count};
+
+    luaL_getmetatable(L, JsBufferView::MetaTableName);
+    lua_setmetatable(L, -2);
+
+    return 1;
+  }
+} // namespace
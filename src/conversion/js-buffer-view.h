@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <napi.h>
+
+#include "core/lua-state-core.h"
+
+/**
+ * Zero-copy view of an ArrayBuffer, TypedArray or DataView as Lua userdata.
+ *
+ * The userdata keeps the JS object alive through a reference and looks its
+ * memory up on every access, as the buffer may be detached (transfer(),
+ * postMessage) or resized in between. Elements are read and written with
+ * 1-based indexes in the element type of the array (bytes for ArrayBuffer
+ * and DataView). view:tostring(i, j) copies a range into a Lua string and
+ * view:sub(i, j) returns a view of a range over the same memory.
+ */
+struct JsBufferView {
+  static constexpr const char* MetaTableName = "lua-state.buffer";
+  // count of a view which follows the current length of its object
+  static constexpr size_t WholeLength = SIZE_MAX;
+
+  enum class Source : uint8_t { ArrayBuffer, TypedArray, DataView };
+
+  std::shared_ptr<Napi::ObjectReference> owner;
+  Source source;
+  napi_typedarray_type type;
+  // range in elements of the owner
+  size_t offset;
+  size_t count;
+
+  static bool IsBufferLike(const Napi::Value& value);
+  static void RegisterMetaTable(LuaStateCore& core);
+  static void Push(LuaStateCore& core, const Napi::Object& object);
+
+  // Current memory of the view, false once the buffer is detached or shrunk below the view.
+  // Plain N-API calls only, Lua callbacks may raise right after
+  bool Resolve(uint8_t*& data, size_t& length) const;
+};
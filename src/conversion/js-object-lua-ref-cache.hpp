@@ -1,43 +1,46 @@
 #pragma once
 
+#include <deque>
 #include <napi.h>
-#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "core/lua-values.h"
 
-#define MAX_VECTOR_SIZE 16
-
+/**
+ * Identity map of the JS objects visited by one JS to Lua conversion.
+ *
+ * Small conversions scan a vector. Past MaxVectorSize objects every visited object gets a napi_wrap marker which
+ * points at its entry, so a lookup is a single napi_unwrap and never calls into JS. Markers are removed when the
+ * cache is destroyed. Objects which are already wrapped (ObjectWrap instances, objects in a running conversion of
+ * another state) cannot be marked and stay in the vector.
+ */
 class JsObjectLuaRefCache {
 public:
-  enum class Strategy;
+  static constexpr size_t MaxVectorSize = 16;
 
-  explicit JsObjectLuaRefCache(const Napi::Env& env) : env_(env) { vector_.reserve(MAX_VECTOR_SIZE); }
+  enum class Strategy { Vector, Marker };
 
-  static void NapiInit(const Napi::Env& env) {
-    map_ctor_ = Napi::Persistent(env.Global().Get("Map").As<Napi::Function>());
-    auto map_proto = map_ctor_.Value().Get("prototype").As<Napi::Object>();
+  explicit JsObjectLuaRefCache(const Napi::Env& env) : env_(env) { vector_.reserve(MaxVectorSize); }
+  ~JsObjectLuaRefCache() { RemoveMarkers(); }
 
-    map_get_ = Napi::Persistent(map_proto.Get("get").As<Napi::Function>());
-    map_set_ = Napi::Persistent(map_proto.Get("set").As<Napi::Function>());
-  }
+  JsObjectLuaRefCache(const JsObjectLuaRefCache&) = delete;
+  JsObjectLuaRefCache& operator=(const JsObjectLuaRefCache&) = delete;
 
   inline bool TryGet(const Napi::Object& key, LuaRegistryRef& out_ref) {
-    if (strategy_ == Strategy::Map) {
-      napi_value args[1] = {key};
-      Napi::Value val = map_get_.Call(map_, 1, args);
+    if (strategy_ == Strategy::Marker) {
+      void* data = nullptr;
 
-      if (val.IsUndefined()) {
-        return false;
+      // the wrap may belong to another addon, only entries of this cache are trusted
+      if (napi_unwrap(env_, key, &data) == napi_ok && markers_.contains(data)) {
+        out_ref = static_cast<Entry*>(data)->ref;
+        return true;
       }
-
-      out_ref.value = val.As<Napi::Number>().Int64Value();
-
-      return true;
     }
 
     for (auto&& vector_item : vector_) {
-      if (key.StrictEquals(vector_item.first)) {
-        out_ref = vector_item.second;
+      if (key.StrictEquals(vector_item.object)) {
+        out_ref = vector_item.ref;
         return true;
       }
     }
@@ -46,36 +49,56 @@ public:
   }
 
   inline void Set(const Napi::Object& key, LuaRegistryRef lua_ref) {
-    if (strategy_ == Strategy::Vector && vector_.size() == MAX_VECTOR_SIZE) {
-      SwitchToMapStrategy();
+    if (strategy_ == Strategy::Vector && vector_.size() == MaxVectorSize) {
+      SwitchToMarkerStrategy();
     }
 
-    if (strategy_ == Strategy::Map) {
-      napi_value args[2] = {key, Napi::Number::New(env_, lua_ref.value)};
-      map_set_.Call(map_, 2, args);
-    } else {
-      vector_.emplace_back(std::pair<Napi::Object, LuaRegistryRef>{key, lua_ref});
+    if (strategy_ == Strategy::Vector || !Mark(key, lua_ref)) {
+      vector_.emplace_back(Entry{key, lua_ref});
     }
   }
 
-  enum class Strategy { Vector, Map };
-
 private:
-  inline static Napi::FunctionReference map_ctor_;
-  inline static Napi::FunctionReference map_get_;
-  inline static Napi::FunctionReference map_set_;
+  struct Entry {
+    Napi::Object object;
+    LuaRegistryRef ref;
+  };
 
-  const Napi::Env& env_;
-  Napi::Object map_;
+  Napi::Env env_;
   Strategy strategy_ = Strategy::Vector;
-  std::vector<std::pair<Napi::Object, LuaRegistryRef>> vector_;
-
-  inline void SwitchToMapStrategy() {
-    strategy_ = Strategy::Map;
-    map_ = map_ctor_.New({});
-    for (const auto& [key, lua_ref] : vector_) {
-      napi_value args[2] = {key, Napi::Number::New(env_, lua_ref.value)};
-      map_set_.Call(map_, 2, args);
+  std::vector<Entry> vector_;
+  // marked entries, a deque keeps their addresses stable
+  std::deque<Entry> marked_;
+  std::unordered_set<const void*> markers_;
+
+  inline bool Mark(const Napi::Object& key, LuaRegistryRef lua_ref) {
+    auto& entry = marked_.emplace_back(Entry{key, lua_ref});
+
+    if (napi_wrap(env_, key, &entry, nullptr, nullptr, nullptr) != napi_ok) {
+      marked_.pop_back();
+      return false;
+    }
+
+    markers_.insert(&entry);
+    return true;
+  }
+
+  inline void SwitchToMarkerStrategy() {
+    strategy_ = Strategy::Marker;
+
+    std::vector<Entry> unmarked;
+    for (const auto& entry : vector_) {
+      if (!Mark(entry.object, entry.ref)) {
+        unmarked.push_back(entry);
+      }
+    }
+
+    vector_ = std::move(unmarked);
+  }
+
+  inline void RemoveMarkers() noexcept {
+    for (const auto& entry : marked_) {
+      napi_remove_wrap(env_, entry.object, nullptr);
     }
   }
-};
\ No newline at end of file
+};
@@ -0,0 +1,37 @@
+#include <new>
+
+#include "conversion/js-object-ref.h"
+
+void JsObjectRef::Marks::Add(const Napi::Env& env, const Napi::Object& object) {
+  if (symbol_.IsEmpty()) {
+    symbol_ = Napi::Persistent(Napi::Symbol::New(env, "lua-state.ref"));
+  }
+
+  // not enumerable, so the mark stays out of keys, spreads and JSON
+  napi_property_descriptor mark{nullptr, symbol_.Value(), nullptr, nullptr, nullptr, Napi::Boolean::New(env, true), napi_configurable, nullptr};
+
+  if (napi_define_properties(env, object, 1, &mark) != napi_ok) {
+    throw Napi::TypeError::New(env, "Cannot mark a non-extensible object");
+  }
+}
+
+bool JsObjectRef::Marks::Has(const Napi::Value& value) const {
+  if (symbol_.IsEmpty()) {
+    return false;
+  }
+
+  bool has_mark = false;
+  return napi_has_own_property(value.Env(), value, symbol_.Value(), &has_mark) == napi_ok && has_mark;
+}
+
+void JsObjectRef::Marks::Clear() { symbol_.Reset(); }
+
+void JsObjectRef::Push(LuaStateCore& core, const Napi::Object& object, const Napi::Object& owner) {
+  auto* ref = static_cast<JsObjectRef*>(core.NewUserData(sizeof(JsObjectRef)));
+  new (ref) JsObjectRef{Napi::Persistent(object), {}, owner.IsEmpty() ? Napi::ObjectReference() : Napi::Persistent(owner)};
+
+  core.PushMetaTable(MetaTableName);
+  core.SetMetaTable(-2);
+}
+
+JsObjectRef* JsObjectRef::Test(LuaStateCore& core, int index) { return static_cast<JsObjectRef*>(core.TestUserData(index, MetaTableName)); }
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <napi.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "core/lua-state-core.h"
+#include "core/lua-values.h"
+
+/**
+ * JS object passed to Lua by reference.
+ *
+ * The userdata holds a reference to the live object, its metamethods (set up
+ * by LuaJsRuntime) read and write the object instead of a copy. Objects are
+ * passed this way when they are marked with LuaState#ref or set with the
+ * byRef option of setGlobal. Functions read through a reference are cached
+ * per userdata by property name.
+ */
+struct JsObjectRef {
+  static constexpr const char* MetaTableName = "lua-state.ref";
+  static constexpr const char* IteratorMetaTableName = "lua-state.ref.iterator";
+
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+  };
+
+  Napi::ObjectReference object;
+  std::unordered_map<std::string, LuaRegistryRef, StringHash, std::equal_to<>> methods;
+  // for a method, the object it was read from, the only receiver passed as this
+  Napi::ObjectReference owner;
+
+  // Snapshot of the keys for __pairs
+  struct Iterator {
+    std::vector<std::string> keys;
+    // elements of an array, keys is empty then
+    uint32_t length = 0;
+    size_t position = 0;
+  };
+
+  // Objects marked with LuaState#ref, every later conversion of that state passes them by reference.
+  // A mark is a hidden property keyed by a symbol of the runtime, checking it does not call into JS and marks
+  // neither keep objects alive nor reach other states. Clear drops the symbol, the old marks mean nothing then
+  class Marks {
+  public:
+    void Add(const Napi::Env& env, const Napi::Object& object);
+    bool Has(const Napi::Value& value) const;
+    void Clear();
+
+  private:
+    // no conversion checks for marks until the first object is marked
+    Napi::Reference<Napi::Symbol> symbol_;
+  };
+
+  static void Push(LuaStateCore& core, const Napi::Object& object, const Napi::Object& owner = Napi::Object());
+  static JsObjectRef* Test(LuaStateCore& core, int index);
+};
@@ -1,12 +1,14 @@
 #include <cassert>
 #include <vector>
 
+#include "conversion/js-buffer-view.h"
+#include "conversion/js-object-ref.h"
 #include "conversion/js-object-lua-ref-cache.hpp"
 #include "conversion/js-to-lua-converter.h"
 #include "core/lua-state-core.h"
 #include "runtime/lua-js-runtime.h"
 
-JsToLuaConverter::JsToLuaConverter(LuaStateCore& core) : core_(core) {
+JsToLuaConverter::JsToLuaConverter(LuaJsRuntime& runtime, LuaStateCore& core, const RecordShapes& shapes) : runtime_(runtime), core_(core), shapes_(shapes) {
   lua_refs_.reserve(32);
   objects_queue_.reserve(32);
 }
@@ -26,6 +28,16 @@ void JsToLuaConverter::PushValue(const Napi::Value& value) {
     return;
   }
 
+  if (JsBufferView::IsBufferLike(value)) {
+    JsBufferView::Push(core_, value.As<Napi::Object>());
+    return;
+  }
+
+  if (runtime_.IsJsObjectRefMarked(value)) {
+    JsObjectRef::Push(core_, value.As<Napi::Object>());
+    return;
+  }
+
   PushObject(value.As<Napi::Object>());
 }
 
@@ -51,13 +63,12 @@ void JsToLuaConverter::PushPrimitive(const napi_valuetype value_type, const Napi
       core_.PushBool(value.As<Napi::Boolean>());
       break;
     case napi_function: {
-      auto fn = value.As<Napi::Function>();
-      auto* holder = static_cast<JsFunctionHolder*>(core_.NewUserData(sizeof(JsFunctionHolder)));
-      new (holder) JsFunctionHolder{Napi::Persistent(fn)};
-
-      core_.PushMetaTable(LuaJsRuntime::MetaTableName);
-      core_.SetMetaTable(-2);
+      if (runtime_.IsJsObjectRefMarked(value)) {
+        JsObjectRef::Push(core_, value.As<Napi::Object>());
+        break;
+      }
 
+      runtime_.PushJsFunction(value.As<Napi::Function>());
       break;
     }
     default:
@@ -86,12 +97,17 @@ void JsToLuaConverter::PushObject(const Napi::Object& object) {
     int obj_length = 0;
     bool is_array = obj.IsArray();
     Napi::Array props;
+    const RecordShape* shape = nullptr;
 
     if (is_array) {
       array_length = obj.As<Napi::Array>().Length();
     } else {
       props = obj.GetPropertyNames();
       obj_length = props.Length();
+
+      if (!shapes_.IsEmpty() && obj_length <= static_cast<int>(shapes_.GetMaxSize())) {
+        shape = shapes_.Match(props, obj_length);
+      }
     }
 
     core_.NewTable(array_length, obj_length);
@@ -101,7 +117,7 @@ void JsToLuaConverter::PushObject(const Napi::Object& object) {
     visited_->Set(obj, ref);
     lua_refs_.emplace_back(ref);
 
-    objects_queue_.emplace_back(ObjectQueueItem{obj, std::move(props), is_array, is_array ? array_length : obj_length});
+    objects_queue_.emplace_back(ObjectQueueItem{obj, std::move(props), is_array, is_array ? array_length : obj_length, shape});
 
     return ref;
   };
@@ -119,6 +135,16 @@ void JsToLuaConverter::PushObject(const Napi::Object& object) {
       return;
     }
 
+    if (JsBufferView::IsBufferLike(value)) {
+      JsBufferView::Push(core_, value.As<Napi::Object>());
+      return;
+    }
+
+    if (runtime_.IsJsObjectRefMarked(value)) {
+      JsObjectRef::Push(core_, value.As<Napi::Object>());
+      return;
+    }
+
     Napi::Object child = value.As<Napi::Object>();
     LuaRegistryRef child_ref;
 
@@ -148,6 +174,16 @@ void JsToLuaConverter::PushObject(const Napi::Object& object) {
         push_value(array_item);
         core_.SetIndex(-2, i + 1);
       }
+    } else if (current_frame.shape) {
+      // keys are already interned, nothing to transcode
+      const auto& shape = *current_frame.shape;
+      Napi::Object js_keys = shape.js_keys.Value();
+
+      for (int i = 0; i < current_frame.length; ++i) {
+        core_.PushRef(shape.lua.keys[i]);
+        push_value(current_frame.obj.Get(js_keys.Get(i)));
+        core_.RawSet(-3);
+      }
     } else {
       for (int i = 0; i < current_frame.length; ++i) {
         Napi::Value prop_name = current_frame.props.Get(i);
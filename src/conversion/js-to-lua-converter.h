@@ -3,16 +3,20 @@
 #include <napi.h>
 
 #include "conversion/js-object-lua-ref-cache.hpp"
+#include "conversion/lua-signature.h"
+#include "conversion/record-shapes.h"
 #include "core/lua-state-core.h"
 #include "core/lua-values.h"
 #include "napi/napi-string-buffer.h"
 
+class LuaJsRuntime;
+
 class JsToLuaConverter {
 public:
   struct JsFunctionHolder;
   struct Scope;
 
-  explicit JsToLuaConverter(LuaStateCore&);
+  JsToLuaConverter(LuaJsRuntime&, LuaStateCore&, const RecordShapes&);
   ~JsToLuaConverter();
 
   void PushValue(const Napi::Value&);
@@ -20,6 +24,8 @@ public:
 
   struct JsFunctionHolder {
     Napi::FunctionReference ref;
+    // declared with setGlobal, null for untyped functions
+    std::shared_ptr<const LuaSignature> signature;
   };
 
   struct Scope {
@@ -33,7 +39,9 @@ public:
 private:
   struct ObjectQueueItem;
 
+  LuaJsRuntime& runtime_;
   LuaStateCore& core_;
+  const RecordShapes& shapes_;
   std::vector<ObjectQueueItem> objects_queue_;
   std::vector<LuaRegistryRef> lua_refs_;
   NapiStringBuffer<256> string_buf_;
@@ -49,5 +57,7 @@ private:
     Napi::Array props;
     bool is_array;
     int length;
+    // props matched a record shape, its keys are used instead
+    const RecordShape* shape = nullptr;
   };
 };
\ No newline at end of file
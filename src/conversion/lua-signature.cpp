@@ -0,0 +1,113 @@
+#include <string>
+
+#include "conversion/lua-signature.h"
+
+namespace {
+  LuaSignature::Type ParseType(const Napi::Env& env, const Napi::Value& value, std::string_view option_name) {
+    if (value.IsString()) {
+      auto name = value.As<Napi::String>().Utf8Value();
+
+      if (name == "any") {
+        return LuaSignature::Type::Any;
+      }
+      if (name == "number") {
+        return LuaSignature::Type::Number;
+      }
+      if (name == "string") {
+        return LuaSignature::Type::String;
+      }
+      if (name == "boolean") {
+        return LuaSignature::Type::Boolean;
+      }
+    }
+
+    throw Napi::TypeError::New(env, "Option \"" + std::string(option_name) + "\" must be \"number\", \"string\", \"boolean\" or \"any\"");
+  }
+}
+
+std::shared_ptr<const LuaSignature> LuaSignature::Parse(const Napi::Env& env, const Napi::Value& options_value) {
+  if (!options_value.IsObject()) {
+    return nullptr;
+  }
+
+  auto options = options_value.As<Napi::Object>();
+  auto args_option = options.Get("args");
+  auto returns_option = options.Get("returns");
+
+  if (args_option.IsUndefined() && returns_option.IsUndefined()) {
+    return nullptr;
+  }
+
+  auto signature = std::make_shared<LuaSignature>();
+
+  if (!args_option.IsUndefined()) {
+    if (!args_option.IsArray()) {
+      throw Napi::TypeError::New(env, "Option \"args\" must be an array of types");
+    }
+
+    auto args = args_option.As<Napi::Array>();
+    auto length = args.Length();
+    signature->args.emplace();
+    signature->args->reserve(length);
+
+    for (uint32_t i = 0; i < length; i++) {
+      signature->args->push_back(ParseType(env, args.Get(i), "args"));
+    }
+  }
+
+  if (!returns_option.IsUndefined()) {
+    signature->returns = ParseType(env, returns_option, "returns");
+  }
+
+  return signature;
+}
+
+const char* LuaSignature::GetTypeName(Type type) {
+  switch (type) {
+    case Type::Number:
+      return "number";
+    case Type::String:
+      return "string";
+    case Type::Boolean:
+      return "boolean";
+    default:
+      return "any";
+  }
+}
+
+const char* LuaSignature::GetJsTypeName(napi_valuetype type) {
+  switch (type) {
+    case napi_undefined:
+      return "undefined";
+    case napi_null:
+      return "null";
+    case napi_boolean:
+      return "boolean";
+    case napi_number:
+      return "number";
+    case napi_string:
+      return "string";
+    case napi_symbol:
+      return "symbol";
+    case napi_function:
+      return "function";
+    case napi_bigint:
+      return "bigint";
+    default:
+      return "object";
+  }
+}
+
+std::string LuaSignature::GetPositionName(size_t position) { return position ? "Argument " + std::to_string(position) : std::string("Result"); }
+
+Napi::TypeError LuaSignature::CreateMismatchError(const Napi::Env& env, std::string_view subject, Type expected, std::string_view actual) {
+  auto err = Napi::TypeError::New(env, std::string(subject) + " expected " + GetTypeName(expected) + ", got " + std::string(actual));
+  err.Set("code", "ERR_LUA_SIGNATURE_MISMATCH");
+  return err;
+}
+
+Napi::TypeError LuaSignature::CreateArgsCountError(const Napi::Env& env, size_t expected, size_t actual) {
+  auto err = Napi::TypeError::New(env, "Expected at most " + std::to_string(expected) + " arguments, got " + std::to_string(actual));
+  err.Set("code", "ERR_LUA_SIGNATURE_MISMATCH");
+  return err;
+}
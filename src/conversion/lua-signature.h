@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <napi.h>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Declared argument and result types of a function called across the boundary,
+ * set with setGlobal(name, fn, { args, returns }) or luaFn.withSignature().
+ *
+ * Declared values are type checked and converted directly, without the
+ * converters and their scopes. "any" keeps the regular conversion for its
+ * position, undeclared args or returns keep it for the whole list.
+ */
+struct LuaSignature {
+  enum class Type : uint8_t { Any, Number, String, Boolean };
+
+  std::optional<std::vector<Type>> args;
+  std::optional<Type> returns;
+
+  // null if the options declare neither args nor returns, throws TypeError for unknown types
+  static std::shared_ptr<const LuaSignature> Parse(const Napi::Env& env, const Napi::Value& options);
+  static const char* GetTypeName(Type type);
+  // typeof of a JS value, null included
+  static const char* GetJsTypeName(napi_valuetype type);
+  // "Argument n" for the 1-based position of an argument, "Result" for 0
+  static std::string GetPositionName(size_t position);
+  static Napi::TypeError CreateMismatchError(const Napi::Env& env, std::string_view subject, Type expected, std::string_view actual);
+  static Napi::TypeError CreateArgsCountError(const Napi::Env& env, size_t expected, size_t actual);
+};
@@ -1,9 +1,14 @@
+#include "conversion/js-object-ref.h"
 #include "conversion/lua-to-js-converter.h"
+#include "core/lua-utf8.h"
 #include "runtime/lua-js-runtime.h"
 
-LuaToJsConverter::LuaToJsConverter(LuaJsRuntime& runtime) : runtime_(runtime) {
+LuaToJsConverter::LuaToJsConverter(LuaJsRuntime& runtime, const RecordShapes& shapes, bool sequence_arrays, bool binary_strings)
+    : runtime_(runtime), shapes_(shapes), sequence_arrays_(sequence_arrays), binary_strings_(binary_strings) {
   objects_.reserve(64);
   results.reserve(16);
+  properties_.reserve(64);
+  strings_.reserve(MaxCachedStrings);
 }
 
 LuaToJsConverter::~LuaToJsConverter() {}
@@ -13,33 +18,106 @@ LuaToJsConverter::Scope LuaToJsConverter::CreateScope(const Napi::Env& env) {
   return Scope(*this);
 }
 
+void LuaToJsConverter::ClearStringCache() {
+  strings_.clear();
+  strings_array_.Reset();
+  runtime_.core_.ClearStringAnchors();
+}
+
+Napi::Value LuaToJsConverter::ToJsString(const Napi::Env& env, LuaString str) {
+  env_ = &env;
+  return GetStringValue(str);
+}
+
 // Visitor Implementation
 
 void LuaToJsConverter::OnValue(LuaNil _value) { results.emplace_back(env_->Null()); }
 void LuaToJsConverter::OnValue(LuaBool value) { results.emplace_back(Napi::Boolean::New(*env_, value.value)); }
 void LuaToJsConverter::OnValue(LuaNumber value) { results.emplace_back(Napi::Number::New(*env_, value.value)); }
-void LuaToJsConverter::OnValue(LuaString value) { results.emplace_back(Napi::String::New(*env_, value.ptr, value.len)); }
+void LuaToJsConverter::OnValue(LuaString value) { results.emplace_back(GetStringValue(value)); }
 void LuaToJsConverter::OnValue(LuaFunction value) { results.emplace_back(runtime_.CreateJsProxyFunction(*env_, value)); }
 bool LuaToJsConverter::OnValue(LuaTable value) {
-  auto [it, inserted] = objects_.try_emplace(value.identity, Napi::Object::New(*env_));
+  auto it = objects_.find(value.identity);
+  bool is_new = it == objects_.end();
+
+  if (is_new) {
+    it = objects_.emplace(value.identity, NewObject(value)).first;
+  }
+
   results.emplace_back(it->second);
-  return inserted;
+
+  if (value.sequence_length && (is_new || array_places_.contains(value.identity))) {
+    array_places_[value.identity].push_back({nullptr, nullptr, results.size() - 1});
+  }
+
+  return is_new;
 }
 
+void LuaToJsConverter::OnValue(LuaUserData value) { results.emplace_back(GetUserDataValue(value)); }
+
 void LuaToJsConverter::SetTable(LuaTable table) {
   auto it = objects_.find(table.identity);
+
+  // set again without a length, the table is no sequence
+  if (sequence_arrays_ && table.sequence_length == 0) {
+    if (auto places = array_places_.find(table.identity); places != array_places_.end()) {
+      auto object = Napi::Object::New(*env_);
+
+      for (const auto& place : places->second) {
+        if (place.holder) {
+          NAPI_THROW_IF_FAILED_VOID(*env_, napi_set_property(*env_, place.holder, place.key, object));
+        } else {
+          results[place.index] = object;
+        }
+      }
+
+      array_places_.erase(places);
+      it->second = object;
+      properties_.clear();
+    }
+  }
+
   current_object_ = it->second;
+  current_identity_ = table.identity;
+  current_length_ = table.sequence_length;
+}
+void LuaToJsConverter::EndTable() {
+  // the array stays, later references to it need no place
+  if (current_length_) {
+    array_places_.erase(current_identity_);
+  }
+
+  if (properties_.empty()) {
+    return;
+  }
+
+  // one call per object instead of a napi_set_property per key
+  napi_status status = napi_define_properties(*env_, current_object_, properties_.size(), properties_.data());
+  properties_.clear();
+  NAPI_THROW_IF_FAILED_VOID(*env_, status);
 }
 void LuaToJsConverter::OnProperty(LuaTableKey key, LuaNil _value) { SetProperty(key, env_->Null()); }
 void LuaToJsConverter::OnProperty(LuaTableKey key, LuaBool value) { SetProperty(key, Napi::Boolean::New(*env_, value.value)); }
 void LuaToJsConverter::OnProperty(LuaTableKey key, LuaNumber value) { SetProperty(key, Napi::Number::New(*env_, value.value)); }
-void LuaToJsConverter::OnProperty(LuaTableKey key, LuaString value) { SetProperty(key, Napi::String::New(*env_, value.ptr, value.len)); }
+void LuaToJsConverter::OnProperty(LuaTableKey key, LuaString value) { SetProperty(key, GetStringValue(value)); }
 void LuaToJsConverter::OnProperty(LuaTableKey key, LuaFunction value) { SetProperty(key, runtime_.CreateJsProxyFunction(*env_, value)); }
 bool LuaToJsConverter::OnProperty(LuaTableKey key, LuaTable value) {
-  auto [it, inserted] = objects_.try_emplace(value.identity, Napi::Object::New(*env_));
+  auto it = objects_.find(value.identity);
+  bool is_new = it == objects_.end();
+
+  if (is_new) {
+    it = objects_.emplace(value.identity, NewObject(value)).first;
+  }
+
   SetProperty(key, it->second);
-  return inserted;
+
+  if (value.sequence_length && (is_new || array_places_.contains(value.identity))) {
+    array_places_[value.identity].push_back({current_object_, GetPropertyKey(key), 0});
+  }
+
+  return is_new;
 }
+void LuaToJsConverter::OnProperty(LuaTableKey key, LuaUserData value) { SetProperty(key, GetUserDataValue(value)); }
 
 // Result
 
@@ -65,13 +143,105 @@ Napi::Value LuaToJsConverter::BuildResult() {
 
 // Private
 
+Napi::Object LuaToJsConverter::NewObject(LuaTable table) {
+  if (table.sequence_length == 0) {
+    return Napi::Object::New(*env_);
+  }
+
+  // V8 keeps large pre-sized arrays in dictionary mode, grow those by appending in order instead
+  if (table.sequence_length <= MaxPresizedArrayLength) {
+    return Napi::Array::New(*env_, table.sequence_length);
+  }
+
+  return Napi::Array::New(*env_);
+}
+
+/**
+ * Returns the JS string for a Lua string, short strings are cached by their address.
+ *
+ * The address identifies the string only while it is alive, so cached strings are anchored in the Lua registry.
+ * A full cache is dropped at once together with the anchors.
+ */
+Napi::String LuaToJsConverter::GetString(LuaString str) {
+  if (str.len > MaxCachedStringLength || str.index == 0) {
+    return Napi::String::New(*env_, str.ptr, str.len);
+  }
+
+  if (auto it = strings_.find(str.ptr); it != strings_.end()) {
+    napi_value value;
+    NAPI_THROW_IF_FAILED(*env_, napi_get_element(*env_, strings_array_.Value(), it->second, &value), Napi::String());
+    return Napi::String(*env_, value);
+  }
+
+  if (strings_.size() >= MaxCachedStrings) {
+    ClearStringCache();
+  }
+
+  if (strings_array_.IsEmpty()) {
+    strings_array_ = Napi::Persistent(Napi::Array::New(*env_, MaxCachedStrings).As<Napi::Object>());
+  }
+
+  auto js_str = Napi::String::New(*env_, str.ptr, str.len);
+  auto index = static_cast<uint32_t>(strings_.size());
+  NAPI_THROW_IF_FAILED(*env_, napi_set_element(*env_, strings_array_.Value(), index, js_str), Napi::String());
+
+  runtime_.core_.AnchorString(str.index);
+  strings_.emplace(str.ptr, index);
+
+  return js_str;
+}
+
+/**
+ * Returns the JS value of a Lua string value, keys go through GetString.
+ *
+ * With binary_strings, strings which are not valid UTF-8 become Buffers instead of strings with replacement characters.
+ */
+Napi::Value LuaToJsConverter::GetStringValue(LuaString str) {
+  if (!binary_strings_) {
+    return GetString(str);
+  }
+
+  std::string_view bytes(str.ptr, str.len);
+  size_t ascii_length = LuaUtf8::GetAsciiLength(bytes);
+
+  if (ascii_length < bytes.size() && !LuaUtf8::IsValid(bytes.substr(ascii_length))) {
+    // Lua strings are immutable and interned, the Buffer gets a copy of the bytes
+    return Napi::Buffer<char>::Copy(*env_, str.ptr, str.len);
+  }
+
+  return GetString(str);
+}
+
+Napi::Value LuaToJsConverter::GetUserDataValue(LuaUserData value) {
+  // objects passed by reference come back as the same object
+  if (auto* ref = JsObjectRef::Test(runtime_.core_, value.index)) {
+    return ref->object.Value();
+  }
+
+  return env_->Null();
+}
+
+napi_value LuaToJsConverter::GetPropertyKey(LuaTableKey key) {
+  if (const auto* k = std::get_if<LuaString>(&key)) {
+    // keys of record shapes are held as property keys for good
+    auto shape_key = shapes_.IsEmpty() ? Napi::Value() : shapes_.GetJsKey(k->ptr);
+    return shape_key.IsEmpty() ? napi_value(GetString(*k)) : napi_value(shape_key);
+  }
+
+  double number = std::get<LuaNumber>(key).value;
+  return Napi::Number::New(*env_, current_length_ ? number - 1 : number);
+}
+
 void LuaToJsConverter::SetProperty(LuaTableKey key, Napi::Value value) {
   std::visit(
     [&](auto&& k) {
       using T = std::decay_t<decltype(k)>;
 
       if constexpr (std::is_same_v<T, LuaString>) {
-        current_object_.Set(Napi::String::New(*env_, k.ptr, k.len), value);
+        properties_.push_back({nullptr, GetPropertyKey(k), nullptr, nullptr, nullptr, value, napi_default_jsproperty, nullptr});
+      } else if (current_length_) {
+        // Lua sequence 1..n to array indexes 0..n-1
+        current_object_.Set(static_cast<uint32_t>(k.value) - 1, value);
       } else {
         current_object_.Set(k.value, value);
       }
@@ -83,4 +253,7 @@ void LuaToJsConverter::SetProperty(LuaTableKey key, Napi::Value value) {
 void LuaToJsConverter::Reset() {
   objects_.clear();
   results.clear();
+  properties_.clear();
+  array_places_.clear();
+  current_length_ = 0;
 }
@@ -3,12 +3,18 @@
 #include <napi.h>
 #include <vector>
 
+#include "conversion/record-shapes.h"
 #include "core/lua-state-core.h"
 
 class LuaJsRuntime;
 
 class LuaToJsConverter {
 public:
+  static constexpr size_t MaxPresizedArrayLength = 32 * 1024;
+  // strings up to LUAI_MAXSHORTLEN are interned by every Lua version, longer ones are rarely repeated keys
+  static constexpr size_t MaxCachedStringLength = 40;
+  static constexpr size_t MaxCachedStrings = 4096;
+
   struct Scope {
     explicit Scope(LuaToJsConverter& converter) : converter_(converter) {}
     ~Scope() { converter_.Reset(); }
@@ -19,26 +25,37 @@ public:
 
   std::vector<Napi::Value> results;
 
-  explicit LuaToJsConverter(LuaJsRuntime&);
+  LuaToJsConverter(LuaJsRuntime&, const RecordShapes&, bool sequence_arrays = false, bool binary_strings = false);
   ~LuaToJsConverter();
 
   Scope CreateScope(const Napi::Env&);
 
+  // Drops the cached JS strings and releases their Lua anchors
+  void ClearStringCache();
+
+  // JS value of a single string value outside of a scope
+  Napi::Value ToJsString(const Napi::Env&, LuaString);
+
   // Visitor Implementation
 
+  bool UseSequences() const { return sequence_arrays_; }
+
   void OnValue(LuaNil);
   void OnValue(LuaBool);
   void OnValue(LuaNumber);
   void OnValue(LuaString);
   void OnValue(LuaFunction);
   bool OnValue(LuaTable);
+  void OnValue(LuaUserData);
   void SetTable(LuaTable);
+  void EndTable();
   void OnProperty(LuaTableKey, LuaNil);
   void OnProperty(LuaTableKey, LuaBool);
   void OnProperty(LuaTableKey, LuaNumber);
   void OnProperty(LuaTableKey, LuaString);
   void OnProperty(LuaTableKey, LuaFunction);
   bool OnProperty(LuaTableKey, LuaTable);
+  void OnProperty(LuaTableKey, LuaUserData);
 
   // Result
   Napi::Value BuildResult();
@@ -46,10 +63,41 @@ public:
 private:
   const Napi::Env* env_;
   LuaJsRuntime& runtime_;
+  const RecordShapes& shapes_;
 
   std::unordered_map<const void*, Napi::Object> objects_;
   Napi::Object current_object_;
+  const void* current_identity_ = nullptr;
+  // sequence length of current_object_, which is an array then
+  size_t current_length_ = 0;
+  bool sequence_arrays_ = false;
+  // strings which are not valid UTF-8 become Buffers
+  bool binary_strings_ = false;
+
+  // string keyed properties of current_object_, defined at once by EndTable
+  std::vector<napi_property_descriptor> properties_;
+
+  // where the arrays of tables which are not visited yet were placed, a table which turns out to be no sequence
+  // replaces its array there by an object
+  struct ArrayPlace {
+    // nullptr for results[index]
+    napi_value holder;
+    napi_value key;
+    size_t index;
+  };
+  std::unordered_map<const void*, std::vector<ArrayPlace>> array_places_;
+
+  // indexes into strings_array_ by the address of an anchored Lua string, kept across conversions.
+  // N-API 8 has no references to strings, the cached strings are elements of a persistent array
+  std::unordered_map<const char*, uint32_t> strings_;
+  Napi::ObjectReference strings_array_;
+
+  Napi::Object NewObject(LuaTable);
+  Napi::String GetString(LuaString);
+  Napi::Value GetStringValue(LuaString);
+  Napi::Value GetUserDataValue(LuaUserData);
 
+  napi_value GetPropertyKey(LuaTableKey);
   void SetProperty(LuaTableKey, Napi::Value);
   void Reset();
 };
@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <unordered_set>
+
+#include "conversion/record-shapes.h"
+
+void RecordShapes::Define(const Napi::Env& env, const std::string& name, const std::vector<std::string>& keys) {
+  if (keys.empty() || keys.size() > MaxKeys) {
+    throw Napi::RangeError::New(env, "Shape must have 1 to " + std::to_string(MaxKeys) + " keys");
+  }
+
+  if (std::unordered_set<std::string_view>(keys.begin(), keys.end()).size() != keys.size()) {
+    throw Napi::TypeError::New(env, "Shape keys must be unique");
+  }
+
+  for (const auto& shape : shapes_) {
+    if (shape->name != name) {
+      continue;
+    }
+
+    if (shape->keys == keys) {
+      return;
+    }
+
+    auto err = Napi::Error::New(env, "Shape \"" + name + "\" is already defined with other keys");
+    err.Set("code", "ERR_LUA_SHAPE_EXISTS");
+    throw err;
+  }
+
+  auto js_keys = Napi::Array::New(env, keys.size());
+  auto& shape = *shapes_.emplace_back(std::make_unique<RecordShape>(RecordShape{name, keys, {}, Napi::Persistent(js_keys.As<Napi::Object>())}));
+  shape.lua.keys.reserve(keys.size());
+
+  for (uint32_t i = 0; i < keys.size(); i++) {
+    const char* ptr;
+    shape.lua.keys.push_back(core_.InternString(keys[i], ptr));
+    js_keys.Set(i, Napi::String::New(env, keys[i]));
+
+    // the first shape with a key provides its JS string
+    keys_.try_emplace(ptr, KeyEntry{&shape, i});
+  }
+
+  max_size_ = std::max(max_size_, keys.size());
+}
+
+void RecordShapes::Clear() {
+  for (const auto& shape : shapes_) {
+    for (const auto& key : shape->lua.keys) {
+      core_.ReleaseRef(key);
+    }
+  }
+
+  shapes_.clear();
+  keys_.clear();
+  max_size_ = 0;
+}
+
+const RecordShape* RecordShapes::Match(const Napi::Array& names, uint32_t count) const {
+  for (const auto& shape : shapes_) {
+    if (shape->keys.size() != count) {
+      continue;
+    }
+
+    auto js_keys = shape->js_keys.Value();
+    bool is_match = true;
+
+    for (uint32_t i = 0; i < count && is_match; i++) {
+      is_match = names.Get(i).StrictEquals(js_keys.Get(i));
+    }
+
+    if (is_match) {
+      return shape.get();
+    }
+  }
+
+  return nullptr;
+}
+
+Napi::Value RecordShapes::GetJsKey(const char* key) const {
+  auto it = keys_.find(key);
+  return it != keys_.end() ? it->second.shape->js_keys.Value().Get(it->second.index) : Napi::Value();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <napi.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/lua-state-core.h"
+#include "core/lua-values.h"
+
+/**
+ * Fixed key layouts of records registered with LuaState#defineShape.
+ *
+ * Every key is kept as an interned Lua string in the registry and as a JS
+ * string in a persistent array (N-API 8 has no references to strings), so
+ * converting a matching record neither transcodes nor interns its keys. A JS
+ * object matches a shape when its own enumerable keys are the shape keys in
+ * the same order. Lua tables are not matched as a whole, their string keys
+ * which are shape keys reuse the stored JS strings.
+ */
+struct RecordShape {
+  std::string name;
+  std::vector<std::string> keys;
+  LuaShape lua;
+  // JS strings of the keys, in the order of keys
+  Napi::ObjectReference js_keys;
+};
+
+class RecordShapes {
+public:
+  static constexpr size_t MaxKeys = 64;
+
+  explicit RecordShapes(LuaStateCore& core) : core_(core) {}
+
+  RecordShapes(const RecordShapes&) = delete;
+  RecordShapes& operator=(const RecordShapes&) = delete;
+
+  // Throws if the name is taken by a shape with other keys, defining the same shape again does nothing
+  void Define(const Napi::Env& env, const std::string& name, const std::vector<std::string>& keys);
+  // Releases the Lua keys, the core must still be open
+  void Clear();
+
+  bool IsEmpty() const { return shapes_.empty(); }
+  size_t GetMaxSize() const { return max_size_; }
+
+  // Shape with the property names of a JS object (count names), nullptr if none matches
+  const RecordShape* Match(const Napi::Array& names, uint32_t count) const;
+  // JS property key for a Lua key string of any shape, empty if it is not one
+  Napi::Value GetJsKey(const char* key) const;
+
+private:
+  LuaStateCore& core_;
+  // stable addresses, converters keep pointers while a conversion runs
+  std::vector<std::unique_ptr<RecordShape>> shapes_;
+  size_t max_size_ = 0;
+
+  struct KeyEntry {
+    const RecordShape* shape;
+    uint32_t index;
+  };
+
+  // by the address of the interned Lua string
+  std::unordered_map<const char*, KeyEntry> keys_;
+};
@@ -0,0 +1,150 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "core/lua-allocator.h"
+
+/**
+ * Constructor
+ */
+LuaAllocator::LuaAllocator(const LuaAllocatorOptions& options) : type_(options.type) { stats_.limit = options.memory_limit; }
+
+/**
+ * Destructor
+ */
+LuaAllocator::~LuaAllocator() {
+  for (auto* chunk : chunks_) {
+    std::free(chunk);
+  }
+}
+
+/**
+ * lua_Alloc entry point, ud is the LuaAllocator instance
+ */
+void* LuaAllocator::Allocate(void* ud, void* ptr, size_t osize, size_t nsize) noexcept {
+  auto* allocator = static_cast<LuaAllocator*>(ud);
+
+  // Lua 5.4 passes the object type in osize when allocating a new block
+  if (ptr == nullptr) {
+    osize = 0;
+  }
+
+  if (nsize == 0) {
+    if (ptr) {
+      allocator->Free(ptr, osize);
+    }
+    return nullptr;
+  }
+
+  auto& stats = allocator->stats_;
+
+  if (stats.limit && allocator->limit_enforced_ && nsize > osize && stats.used - osize + nsize > stats.limit) {
+    return nullptr;
+  }
+
+  void* block = allocator->Realloc(ptr, osize, nsize);
+  if (!block) {
+    return nullptr;
+  }
+
+  if (ptr) {
+    allocator->StatsFor(osize).live--;
+  }
+
+  auto& size_class_stats = allocator->StatsFor(nsize);
+  size_class_stats.allocations++;
+  size_class_stats.live++;
+
+  stats.allocations++;
+  stats.used = stats.used - osize + nsize;
+  if (stats.used > stats.peak) {
+    stats.peak = stats.used;
+  }
+
+  return block;
+}
+
+void* LuaAllocator::Realloc(void* ptr, size_t osize, size_t nsize) {
+  if (type_ == LuaAllocatorType::System || (!IsPooled(nsize) && (!ptr || !IsPooled(osize)))) {
+    return std::realloc(ptr, nsize);
+  }
+
+  if (ptr && IsPooled(osize) && IsPooled(nsize) && SizeClassOf(osize) == SizeClassOf(nsize)) {
+    return ptr;
+  }
+
+  void* block = IsPooled(nsize) ? PoolAlloc(SizeClassOf(nsize)) : std::malloc(nsize);
+  if (!block) {
+    return nullptr;
+  }
+
+  if (ptr) {
+    std::memcpy(block, ptr, osize < nsize ? osize : nsize);
+
+    if (IsPooled(osize)) {
+      PoolFree(ptr, SizeClassOf(osize));
+    } else {
+      std::free(ptr);
+    }
+  }
+
+  return block;
+}
+
+void LuaAllocator::Free(void* ptr, size_t osize) {
+  if (type_ == LuaAllocatorType::Pool && IsPooled(osize)) {
+    PoolFree(ptr, SizeClassOf(osize));
+  } else {
+    std::free(ptr);
+  }
+
+  StatsFor(osize).live--;
+  stats_.used -= osize;
+}
+
+void* LuaAllocator::PoolAlloc(size_t size_class) {
+  if (auto* block = free_lists_[size_class]) {
+    free_lists_[size_class] = block->next;
+    return block;
+  }
+
+  size_t block_size = (size_class + 1) * SizeClassStep;
+
+  if (chunk_left_ < block_size) {
+    // the chunk tail is too small for this class, carve it into the smaller free lists
+    while (chunk_left_ >= SizeClassStep) {
+      size_t tail_class = SizeClassOf(chunk_left_ < MaxPooledSize ? chunk_left_ : MaxPooledSize);
+      size_t tail_size = (tail_class + 1) * SizeClassStep;
+      PoolFree(chunk_cursor_, tail_class);
+      chunk_cursor_ += tail_size;
+      chunk_left_ -= tail_size;
+    }
+
+    auto* chunk = static_cast<char*>(std::malloc(ChunkSize));
+    if (!chunk) {
+      return nullptr;
+    }
+
+    chunks_.push_back(chunk);
+    chunk_cursor_ = chunk;
+    chunk_left_ = ChunkSize;
+  }
+
+  void* block = chunk_cursor_;
+  chunk_cursor_ += block_size;
+  chunk_left_ -= block_size;
+
+  return block;
+}
+
+void LuaAllocator::PoolFree(void* ptr, size_t size_class) {
+  auto* block = static_cast<FreeBlock*>(ptr);
+  block->next = free_lists_[size_class];
+  free_lists_[size_class] = block;
+}
+
+LuaAllocator::SizeClassStats& LuaAllocator::StatsFor(size_t size) {
+  if (IsPooled(size)) {
+    return stats_.size_classes[SizeClassOf(size)];
+  }
+  return stats_.large;
+}
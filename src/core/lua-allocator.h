@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+enum class LuaAllocatorType { System, Pool };
+
+struct LuaAllocatorOptions {
+  LuaAllocatorType type = LuaAllocatorType::System;
+  // hard cap for live bytes, 0 - unlimited
+  size_t memory_limit = 0;
+};
+
+/**
+ * lua_Alloc implementation with per-state memory accounting.
+ *
+ * The System type forwards to realloc/free. The Pool type serves small blocks
+ * (up to MaxPooledSize) from size-class free lists carved out of fixed chunks,
+ * so short-lived tables, strings and closures do not hit the process heap.
+ */
+class LuaAllocator {
+public:
+  static constexpr size_t SizeClassStep = 16;
+  static constexpr size_t SizeClassesCount = 16;
+  static constexpr size_t MaxPooledSize = SizeClassStep * SizeClassesCount;
+  static constexpr size_t ChunkSize = 64 * 1024;
+
+  struct SizeClassStats {
+    size_t allocations = 0;
+    size_t live = 0;
+  };
+
+  struct Stats {
+    size_t used = 0;
+    size_t peak = 0;
+    size_t limit = 0;
+    size_t allocations = 0;
+    std::array<SizeClassStats, SizeClassesCount> size_classes{};
+    SizeClassStats large{};
+  };
+
+  explicit LuaAllocator(const LuaAllocatorOptions&);
+  ~LuaAllocator();
+
+  LuaAllocator(const LuaAllocator&) = delete;
+  LuaAllocator& operator=(const LuaAllocator&) = delete;
+
+  static void* Allocate(void* ud, void* ptr, size_t osize, size_t nsize) noexcept;
+
+  LuaAllocatorType GetType() const { return type_; }
+  const Stats& GetStats() const { return stats_; }
+
+  // Allocations past the limit only fail while it is enforced (Lua runs in protected mode),
+  // elsewhere the error would abort or unwind C++ frames. Returns the previous value
+  bool SetLimitEnforced(bool enforced) {
+    bool was_enforced = limit_enforced_;
+    limit_enforced_ = enforced;
+    return was_enforced;
+  }
+  bool IsOverLimit() const { return stats_.limit && stats_.used > stats_.limit; }
+
+private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  LuaAllocatorType type_;
+  Stats stats_;
+  bool limit_enforced_ = true;
+
+  std::array<FreeBlock*, SizeClassesCount> free_lists_{};
+  std::vector<void*> chunks_;
+  char* chunk_cursor_ = nullptr;
+  size_t chunk_left_ = 0;
+
+  void* Realloc(void* ptr, size_t osize, size_t nsize);
+  void Free(void* ptr, size_t osize);
+
+  void* PoolAlloc(size_t size_class);
+  void PoolFree(void* ptr, size_t size_class);
+
+  SizeClassStats& StatsFor(size_t size);
+
+  static inline size_t SizeClassOf(size_t size) { return (size - 1) / SizeClassStep; }
+  static inline bool IsPooled(size_t size) { return size <= MaxPooledSize; }
+};
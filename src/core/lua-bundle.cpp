@@ -0,0 +1,273 @@
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "core/lua-bundle.h"
+
+#if __has_include(<luajit.h>)
+extern "C" {
+#include <luajit.h>
+}
+#endif
+
+extern "C" {
+#include <lua.h>
+}
+
+namespace {
+  constexpr char BundleMagic[8] = {'L', 'U', 'A', 'B', 'N', 'D', 'L', '\0'};
+
+  // smallest chunk table entry: name length, bytecode offset, size and checksum
+  constexpr size_t MinChunkEntrySize = sizeof(uint32_t) + 3 * sizeof(uint64_t);
+
+  // hash continues a previous one
+  uint64_t Fnv1a(const char* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (size_t i = 0; i < size; i++) {
+      hash ^= static_cast<unsigned char>(data[i]);
+      hash *= 0x100000001b3ULL;
+    }
+    return hash;
+  }
+
+  // integers are stored little-endian regardless of the host
+  template <typename T> void WriteInt(std::string& out, T value) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+      out.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+    }
+  }
+
+  struct Reader {
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+
+    template <typename T> T ReadInt() {
+      auto bytes = ReadBytes(sizeof(T));
+      T value = 0;
+      for (size_t i = 0; i < sizeof(T); i++) {
+        value |= static_cast<T>(static_cast<unsigned char>(bytes[i])) << (i * 8);
+      }
+      return value;
+    }
+
+    std::string_view ReadBytes(uint64_t count) {
+      if (count > size - pos) {
+        throw LuaBundle::Error(LuaBundle::Error::Code::Invalid, "bundle is truncated");
+      }
+      std::string_view bytes(data + pos, static_cast<size_t>(count));
+      pos += static_cast<size_t>(count);
+      return bytes;
+    }
+  };
+} // namespace
+
+LuaBundle::~LuaBundle() {
+  if (!data_) {
+    return;
+  }
+
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+  CloseHandle(mapping_);
+#else
+  munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+std::string LuaBundle::GetAbiTag() {
+#ifdef LUAJIT_VERSION
+  std::string tag = LUAJIT_VERSION;
+#elif defined(LUA_RELEASE)
+  std::string tag = LUA_RELEASE;
+#else
+  std::string tag = LUA_VERSION;
+#endif
+
+  tag += ";num=" + std::to_string(LUA_VERSION_NUM);
+  tag += ";lua_Number=" + std::to_string(sizeof(lua_Number));
+  tag += ";lua_Integer=" + std::to_string(sizeof(lua_Integer));
+  tag += ";size_t=" + std::to_string(sizeof(size_t));
+  tag += ";int=" + std::to_string(sizeof(int));
+  tag += std::endian::native == std::endian::little ? ";le" : ";be";
+
+  return tag;
+}
+
+void LuaBundle::Write(const std::string& path, const std::vector<Source>& sources) {
+  auto abi_tag = GetAbiTag();
+
+  std::string header(BundleMagic, sizeof(BundleMagic));
+  WriteInt<uint32_t>(header, FormatVersion);
+  WriteInt<uint32_t>(header, static_cast<uint32_t>(abi_tag.size()));
+  header += abi_tag;
+  WriteInt<uint32_t>(header, static_cast<uint32_t>(sources.size()));
+
+  // bytecode follows the chunk table and the header checksum
+  uint64_t offset = header.size() + sizeof(uint64_t);
+  for (const auto& source : sources) {
+    offset += sizeof(uint32_t) + source.name.size() + 3 * sizeof(uint64_t);
+  }
+
+  for (const auto& source : sources) {
+    WriteInt<uint32_t>(header, static_cast<uint32_t>(source.name.size()));
+    header += source.name;
+    WriteInt<uint64_t>(header, offset);
+    WriteInt<uint64_t>(header, source.bytecode.size());
+    WriteInt<uint64_t>(header, Fnv1a(source.bytecode.data(), source.bytecode.size()));
+    offset += source.bytecode.size();
+  }
+
+  WriteInt<uint64_t>(header, Fnv1a(header.data(), header.size()));
+
+  // write next to the target and rename, so processes which have the old bundle mapped keep a consistent view
+  auto tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(header.data(), header.size());
+    for (const auto& source : sources) {
+      file.write(source.bytecode.data(), source.bytecode.size());
+    }
+    if (!file) {
+      throw Error(Error::Code::Io, "cannot write " + tmp_path);
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp_path, ec);
+    throw Error(Error::Code::Io, "cannot write " + path);
+  }
+}
+
+std::shared_ptr<const LuaBundle> LuaBundle::Open(const std::string& path) {
+  std::shared_ptr<LuaBundle> bundle(new LuaBundle());
+
+  bundle->Map(path);
+  bundle->Parse(path);
+
+  return bundle;
+}
+
+void LuaBundle::Map(const std::string& path) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw Error(Error::Code::Io, "cannot open " + path);
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+    CloseHandle(file);
+    throw Error(Error::Code::Invalid, path + " is not a bytecode bundle");
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping) {
+    throw Error(Error::Code::Io, "cannot map " + path);
+  }
+
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!data) {
+    CloseHandle(mapping);
+    throw Error(Error::Code::Io, "cannot map " + path);
+  }
+
+  mapping_ = mapping;
+  data_ = static_cast<const char*>(data);
+  size_ = static_cast<size_t>(file_size.QuadPart);
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw Error(Error::Code::Io, "cannot open " + path);
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    throw Error(Error::Code::Invalid, path + " is not a bytecode bundle");
+  }
+
+  void* data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw Error(Error::Code::Io, "cannot map " + path);
+  }
+
+  data_ = static_cast<const char*>(data);
+  size_ = static_cast<size_t>(file_stat.st_size);
+#endif
+}
+
+void LuaBundle::Parse(const std::string& path) {
+  Reader reader{data_, size_};
+
+  if (size_ < sizeof(BundleMagic) || std::memcmp(data_, BundleMagic, sizeof(BundleMagic)) != 0) {
+    throw Error(Error::Code::Invalid, path + " is not a bytecode bundle");
+  }
+  reader.pos = sizeof(BundleMagic);
+
+  auto format_version = reader.ReadInt<uint32_t>();
+  if (format_version != FormatVersion) {
+    throw Error(Error::Code::Mismatch, "bundle format version " + std::to_string(format_version) + " is not supported");
+  }
+
+  auto abi_tag = reader.ReadBytes(reader.ReadInt<uint32_t>());
+  auto current_abi_tag = GetAbiTag();
+  if (abi_tag != current_abi_tag) {
+    throw Error(Error::Code::Mismatch, "bundle was built for " + std::string(abi_tag) + ", current build is " + current_abi_tag);
+  }
+
+  auto chunks_count = reader.ReadInt<uint32_t>();
+  if (chunks_count > (size_ - reader.pos) / MinChunkEntrySize) {
+    throw Error(Error::Code::Invalid, "bundle is truncated");
+  }
+
+  chunks_.reserve(chunks_count);
+  checksums_.reserve(chunks_count);
+  for (uint32_t i = 0; i < chunks_count; i++) {
+    auto name = reader.ReadBytes(reader.ReadInt<uint32_t>());
+    auto offset = reader.ReadInt<uint64_t>();
+    auto size = reader.ReadInt<uint64_t>();
+    if (offset > size_ || size > size_ - offset) {
+      throw Error(Error::Code::Invalid, "bundle is truncated");
+    }
+    chunks_.push_back(Chunk{std::string(name), std::string_view(data_ + offset, static_cast<size_t>(size))});
+    checksums_.push_back(reader.ReadInt<uint64_t>());
+  }
+
+  // the checksum covers everything before it, the bytecode of each chunk is checked by Verify
+  auto header_size = reader.pos;
+  auto checksum = reader.ReadInt<uint64_t>();
+  if (Fnv1a(data_, header_size) != checksum) {
+    throw Error(Error::Code::Invalid, "bundle checksum mismatch");
+  }
+
+  verified_ = std::make_unique<std::atomic<bool>[]>(chunks_count);
+}
+
+bool LuaBundle::Verify(size_t index) const {
+  if (verified_[index].load(std::memory_order_relaxed)) {
+    return true;
+  }
+
+  const auto& bytecode = chunks_[index].bytecode;
+  if (Fnv1a(bytecode.data(), bytecode.size()) != checksums_[index]) {
+    return false;
+  }
+
+  verified_[index].store(true, std::memory_order_relaxed);
+  return true;
+}
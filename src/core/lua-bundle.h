@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Precompiled bytecode bundle.
+ *
+ * A bundle is a single file with the dumped chunks of a Lua codebase. The
+ * header carries a format version, an ABI tag of the Lua build which produced
+ * it (version, number sizes, endianness) and a chunk table, so a bundle built
+ * by another Lua build is rejected before any bytecode reaches lua_load.
+ * Bundles are memory-mapped and chunks are loaded straight from the mapping.
+ * Open checksums only the header and the chunk table, every chunk has its own
+ * checksum which is verified the first time it is loaded, so opening a bundle
+ * does not read the pages of chunks that are never required.
+ */
+class LuaBundle {
+public:
+  // 2: the checksum covers the header
+  // 3: chunk table with a checksum per chunk
+  static constexpr uint32_t FormatVersion = 3;
+
+  struct Chunk {
+    std::string name;
+    std::string_view bytecode;
+  };
+
+  struct Source {
+    std::string name;
+    std::string bytecode;
+  };
+
+  class Error : public std::runtime_error {
+  public:
+    enum class Code { Io, Invalid, Mismatch };
+
+    Error(Code code, const std::string& message) : std::runtime_error(message), code_(code) {}
+    Code GetCode() const { return code_; }
+
+  private:
+    Code code_;
+  };
+
+  ~LuaBundle();
+
+  LuaBundle(const LuaBundle&) = delete;
+  LuaBundle& operator=(const LuaBundle&) = delete;
+
+  // ABI tag of the Lua build this addon is compiled with
+  static std::string GetAbiTag();
+
+  static void Write(const std::string& path, const std::vector<Source>& sources) noexcept(false);
+  static std::shared_ptr<const LuaBundle> Open(const std::string& path) noexcept(false);
+
+  const std::vector<Chunk>& GetChunks() const { return chunks_; }
+  // checks the bytecode of a chunk against its checksum, only the first call per chunk reads it
+  bool Verify(size_t index) const;
+
+private:
+  LuaBundle() = default;
+
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void* mapping_ = nullptr;
+#endif
+
+  std::vector<Chunk> chunks_;
+  std::vector<uint64_t> checksums_;
+  // a bundle is shared by every state which loaded it
+  std::unique_ptr<std::atomic<bool>[]> verified_;
+
+  void Map(const std::string& path);
+  void Parse(const std::string& path);
+};
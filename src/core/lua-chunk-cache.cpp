@@ -0,0 +1,82 @@
+#include <functional>
+
+#include "core/lua-chunk-cache.h"
+
+LuaChunkCache& LuaChunkCache::Shared() {
+  static LuaChunkCache cache;
+  return cache;
+}
+
+LuaChunkCache::Bytecode LuaChunkCache::Find(std::string_view source) {
+  auto hash = std::hash<std::string_view>{}(source);
+
+  std::lock_guard lock(mutex_);
+
+  auto it = index_.find(hash);
+  if (it == index_.end() || it->second->source != source) {
+    misses_++;
+    return nullptr;
+  }
+
+  // move to the most recently used position
+  lru_.splice(lru_.begin(), lru_, it->second);
+  hits_++;
+
+  return it->second->bytecode;
+}
+
+void LuaChunkCache::Insert(std::string_view source, std::string bytecode) {
+  auto hash = std::hash<std::string_view>{}(source);
+  auto size = source.size() + bytecode.size();
+
+  std::lock_guard lock(mutex_);
+
+  if (size > options_.max_bytes || options_.max_entries == 0) {
+    return;
+  }
+
+  // replace the previous entry (also covers hash collisions)
+  if (auto it = index_.find(hash); it != index_.end()) {
+    Erase(it->second);
+  }
+
+  EvictToFit(size);
+
+  lru_.push_front(Entry{hash, std::string(source), std::make_shared<const std::string>(std::move(bytecode))});
+  index_.emplace(hash, lru_.begin());
+  bytes_ += size;
+}
+
+void LuaChunkCache::Configure(const Options& options) {
+  std::lock_guard lock(mutex_);
+  options_ = options;
+  EvictToFit(0);
+}
+
+void LuaChunkCache::Clear() {
+  std::lock_guard lock(mutex_);
+  lru_.clear();
+  index_.clear();
+  bytes_ = 0;
+  hits_ = 0;
+  misses_ = 0;
+  evictions_ = 0;
+}
+
+LuaChunkCache::Stats LuaChunkCache::GetStats() {
+  std::lock_guard lock(mutex_);
+  return Stats{hits_, misses_, evictions_, lru_.size(), bytes_, options_.max_bytes, options_.max_entries};
+}
+
+void LuaChunkCache::Erase(std::list<Entry>::iterator it) {
+  bytes_ -= it->Size();
+  index_.erase(it->hash);
+  lru_.erase(it);
+}
+
+void LuaChunkCache::EvictToFit(size_t incoming_size) {
+  while (!lru_.empty() && (bytes_ + incoming_size > options_.max_bytes || lru_.size() + (incoming_size ? 1 : 0) > options_.max_entries)) {
+    Erase(std::prev(lru_.end()));
+    evictions_++;
+  }
+}
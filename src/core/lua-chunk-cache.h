@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * Process-wide LRU cache of compiled chunks.
+ *
+ * Entries are keyed by the source text and hold the output of lua_dump, so a
+ * repeated eval of the same snippet skips lexing and parsing in every state.
+ * The cache is shared between worker threads and guarded by a mutex.
+ */
+class LuaChunkCache {
+public:
+  struct Options {
+    size_t max_bytes = 32 * 1024 * 1024;
+    size_t max_entries = 1024;
+  };
+
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t max_bytes = 0;
+    size_t max_entries = 0;
+  };
+
+  using Bytecode = std::shared_ptr<const std::string>;
+
+  static LuaChunkCache& Shared();
+
+  Bytecode Find(std::string_view source);
+  void Insert(std::string_view source, std::string bytecode);
+
+  void Configure(const Options&);
+  void Clear();
+  Stats GetStats();
+
+private:
+  struct Entry {
+    size_t hash;
+    std::string source;
+    Bytecode bytecode;
+
+    size_t Size() const { return source.size() + bytecode->size(); }
+  };
+
+  std::mutex mutex_;
+  Options options_;
+  std::list<Entry> lru_;
+  std::unordered_map<size_t, std::list<Entry>::iterator> index_;
+  size_t bytes_ = 0;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+  size_t evictions_ = 0;
+
+  void Erase(std::list<Entry>::iterator);
+  void EvictToFit(size_t incoming_size);
+};
@@ -26,6 +26,20 @@ static int lua_absindex_compat(lua_State* L, int idx) { return (idx > 0 || idx <
 #define lua_absindex(L, idx) lua_absindex_compat(L, idx)
 #endif
 
+//
+// --- lua_rawlen (added in Lua 5.2) ---
+//
+#if LUA_VERSION_NUM < 502 && !defined(lua_rawlen)
+#define lua_rawlen(L, idx) lua_objlen(L, idx)
+#endif
+
+//
+// --- lua_pushglobaltable (added in Lua 5.2) ---
+//
+#if LUA_VERSION_NUM < 502 && !defined(lua_pushglobaltable)
+#define lua_pushglobaltable(L) lua_pushvalue(L, LUA_GLOBALSINDEX)
+#endif
+
 //
 // --- luaL_getsubtable (added in Lua 5.2) ---
 //
@@ -122,3 +136,17 @@ inline void lua_seti_compat(lua_State* L, int index, lua_Integer n) {
 }
 #define lua_seti(L, index, n) lua_seti_compat(L, index, n)
 #endif
+
+//
+// --- lua_dump strip argument (added in Lua 5.3) ---
+//
+#if LUA_VERSION_NUM < 503
+#define lua_dump(L, writer, data, strip) lua_dump(L, writer, data)
+#endif
+
+//
+// --- luaL_loadbufferx (added in Lua 5.2, provided by LuaJIT) ---
+//
+#if LUA_VERSION_NUM < 502 && !defined(LUAJIT_VERSION)
+#define luaL_loadbufferx(L, buff, sz, name, mode) luaL_loadbuffer(L, buff, sz, name)
+#endif
@@ -0,0 +1,472 @@
+#include <algorithm>
+#include <charconv>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "core/lua-json.h"
+#include "core/lua-utf8.h"
+
+namespace {
+  constexpr uint64_t LowBytes = LuaUtf8::LowBytes;
+  constexpr uint64_t HighBits = LuaUtf8::HighBits;
+
+  constexpr std::string_view ReplacementChar = "\xEF\xBF\xBD";
+
+  // non-zero if a byte of x is zero
+  inline uint64_t HasZeroByte(uint64_t x) { return (x - LowBytes) & ~x & HighBits; }
+
+  // non-zero if a byte is a control character, a quote or a backslash
+  inline uint64_t HasEscapeByte(uint64_t x) {
+    uint64_t control = (x - LowBytes * 0x20) & ~x & HighBits;
+    uint64_t quote = HasZeroByte(x ^ (LowBytes * '"'));
+    uint64_t backslash = HasZeroByte(x ^ (LowBytes * '\\'));
+    return control | quote | backslash;
+  }
+
+  inline bool IsPlainByte(unsigned char c) { return c >= 0x20 && c < 0x80 && c != '"' && c != '\\'; }
+
+  void AppendUtf8(std::string& out, uint32_t code_point) {
+    if (code_point < 0x80) {
+      out.push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+      out.push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+      out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    } else if (code_point < 0x10000) {
+      out.push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    } else {
+      out.push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+  }
+
+  bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+} // namespace
+
+void LuaJson::AppendString(std::string& out, std::string_view str) {
+  static constexpr char Hex[] = "0123456789abcdef";
+
+  const auto* p = reinterpret_cast<const unsigned char*>(str.data());
+  const auto* end = p + str.size();
+
+  out.reserve(out.size() + str.size() + 2);
+  out.push_back('"');
+
+  while (p < end) {
+    const auto* run = p;
+
+    // plain runs are checked 8 bytes at a time
+    while (end - p >= 8) {
+      uint64_t chunk;
+      std::memcpy(&chunk, p, sizeof(chunk));
+
+      // bytes above 0x7f start multibyte sequences which are validated one by one
+      if (HasEscapeByte(chunk) | (chunk & HighBits)) {
+        break;
+      }
+
+      p += 8;
+    }
+
+    while (p < end && IsPlainByte(*p)) {
+      p++;
+    }
+
+    out.append(reinterpret_cast<const char*>(run), static_cast<size_t>(p - run));
+
+    if (p == end) {
+      break;
+    }
+
+    unsigned char c = *p;
+
+    if (c >= 0x80) {
+      size_t length = LuaUtf8::GetSequenceLength(p, end);
+
+      if (length) {
+        out.append(reinterpret_cast<const char*>(p), length);
+        p += length;
+      } else {
+        out.append(ReplacementChar);
+        p++;
+      }
+      continue;
+    }
+
+    switch (c) {
+      case '"':
+        out.append("\\\"");
+        break;
+      case '\\':
+        out.append("\\\\");
+        break;
+      case '\b':
+        out.append("\\b");
+        break;
+      case '\f':
+        out.append("\\f");
+        break;
+      case '\n':
+        out.append("\\n");
+        break;
+      case '\r':
+        out.append("\\r");
+        break;
+      case '\t':
+        out.append("\\t");
+        break;
+      default: {
+        char escape[] = {'\\', 'u', '0', '0', Hex[c >> 4], Hex[c & 0xf]};
+        out.append(escape, sizeof(escape));
+        break;
+      }
+    }
+
+    p++;
+  }
+
+  out.push_back('"');
+}
+
+bool LuaJson::AppendNumber(std::string& out, double value) {
+  if (!std::isfinite(value)) {
+    return false;
+  }
+
+  // covers -0 as well
+  if (value == 0) {
+    out.push_back('0');
+    return true;
+  }
+
+  double abs = std::fabs(value);
+
+  if (abs < 9007199254740992.0 && value == std::trunc(value)) {
+    char buf[24];
+    char* end = std::to_chars(buf, buf + sizeof(buf), static_cast<int64_t>(value)).ptr;
+    out.append(buf, static_cast<size_t>(end - buf));
+    return true;
+  }
+
+  // shortest round-trip digits, laid out like Number::toString: 2^60 is "1152921504606847000", not the exact value
+  char sci[32];
+  char* sci_end = std::to_chars(sci, sci + sizeof(sci), abs, std::chars_format::scientific).ptr;
+  char* e = std::find(sci, sci_end, 'e');
+
+  char digits[24];
+  int k = 0;
+  for (char* c = sci; c < e; c++) {
+    if (*c != '.') {
+      digits[k++] = *c;
+    }
+  }
+
+  // decimal exponent n of 0.digits * 10^n
+  int n = 0;
+  std::from_chars(e + (e[1] == '+' ? 2 : 1), sci_end, n);
+  n++;
+
+  if (value < 0) {
+    out.push_back('-');
+  }
+
+  if (k <= n && n <= 21) {
+    out.append(digits, static_cast<size_t>(k));
+    out.append(static_cast<size_t>(n - k), '0');
+  } else if (0 < n && n <= 21) {
+    out.append(digits, static_cast<size_t>(n));
+    out.push_back('.');
+    out.append(digits + n, static_cast<size_t>(k - n));
+  } else if (-6 < n && n <= 0) {
+    out.append("0.");
+    out.append(static_cast<size_t>(-n), '0');
+    out.append(digits, static_cast<size_t>(k));
+  } else {
+    out.push_back(digits[0]);
+    if (k > 1) {
+      out.push_back('.');
+      out.append(digits + 1, static_cast<size_t>(k - 1));
+    }
+    out.push_back('e');
+    out.push_back(n > 0 ? '+' : '-');
+    char buf[8];
+    char* end = std::to_chars(buf, buf + sizeof(buf), n > 0 ? n - 1 : 1 - n).ptr;
+    out.append(buf, static_cast<size_t>(end - buf));
+  }
+
+  return true;
+}
+
+void LuaJson::AppendNumberKey(std::string& out, double value) {
+  out.push_back('"');
+
+  if (!AppendNumber(out, value)) {
+    out.append(std::isnan(value) ? "NaN" : value > 0 ? "Infinity" : "-Infinity");
+  }
+
+  out.push_back('"');
+}
+
+double LuaJson::ParseNumber(std::string_view text) {
+  // strtod needs a NUL-terminated copy, floating-point std::from_chars is missing from Apple libc++
+  char buf[64];
+  std::string long_text;
+  char* str = buf;
+
+  if (text.size() < sizeof(buf)) {
+    std::memcpy(buf, text.data(), text.size());
+    buf[text.size()] = '\0';
+  } else {
+    long_text.assign(text);
+    str = long_text.data();
+  }
+
+  // strtod reads the decimal point of the current locale
+  if (auto dot = text.find('.'); dot != std::string_view::npos) {
+    char point = *std::localeconv()->decimal_point;
+    str[dot] = point ? point : '.';
+  }
+
+  // out of range numbers are infinities or zeros like in JSON.parse, which is what strtod returns for them
+  return std::strtod(str, nullptr);
+}
+
+// Reader
+
+void LuaJson::Reader::SkipWhitespace() {
+  while (pos_ < json_.size()) {
+    char c = json_[pos_];
+
+    if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+      break;
+    }
+
+    pos_++;
+  }
+}
+
+char LuaJson::Reader::Peek() {
+  SkipWhitespace();
+  return pos_ < json_.size() ? json_[pos_] : 0;
+}
+
+bool LuaJson::Reader::TryConsume(char c) {
+  if (Peek() != c) {
+    return false;
+  }
+
+  pos_++;
+  return true;
+}
+
+void LuaJson::Reader::Expect(char c) {
+  if (!TryConsume(c)) {
+    Fail(std::string_view(&c, 1));
+  }
+}
+
+void LuaJson::Reader::ExpectLiteral(std::string_view literal) {
+  SkipWhitespace();
+
+  if (json_.substr(pos_, literal.size()) != literal) {
+    Fail(literal);
+  }
+
+  pos_ += literal.size();
+}
+
+double LuaJson::Reader::ReadNumber() {
+  SkipWhitespace();
+
+  size_t start = pos_;
+  auto skip_digits = [&]() {
+    size_t digits_start = pos_;
+    while (pos_ < json_.size() && IsDigit(json_[pos_])) {
+      pos_++;
+    }
+    return pos_ > digits_start;
+  };
+  auto at = [&](char c) { return pos_ < json_.size() && json_[pos_] == c; };
+
+  if (at('-')) {
+    pos_++;
+  }
+
+  // no leading zeros
+  if (at('0')) {
+    pos_++;
+  } else if (!skip_digits()) {
+    pos_ = start;
+    Fail("number");
+  }
+
+  if (at('.')) {
+    pos_++;
+    if (!skip_digits()) {
+      Fail("digit");
+    }
+  }
+
+  if (at('e') || at('E')) {
+    pos_++;
+    if (at('+') || at('-')) {
+      pos_++;
+    }
+    if (!skip_digits()) {
+      Fail("digit");
+    }
+  }
+
+  return ParseNumber(json_.substr(start, pos_ - start));
+}
+
+uint32_t LuaJson::Reader::ReadHex4() {
+  if (json_.size() - pos_ < 4) {
+    Fail("hex digit");
+  }
+
+  uint32_t value = 0;
+  auto [ptr, ec] = std::from_chars(json_.data() + pos_, json_.data() + pos_ + 4, value, 16);
+
+  if (ec != std::errc() || ptr != json_.data() + pos_ + 4) {
+    Fail("hex digit");
+  }
+
+  pos_ += 4;
+  return value;
+}
+
+std::string_view LuaJson::Reader::ReadString() {
+  Expect('"');
+
+  size_t start = pos_;
+  const char* data = json_.data();
+  size_t size = json_.size();
+
+  // strings without escapes are returned as a view of the text, plain runs are checked 8 bytes at a time
+  while (size - pos_ >= 8) {
+    uint64_t chunk;
+    std::memcpy(&chunk, data + pos_, sizeof(chunk));
+
+    if (HasEscapeByte(chunk)) {
+      break;
+    }
+
+    pos_ += 8;
+  }
+
+  while (pos_ < size) {
+    unsigned char c = static_cast<unsigned char>(data[pos_]);
+
+    if (c == '"') {
+      return json_.substr(start, pos_++ - start);
+    }
+
+    if (c == '\\') {
+      break;
+    }
+
+    if (c < 0x20) {
+      Fail("end of string");
+    }
+
+    pos_++;
+  }
+
+  if (pos_ >= size) {
+    Fail("end of string");
+  }
+
+  scratch_.assign(data + start, pos_ - start);
+
+  while (pos_ < size) {
+    char c = data[pos_++];
+
+    if (c == '"') {
+      return scratch_;
+    }
+
+    if (static_cast<unsigned char>(c) < 0x20) {
+      pos_--;
+      Fail("end of string");
+    }
+
+    if (c != '\\') {
+      scratch_.push_back(c);
+      continue;
+    }
+
+    if (pos_ >= size) {
+      break;
+    }
+
+    switch (char escape = data[pos_++]) {
+      case '"':
+      case '\\':
+      case '/':
+        scratch_.push_back(escape);
+        break;
+      case 'b':
+        scratch_.push_back('\b');
+        break;
+      case 'f':
+        scratch_.push_back('\f');
+        break;
+      case 'n':
+        scratch_.push_back('\n');
+        break;
+      case 'r':
+        scratch_.push_back('\r');
+        break;
+      case 't':
+        scratch_.push_back('\t');
+        break;
+      case 'u': {
+        uint32_t code_point = ReadHex4();
+
+        if (code_point >= 0xd800 && code_point <= 0xdbff && json_.substr(pos_, 2) == "\\u") {
+          size_t low_pos = pos_;
+          pos_ += 2;
+          uint32_t low = ReadHex4();
+
+          if (low >= 0xdc00 && low <= 0xdfff) {
+            code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+          } else {
+            pos_ = low_pos;
+          }
+        }
+
+        // lone surrogates have no UTF-8 form
+        if (code_point >= 0xd800 && code_point <= 0xdfff) {
+          scratch_.append(ReplacementChar);
+        } else {
+          AppendUtf8(scratch_, code_point);
+        }
+        break;
+      }
+      default:
+        pos_--;
+        Fail("escape sequence");
+    }
+  }
+
+  Fail("end of string");
+}
+
+void LuaJson::Reader::Fail(std::string_view expected) {
+  std::string message;
+
+  if (pos_ >= json_.size()) {
+    message = "Unexpected end of JSON input, expected " + std::string(expected);
+  } else {
+    message = "Unexpected character at position " + std::to_string(pos_) + ", expected " + std::string(expected);
+  }
+
+  throw Error(Error::Code::Invalid, message);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+/**
+ * JSON text for Lua values without a JS object graph in between.
+ *
+ * Output follows JSON.stringify of the value getGlobal would return: nil is
+ * null, non-finite numbers are null, functions are left out of tables, Lua
+ * strings are written as UTF-8 with invalid bytes replaced by U+FFFD. Plain
+ * runs of a string are scanned and copied 8 bytes at a time. Input is parsed
+ * straight into Lua values, objects and arrays become tables.
+ */
+struct LuaJson {
+  // nesting of tables, deeper values fail instead of exhausting the C stack
+  static constexpr int MaxDepth = 1000;
+
+  class Error : public std::runtime_error {
+  public:
+    enum class Code { Invalid, Circular, TooDeep };
+
+    Error(Code code, const std::string& message) : std::runtime_error(message), code_(code) {}
+    Code GetCode() const { return code_; }
+
+  private:
+    Code code_;
+  };
+
+  // Appends a quoted JSON string
+  static void AppendString(std::string& out, std::string_view str);
+  // Appends a number in the notation of JS, returns false for NaN and infinities
+  static bool AppendNumber(std::string& out, double value);
+  // Appends a number as a quoted property name like JS converts number keys
+  static void AppendNumberKey(std::string& out, double value);
+  // Parses the text of a number, which must have been validated (strtod also accepts hex and infinities)
+  static double ParseNumber(std::string_view text);
+
+  class Reader {
+  public:
+    explicit Reader(std::string_view json) : json_(json) {}
+
+    // next character after whitespace, 0 at the end of the text
+    char Peek();
+    bool TryConsume(char c);
+    void Expect(char c);
+    void ExpectLiteral(std::string_view literal);
+    bool IsEnd() { return Peek() == 0; }
+
+    double ReadNumber();
+    // the view is valid until the next ReadString
+    std::string_view ReadString();
+
+    [[noreturn]] void Fail(std::string_view expected);
+
+  private:
+    std::string_view json_;
+    size_t pos_ = 0;
+    // unescaped strings
+    std::string scratch_;
+
+    void SkipWhitespace();
+    uint32_t ReadHex4();
+  };
+};
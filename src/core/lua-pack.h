@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+/**
+ * Compact binary format for bulk transfers of Lua values.
+ *
+ * A packed value is a 3 byte header ("LP" and the format version) followed
+ * by one tagged value. Numbers are little-endian, lengths and indexes are
+ * unsigned LEB128 varints. Tables get an index in the order their tag is
+ * written and are referenced by it afterwards, so shared and cyclic tables
+ * keep their identity. Short strings can be defined once and referenced by
+ * index, which makes repeated keys of records cheap. js/lua-pack.js is the
+ * JS side of the format.
+ *
+ *   Nil                     Float64 f64         String len bytes
+ *   False                   Array n value*n     StringDef len bytes
+ *   True                    Map u32 (key value)*u32
+ *   Int32 i32               TableRef index      StringRef index
+ */
+struct LuaPack {
+  static constexpr char Magic[2] = {'L', 'P'};
+  static constexpr uint8_t FormatVersion = 1;
+  static constexpr size_t HeaderSize = 3;
+  // nesting of tables, deeper values fail instead of exhausting the C stack
+  static constexpr int MaxDepth = 1000;
+  // strings up to this length are defined once and referenced afterwards
+  static constexpr size_t MaxRefStringLength = 40;
+
+  enum Tag : uint8_t {
+    Nil = 0x00,
+    False = 0x01,
+    True = 0x02,
+    Int32 = 0x03,
+    Float64 = 0x04,
+    String = 0x05,
+    StringDef = 0x06,
+    StringRef = 0x07,
+    Array = 0x08,
+    Map = 0x09,
+    TableRef = 0x0a,
+  };
+
+  class Error : public std::runtime_error {
+  public:
+    enum class Code { Invalid, TooDeep };
+
+    Error(Code code, const std::string& message) : std::runtime_error(message), code_(code) {}
+    Code GetCode() const { return code_; }
+
+  private:
+    Code code_;
+  };
+
+  class Writer {
+  public:
+    explicit Writer(std::string& out) : out_(out) {}
+
+    void WriteHeader() {
+      out_.append(Magic, sizeof(Magic));
+      out_.push_back(static_cast<char>(FormatVersion));
+    }
+
+    void WriteTag(Tag tag) { out_.push_back(static_cast<char>(tag)); }
+
+    void WriteVarUint(uint64_t value) {
+      while (value >= 0x80) {
+        out_.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+      }
+      out_.push_back(static_cast<char>(value));
+    }
+
+    template <typename T> void WriteFixed(T value) {
+      // the supported targets are little-endian, which is also the byte order of the format
+      char bytes[sizeof(T)];
+      std::memcpy(bytes, &value, sizeof(T));
+      out_.append(bytes, sizeof(T));
+    }
+
+    void WriteBytes(std::string_view bytes) {
+      WriteVarUint(bytes.size());
+      out_.append(bytes);
+    }
+
+    // position of a fixed value written later with PatchFixed
+    size_t Reserve(size_t size) {
+      size_t pos = out_.size();
+      out_.append(size, '\0');
+      return pos;
+    }
+
+    template <typename T> void PatchFixed(size_t pos, T value) { std::memcpy(out_.data() + pos, &value, sizeof(T)); }
+
+    size_t Size() const { return out_.size(); }
+
+    // removes and returns the bytes written from pos, to write them again in another layout
+    std::string Cut(size_t pos) {
+      std::string tail(out_, pos);
+      out_.resize(pos);
+      return tail;
+    }
+
+    void WriteRaw(std::string_view bytes) { out_.append(bytes); }
+
+  private:
+    std::string& out_;
+  };
+
+  class Reader {
+  public:
+    explicit Reader(std::string_view data) : data_(data) {}
+
+    void ReadHeader() {
+      if (data_.size() < HeaderSize || data_[0] != Magic[0] || data_[1] != Magic[1]) {
+        throw Error(Error::Code::Invalid, "Not a packed Lua value");
+      }
+
+      if (static_cast<uint8_t>(data_[2]) != FormatVersion) {
+        throw Error(Error::Code::Invalid, "Unsupported pack format version " + std::to_string(static_cast<uint8_t>(data_[2])));
+      }
+
+      pos_ = HeaderSize;
+    }
+
+    bool IsEnd() const { return pos_ == data_.size(); }
+
+    Tag ReadTag() { return static_cast<Tag>(ReadFixed<uint8_t>()); }
+
+    uint64_t ReadVarUint() {
+      uint64_t value = 0;
+
+      for (int shift = 0; shift < 64; shift += 7) {
+        auto byte = ReadFixed<uint8_t>();
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80)) {
+          return value;
+        }
+      }
+
+      throw Error(Error::Code::Invalid, "Malformed varint");
+    }
+
+    template <typename T> T ReadFixed() {
+      Require(sizeof(T));
+
+      T value;
+      std::memcpy(&value, data_.data() + pos_, sizeof(T));
+      pos_ += sizeof(T);
+      return value;
+    }
+
+    std::string_view ReadBytes() {
+      auto size = ReadVarUint();
+      Require(size);
+
+      auto bytes = data_.substr(pos_, size);
+      pos_ += size;
+      return bytes;
+    }
+
+    // every element takes at least one byte, larger counts are malformed
+    void RequireElements(uint64_t count) { Require(count); }
+
+  private:
+    std::string_view data_;
+    size_t pos_ = 0;
+
+    void Require(uint64_t size) {
+      if (size > data_.size() - pos_) {
+        throw Error(Error::Code::Invalid, "Unexpected end of packed data");
+      }
+    }
+  };
+};
@@ -1,7 +1,13 @@
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <new>
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "core/lua-compat-defines.h"
@@ -14,15 +20,64 @@ extern "C" {
 }
 
 namespace {
+  // registry key of the owning LuaStateCore, read by the budget hook
+  char CoreRegistryKey;
+
   std::unordered_map<std::string, lua_CFunction> BuildLuaLibFunctionsMap();
 
+  // function and data run by ProtectedLuaCb
+  struct ProtectedCallCtx {
+    int (*invoke)(lua_State*, void*);
+    void* data;
+  };
+
   int TracebackLuaCb(lua_State*);
+  int PanicLuaCb(lua_State*);
+  int ProtectedLuaCb(lua_State*);
+  int LoadBundleChunkLuaCb(lua_State*);
+  int GcBundleLuaCb(lua_State*);
+  int GcLuaCb(lua_State*);
+
+  bool IsWeakTable(lua_State*, int table_index);
+  void SnapshotTables(lua_State*, int copies_index, int metas_index, int pending_index, int pending_count);
+  void RestoreTable(lua_State*, int table_index, int copy_index);
+#if LUA_VERSION_NUM >= 504
+  void WarnOffLuaCb(void*, const char*, int);
+#endif
 } // namespace
 
 /**
  * Constructor
  */
-LuaStateCore::LuaStateCore() : L_(luaL_newstate()) {}
+LuaStateCore::LuaStateCore(const LuaAllocatorOptions& allocator_options)
+  : allocator_(std::make_unique<LuaAllocator>(allocator_options)), L_(lua_newstate(LuaAllocator::Allocate, allocator_.get())) {
+#ifdef LUAJIT_VERSION
+  // 64-bit LuaJIT builds without GC64 reject custom allocators
+  if (!L_) {
+    allocator_.reset();
+    L_ = luaL_newstate();
+  }
+#endif
+
+  // not enough memory for the base state (e.g. too small memory limit)
+  if (!L_) {
+    is_closed_ = true;
+    return;
+  }
+
+  // same defaults as luaL_newstate
+  lua_atpanic(L_, PanicLuaCb);
+#if LUA_VERSION_NUM >= 504
+  lua_setwarnf(L_, WarnOffLuaCb, L_);
+#endif
+
+  lua_pushlightuserdata(L_, &CoreRegistryKey);
+  lua_pushlightuserdata(L_, this);
+  lua_rawset(L_, LUA_REGISTRYINDEX);
+
+  // the memory limit is enforced by PCall and Protect, an unprotected allocation failure would abort
+  EnforceMemoryLimit(false);
+}
 
 /**
  * Destructor
@@ -39,25 +94,82 @@ void LuaStateCore::Close() {
   is_closed_ = true;
   lua_close(L_);
   L_ = nullptr;
+  baseline_ref_ = LuaRegistryRef{};
+  budget_.reset();
+  traverse_scratch_ref_ = LuaRegistryRef{};
+  traverse_scratch_top_ = 0;
+  string_anchors_ref_ = LuaRegistryRef{};
+  allocator_.reset();
 }
 
 void LuaStateCore::OpenLibs(const std::optional<std::vector<std::string>>& libs) {
-  if (libs) {
-    auto lua_lib_functions_map = BuildLuaLibFunctionsMap();
+  if (!libs) {
+    Protect(0, [](lua_State* L) {
+      luaL_openlibs(L);
+      return 0;
+    });
+    return;
+  }
+
+  auto lua_lib_functions_map = BuildLuaLibFunctionsMap();
 
+  Protect(0, [&](lua_State* L) {
     for (const auto& lib_for_open : libs.value()) {
       auto lua_lib_function_map_item = lua_lib_functions_map.find(lib_for_open);
       if (lua_lib_function_map_item == lua_lib_functions_map.end()) {
         continue;
       }
-      luaL_requiref(L_, lib_for_open.c_str(), lua_lib_function_map_item->second, 1);
-      if (lib_for_open != "base") {
-        lua_pop(L_, 1);
-      }
+      luaL_requiref(L, lib_for_open.c_str(), lua_lib_function_map_item->second, 1);
+      lua_pop(L, 1);
     }
-  } else {
-    luaL_openlibs(L_);
+    return 0;
+  });
+}
+
+LuaAllocator* LuaStateCore::GetAllocator(lua_State* L) {
+  void* ud = nullptr;
+  return lua_getallocf(L, &ud) == LuaAllocator::Allocate ? static_cast<LuaAllocator*>(ud) : nullptr;
+}
+
+bool LuaStateCore::EnforceMemoryLimit(bool enforced) { return allocator_ && allocator_->SetLimitEnforced(enforced); }
+
+bool LuaStateCore::HasMemoryLimit() const { return allocator_ && allocator_->GetStats().limit; }
+
+bool LuaStateCore::CheckMemoryLimit() {
+  if (!allocator_ || !allocator_->IsOverLimit()) {
+    return true;
+  }
+
+  // garbage may account for the excess, as with the emergency collection before a failed allocation
+  GcCollect();
+
+  return !allocator_->IsOverLimit();
+}
+
+int LuaStateCore::ProtectedCall(int args_count, int (*invoke)(lua_State*, void*), void* data) {
+  ProtectedCallCtx ctx{invoke, data};
+
+  int base_index = lua_gettop(L_) - args_count;
+
+  lua_pushcfunction(L_, ProtectedLuaCb);
+  lua_insert(L_, base_index + 1);
+  lua_pushlightuserdata(L_, &ctx);
+  lua_insert(L_, base_index + 2);
+
+  bool was_enforced = EnforceMemoryLimit(true);
+  int status = lua_pcall(L_, args_count + 1, LUA_MULTRET, 0);
+  EnforceMemoryLimit(was_enforced);
+
+  if (status == LUA_ERRMEM) {
+    lua_pop(L_, 1);
+    throw MemoryException{};
   }
+
+  if (status != LUA_OK) {
+    throw LuaException{};
+  }
+
+  return lua_gettop(L_) - base_index;
 }
 
 LuaRegistryRef LuaStateCore::PopRef() { return LuaRegistryRef{luaL_ref(L_, LUA_REGISTRYINDEX)}; }
@@ -73,6 +185,58 @@ void LuaStateCore::PushRef(const LuaRegistryRef& ref) { lua_rawgeti(L_, LUA_REGI
 
 int LuaStateCore::GetTop() { return lua_gettop(L_); }
 
+void LuaStateCore::PushTraverseScratch() {
+  if (traverse_scratch_ref_.value == LUA_NOREF) {
+    lua_createtable(L_, 16, 0);
+    traverse_scratch_ref_ = CopyRef(-1);
+    return;
+  }
+
+  PushRef(traverse_scratch_ref_);
+}
+
+void LuaStateCore::ClearTraverseScratch(int base) {
+  PushRef(traverse_scratch_ref_);
+
+  for (; traverse_scratch_top_ > base; traverse_scratch_top_--) {
+    lua_pushnil(L_);
+    lua_rawseti(L_, -2, traverse_scratch_top_);
+  }
+
+  lua_pop(L_, 1);
+}
+
+LuaRegistryRef LuaStateCore::InternString(std::string_view str, const char*& ptr) {
+  lua_pushlstring(L_, str.data(), str.size());
+  ptr = lua_tostring(L_, -1);
+  return PopRef();
+}
+
+void LuaStateCore::AnchorString(int index) {
+  index = lua_absindex(L_, index);
+
+  if (string_anchors_ref_.value == LUA_NOREF) {
+    lua_newtable(L_);
+    string_anchors_ref_ = CopyRef(-1);
+  } else {
+    PushRef(string_anchors_ref_);
+  }
+
+  lua_pushvalue(L_, index);
+  lua_pushboolean(L_, 1);
+  lua_rawset(L_, -3);
+  lua_pop(L_, 1);
+}
+
+void LuaStateCore::ClearStringAnchors() {
+  if (string_anchors_ref_.value == LUA_NOREF) {
+    return;
+  }
+
+  ReleaseRef(string_anchors_ref_);
+  string_anchors_ref_ = LuaRegistryRef{};
+}
+
 void LuaStateCore::Pop(int n) { lua_pop(L_, n); }
 
 void LuaStateCore::PushNil() { lua_pushnil(L_); }
@@ -99,15 +263,95 @@ void* LuaStateCore::NewUserData(size_t size) { return lua_newuserdata(L_, size);
 
 void LuaStateCore::SetField(int table_index, std::string_view key) { lua_setfield(L_, table_index, key.data()); }
 
+int LuaStateCore::GetType(int index) { return lua_type(L_, index); }
+
+bool LuaStateCore::IsNil(int index) { return lua_isnil(L_, index); }
+
+bool LuaStateCore::IsTable(int index) { return lua_istable(L_, index); }
+
+const char* LuaStateCore::GetTypeName(int index) { return lua_typename(L_, lua_type(L_, index)); }
+
+bool LuaStateCore::ToBool(int index) { return lua_toboolean(L_, index) != 0; }
+
+double LuaStateCore::ToNumber(int index) { return lua_tonumber(L_, index); }
+
+std::string_view LuaStateCore::ToString(int index) {
+  size_t len;
+  const char* ptr = lua_tolstring(L_, index, &len);
+  return {ptr, len};
+}
+
+const void* LuaStateCore::ToPointer(int index) { return lua_topointer(L_, index); }
+
+void* LuaStateCore::GetCClosureUserData(int index, lua_CFunction fn, int n) {
+  if (lua_tocfunction(L_, index) != fn || !lua_getupvalue(L_, index, n)) {
+    return nullptr;
+  }
+
+  void* data = lua_touserdata(L_, -1);
+  lua_pop(L_, 1);
+  return data;
+}
+
+void* LuaStateCore::TestUserData(int index, std::string_view meta_table_name) {
+  void* data = lua_touserdata(L_, index);
+  if (!data || !lua_getmetatable(L_, index)) {
+    return nullptr;
+  }
+
+  luaL_getmetatable(L_, meta_table_name.data());
+  bool matches = lua_rawequal(L_, -1, -2);
+  lua_pop(L_, 2);
+
+  return matches ? data : nullptr;
+}
+
+void LuaStateCore::RawGet(int table_index) { lua_rawget(L_, table_index); }
+
+void LuaStateCore::RawSet(int table_index) { lua_rawset(L_, table_index); }
+
+void LuaStateCore::GetTableKeys(int index, std::vector<LuaTableKey>& keys) {
+  index = lua_absindex(L_, index);
+
+  lua_pushnil(L_);
+  while (lua_next(L_, index)) {
+    lua_pop(L_, 1);
+
+    if (lua_type(L_, -1) == LUA_TNUMBER) {
+      keys.emplace_back(LuaNumber{lua_tonumber(L_, -1)});
+    } else if (lua_type(L_, -1) == LUA_TSTRING) {
+      size_t len;
+      const char* ptr = lua_tolstring(L_, -1, &len);
+      // the table keeps the string alive
+      keys.emplace_back(LuaString{ptr, len});
+    }
+  }
+}
+
 void LuaStateCore::SetIndex(int table_index, int i) { lua_seti(L_, table_index, i); }
 
 void LuaStateCore::SetMetaTable(int index) { lua_setmetatable(L_, index); }
 
-void LuaStateCore::SetGlobal(std::string_view name) { lua_setglobal(L_, name.data()); }
+void LuaStateCore::SetGlobal(std::string_view name) {
+  ProtectLimited(1, [&](lua_State* L) {
+    lua_setglobal(L, name.data());
+    return 0;
+  });
+}
 
 void LuaStateCore::Error(std::string_view msg) { luaL_error(L_, msg.data()); }
 
 LuaStateCore::PushValueByPathStatus LuaStateCore::PushValueByPath(std::string_view path) {
+  // interning the segments and __index metamethods may run out of memory
+  auto status = PushValueByPathStatus::NotFound;
+  ProtectLimited(0, [&](lua_State*) {
+    status = LookupValueByPath(path);
+    return status == PushValueByPathStatus::Found ? 1 : 0;
+  });
+  return status;
+}
+
+LuaStateCore::PushValueByPathStatus LuaStateCore::LookupValueByPath(std::string_view path) {
   if (path.empty()) {
     return LuaStateCore::PushValueByPathStatus::NotFound;
   }
@@ -154,6 +398,116 @@ LuaStateCore::PushValueByPathStatus LuaStateCore::PushValueByPath(std::string_vi
   return LuaStateCore::PushValueByPathStatus::Found;
 }
 
+std::vector<LuaRegistryRef> LuaStateCore::PreparePath(std::string_view path) {
+  std::vector<LuaRegistryRef> segments;
+
+  if (path.empty()) {
+    return segments;
+  }
+
+  size_t current_pos = 0;
+
+  while (true) {
+    size_t dot_pos = path.find(".", current_pos);
+    bool is_last_segment = dot_pos == std::string_view::npos;
+
+    std::string_view segment = is_last_segment ? path.substr(current_pos) : path.substr(current_pos, dot_pos - current_pos);
+
+    lua_pushlstring(L_, segment.data(), segment.size());
+    segments.push_back(PopRef());
+
+    if (is_last_segment) {
+      break;
+    }
+
+    current_pos = dot_pos + 1;
+  }
+
+  return segments;
+}
+
+void LuaStateCore::ReleasePath(const std::vector<LuaRegistryRef>& segments) {
+  for (const auto& segment : segments) {
+    ReleaseRef(segment);
+  }
+}
+
+LuaStateCore::PushValueByPathStatus LuaStateCore::PushValueByPath(const std::vector<LuaRegistryRef>& segments) {
+  auto status = PushValueByPathStatus::NotFound;
+  ProtectLimited(0, [&](lua_State*) {
+    status = LookupValueByPath(segments);
+    return status == PushValueByPathStatus::Found ? 1 : 0;
+  });
+  return status;
+}
+
+LuaStateCore::PushValueByPathStatus LuaStateCore::LookupValueByPath(const std::vector<LuaRegistryRef>& segments) {
+  if (segments.empty()) {
+    return LuaStateCore::PushValueByPathStatus::NotFound;
+  }
+
+  lua_pushglobaltable(L_);
+
+  for (size_t i = 0; i < segments.size(); i++) {
+    if (i > 0 && !lua_istable(L_, -1)) {
+      lua_pop(L_, 1);
+      return LuaStateCore::PushValueByPathStatus::BrokenPath;
+    }
+
+    lua_rawgeti(L_, LUA_REGISTRYINDEX, segments[i].value);
+    lua_gettable(L_, -2);
+    lua_remove(L_, -2);
+
+    if (lua_isnil(L_, -1)) {
+      lua_pop(L_, 1);
+      return i == 0 ? LuaStateCore::PushValueByPathStatus::NotFound : LuaStateCore::PushValueByPathStatus::BrokenPath;
+    }
+  }
+
+  return LuaStateCore::PushValueByPathStatus::Found;
+}
+
+/**
+ * Assigns the value on top of the stack (and pops it), fails when the parent path is not a table
+ */
+bool LuaStateCore::SetValueByPath(const std::vector<LuaRegistryRef>& segments) {
+  bool is_set = false;
+  ProtectLimited(1, [&](lua_State*) {
+    is_set = AssignValueByPath(segments);
+    return 0;
+  });
+  return is_set;
+}
+
+bool LuaStateCore::AssignValueByPath(const std::vector<LuaRegistryRef>& segments) {
+  int value_index = lua_gettop(L_);
+
+  if (segments.empty()) {
+    lua_settop(L_, value_index - 1);
+    return false;
+  }
+
+  lua_pushglobaltable(L_);
+
+  for (size_t i = 0; i + 1 < segments.size(); i++) {
+    lua_rawgeti(L_, LUA_REGISTRYINDEX, segments[i].value);
+    lua_gettable(L_, -2);
+    lua_remove(L_, -2);
+
+    if (!lua_istable(L_, -1)) {
+      lua_settop(L_, value_index - 1);
+      return false;
+    }
+  }
+
+  lua_rawgeti(L_, LUA_REGISTRYINDEX, segments.back().value);
+  lua_pushvalue(L_, value_index);
+  lua_settable(L_, -3);
+
+  lua_settop(L_, value_index - 1);
+  return true;
+}
+
 void LuaStateCore::LoadString(std::string_view source) {
   auto load_result = luaL_loadbuffer(L_, source.data(), source.size(), NULL);
   if (load_result != LUA_OK) {
@@ -168,85 +522,1363 @@ void LuaStateCore::LoadFile(std::string_view path) {
   };
 }
 
-int LuaStateCore::PCall(int args_count) {
-  // function stack index
-  int function_index = lua_gettop(L_) - args_count;
+void LuaStateCore::LoadBinary(std::string_view bytecode, std::string_view chunk_name) {
+  auto load_result = luaL_loadbufferx(L_, bytecode.data(), bytecode.size(), chunk_name.data(), "b");
+  if (load_result != LUA_OK) {
+    throw LuaException{};
+  };
+}
 
-  // stack index without function and arguments
-  int pivot_index = function_index - 1;
+std::string LuaStateCore::Dump(int index, bool strip) {
+  std::string bytecode;
 
-  // push TracebackLuaCb function
-  lua_pushcfunction(L_, TracebackLuaCb);
-  lua_insert(L_, function_index);
-  ++pivot_index;
+  lua_pushvalue(L_, index);
 
-  // call lua function on stack
-  int function_call_status = lua_pcall(L_, args_count, LUA_MULTRET, function_index);
-  if (function_call_status != LUA_OK) {
-    throw LuaException{};
-  }
+  lua_dump(
+    L_,
+    [](lua_State*, const void* chunk, size_t size, void* ud) -> int {
+      static_cast<std::string*>(ud)->append(static_cast<const char*>(chunk), size);
+      return 0;
+    },
+    &bytecode,
+    strip
+  );
 
-  int top_index = lua_gettop(L_);
+  lua_pop(L_, 1);
 
-  // return results count
-  return top_index - pivot_index;
+  return bytecode;
 }
 
-std::optional<int> LuaStateCore::GetLength(int index) {
-  auto value_type = lua_type(L_, index);
+struct LuaStateCore::PackContext {
+  LuaPack::Writer writer;
+  bool use_sequences;
+  // indexes of the written tables and defined strings
+  std::unordered_map<const void*, uint32_t> tables;
+  std::unordered_map<const char*, uint32_t> strings;
+  // positions of the elements written for the arrays being packed, and their out of order keys
+  std::vector<size_t> items;
+  std::vector<lua_Integer> skipped;
+};
+
+void LuaStateCore::Pack(int index, bool use_sequences, std::string& out) {
+  PackContext ctx{LuaPack::Writer(out), use_sequences, {}, {}, {}, {}};
+
+  ctx.writer.WriteHeader();
+  PackValue(lua_absindex(L_, index), ctx, 0);
+}
 
-  if (value_type != LUA_TTABLE && value_type != LUA_TSTRING) {
-    return std::nullopt;
-  }
+void LuaStateCore::PackValue(int index, PackContext& ctx, int depth) {
+  auto& writer = ctx.writer;
 
-  lua_len(L_, index);
-  int length = lua_tointeger(L_, -1);
+  switch (lua_type(L_, index)) {
+    case LUA_TBOOLEAN:
+      writer.WriteTag(lua_toboolean(L_, index) ? LuaPack::True : LuaPack::False);
+      break;
+    case LUA_TNUMBER: {
+      double value = lua_tonumber(L_, index);
+
+      if (value >= INT32_MIN && value <= INT32_MAX && value == std::trunc(value) && !(value == 0 && std::signbit(value))) {
+        writer.WriteTag(LuaPack::Int32);
+        writer.WriteFixed<int32_t>(static_cast<int32_t>(value));
+      } else {
+        writer.WriteTag(LuaPack::Float64);
+        writer.WriteFixed<double>(value);
+      }
+      break;
+    }
+    case LUA_TSTRING: {
+      size_t len;
+      const char* ptr = lua_tolstring(L_, index, &len);
 
-  lua_pop(L_, 1);
+      if (len > LuaPack::MaxRefStringLength) {
+        writer.WriteTag(LuaPack::String);
+        writer.WriteBytes({ptr, len});
+        break;
+      }
 
-  return length;
-}
+      // short strings are interned, the address identifies them while they are reachable from the packed value
+      auto [it, is_new] = ctx.strings.try_emplace(ptr, static_cast<uint32_t>(ctx.strings.size()));
 
-std::string LuaStateCore::GetLuaVersion() {
-  std::string compileTime;
+      if (is_new) {
+        writer.WriteTag(LuaPack::StringDef);
+        writer.WriteBytes({ptr, len});
+      } else {
+        writer.WriteTag(LuaPack::StringRef);
+        writer.WriteVarUint(it->second);
+      }
+      break;
+    }
+    case LUA_TTABLE: {
+      auto [it, is_new] = ctx.tables.try_emplace(lua_topointer(L_, index), static_cast<uint32_t>(ctx.tables.size()));
 
-#ifdef LUAJIT_VERSION
-  compileTime = LUAJIT_VERSION;
-#elif defined(LUA_RELEASE)
-  compileTime = LUA_RELEASE;
-#elif defined(LUA_VERSION)
-  compileTime = LUA_VERSION;
-#else
-  compileTime = "Lua (unknown version)";
-#endif
+      if (!is_new) {
+        writer.WriteTag(LuaPack::TableRef);
+        writer.WriteVarUint(it->second);
+        break;
+      }
 
-  lua_getglobal(L_, "_VERSION");
-  std::string runtime = lua_tostring(L_, -1);
-  lua_pop(L_, 1);
+      if (depth >= LuaPack::MaxDepth || !lua_checkstack(L_, 4)) {
+        throw LuaPack::Error(LuaPack::Error::Code::TooDeep, "Tables are nested deeper than " + std::to_string(LuaPack::MaxDepth) + " levels");
+      }
 
-  if (runtime == compileTime || compileTime.find(runtime) != std::string::npos) {
-    return compileTime;
+      PackTable(index, ctx, depth);
+      break;
+    }
+    default:
+      // functions, userdata and threads cannot be packed
+      writer.WriteTag(LuaPack::Nil);
+      break;
   }
-
-  return runtime + " (compiled with " + compileTime + ")";
 }
 
-namespace {
+void LuaStateCore::PackTable(int index, PackContext& ctx, int depth) {
+  auto& writer = ctx.writer;
+
+  // with sequences a table with a raw length starts as an array, its elements are written as the walk meets them in
+  // order. Elements out of order are written after the walk, a key which is not a sequence key turns the table into a map
+  size_t length = ctx.use_sequences ? lua_rawlen(L_, index) : 0;
+  size_t table_pos = writer.Size();
+  size_t items_base = ctx.items.size();
+  size_t skipped_base = ctx.skipped.size();
+  size_t sequence_keys = 0;
+  size_t count_pos = 0;
+  uint32_t count = 0;
+  bool is_array = length > 0;
+
+  if (is_array) {
+    writer.WriteTag(LuaPack::Array);
+    writer.WriteVarUint(length);
+  } else {
+    writer.WriteTag(LuaPack::Map);
+    count_pos = writer.Reserve(sizeof(uint32_t));
+  }
 
-  int TracebackLuaCb(lua_State* L) {
-    lua_createtable(L, 2, 2);
-    auto table_index = lua_absindex(L, -1);
+  auto write_entry = [&](int key_index, int value_index) {
+    PackValue(key_index, ctx, depth + 1);
+    PackValue(value_index, ctx, depth + 1);
+    count++;
+  };
 
-    lua_pushvalue(L, -2);
+  // the written elements keep their bytes and order, so the string and table indexes in them stay valid
+  auto to_map = [&]() {
+    std::string tail = writer.Cut(table_pos);
+    size_t items_count = ctx.items.size() - items_base;
 
-    if (lua_type(L, -1) == LUA_TTABLE) {
-      lua_setfield(L, table_index, "cause");
-    } else {
-      lua_setfield(L, table_index, "message");
+    writer.WriteTag(LuaPack::Map);
+    count_pos = writer.Reserve(sizeof(uint32_t));
+
+    for (size_t i = 0; i < items_count; i++) {
+      size_t begin = ctx.items[items_base + i] - table_pos;
+      size_t end = i + 1 < items_count ? ctx.items[items_base + i + 1] - table_pos : tail.size();
+
+      lua_pushinteger(L_, static_cast<lua_Integer>(i + 1));
+      PackValue(GetTop(), ctx, depth + 1);
+      lua_pop(L_, 1);
+
+      writer.WriteRaw(std::string_view(tail).substr(begin, end - begin));
+      count++;
     }
 
-    luaL_traceback(L, L, nullptr, 1);
-    lua_setfield(L, table_index, "stack");
+    for (size_t i = skipped_base; i < ctx.skipped.size(); i++) {
+      lua_pushinteger(L_, ctx.skipped[i]);
+      lua_rawgeti(L_, index, ctx.skipped[i]);
+      write_entry(GetTop() - 1, GetTop());
+      lua_pop(L_, 2);
+    }
+
+    ctx.items.resize(items_base);
+    ctx.skipped.resize(skipped_base);
+    is_array = false;
+  };
+
+  lua_pushnil(L_);
+  while (lua_next(L_, index)) {
+    int key_type = lua_type(L_, -2);
+
+    // other keys have no JS counterpart
+    if (key_type != LUA_TNUMBER && key_type != LUA_TSTRING) {
+      lua_pop(L_, 1);
+      continue;
+    }
+
+    if (is_array) {
+      if (key_type == LUA_TNUMBER && IsSequenceKey(lua_tonumber(L_, -2), length)) {
+        auto key = static_cast<size_t>(lua_tonumber(L_, -2));
+        sequence_keys++;
+
+        if (ctx.skipped.size() == skipped_base && key == ctx.items.size() - items_base + 1) {
+          ctx.items.push_back(writer.Size());
+          PackValue(GetTop(), ctx, depth + 1);
+        } else {
+          ctx.skipped.push_back(static_cast<lua_Integer>(key));
+        }
+
+        lua_pop(L_, 1);
+        continue;
+      }
+
+      to_map();
+    }
+
+    write_entry(GetTop() - 1, GetTop());
+    lua_pop(L_, 1);
+  }
+
+  if (is_array && sequence_keys == length) {
+    for (size_t i = ctx.items.size() - items_base + 1; i <= length; i++) {
+      lua_rawgeti(L_, index, static_cast<lua_Integer>(i));
+      PackValue(GetTop(), ctx, depth + 1);
+      lua_pop(L_, 1);
+    }
+
+    ctx.items.resize(items_base);
+    ctx.skipped.resize(skipped_base);
+    return;
+  }
+
+  // holes in 1..n
+  if (is_array) {
+    to_map();
+  }
+
+  writer.PatchFixed<uint32_t>(count_pos, count);
+}
+
+struct LuaStateCore::UnpackContext {
+  LuaPack::Reader reader;
+  // stack index of a table with the unpacked tables by index + 1
+  int tables_index;
+  int tables_count;
+  std::vector<std::string_view> strings;
+  // failure of the decoding, kept until the protected call returns
+  std::optional<LuaPack::Error> error;
+  bool out_of_memory;
+};
+
+void LuaStateCore::Unpack(std::string_view data) {
+  UnpackContext ctx{LuaPack::Reader(data), 0, 0, {}, std::nullopt, false};
+
+  ctx.reader.ReadHeader();
+
+  // the data is untrusted and may take the state past its memory limit, the decoding runs in protected mode and C++
+  // exceptions are caught before they reach the Lua frames
+  Protect(0, [this, &ctx](lua_State*) -> int {
+    try {
+      lua_newtable(L_);
+      ctx.tables_index = GetTop();
+
+      UnpackValue(ctx, 0);
+
+      if (!ctx.reader.IsEnd()) {
+        throw LuaPack::Error(LuaPack::Error::Code::Invalid, "Unexpected data after the packed value");
+      }
+    } catch (const LuaPack::Error& e) {
+      ctx.error.emplace(e);
+      return 0;
+    } catch (const std::bad_alloc&) {
+      ctx.out_of_memory = true;
+      return 0;
+    }
+
+    lua_remove(L_, ctx.tables_index);
+    return 1;
+  });
+
+  if (ctx.error) {
+    throw *ctx.error;
+  }
+
+  if (ctx.out_of_memory) {
+    throw MemoryException{};
+  }
+}
+
+void LuaStateCore::UnpackValue(UnpackContext& ctx, int depth) {
+  auto& reader = ctx.reader;
+
+  auto read_count = [&](uint64_t count) {
+    // every element takes at least one byte
+    reader.RequireElements(count);
+
+    if (count > INT_MAX) {
+      throw LuaPack::Error(LuaPack::Error::Code::Invalid, "Table is too large");
+    }
+
+    return static_cast<int>(count);
+  };
+
+  auto new_table = [&](int narr, int nrec) {
+    if (depth >= LuaPack::MaxDepth || !lua_checkstack(L_, 4)) {
+      throw LuaPack::Error(LuaPack::Error::Code::TooDeep, "Tables are nested deeper than " + std::to_string(LuaPack::MaxDepth) + " levels");
+    }
+
+    lua_createtable(L_, narr, nrec);
+    lua_pushvalue(L_, -1);
+    lua_rawseti(L_, ctx.tables_index, ++ctx.tables_count);
+  };
+
+  switch (auto tag = reader.ReadTag()) {
+    case LuaPack::Nil:
+      lua_pushnil(L_);
+      break;
+    case LuaPack::False:
+    case LuaPack::True:
+      lua_pushboolean(L_, tag == LuaPack::True);
+      break;
+    case LuaPack::Int32:
+      lua_pushnumber(L_, reader.ReadFixed<int32_t>());
+      break;
+    case LuaPack::Float64:
+      lua_pushnumber(L_, reader.ReadFixed<double>());
+      break;
+    case LuaPack::String:
+    case LuaPack::StringDef: {
+      auto bytes = reader.ReadBytes();
+      if (tag == LuaPack::StringDef) {
+        ctx.strings.push_back(bytes);
+      }
+      lua_pushlstring(L_, bytes.data(), bytes.size());
+      break;
+    }
+    case LuaPack::StringRef: {
+      auto index = reader.ReadVarUint();
+      if (index >= ctx.strings.size()) {
+        throw LuaPack::Error(LuaPack::Error::Code::Invalid, "Reference to an undefined string");
+      }
+      lua_pushlstring(L_, ctx.strings[index].data(), ctx.strings[index].size());
+      break;
+    }
+    case LuaPack::TableRef: {
+      auto index = reader.ReadVarUint();
+      if (index >= static_cast<uint64_t>(ctx.tables_count)) {
+        throw LuaPack::Error(LuaPack::Error::Code::Invalid, "Reference to an undefined table");
+      }
+      lua_rawgeti(L_, ctx.tables_index, static_cast<lua_Integer>(index + 1));
+      break;
+    }
+    case LuaPack::Array: {
+      int length = read_count(reader.ReadVarUint());
+      new_table(length, 0);
+
+      for (int i = 1; i <= length; i++) {
+        UnpackValue(ctx, depth + 1);
+        lua_rawseti(L_, -2, i);
+      }
+      break;
+    }
+    case LuaPack::Map: {
+      int count = read_count(reader.ReadFixed<uint32_t>());
+      new_table(0, count);
+
+      for (int i = 0; i < count; i++) {
+        UnpackValue(ctx, depth + 1);
+
+        // lua_rawset raises a Lua error for these keys
+        if (lua_isnil(L_, -1) || (lua_type(L_, -1) == LUA_TNUMBER && std::isnan(lua_tonumber(L_, -1)))) {
+          throw LuaPack::Error(LuaPack::Error::Code::Invalid, "Table key is nil or NaN");
+        }
+
+        UnpackValue(ctx, depth + 1);
+        lua_rawset(L_, -3);
+      }
+      break;
+    }
+    default:
+      throw LuaPack::Error(LuaPack::Error::Code::Invalid, "Unknown tag " + std::to_string(static_cast<int>(tag)));
+  }
+}
+
+struct LuaStateCore::JsonContext {
+  std::string& out;
+  bool use_sequences;
+  // tables being written, JSON has no way to refer back to them
+  std::unordered_set<const void*> path;
+  // positions of the elements written for the arrays being written and whether they have a JSON form, and the out of
+  // order keys of the arrays
+  std::vector<std::pair<size_t, bool>> items;
+  std::vector<lua_Integer> skipped;
+};
+
+bool LuaStateCore::ToJson(int index, bool use_sequences, std::string& out) {
+  JsonContext ctx{out, use_sequences, {}, {}, {}};
+  return WriteJsonValue(lua_absindex(L_, index), ctx, 0);
+}
+
+bool LuaStateCore::WriteJsonValue(int index, JsonContext& ctx, int depth) {
+  auto& out = ctx.out;
+
+  switch (lua_type(L_, index)) {
+    case LUA_TBOOLEAN:
+      out.append(lua_toboolean(L_, index) ? "true" : "false");
+      return true;
+    case LUA_TNUMBER:
+      if (!LuaJson::AppendNumber(out, lua_tonumber(L_, index))) {
+        out.append("null");
+      }
+      return true;
+    case LUA_TSTRING: {
+      size_t len;
+      const char* ptr = lua_tolstring(L_, index, &len);
+      LuaJson::AppendString(out, {ptr, len});
+      return true;
+    }
+    case LUA_TTABLE:
+      break;
+    case LUA_TFUNCTION:
+      // like JSON.stringify, functions are left out
+      return false;
+    default:
+      out.append("null");
+      return true;
+  }
+
+  const void* identity = lua_topointer(L_, index);
+
+  if (!ctx.path.insert(identity).second) {
+    throw LuaJson::Error(LuaJson::Error::Code::Circular, "Converting circular structure to JSON");
+  }
+
+  if (depth >= LuaJson::MaxDepth || !lua_checkstack(L_, 4)) {
+    throw LuaJson::Error(LuaJson::Error::Code::TooDeep, "Tables are nested deeper than " + std::to_string(LuaJson::MaxDepth) + " levels");
+  }
+
+  WriteJsonTable(index, ctx, depth);
+
+  ctx.path.erase(identity);
+  return true;
+}
+
+void LuaStateCore::WriteJsonTable(int index, JsonContext& ctx, int depth) {
+  auto& out = ctx.out;
+
+  // like PackTable, a table with a raw length starts as an array and becomes an object at the first key which is not a
+  // sequence key
+  size_t length = ctx.use_sequences ? lua_rawlen(L_, index) : 0;
+  size_t table_pos = out.size();
+  size_t items_base = ctx.items.size();
+  size_t skipped_base = ctx.skipped.size();
+  size_t sequence_keys = 0;
+  bool is_array = length > 0;
+  bool is_first = true;
+
+  out.push_back(is_array ? '[' : '{');
+
+  // values without a JSON form are left out of objects
+  auto write_entry = [&](int key_index, int value_index) {
+    size_t mark = out.size();
+
+    if (!is_first) {
+      out.push_back(',');
+    }
+
+    if (lua_type(L_, key_index) == LUA_TSTRING) {
+      size_t len;
+      const char* ptr = lua_tolstring(L_, key_index, &len);
+      LuaJson::AppendString(out, {ptr, len});
+    } else {
+      LuaJson::AppendNumberKey(out, lua_tonumber(L_, key_index));
+    }
+
+    out.push_back(':');
+
+    if (WriteJsonValue(value_index, ctx, depth + 1)) {
+      is_first = false;
+    } else {
+      out.resize(mark);
+    }
+  };
+
+  // in arrays they are written as null
+  auto write_item = [&](int value_index) {
+    if (!is_first) {
+      out.push_back(',');
+    }
+
+    size_t pos = out.size();
+    bool has_value = WriteJsonValue(value_index, ctx, depth + 1);
+
+    if (!has_value) {
+      out.append("null");
+    }
+
+    is_first = false;
+    return std::make_pair(pos, has_value);
+  };
+
+  auto to_object = [&]() {
+    std::string tail(out, table_pos);
+    size_t items_count = ctx.items.size() - items_base;
+
+    out.resize(table_pos);
+    out.push_back('{');
+    is_first = true;
+
+    for (size_t i = 0; i < items_count; i++) {
+      auto [pos, has_value] = ctx.items[items_base + i];
+      if (!has_value) {
+        continue;
+      }
+
+      // the next element starts after a comma
+      size_t begin = pos - table_pos;
+      size_t end = i + 1 < items_count ? ctx.items[items_base + i + 1].first - table_pos - 1 : tail.size();
+
+      if (!is_first) {
+        out.push_back(',');
+      }
+
+      LuaJson::AppendNumberKey(out, static_cast<double>(i + 1));
+      out.push_back(':');
+      out.append(tail, begin, end - begin);
+      is_first = false;
+    }
+
+    for (size_t i = skipped_base; i < ctx.skipped.size(); i++) {
+      lua_pushinteger(L_, ctx.skipped[i]);
+      lua_rawgeti(L_, index, ctx.skipped[i]);
+      write_entry(GetTop() - 1, GetTop());
+      lua_pop(L_, 2);
+    }
+
+    ctx.items.resize(items_base);
+    ctx.skipped.resize(skipped_base);
+    is_array = false;
+  };
+
+  lua_pushnil(L_);
+  while (lua_next(L_, index)) {
+    int key_type = lua_type(L_, -2);
+
+    // other keys have no JS counterpart
+    if (key_type != LUA_TNUMBER && key_type != LUA_TSTRING) {
+      lua_pop(L_, 1);
+      continue;
+    }
+
+    if (is_array) {
+      if (key_type == LUA_TNUMBER && IsSequenceKey(lua_tonumber(L_, -2), length)) {
+        auto key = static_cast<size_t>(lua_tonumber(L_, -2));
+        sequence_keys++;
+
+        if (ctx.skipped.size() == skipped_base && key == ctx.items.size() - items_base + 1) {
+          auto item = write_item(GetTop());
+          ctx.items.push_back(item);
+        } else {
+          ctx.skipped.push_back(static_cast<lua_Integer>(key));
+        }
+
+        lua_pop(L_, 1);
+        continue;
+      }
+
+      to_object();
+    }
+
+    write_entry(GetTop() - 1, GetTop());
+    lua_pop(L_, 1);
+  }
+
+  if (is_array && sequence_keys == length) {
+    for (size_t i = ctx.items.size() - items_base + 1; i <= length; i++) {
+      lua_rawgeti(L_, index, static_cast<lua_Integer>(i));
+      write_item(GetTop());
+      lua_pop(L_, 1);
+    }
+
+    ctx.items.resize(items_base);
+    ctx.skipped.resize(skipped_base);
+    out.push_back(']');
+    return;
+  }
+
+  // holes in 1..n
+  if (is_array) {
+    to_object();
+  }
+
+  out.push_back('}');
+}
+
+void LuaStateCore::FromJson(std::string_view json) {
+  LuaJson::Reader reader(json);
+  std::optional<LuaJson::Error> error;
+  bool out_of_memory = false;
+
+  // like Unpack, the tables are built in protected mode and C++ exceptions do not reach the Lua frames
+  Protect(0, [&](lua_State*) -> int {
+    try {
+      ReadJsonValue(reader, 0);
+
+      if (!reader.IsEnd()) {
+        reader.Fail("end of JSON input");
+      }
+    } catch (const LuaJson::Error& e) {
+      error.emplace(e);
+      return 0;
+    } catch (const std::bad_alloc&) {
+      out_of_memory = true;
+      return 0;
+    }
+
+    return 1;
+  });
+
+  if (error) {
+    throw *error;
+  }
+
+  if (out_of_memory) {
+    throw MemoryException{};
+  }
+}
+
+void LuaStateCore::ReadJsonValue(LuaJson::Reader& reader, int depth) {
+  auto new_table = [&]() {
+    if (depth >= LuaJson::MaxDepth || !lua_checkstack(L_, 4)) {
+      throw LuaJson::Error(LuaJson::Error::Code::TooDeep, "Tables are nested deeper than " + std::to_string(LuaJson::MaxDepth) + " levels");
+    }
+
+    lua_newtable(L_);
+  };
+
+  switch (reader.Peek()) {
+    case 'n':
+      reader.ExpectLiteral("null");
+      lua_pushnil(L_);
+      break;
+    case 't':
+      reader.ExpectLiteral("true");
+      lua_pushboolean(L_, 1);
+      break;
+    case 'f':
+      reader.ExpectLiteral("false");
+      lua_pushboolean(L_, 0);
+      break;
+    case '"': {
+      auto str = reader.ReadString();
+      lua_pushlstring(L_, str.data(), str.size());
+      break;
+    }
+    case '[': {
+      reader.Expect('[');
+      new_table();
+
+      if (reader.TryConsume(']')) {
+        break;
+      }
+
+      // null elements are holes like in regular conversions
+      int i = 0;
+      do {
+        ReadJsonValue(reader, depth + 1);
+        lua_rawseti(L_, -2, ++i);
+      } while (reader.TryConsume(','));
+
+      reader.Expect(']');
+      break;
+    }
+    case '{': {
+      reader.Expect('{');
+      new_table();
+
+      if (reader.TryConsume('}')) {
+        break;
+      }
+
+      do {
+        if (reader.Peek() != '"') {
+          reader.Fail("property name");
+        }
+
+        auto key = reader.ReadString();
+        lua_pushlstring(L_, key.data(), key.size());
+        reader.Expect(':');
+        ReadJsonValue(reader, depth + 1);
+        lua_rawset(L_, -3);
+      } while (reader.TryConsume(','));
+
+      reader.Expect('}');
+      break;
+    }
+    default:
+      lua_pushnumber(L_, reader.ReadNumber());
+      break;
+  }
+}
+
+bool LuaStateCore::RegisterBundle(const std::shared_ptr<const LuaBundle>& bundle) {
+  StackGuard guard(*this);
+
+  // package.preload (the package library is required)
+  lua_getfield(L_, LUA_REGISTRYINDEX, "_LOADED");
+  lua_getfield(L_, -1, "package");
+  if (!lua_istable(L_, -1)) {
+    return false;
+  }
+  lua_getfield(L_, -1, "preload");
+  if (!lua_istable(L_, -1)) {
+    return false;
+  }
+  int preload_index = lua_gettop(L_);
+
+  // the mapping lives as long as any of the bundle loaders
+  new (lua_newuserdata(L_, sizeof(std::shared_ptr<const LuaBundle>))) std::shared_ptr<const LuaBundle>(bundle);
+  if (luaL_newmetatable(L_, BundleMetaTableName)) {
+    lua_pushcfunction(L_, GcBundleLuaCb);
+    lua_setfield(L_, -2, "__gc");
+  }
+  lua_setmetatable(L_, -2);
+  int bundle_index = lua_gettop(L_);
+
+  const auto& chunks = bundle->GetChunks();
+  for (size_t i = 0; i < chunks.size(); i++) {
+    lua_pushvalue(L_, bundle_index);
+    lua_pushinteger(L_, static_cast<lua_Integer>(i));
+    lua_pushcclosure(L_, LoadBundleChunkLuaCb, 2);
+    lua_setfield(L_, preload_index, chunks[i].name.c_str());
+  }
+
+  return true;
+}
+
+/**
+ * Records the current globals as the baseline for RestoreBaseline.
+ *
+ * Snapshot roots are _G, package.loaded, package.preload and the string metatable. Every table reachable from them
+ * through keys, values and metatables is snapshotted as well, except weak tables, which are kept by reference.
+ */
+void LuaStateCore::SaveBaseline() {
+  StackGuard guard(*this);
+
+  if (baseline_ref_.value != LUA_NOREF) {
+    ReleaseRef(baseline_ref_);
+    baseline_ref_ = LuaRegistryRef{};
+  }
+
+  // the snapshot of a large prelude may hit the memory limit
+  Protect(0, [](lua_State* L) -> int {
+    // baseline = { copies = { [table] = shallow copy }, metas = { [table] = metatable } }
+    lua_createtable(L, 2, 0);
+    int baseline_index = lua_gettop(L);
+    lua_newtable(L);
+    int copies_index = lua_gettop(L);
+    lua_newtable(L);
+    int metas_index = lua_gettop(L);
+    lua_newtable(L);
+    int pending_index = lua_gettop(L);
+
+    int roots_index = lua_gettop(L) + 1;
+#if LUA_VERSION_NUM >= 502
+    lua_pushglobaltable(L);
+#else
+    lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+    lua_getfield(L, LUA_REGISTRYINDEX, "_LOADED");
+    lua_pushliteral(L, "");
+    if (!lua_getmetatable(L, -1)) {
+      lua_pushnil(L);
+    }
+    lua_remove(L, -2);
+    // package.preload, where bundles and user loaders are registered
+    if (lua_istable(L, roots_index + 1)) {
+      lua_getfield(L, roots_index + 1, "package");
+      if (lua_istable(L, -1)) {
+        lua_getfield(L, -1, "preload");
+        lua_remove(L, -2);
+      }
+    }
+
+    int pending_count = 0;
+    for (int i = roots_index; i <= lua_gettop(L); i++) {
+      if (lua_istable(L, i)) {
+        lua_pushvalue(L, i);
+        lua_rawseti(L, pending_index, ++pending_count);
+      }
+    }
+
+    SnapshotTables(L, copies_index, metas_index, pending_index, pending_count);
+
+    lua_pushvalue(L, copies_index);
+    lua_rawseti(L, baseline_index, 1);
+    lua_pushvalue(L, metas_index);
+    lua_rawseti(L, baseline_index, 2);
+
+    lua_settop(L, baseline_index);
+    return 1;
+  });
+
+  baseline_ref_ = PopRef();
+}
+
+/**
+ * Puts every snapshotted table back to its recorded fields and metatable
+ */
+void LuaStateCore::RestoreBaseline() {
+  if (baseline_ref_.value == LUA_NOREF) {
+    return;
+  }
+
+  StackGuard guard(*this);
+
+  // putting back removed fields may grow tables past the memory limit
+  PushRef(baseline_ref_);
+  Protect(1, [](lua_State* L) -> int {
+    lua_rawgeti(L, 1, 1);
+    int copies_index = lua_gettop(L);
+    lua_rawgeti(L, 1, 2);
+    int metas_index = lua_gettop(L);
+
+    lua_pushnil(L);
+    while (lua_next(L, copies_index)) {
+      RestoreTable(L, -2, -1);
+
+      lua_pushvalue(L, -2);
+      lua_rawget(L, metas_index);
+      lua_setmetatable(L, -3);
+
+      lua_pop(L, 1);
+    }
+
+    return 0;
+  });
+}
+
+int LuaStateCore::PCall(int args_count, bool with_traceback) {
+  // function stack index
+  int function_index = lua_gettop(L_) - args_count;
+
+  // stack index without function and arguments
+  int pivot_index = function_index - 1;
+  int handler_index = 0;
+
+  // push TracebackLuaCb function, only when the caller is going to read the traceback
+  if (with_traceback) {
+    lua_pushcfunction(L_, TracebackLuaCb);
+    lua_insert(L_, function_index);
+    handler_index = function_index;
+    ++pivot_index;
+  }
+
+  // call lua function on stack
+  bool was_enforced = EnforceMemoryLimit(true);
+  int function_call_status = lua_pcall(L_, args_count, LUA_MULTRET, handler_index);
+  EnforceMemoryLimit(was_enforced);
+  if (function_call_status != LUA_OK) {
+    throw LuaException{};
+  }
+
+  int top_index = lua_gettop(L_);
+
+  // return results count
+  return top_index - pivot_index;
+}
+
+LuaStateCore::ErrorInfo LuaStateCore::ReadError(int index, bool with_traceback) {
+  ErrorInfo info;
+  index = lua_absindex(L_, index);
+
+  // unwrap the table built by TracebackLuaCb, not one that Lua code threw with error()
+  bool is_traceback = false;
+  if (with_traceback && lua_getmetatable(L_, index)) {
+    luaL_getmetatable(L_, TracebackMetaTableName);
+    is_traceback = lua_rawequal(L_, -1, -2);
+    lua_pop(L_, 2);
+  }
+
+  if (is_traceback) {
+    lua_getfield(L_, index, "stack");
+    if (lua_type(L_, -1) == LUA_TSTRING) {
+      info.traceback = lua_tostring(L_, -1);
+    }
+    lua_pop(L_, 1);
+
+    lua_getfield(L_, index, "cause");
+    if (lua_isnil(L_, -1)) {
+      lua_pop(L_, 1);
+      lua_getfield(L_, index, "message");
+    }
+  } else {
+    lua_pushvalue(L_, index);
+  }
+
+  switch (lua_type(L_, -1)) {
+    case LUA_TTABLE:
+      // left on the stack for the caller to convert
+      info.has_cause = true;
+      return info;
+    case LUA_TSTRING:
+    case LUA_TNUMBER: {
+      size_t length;
+      const char* message = lua_tolstring(L_, -1, &length);
+      info.message.assign(message, length);
+      break;
+    }
+    case LUA_TBOOLEAN:
+      info.message = lua_toboolean(L_, -1) ? "true" : "false";
+      break;
+    case LUA_TNIL:
+    case LUA_TNONE:
+      break;
+    default:
+      info.message = std::string("(error object is a ") + luaL_typename(L_, -1) + " value)";
+      break;
+  }
+
+  lua_pop(L_, 1);
+
+  return info;
+}
+
+void LuaStateCore::GcCollect() {
+  // __gc metamethods may raise, run the collector protected
+  lua_pushcfunction(L_, GcLuaCb);
+  lua_pushinteger(L_, LUA_GCCOLLECT);
+  lua_pushinteger(L_, 0);
+  if (lua_pcall(L_, 2, 1, 0) != LUA_OK) {
+    lua_pop(L_, 1);
+    return;
+  }
+  lua_pop(L_, 1);
+}
+
+void LuaStateCore::GcStop() {
+  lua_gc(L_, LUA_GCSTOP, 0);
+#ifndef LUA_GCISRUNNING
+  gc_stopped_ = true;
+#endif
+}
+
+void LuaStateCore::GcRestart() {
+  lua_gc(L_, LUA_GCRESTART, 0);
+#ifndef LUA_GCISRUNNING
+  gc_stopped_ = false;
+#endif
+}
+
+bool LuaStateCore::GcStep(int kbytes) {
+  lua_pushcfunction(L_, GcLuaCb);
+  lua_pushinteger(L_, LUA_GCSTEP);
+  lua_pushinteger(L_, kbytes);
+  if (lua_pcall(L_, 2, 1, 0) != LUA_OK) {
+    lua_pop(L_, 1);
+    return false;
+  }
+
+  bool finished = lua_tointeger(L_, -1) != 0;
+  lua_pop(L_, 1);
+
+  return finished;
+}
+
+size_t LuaStateCore::GcCount() { return static_cast<size_t>(lua_gc(L_, LUA_GCCOUNT, 0)) * 1024 + static_cast<size_t>(lua_gc(L_, LUA_GCCOUNTB, 0)); }
+
+bool LuaStateCore::GcIsRunning() {
+#ifdef LUA_GCISRUNNING
+  return lua_gc(L_, LUA_GCISRUNNING, 0) != 0;
+#else
+  return !gc_stopped_;
+#endif
+}
+
+void LuaStateCore::GcSetIncremental(const GcIncrementalParams& params) {
+#if LUA_VERSION_NUM >= 505
+  lua_gc(L_, LUA_GCINC);
+  if (params.pause) {
+    lua_gc(L_, LUA_GCPARAM, LUA_GCPPAUSE, *params.pause);
+  }
+  if (params.step_mul) {
+    lua_gc(L_, LUA_GCPARAM, LUA_GCPSTEPMUL, *params.step_mul);
+  }
+  if (params.step_size) {
+    lua_gc(L_, LUA_GCPARAM, LUA_GCPSTEPSIZE, *params.step_size);
+  }
+#elif LUA_VERSION_NUM == 504
+  // zero keeps the current value
+  lua_gc(L_, LUA_GCINC, params.pause.value_or(0), params.step_mul.value_or(0), params.step_size.value_or(0));
+#else
+#ifdef LUA_GCINC
+  lua_gc(L_, LUA_GCINC, 0);
+#endif
+  if (params.pause) {
+    lua_gc(L_, LUA_GCSETPAUSE, *params.pause);
+  }
+  if (params.step_mul) {
+    lua_gc(L_, LUA_GCSETSTEPMUL, *params.step_mul);
+  }
+#endif
+}
+
+bool LuaStateCore::GcSetGenerational(const GcGenerationalParams& params) {
+#if LUA_VERSION_NUM >= 505
+  lua_gc(L_, LUA_GCGEN);
+  if (params.minor_mul) {
+    lua_gc(L_, LUA_GCPARAM, LUA_GCPMINORMUL, *params.minor_mul);
+  }
+  if (params.major_mul) {
+    lua_gc(L_, LUA_GCPARAM, LUA_GCPMINORMAJOR, *params.major_mul);
+  }
+  return true;
+#elif LUA_VERSION_NUM == 504
+  lua_gc(L_, LUA_GCGEN, params.minor_mul.value_or(0), params.major_mul.value_or(0));
+  return true;
+#elif defined(LUA_GCGEN)
+  // Lua 5.2 generational mode has no parameters
+  lua_gc(L_, LUA_GCGEN, 0);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool LuaStateCore::StartBudget(ExecutionBudget budget) {
+  if (budget_) {
+    return false;
+  }
+
+  int interval = budget.hook_interval;
+  if (budget.instructions && budget.instructions < static_cast<uint64_t>(interval)) {
+    interval = static_cast<int>(budget.instructions);
+  }
+
+  budget_ = std::move(budget);
+  budget_->hook_interval = interval;
+  budget_status_ = BudgetStatus::Ok;
+  budget_used_ = 0;
+
+  // already aborted signal, fail on the first instruction
+  if (budget_->is_aborted && budget_->is_aborted()) {
+    budget_status_ = BudgetStatus::Aborted;
+    interval = 1;
+  }
+
+  lua_sethook(L_, BudgetHookLuaCb, LUA_MASKCOUNT, interval);
+
+  return true;
+}
+
+void LuaStateCore::StopBudget() {
+  budget_.reset();
+  budget_status_ = BudgetStatus::Ok;
+
+  if (L_) {
+    lua_sethook(L_, nullptr, 0, 0);
+  }
+}
+
+LuaStateCore::BudgetStatus LuaStateCore::CheckBudget() {
+  if (budget_status_ != BudgetStatus::Ok) {
+    return budget_status_;
+  }
+
+  budget_used_ += budget_->hook_interval;
+
+  if (budget_->instructions && budget_used_ >= budget_->instructions) {
+    budget_status_ = BudgetStatus::InstructionsExceeded;
+  } else if (budget_->deadline && std::chrono::steady_clock::now() >= *budget_->deadline) {
+    budget_status_ = BudgetStatus::TimedOut;
+  } else if (budget_->is_aborted && budget_->is_aborted()) {
+    budget_status_ = BudgetStatus::Aborted;
+  }
+
+  return budget_status_;
+}
+
+void LuaStateCore::BudgetHookLuaCb(lua_State* L, lua_Debug*) {
+  lua_pushlightuserdata(L, &CoreRegistryKey);
+  lua_rawget(L, LUA_REGISTRYINDEX);
+  auto* core = static_cast<LuaStateCore*>(lua_touserdata(L, -1));
+  lua_pop(L, 1);
+
+  // a coroutine which inherited the hook outlived the budget
+  if (!core || !core->budget_) {
+    lua_sethook(L, nullptr, 0, 0);
+    return;
+  }
+
+  auto status = core->CheckBudget();
+  if (status == BudgetStatus::Ok) {
+    return;
+  }
+
+  // raise again on the next instruction, so pcall inside the script cannot swallow the error
+  lua_sethook(L, BudgetHookLuaCb, LUA_MASKCOUNT, 1);
+  switch (status) {
+    case BudgetStatus::InstructionsExceeded:
+      luaL_error(L, "instruction budget exceeded");
+      break;
+    case BudgetStatus::TimedOut:
+      luaL_error(L, "execution timed out");
+      break;
+    default:
+      luaL_error(L, "execution aborted");
+      break;
+  }
+}
+
+std::optional<int> LuaStateCore::GetLength(int index) {
+  auto value_type = lua_type(L_, index);
+
+  if (value_type != LUA_TTABLE && value_type != LUA_TSTRING) {
+    return std::nullopt;
+  }
+
+  lua_len(L_, index);
+  int length = lua_tointeger(L_, -1);
+
+  lua_pop(L_, 1);
+
+  return length;
+}
+
+std::string LuaStateCore::GetLuaVersion() {
+  std::string compileTime;
+
+#ifdef LUAJIT_VERSION
+  compileTime = LUAJIT_VERSION;
+#elif defined(LUA_RELEASE)
+  compileTime = LUA_RELEASE;
+#elif defined(LUA_VERSION)
+  compileTime = LUA_VERSION;
+#else
+  compileTime = "Lua (unknown version)";
+#endif
+
+  lua_getglobal(L_, "_VERSION");
+  std::string runtime = lua_tostring(L_, -1);
+  lua_pop(L_, 1);
+
+  if (runtime == compileTime || compileTime.find(runtime) != std::string::npos) {
+    return compileTime;
+  }
+
+  return runtime + " (compiled with " + compileTime + ")";
+}
+
+namespace {
+
+  int PanicLuaCb(lua_State* L) {
+    const char* msg = lua_type(L, -1) == LUA_TSTRING ? lua_tostring(L, -1) : "error object is not a string";
+    std::fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", msg);
+    std::fflush(stderr);
+    return 0;
+  }
+
+  int ProtectedLuaCb(lua_State* L) {
+    auto* ctx = static_cast<ProtectedCallCtx*>(lua_touserdata(L, 1));
+    lua_remove(L, 1);
+    return ctx->invoke(L, ctx->data);
+  }
+
+#if LUA_VERSION_NUM >= 504
+  void WarnOnLuaCb(void*, const char*, int);
+
+  /**
+   * Port of the lauxlib warning functions, which are not exported
+   */
+  bool CheckWarnControl(lua_State* L, const char* message, int tocont) {
+    if (tocont || *(message++) != '@') {
+      return false;
+    }
+
+    if (std::strcmp(message, "off") == 0) {
+      lua_setwarnf(L, WarnOffLuaCb, L);
+    } else if (std::strcmp(message, "on") == 0) {
+      lua_setwarnf(L, WarnOnLuaCb, L);
+    }
+
+    return true;
+  }
+
+  void WarnContLuaCb(void* ud, const char* message, int tocont) {
+    auto* L = static_cast<lua_State*>(ud);
+
+    std::fprintf(stderr, "%s", message);
+
+    if (tocont) {
+      lua_setwarnf(L, WarnContLuaCb, L);
+    } else {
+      std::fprintf(stderr, "\n");
+      std::fflush(stderr);
+      lua_setwarnf(L, WarnOnLuaCb, L);
+    }
+  }
+
+  void WarnOnLuaCb(void* ud, const char* message, int tocont) {
+    if (CheckWarnControl(static_cast<lua_State*>(ud), message, tocont)) {
+      return;
+    }
+
+    std::fprintf(stderr, "Lua warning: ");
+    WarnContLuaCb(ud, message, tocont);
+  }
+
+  void WarnOffLuaCb(void* ud, const char* message, int tocont) { CheckWarnControl(static_cast<lua_State*>(ud), message, tocont); }
+#endif
+
+  /**
+   * package.preload loader, verifies and loads the chunk from the mapped bundle and runs it with the require arguments
+   */
+  int LoadBundleChunkLuaCb(lua_State* L) {
+    auto* bundle = static_cast<std::shared_ptr<const LuaBundle>*>(lua_touserdata(L, lua_upvalueindex(1)));
+    auto index = static_cast<size_t>(lua_tointeger(L, lua_upvalueindex(2)));
+
+    const auto& chunk = (*bundle)->GetChunks()[index];
+
+    // Lua does not verify bytecode, a damaged chunk must not reach lua_load
+    if (!(*bundle)->Verify(index)) {
+      return luaL_error(L, "bundle chunk '%s' checksum mismatch", chunk.name.c_str());
+    }
+
+    int load_result;
+    {
+      // lua_error does not unwind C++ frames, so the name must be gone before it
+      auto chunk_name = "=" + chunk.name;
+      load_result = luaL_loadbufferx(L, chunk.bytecode.data(), chunk.bytecode.size(), chunk_name.c_str(), "b");
+    }
+
+    if (load_result != LUA_OK) {
+      return lua_error(L);
+    }
+
+    lua_insert(L, 1);
+    lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+
+    return lua_gettop(L);
+  }
+
+  bool IsWeakTable(lua_State* L, int table_index) {
+    if (!lua_getmetatable(L, table_index)) {
+      return false;
+    }
+
+    lua_pushliteral(L, "__mode");
+    lua_rawget(L, -2);
+    bool is_weak = lua_isstring(L, -1);
+    lua_pop(L, 2);
+
+    return is_weak;
+  }
+
+  /**
+   * copies[table] = shallow copy of table, metas[table] = metatable of table, for every table reachable from the
+   * pending ones. copies doubles as the visited set and pending as the work list, so deep nesting uses no C stack.
+   */
+  void SnapshotTables(lua_State* L, int copies_index, int metas_index, int pending_index, int pending_count) {
+    auto push_pending = [&](int index) {
+      if (lua_istable(L, index)) {
+        lua_pushvalue(L, index);
+        lua_rawseti(L, pending_index, ++pending_count);
+      }
+    };
+
+    while (pending_count > 0) {
+      lua_rawgeti(L, pending_index, pending_count);
+      lua_pushnil(L);
+      lua_rawseti(L, pending_index, pending_count--);
+      int table_index = lua_gettop(L);
+
+      lua_pushvalue(L, table_index);
+      lua_rawget(L, copies_index);
+      bool is_snapshotted = !lua_isnil(L, -1);
+      lua_pop(L, 1);
+
+      // weak tables are caches, restoring them would keep their entries alive
+      if (is_snapshotted || IsWeakTable(L, table_index)) {
+        lua_pop(L, 1);
+        continue;
+      }
+
+      lua_pushvalue(L, table_index);
+      lua_newtable(L);
+      lua_pushnil(L);
+      while (lua_next(L, table_index)) {
+        push_pending(-2);
+        push_pending(-1);
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -4);
+      }
+      lua_rawset(L, copies_index);
+
+      if (lua_getmetatable(L, table_index)) {
+        push_pending(-1);
+        lua_pushvalue(L, table_index);
+        lua_insert(L, -2);
+        lua_rawset(L, metas_index);
+      }
+
+      lua_pop(L, 1);
+    }
+  }
+
+  void RestoreTable(lua_State* L, int table_index, int copy_index) {
+    table_index = lua_absindex(L, table_index);
+    copy_index = lua_absindex(L, copy_index);
+
+    // reset changed and drop added fields (clearing existing fields is allowed during lua_next)
+    lua_pushnil(L);
+    while (lua_next(L, table_index)) {
+      lua_pushvalue(L, -2);
+      lua_rawget(L, copy_index);
+      if (lua_rawequal(L, -1, -2)) {
+        lua_pop(L, 2);
+        continue;
+      }
+      lua_pushvalue(L, -3);
+      lua_insert(L, -2);
+      lua_rawset(L, table_index);
+      lua_pop(L, 1);
+    }
+
+    // bring back removed fields
+    lua_pushnil(L);
+    while (lua_next(L, copy_index)) {
+      lua_pushvalue(L, -2);
+      lua_rawget(L, table_index);
+      bool is_missing = lua_isnil(L, -1);
+      lua_pop(L, 1);
+
+      if (is_missing) {
+        lua_pushvalue(L, -2);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, table_index);
+      }
+      lua_pop(L, 1);
+    }
+  }
+
+  int GcBundleLuaCb(lua_State* L) {
+    auto* bundle = static_cast<std::shared_ptr<const LuaBundle>*>(lua_touserdata(L, 1));
+    if (bundle) {
+      bundle->~shared_ptr();
+    }
+    return 0;
+  }
+
+  int GcLuaCb(lua_State* L) {
+    int what = static_cast<int>(lua_tointeger(L, 1));
+    int data = static_cast<int>(lua_tointeger(L, 2));
+    lua_pushinteger(L, lua_gc(L, what, data));
+    return 1;
+  }
+
+  int TracebackLuaCb(lua_State* L) {
+    lua_createtable(L, 2, 2);
+    auto table_index = lua_absindex(L, -1);
+
+    lua_pushvalue(L, -2);
+
+    if (lua_type(L, -1) == LUA_TTABLE) {
+      lua_setfield(L, table_index, "cause");
+    } else {
+      lua_setfield(L, table_index, "message");
+    }
+
+    luaL_traceback(L, L, nullptr, 1);
+    lua_setfield(L, table_index, "stack");
+
+    luaL_newmetatable(L, LuaStateCore::TracebackMetaTableName);
+    lua_setmetatable(L, table_index);
 
     return 1;
   }
@@ -1,8 +1,16 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <string>
 
+#include "core/lua-allocator.h"
+#include "core/lua-bundle.h"
+#include "core/lua-json.h"
+#include "core/lua-pack.h"
 #include "core/lua-values.h"
 #include "core/lua-visitor-concept.h"
 
@@ -12,13 +20,23 @@ extern "C" {
 
 class LuaStateCore {
 public:
-  explicit LuaStateCore();
+  static constexpr const char* BundleMetaTableName = "lua-state.bundle";
+  // marks the error tables built by the traceback handler, so ReadError leaves error tables thrown by Lua code alone
+  static constexpr const char* TracebackMetaTableName = "lua-state.traceback";
+
+  explicit LuaStateCore(const LuaAllocatorOptions& allocator_options = {});
   ~LuaStateCore();
 
   void OpenLibs(const std::optional<std::vector<std::string>>&);
   void Close();
   bool IsClosed();
   std::string GetLuaVersion();
+  const LuaAllocator* GetAllocator() const { return allocator_.get(); }
+  // LuaAllocator of the state, nullptr if it runs on the default allocator (64-bit LuaJIT without GC64)
+  static LuaAllocator* GetAllocator(lua_State* L);
+  bool HasMemoryLimit() const;
+  // false if the state is past its memory limit once the garbage is collected
+  bool CheckMemoryLimit();
 
   LuaRegistryRef PopRef();
   LuaRegistryRef CopyRef(int index);
@@ -41,6 +59,25 @@ public:
   bool NewMetaTable(std::string_view name);
   void* NewUserData(size_t size);
 
+  int GetType(int index);
+  const char* GetTypeName(int index);
+  bool IsNil(int index);
+  bool IsTable(int index);
+  bool ToBool(int index);
+  double ToNumber(int index);
+  std::string_view ToString(int index);
+  const void* ToPointer(int index);
+  // userdata upvalue n of the function at index if it is a C closure of fn, nullptr otherwise
+  void* GetCClosureUserData(int index, lua_CFunction fn, int n);
+  // userdata at index if its metatable is the named one, nullptr otherwise
+  void* TestUserData(int index, std::string_view meta_table_name);
+
+  // Raw table access, the key (and value) are on top of the stack
+  void RawGet(int table_index);
+  void RawSet(int table_index);
+  // Number and string keys of the table at index
+  void GetTableKeys(int index, std::vector<LuaTableKey>& keys);
+
   void SetField(int table_index, std::string_view key);
   void SetIndex(int table_index, int i);
   void SetMetaTable(int index);
@@ -52,16 +89,131 @@ public:
 
   void LoadString(std::string_view source) noexcept(false);
   void LoadFile(std::string_view path) noexcept(false);
-  int PCall(int args_count) noexcept(false);
+  void LoadBinary(std::string_view bytecode, std::string_view chunk_name) noexcept(false);
+  std::string Dump(int index, bool strip = false);
+  bool RegisterBundle(const std::shared_ptr<const LuaBundle>& bundle);
+
+  // Packs the value at index in the LuaPack format, sequences become arrays with use_sequences
+  void Pack(int index, bool use_sequences, std::string& out) noexcept(false);
+  // Pushes a value in the LuaPack format, throws LuaPack::Error if the data is malformed or MemoryException if it does not fit
+  void Unpack(std::string_view data) noexcept(false);
+  // Appends the value at index as JSON text, false if it has none (functions)
+  bool ToJson(int index, bool use_sequences, std::string& out) noexcept(false);
+  // Pushes the value of a JSON text, throws LuaJson::Error if it is malformed or MemoryException if it does not fit
+  void FromJson(std::string_view json) noexcept(false);
+
+  void SaveBaseline();
+  void RestoreBaseline();
+  int PCall(int args_count, bool with_traceback = true) noexcept(false);
+
+  struct ErrorInfo {
+    std::string message;
+    std::string traceback;
+    // the error value is a table and is left on top of the stack
+    bool has_cause = false;
+  };
+  ErrorInfo ReadError(int index, bool with_traceback);
+
+  // Garbage collector, unset parameters keep their current value
+  struct GcIncrementalParams {
+    std::optional<int> pause;
+    std::optional<int> step_mul;
+    std::optional<int> step_size;
+  };
+
+  struct GcGenerationalParams {
+    std::optional<int> minor_mul;
+    std::optional<int> major_mul;
+  };
+
+  void GcCollect();
+  void GcStop();
+  void GcRestart();
+  // returns true if the step finished a collection cycle
+  bool GcStep(int kbytes);
+  size_t GcCount();
+  bool GcIsRunning();
+  void GcSetIncremental(const GcIncrementalParams& params);
+  // returns false if the Lua build has no generational mode
+  bool GcSetGenerational(const GcGenerationalParams& params);
+
+  // Execution budget, enforced by a count hook which is only installed while a budget runs
+  struct ExecutionBudget {
+    // 0 is unlimited
+    uint64_t instructions = 0;
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    std::function<bool()> is_aborted;
+    int hook_interval = 1000;
+
+    bool IsEmpty() const { return !instructions && !deadline && !is_aborted; }
+  };
+
+  enum class BudgetStatus { Ok, InstructionsExceeded, TimedOut, Aborted };
+
+  // returns false if another budget is already running, nested calls share the outer one
+  bool StartBudget(ExecutionBudget budget);
+  void StopBudget();
+  BudgetStatus GetBudgetStatus() const { return budget_ ? budget_status_ : BudgetStatus::Ok; }
   std::optional<int> GetLength(int index);
 
   enum class PushValueByPathStatus { NotFound, BrokenPath, Found };
   PushValueByPathStatus PushValueByPath(std::string_view path);
 
+  // Prepared paths keep every segment as an interned string in the registry
+  std::vector<LuaRegistryRef> PreparePath(std::string_view path);
+  void ReleasePath(const std::vector<LuaRegistryRef>& segments);
+  PushValueByPathStatus PushValueByPath(const std::vector<LuaRegistryRef>& segments);
+  bool SetValueByPath(const std::vector<LuaRegistryRef>& segments);
+
+  // Keeps the string in the registry, its address is a stable identity until the ref is released
+  LuaRegistryRef InternString(std::string_view str, const char*& ptr);
+
+  // Keeps the string at index alive until ClearStringAnchors, its address is then a stable identity
+  void AnchorString(int index);
+  void ClearStringAnchors();
+
   void PrintLuaStack(std::string_view title);
   void SetTop(int idx) { lua_settop(L_, idx); }
 
+  // Runs fn(L) in protected mode on the args_count values on top of the stack, and returns the count of values it leaves.
+  // A Lua error unwinds fn with longjmp: it must not throw nor own objects with destructors
+  template <typename Fn> int Protect(int args_count, Fn&& fn) noexcept(false);
+  // Like Protect, for operations which only need protected mode to fail on the memory limit. Without a limit fn runs
+  // directly, as lua_pcall costs more than a short lookup
+  template <typename Fn> int ProtectLimited(int args_count, Fn&& fn) noexcept(false);
+
   struct LuaException {};
+  // memory limit error of a protected operation, no error value is left on the stack
+  struct MemoryException {};
+
+  struct BudgetGuard {
+  public:
+    BudgetGuard(LuaStateCore& core, ExecutionBudget budget) : core_(core), started_(!budget.IsEmpty() && core.StartBudget(std::move(budget))) {}
+    ~BudgetGuard() noexcept {
+      if (started_) {
+        core_.StopBudget();
+      }
+    }
+
+  private:
+    LuaStateCore& core_;
+    bool started_;
+  };
+
+  // Lifts the memory limit while C++ code called from Lua runs, a memory error must not unwind its frames
+  struct MemoryLimitSuspension {
+  public:
+    explicit MemoryLimitSuspension(lua_State* L) : allocator_(GetAllocator(L)), was_enforced_(allocator_ && allocator_->SetLimitEnforced(false)) {}
+    ~MemoryLimitSuspension() noexcept {
+      if (allocator_) {
+        allocator_->SetLimitEnforced(was_enforced_);
+      }
+    }
+
+  private:
+    LuaAllocator* allocator_;
+    bool was_enforced_;
+  };
 
   struct StackGuard {
   public:
@@ -74,10 +226,54 @@ public:
   };
 
 private:
+  std::unique_ptr<LuaAllocator> allocator_;
   lua_State* L_;
   bool is_closed_ = false;
+#ifndef LUA_GCISRUNNING
+  bool gc_stopped_ = false;
+#endif
+  LuaRegistryRef baseline_ref_;
+
+  std::optional<ExecutionBudget> budget_;
+  BudgetStatus budget_status_ = BudgetStatus::Ok;
+  uint64_t budget_used_ = 0;
+
+  bool EnforceMemoryLimit(bool enforced);
+  int ProtectedCall(int args_count, int (*invoke)(lua_State*, void*), void* data) noexcept(false);
+
+  PushValueByPathStatus LookupValueByPath(std::string_view path);
+  PushValueByPathStatus LookupValueByPath(const std::vector<LuaRegistryRef>& segments);
+  bool AssignValueByPath(const std::vector<LuaRegistryRef>& segments);
+
+  static void BudgetHookLuaCb(lua_State*, lua_Debug*);
+  BudgetStatus CheckBudget();
+
+  // reusable table for pending tables of TraverseTable
+  LuaRegistryRef traverse_scratch_ref_;
+  int traverse_scratch_top_ = 0;
+
+  // set of anchored strings
+  LuaRegistryRef string_anchors_ref_;
 
   template <LuaVisitor Visitor> void TraverseTable(int index, Visitor& visitor);
+
+  // a table is a sequence when its number keys are exactly 1..n, n being its raw length. The length is known without a
+  // walk, the keys are checked while the table is walked for its properties anyway
+  static bool IsSequenceKey(double key, size_t length) {
+    return key >= 1 && key <= static_cast<double>(length) && key == static_cast<double>(static_cast<size_t>(key));
+  }
+
+  struct PackContext;
+  struct UnpackContext;
+  void PackValue(int index, PackContext& ctx, int depth);
+  void PackTable(int index, PackContext& ctx, int depth);
+  void UnpackValue(UnpackContext& ctx, int depth);
+  struct JsonContext;
+  bool WriteJsonValue(int index, JsonContext& ctx, int depth);
+  void WriteJsonTable(int index, JsonContext& ctx, int depth);
+  void ReadJsonValue(LuaJson::Reader& reader, int depth);
+  void PushTraverseScratch();
+  void ClearTraverseScratch(int base);
 };
 
 #include "lua-state-core.hpp"
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <memory>
+#include <type_traits>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "core/lua-compat-defines.h"
 #include "core/lua-values.h"
 #include "core/lua-visitor-concept.h"
 
@@ -12,6 +16,15 @@ extern "C" {
 #include <lualib.h>
 }
 
+template <typename Fn> inline int LuaStateCore::Protect(int args_count, Fn&& fn) {
+  auto invoke = [](lua_State* L, void* data) -> int { return (*static_cast<std::remove_reference_t<Fn>*>(data))(L); };
+  return ProtectedCall(args_count, invoke, const_cast<void*>(static_cast<const void*>(std::addressof(fn))));
+}
+
+template <typename Fn> inline int LuaStateCore::ProtectLimited(int args_count, Fn&& fn) {
+  return HasMemoryLimit() ? Protect(args_count, std::forward<Fn>(fn)) : fn(L_);
+}
+
 template <LuaVisitor Visitor> inline void LuaStateCore::Traverse(int index, Visitor& visitor) {
   switch (lua_type(L_, index)) {
     case LUA_TNUMBER:
@@ -20,7 +33,7 @@ template <LuaVisitor Visitor> inline void LuaStateCore::Traverse(int index, Visi
     case LUA_TSTRING: {
       size_t len;
       const char* ptr = lua_tolstring(L_, index, &len);
-      visitor.OnValue(LuaString{ptr, len});
+      visitor.OnValue(LuaString{ptr, len, index});
       break;
     }
     case LUA_TBOOLEAN:
@@ -33,6 +46,14 @@ template <LuaVisitor Visitor> inline void LuaStateCore::Traverse(int index, Visi
     case LUA_TTABLE:
       TraverseTable(index, visitor);
       break;
+    case LUA_TUSERDATA:
+      // visitors may resolve the userdata they know, the rest converts to nil
+      if constexpr (requires { visitor.OnValue(LuaUserData{0}); }) {
+        visitor.OnValue(LuaUserData{index});
+      } else {
+        visitor.OnValue(LuaNil{});
+      }
+      break;
     default:
       visitor.OnValue(LuaNil{});
       break;
@@ -40,32 +61,93 @@ template <LuaVisitor Visitor> inline void LuaStateCore::Traverse(int index, Visi
 }
 
 template <LuaVisitor Visitor> void LuaStateCore::TraverseTable(int index, Visitor& visitor) {
-  struct QueueFrame {
-    LuaRegistryRef ref;
-    LuaTable table;
+  // pending tables are kept in the scratch table slots above the entry top, so nested traversals do not clash
+  struct ScratchGuard {
+    LuaStateCore& core;
+    int base;
+    ~ScratchGuard() {
+      if (core.traverse_scratch_top_ > base) {
+        core.ClearTraverseScratch(base);
+      }
+    }
   };
 
-  auto root_table = LuaTable{lua_topointer(L_, index)};
-  auto root_ref = CopyRef(index);
+  // visitors opt in to sequences, a pending table then takes a second slot with its sequence length
+  bool use_sequences = false;
+  if constexpr (requires { { visitor.UseSequences() } -> std::same_as<bool>; }) {
+    use_sequences = visitor.UseSequences();
+  }
+
+  index = lua_absindex(L_, index);
 
-  visitor.OnValue(root_table);
+  PushTraverseScratch();
 
-  std::vector<QueueFrame> queue;
-  queue.reserve(8);
-  queue.emplace_back(QueueFrame{root_ref, root_table});
+  int scratch_index = GetTop();
+  int& top = traverse_scratch_top_;
 
-  while (!queue.empty()) {
-    QueueFrame current_frame = queue.back();
-    queue.pop_back();
+  ScratchGuard guard{*this, top};
 
-    // push table to lua stack by ref
-    PushRef(current_frame.ref);
+  // value_index is a table, its raw length is the length of the sequence it may be
+  auto make_table = [&](int value_index) {
+    return LuaTable{lua_topointer(L_, value_index), use_sequences ? static_cast<size_t>(lua_rawlen(L_, value_index)) : 0};
+  };
 
-    int table_index = GetTop();
+  auto push_pending = [&](int value_index, const LuaTable& table) {
+    lua_pushvalue(L_, value_index);
+    lua_rawseti(L_, scratch_index, ++top);
+
+    if (use_sequences) {
+      lua_pushinteger(L_, static_cast<lua_Integer>(table.sequence_length));
+      lua_rawseti(L_, scratch_index, ++top);
+    }
+  };
+
+  // value on top of the stack
+  auto visit_property = [&](const LuaTableKey& key) {
+    switch (lua_type(L_, -1)) {
+      case LUA_TNUMBER:
+        visitor.OnProperty(key, LuaNumber{lua_tonumber(L_, -1)});
+        break;
+      case LUA_TSTRING: {
+        size_t len;
+        const char* ptr = lua_tolstring(L_, -1, &len);
+        visitor.OnProperty(key, LuaString{ptr, len, -1});
+        break;
+      }
+      case LUA_TBOOLEAN:
+        visitor.OnProperty(key, LuaBool{lua_toboolean(L_, -1) != 0});
+        break;
+      case LUA_TFUNCTION: {
+        visitor.OnProperty(key, LuaFunction{lua_topointer(L_, -1), -1});
+        break;
+      }
+      case LUA_TTABLE: {
+        auto child_table = make_table(-1);
+
+        // if the child table has not been visited, add it to the pending slots
+        if (visitor.OnProperty(key, child_table)) {
+          push_pending(-1, child_table);
+        }
+        break;
+      }
+      case LUA_TUSERDATA:
+        if constexpr (requires { visitor.OnProperty(key, LuaUserData{0}); }) {
+          visitor.OnProperty(key, LuaUserData{-1});
+        } else {
+          visitor.OnProperty(key, LuaNil{});
+        }
+        break;
+      default:
+        visitor.OnProperty(key, LuaNil{});
+        break;
+    }
+  };
 
-    visitor.SetTable(current_frame.table);
+  // visits the properties of the table at table_index, returns false if the table is not the sequence 1..length: at
+  // the first other number key, or after the walk if keys are missing
+  auto visit_properties = [&](int table_index, size_t length) -> bool {
+    size_t sequence_keys = 0;
 
-    // loop by table properties
     PushNil();
 
     while (lua_next(L_, table_index)) {
@@ -85,46 +167,68 @@ template <LuaVisitor Visitor> void LuaStateCore::TraverseTable(int index, Visito
 
         size_t len;
         const char* ptr = lua_tolstring(L_, -2, &len);
-        return LuaString{ptr, len};
+        return LuaString{ptr, len, -2};
       }();
 
-      switch (lua_type(L_, -1)) {
-        case LUA_TNUMBER:
-          visitor.OnProperty(key, LuaNumber{lua_tonumber(L_, -1)});
-          break;
-        case LUA_TSTRING: {
-          size_t len;
-          const char* ptr = lua_tolstring(L_, -1, &len);
-          visitor.OnProperty(key, LuaString{ptr, len});
-          break;
-        }
-        case LUA_TBOOLEAN:
-          visitor.OnProperty(key, LuaBool{lua_toboolean(L_, -1) != 0});
-          break;
-        case LUA_TFUNCTION: {
-          visitor.OnProperty(key, LuaFunction{lua_topointer(L_, -1), -1});
-          break;
+      if (length && prop_key_type == LUA_TNUMBER) {
+        if (!IsSequenceKey(lua_tonumber(L_, -2), length)) {
+          Pop(2);
+          return false;
         }
-        case LUA_TTABLE: {
-          auto child_table = LuaTable{lua_topointer(L_, -1)};
-
-          // if the child table has not been visited, add a new frame to the queue
-          if (visitor.OnProperty(key, child_table)) {
-            auto child_ref = CopyRef(-1);
-            queue.emplace_back(QueueFrame{child_ref, child_table});
-          }
-          break;
-        }
-        default:
-          visitor.OnProperty(key, LuaNil{});
-          break;
+
+        sequence_keys++;
       }
 
+      visit_property(key);
+
       Pop(1);
     }
 
-    Pop(1);
+    // holes in 1..length
+    return sequence_keys == length;
+  };
+
+  {
+    auto root_table = make_table(index);
+    visitor.OnValue(root_table);
+    push_pending(index, root_table);
+  }
+
+  while (top > guard.base) {
+    size_t length = 0;
 
-    ReleaseRef(current_frame.ref);
+    if (use_sequences) {
+      lua_rawgeti(L_, scratch_index, top);
+      length = static_cast<size_t>(lua_tointeger(L_, -1));
+      lua_pop(L_, 1);
+      lua_pushnil(L_);
+      lua_rawseti(L_, scratch_index, top--);
+    }
+
+    // take the last pending table and clear its slot
+    lua_rawgeti(L_, scratch_index, top);
+    lua_pushnil(L_);
+    lua_rawseti(L_, scratch_index, top--);
+
+    int table_index = GetTop();
+    const void* identity = lua_topointer(L_, table_index);
+
+    // a table with a raw length is visited as a sequence in one walk, if the walk proves it is none, the table is set
+    // again without a length and visited from the start
+    visitor.SetTable(LuaTable{identity, length});
+
+    if (!visit_properties(table_index, length)) {
+      visitor.SetTable(LuaTable{identity, 0});
+      visit_properties(table_index, 0);
+    }
+
+    // visitors may batch the properties of a table
+    if constexpr (requires { visitor.EndTable(); }) {
+      visitor.EndTable();
+    }
+
+    Pop(1);
   }
+
+  Pop(1);
 };
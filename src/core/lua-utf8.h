@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/**
+ * UTF-8 checks of Lua strings, which are plain bytes. ASCII runs are skipped
+ * 8 bytes at a time, only the bytes of multibyte sequences are looked at one
+ * by one.
+ */
+struct LuaUtf8 {
+  static constexpr uint64_t LowBytes = 0x0101010101010101ULL;
+  static constexpr uint64_t HighBits = 0x8080808080808080ULL;
+
+  // length of the ASCII prefix of the string
+  static size_t GetAsciiLength(std::string_view str) {
+    const char* p = str.data();
+    const char* end = p + str.size();
+
+    while (end - p >= 8) {
+      uint64_t chunk;
+      std::memcpy(&chunk, p, sizeof(chunk));
+
+      if (chunk & HighBits) {
+        break;
+      }
+
+      p += 8;
+    }
+
+    while (p < end && static_cast<unsigned char>(*p) < 0x80) {
+      p++;
+    }
+
+    return static_cast<size_t>(p - str.data());
+  }
+
+  static bool IsAscii(std::string_view str) { return GetAsciiLength(str) == str.size(); }
+
+  // length of the valid multibyte sequence at p, 0 if it is invalid
+  static size_t GetSequenceLength(const unsigned char* p, const unsigned char* end) {
+    auto is_continuation = [](unsigned char c) { return (c & 0xc0) == 0x80; };
+    size_t available = static_cast<size_t>(end - p);
+    unsigned char c = p[0];
+
+    if (c >= 0xc2 && c <= 0xdf) {
+      return available >= 2 && is_continuation(p[1]) ? 2 : 0;
+    }
+
+    if (c >= 0xe0 && c <= 0xef) {
+      if (available < 3 || !is_continuation(p[1]) || !is_continuation(p[2])) {
+        return 0;
+      }
+      // overlong forms and surrogates
+      if ((c == 0xe0 && p[1] < 0xa0) || (c == 0xed && p[1] > 0x9f)) {
+        return 0;
+      }
+      return 3;
+    }
+
+    if (c >= 0xf0 && c <= 0xf4) {
+      if (available < 4 || !is_continuation(p[1]) || !is_continuation(p[2]) || !is_continuation(p[3])) {
+        return 0;
+      }
+      // overlong forms and code points above U+10FFFF
+      if ((c == 0xf0 && p[1] < 0x90) || (c == 0xf4 && p[1] > 0x8f)) {
+        return 0;
+      }
+      return 4;
+    }
+
+    return 0;
+  }
+
+  static bool IsValid(std::string_view str) {
+    const auto* p = reinterpret_cast<const unsigned char*>(str.data());
+    const auto* end = p + str.size();
+
+    while (p < end) {
+      p += GetAsciiLength({reinterpret_cast<const char*>(p), static_cast<size_t>(end - p)});
+
+      if (p == end) {
+        break;
+      }
+
+      size_t length = GetSequenceLength(p, end);
+
+      if (!length) {
+        return false;
+      }
+
+      p += length;
+    }
+
+    return true;
+  }
+};
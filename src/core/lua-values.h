@@ -2,6 +2,7 @@
 
 #include <string>
 #include <variant>
+#include <vector>
 
 extern "C" {
 #include <lauxlib.h>
@@ -20,10 +21,14 @@ struct LuaNumber {
 struct LuaString {
   const char* ptr;
   const size_t len;
+  // stack index of the string while it is visited
+  const int index = 0;
 };
 
 struct LuaTable {
   const void* identity;
+  // raw length of a table which may be the sequence 1..n, 0 if it is not one or sequences are not requested
+  size_t sequence_length = 0;
 };
 
 struct LuaFunction {
@@ -31,8 +36,17 @@ struct LuaFunction {
   const int index;
 };
 
+struct LuaUserData {
+  const int index;
+};
+
 struct LuaRegistryRef {
   int value = LUA_NOREF;
 };
 
+// String keys of a record, interned in the registry, see LuaStateCore::TraverseTable
+struct LuaShape {
+  std::vector<LuaRegistryRef> keys;
+};
+
 using LuaTableKey = std::variant<LuaNumber, LuaString>;
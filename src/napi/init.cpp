@@ -1,13 +1,17 @@
 #include <napi.h>
 
-#include "conversion/js-object-lua-ref-cache.hpp"
+#include "napi/lua-call.h"
 #include "napi/lua-error.h"
+#include "napi/lua-path.h"
+#include "napi/lua-state-pool.h"
 #include "napi/lua-state.h"
 
 Napi::Object InitAll(Napi::Env env, Napi::Object exports) {
+  LuaCall::NapiInit(env, exports);
   LuaError::NapiInit(env, exports);
+  LuaPath::NapiInit(env, exports);
   LuaState::NapiInit(env, exports);
-  JsObjectLuaRefCache::NapiInit(env);
+  LuaStatePool::NapiInit(env, exports);
 
   return exports;
 }
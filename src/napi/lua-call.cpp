@@ -0,0 +1,120 @@
+#include <span>
+
+#include "napi/lua-call.h"
+
+namespace {
+  struct LuaCallInit {
+    const std::shared_ptr<LuaJsRuntime>& runtime;
+    const Napi::Value& path_or_fn;
+    const Napi::Value& options;
+  };
+
+  Napi::Reference<Napi::Float64Array> ParseArrayOption(const Napi::Env& env, const Napi::Object& options, const char* name) {
+    auto value = options.Get(name);
+
+    if (value.IsUndefined()) {
+      return {};
+    }
+
+    if (!value.IsTypedArray() || value.As<Napi::TypedArray>().TypedArrayType() != napi_float64_array) {
+      throw Napi::TypeError::New(env, "Option \"" + std::string(name) + "\" must be a Float64Array");
+    }
+
+    return Napi::Persistent(value.As<Napi::Float64Array>());
+  }
+
+  template <typename T> std::span<T> GetElements(const Napi::Reference<Napi::Float64Array>& ref) {
+    if (ref.IsEmpty()) {
+      return {};
+    }
+
+    // read on every call, a detached buffer has no elements. Only valid until JS runs again
+    auto array = ref.Value();
+    return {array.Data(), array.ElementLength()};
+  }
+} // namespace
+
+/**
+ * Napi Initializer
+ */
+void LuaCall::NapiInit(Napi::Env env, Napi::Object exports) {
+  auto lua_call_class = DefineClass(
+    env,
+    "LuaCall",
+    {
+      InstanceMethod("call", &LuaCall::Call),
+    }
+  );
+
+  constructor_ = Napi::Persistent(lua_call_class);
+  constructor_.SuppressDestruct();
+}
+
+/**
+ * Factory
+ */
+Napi::Object LuaCall::New(const Napi::Env& env, const std::shared_ptr<LuaJsRuntime>& runtime, const Napi::Value& path_or_fn, const Napi::Value& options) {
+  LuaCallInit init{runtime, path_or_fn, options};
+  return constructor_.New({Napi::External<LuaCallInit>::New(env, &init)});
+}
+
+/**
+ * Constructor
+ */
+LuaCall::LuaCall(const Napi::CallbackInfo& info) : Napi::ObjectWrap<LuaCall>(info) {
+  auto env = info.Env();
+
+  if (info.Length() != 1 || !info[0].IsExternal()) {
+    throw Napi::TypeError::New(env, "Use LuaState#prepareCall to create a call");
+  }
+
+  auto* init = info[0].As<Napi::External<LuaCallInit>>().Data();
+
+  if (!init->options.IsUndefined() && !init->options.IsObject()) {
+    throw Napi::TypeError::New(env, "Options must be an object");
+  }
+
+  if (init->options.IsObject()) {
+    auto options = init->options.As<Napi::Object>();
+    args_ = ParseArrayOption(env, options, "args");
+    results_ = ParseArrayOption(env, options, "results");
+  }
+
+  runtime_ = init->runtime;
+  generation_ = init->runtime->GetGeneration();
+  fn_ref_ = init->runtime->PrepareCall(env, init->path_or_fn);
+}
+
+/**
+ * Destructor
+ */
+LuaCall::~LuaCall() {
+  // if runtime destroyed then LuaStateCore also destroyed with Lua VM and all refs
+  auto runtime = runtime_.lock();
+  if (runtime && !runtime->IsClosed() && fn_ref_.value != LUA_NOREF) {
+    runtime->ReleaseCall(fn_ref_);
+  }
+}
+
+/**
+ * Call
+ */
+Napi::Value LuaCall::Call(const Napi::CallbackInfo& info) {
+  auto runtime = LockRuntime();
+  // the arguments are pushed before Lua runs, the results are resolved by the runtime after the call
+  auto count = runtime->CallPrepared(info.Env(), fn_ref_, GetElements<const double>(args_), results_);
+  return Napi::Number::New(info.Env(), count);
+}
+
+std::shared_ptr<LuaJsRuntime> LuaCall::LockRuntime() {
+  auto runtime = runtime_.lock();
+
+  // closed, or released to a LuaStatePool and lent to another borrower
+  if (!runtime || runtime->IsClosed() || runtime->GetGeneration() != generation_) [[unlikely]] {
+    auto err = Napi::Error::New(Env(), "LuaState is closed");
+    err.Set("code", "ERR_LUA_STATE_CLOSED");
+    throw err;
+  }
+
+  return runtime;
+}
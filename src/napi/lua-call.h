@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <napi.h>
+
+#include "core/lua-values.h"
+#include "runtime/lua-js-runtime.h"
+
+/**
+ * Prepared Lua call, created by LuaState#prepareCall.
+ *
+ * The function is resolved once and kept in the registry. Every call reads its
+ * numeric arguments from the args Float64Array and writes the numeric results
+ * into the results Float64Array, so it allocates neither JS values nor
+ * argument lists.
+ */
+class LuaCall : public Napi::ObjectWrap<LuaCall> {
+public:
+  static void NapiInit(Napi::Env, Napi::Object);
+  static Napi::Object New(const Napi::Env&, const std::shared_ptr<LuaJsRuntime>& runtime, const Napi::Value& path_or_fn, const Napi::Value& options);
+
+  LuaCall(const Napi::CallbackInfo&);
+  ~LuaCall();
+
+private:
+  static inline Napi::FunctionReference constructor_;
+
+  std::weak_ptr<LuaJsRuntime> runtime_;
+  uint64_t generation_ = 0;
+  LuaRegistryRef fn_ref_;
+  Napi::Reference<Napi::Float64Array> args_;
+  Napi::Reference<Napi::Float64Array> results_;
+
+  Napi::Value Call(const Napi::CallbackInfo&);
+
+  std::shared_ptr<LuaJsRuntime> LockRuntime();
+};
@@ -4,7 +4,13 @@
  * Napi Initializer
  */
 void LuaError::NapiInit(Napi::Env env, Napi::Object exports) {
-  auto lua_error_class = DefineClass(env, "LuaError", {});
+  auto lua_error_class = DefineClass(
+    env,
+    "LuaError",
+    {
+      InstanceAccessor("stack", &LuaError::GetStack, &LuaError::SetStack, napi_configurable),
+    }
+  );
 
   auto global = env.Global();
   auto error_class = global.Get("Error").As<Napi::Function>();
@@ -45,33 +51,44 @@ LuaError::LuaError(const Napi::CallbackInfo& info) : Napi::ObjectWrap<LuaError>(
 /**
  * Factory
  */
-Napi::Error LuaError::New(Napi::Env env, const Napi::Object& lua_error) {
-  auto message_value = lua_error.Get("message");
-  auto cause_value = lua_error.Get("cause");
-  auto stack_value = lua_error.Get("stack");
-
-  auto message = message_value.IsString()      ? message_value.As<Napi::String>()
-                 : message_value.IsUndefined() ? Napi::String::New(env, "")
-                                               : message_value.ToString();
-
-  Napi::Object options = Napi::Object::New(env);
-  if (!cause_value.IsUndefined()) {
-    options.Set("cause", cause_value);
+Napi::Error LuaError::New(Napi::Env env, const Napi::String& message, const Napi::Value& cause, std::string traceback) {
+  Napi::Object instance;
+
+  if (cause.IsUndefined()) {
+    instance = constructor_.New({message});
+  } else {
+    Napi::Object options = Napi::Object::New(env);
+    options.Set("cause", cause);
+    instance = constructor_.New({message, options});
   }
 
-  Napi::Object instance = constructor_.New({message, options});
+  Unwrap(instance)->traceback_ = std::move(traceback);
 
-  if (stack_value.IsString()) {
-    std::string msg = message.Utf8Value();
-    std::string header = "LuaError:";
-    if (!msg.empty()) {
-      header += " " + msg;
-    }
+  return Napi::Error(env, instance);
+}
 
-    std::string stack = header + "\n    " + stack_value.As<Napi::String>().Utf8Value();
+/**
+ * Stack getter, formats the Lua traceback with the current message
+ */
+Napi::Value LuaError::GetStack(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
 
-    instance.Set("stack", stack);
+  if (traceback_.empty()) {
+    return env.Undefined();
   }
 
-  return Napi::Error(env, instance);
-}
\ No newline at end of file
+  std::string msg = Value().Get("message").ToString().Utf8Value();
+  std::string header = "LuaError:";
+  if (!msg.empty()) {
+    header += " " + msg;
+  }
+
+  return Napi::String::New(env, header + "\n    " + traceback_);
+}
+
+/**
+ * Stack setter, an assigned value shadows the accessor
+ */
+void LuaError::SetStack(const Napi::CallbackInfo& info, const Napi::Value& value) {
+  Value().DefineProperty(Napi::PropertyDescriptor::Value("stack", value, static_cast<napi_property_attributes>(napi_writable | napi_configurable)));
+}
@@ -1,14 +1,22 @@
 #pragma once
 
+#include <string>
+
 #include <napi.h>
 
 class LuaError : public Napi::ObjectWrap<LuaError> {
 public:
   static void NapiInit(Napi::Env, Napi::Object);
-  static Napi::Error New(Napi::Env, const Napi::Object&);
+  static Napi::Error New(Napi::Env, const Napi::String& message, const Napi::Value& cause, std::string traceback);
 
   LuaError(const Napi::CallbackInfo&);
 
 private:
   static inline Napi::FunctionReference constructor_;
-};
\ No newline at end of file
+
+  // Lua traceback, the stack string is only built when it is read
+  std::string traceback_;
+
+  Napi::Value GetStack(const Napi::CallbackInfo&);
+  void SetStack(const Napi::CallbackInfo&, const Napi::Value&);
+};
@@ -0,0 +1,104 @@
+#include "napi/lua-path.h"
+
+namespace {
+  struct LuaPathInit {
+    const std::shared_ptr<LuaJsRuntime>& runtime;
+    std::string path;
+  };
+} // namespace
+
+/**
+ * Napi Initializer
+ */
+void LuaPath::NapiInit(Napi::Env env, Napi::Object exports) {
+  auto lua_path_class = DefineClass(
+    env,
+    "LuaPath",
+    {
+      InstanceMethod("get", &LuaPath::Get),
+      InstanceMethod("length", &LuaPath::GetLength),
+      InstanceMethod("set", &LuaPath::Set),
+      InstanceMethod("toString", &LuaPath::ToString),
+    }
+  );
+
+  constructor_ = Napi::Persistent(lua_path_class);
+  constructor_.SuppressDestruct();
+}
+
+/**
+ * Factory
+ */
+Napi::Object LuaPath::New(const Napi::Env& env, const std::shared_ptr<LuaJsRuntime>& runtime, std::string path) {
+  LuaPathInit init{runtime, std::move(path)};
+  return constructor_.New({Napi::External<LuaPathInit>::New(env, &init)});
+}
+
+/**
+ * Constructor
+ */
+LuaPath::LuaPath(const Napi::CallbackInfo& info) : Napi::ObjectWrap<LuaPath>(info) {
+  if (info.Length() != 1 || !info[0].IsExternal()) {
+    throw Napi::TypeError::New(info.Env(), "Use LuaState#path to create a path");
+  }
+
+  auto* init = info[0].As<Napi::External<LuaPathInit>>().Data();
+
+  runtime_ = init->runtime;
+  generation_ = init->runtime->GetGeneration();
+  path_ = std::move(init->path);
+  segments_ = init->runtime->PreparePath(path_);
+}
+
+/**
+ * Destructor
+ */
+LuaPath::~LuaPath() {
+  // if runtime destroyed then LuaStateCore also destroyed with Lua VM and all refs
+  auto runtime = runtime_.lock();
+  if (runtime && !runtime->IsClosed()) {
+    runtime->ReleasePath(segments_);
+  }
+}
+
+/**
+ * Get
+ */
+Napi::Value LuaPath::Get(const Napi::CallbackInfo& info) {
+  auto runtime = LockRuntime();
+  return runtime->GetGlobal(info.Env(), segments_);
+}
+
+/**
+ * GetLength
+ */
+Napi::Value LuaPath::GetLength(const Napi::CallbackInfo& info) {
+  auto runtime = LockRuntime();
+  return runtime->GetLength(info.Env(), segments_);
+}
+
+/**
+ * Set
+ */
+Napi::Value LuaPath::Set(const Napi::CallbackInfo& info) {
+  auto runtime = LockRuntime();
+  return Napi::Boolean::New(info.Env(), runtime->SetGlobal(segments_, info[0]));
+}
+
+/**
+ * ToString
+ */
+Napi::Value LuaPath::ToString(const Napi::CallbackInfo& info) { return Napi::String::New(info.Env(), path_); }
+
+std::shared_ptr<LuaJsRuntime> LuaPath::LockRuntime() {
+  auto runtime = runtime_.lock();
+
+  // closed, or released to a LuaStatePool and lent to another borrower
+  if (!runtime || runtime->IsClosed() || runtime->GetGeneration() != generation_) [[unlikely]] {
+    auto err = Napi::Error::New(Env(), "LuaState is closed");
+    err.Set("code", "ERR_LUA_STATE_CLOSED");
+    throw err;
+  }
+
+  return runtime;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+#include <napi.h>
+#include <string>
+#include <vector>
+
+#include "core/lua-values.h"
+#include "runtime/lua-js-runtime.h"
+
+/**
+ * Prepared global path, created by LuaState#path.
+ *
+ * The path is split once and each segment is kept as an interned Lua string in
+ * the registry, so reads and writes skip parsing and string hashing.
+ */
+class LuaPath : public Napi::ObjectWrap<LuaPath> {
+public:
+  static void NapiInit(Napi::Env, Napi::Object);
+  static Napi::Object New(const Napi::Env&, const std::shared_ptr<LuaJsRuntime>& runtime, std::string path);
+
+  LuaPath(const Napi::CallbackInfo&);
+  ~LuaPath();
+
+private:
+  static inline Napi::FunctionReference constructor_;
+
+  std::weak_ptr<LuaJsRuntime> runtime_;
+  uint64_t generation_ = 0;
+  std::string path_;
+  std::vector<LuaRegistryRef> segments_;
+
+  Napi::Value Get(const Napi::CallbackInfo&);
+  Napi::Value GetLength(const Napi::CallbackInfo&);
+  Napi::Value Set(const Napi::CallbackInfo&);
+  Napi::Value ToString(const Napi::CallbackInfo&);
+
+  std::shared_ptr<LuaJsRuntime> LockRuntime();
+};
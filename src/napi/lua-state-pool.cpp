@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <napi.h>
+
+#include "napi/lua-state-pool.h"
+#include "napi/lua-state.h"
+
+/**
+ * Napiapi Initializer
+ */
+void LuaStatePool::NapiInit(Napi::Env env, Napi::Object exports) {
+  Napi::Function lua_state_pool_class = DefineClass(
+    env,
+    "LuaStatePool",
+    {
+      InstanceMethod("acquire", &LuaStatePool::Acquire),
+      InstanceMethod("close", &LuaStatePool::Close),
+      InstanceMethod("getStats", &LuaStatePool::GetStats),
+      InstanceMethod("release", &LuaStatePool::Release),
+    }
+  );
+
+  exports.Set("LuaStatePool", lua_state_pool_class);
+}
+
+/**
+ * Constructor
+ */
+LuaStatePool::LuaStatePool(const Napi::CallbackInfo& info) : Napi::ObjectWrap<LuaStatePool>(info) {
+  auto env = info.Env();
+
+  config_ = LuaState::ParseLuaConfig(env, info[0]);
+
+  if (info[0].IsObject()) {
+    auto options = info[0].As<Napi::Object>();
+
+    auto size_option = options.Get("size");
+    if (!size_option.IsUndefined()) {
+      if (!size_option.IsNumber() || size_option.As<Napi::Number>().DoubleValue() < 1) {
+        throw Napi::TypeError::New(env, "Option \"size\" must be a positive number");
+      }
+      size_ = static_cast<size_t>(size_option.As<Napi::Number>().DoubleValue());
+    }
+
+    auto prelude_option = options.Get("prelude");
+    if (!prelude_option.IsUndefined()) {
+      if (!prelude_option.IsString()) {
+        throw Napi::TypeError::New(env, "Option \"prelude\" must be a string");
+      }
+      prelude_ = prelude_option.As<Napi::String>().Utf8Value();
+    }
+  }
+
+  idle_.reserve(size_);
+  for (size_t i = 0; i < size_; i++) {
+    idle_.push_back(CreateRuntime(env));
+  }
+}
+
+/**
+ * Acquire
+ */
+Napi::Value LuaStatePool::Acquire(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  if (is_closed_) {
+    auto err = Napi::Error::New(env, "LuaStatePool is closed");
+    err.Set("code", "ERR_LUA_STATE_POOL_CLOSED");
+    throw err;
+  }
+
+  std::shared_ptr<LuaJsRuntime> runtime;
+
+  // all warm states are lent, grow beyond the pool size
+  if (idle_.empty()) {
+    runtime = CreateRuntime(env);
+  } else {
+    runtime = std::move(idle_.back());
+    idle_.pop_back();
+  }
+
+  PruneBorrowed();
+  borrowed_.push_back(runtime);
+
+  return LuaState::NewInstance(env, std::move(runtime));
+}
+
+/**
+ * Release
+ */
+Napi::Value LuaStatePool::Release(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  if (info.Length() < 1 || !LuaState::IsInstance(env, info[0])) {
+    throw Napi::TypeError::New(env, "LuaState argument expected");
+  }
+
+  auto* lua_state = LuaState::Unwrap(info[0].As<Napi::Object>());
+  const auto& lua_state_runtime = lua_state->GetRuntime();
+
+  // an expired entry never matches, even if a new runtime took the address of its runtime
+  auto it = std::find_if(borrowed_.begin(), borrowed_.end(), [&](const auto& borrowed) { return lua_state_runtime && borrowed.lock() == lua_state_runtime; });
+  if (it == borrowed_.end()) {
+    auto err = Napi::Error::New(env, "LuaState is not borrowed from this pool");
+    err.Set("code", "ERR_LUA_STATE_NOT_BORROWED");
+    throw err;
+  }
+
+  borrowed_.erase(it);
+
+  auto runtime = lua_state->Detach();
+
+  if (runtime->IsClosed()) {
+    return env.Undefined();
+  }
+
+  // surplus states created on demand are not kept
+  if (is_closed_ || idle_.size() >= size_) {
+    runtime->Close();
+    return env.Undefined();
+  }
+
+  // a state too close to its memory limit to be reset is not reused
+  if (!runtime->ResetToBaseline()) {
+    runtime->Close();
+    return env.Undefined();
+  }
+
+  idle_.push_back(std::move(runtime));
+
+  return env.Undefined();
+}
+
+/**
+ * Close
+ */
+Napi::Value LuaStatePool::Close(const Napi::CallbackInfo& info) {
+  is_closed_ = true;
+
+  for (auto& runtime : idle_) {
+    runtime->Close();
+  }
+  idle_.clear();
+
+  return info.Env().Undefined();
+}
+
+/**
+ * GetStats
+ */
+Napi::Value LuaStatePool::GetStats(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  auto result = Napi::Object::New(env);
+  result.Set("size", static_cast<double>(size_));
+  result.Set("idle", static_cast<double>(idle_.size()));
+  PruneBorrowed();
+  result.Set("borrowed", static_cast<double>(borrowed_.size()));
+
+  return result;
+}
+
+std::shared_ptr<LuaJsRuntime> LuaStatePool::CreateRuntime(const Napi::Env& env) {
+  auto runtime = std::make_shared<LuaJsRuntime>(config_);
+
+  if (runtime->IsClosed()) {
+    auto err = Napi::Error::New(env, "Not enough memory to create LuaState");
+    err.Set("code", "ERR_LUA_STATE_ALLOC");
+    throw err;
+  }
+
+  if (!prelude_.empty()) {
+    runtime->EvalString(env, prelude_);
+
+    if (env.IsExceptionPending()) {
+      throw env.GetAndClearPendingException();
+    }
+  }
+
+  if (!runtime->SaveBaseline()) {
+    runtime->Close();
+    auto err = Napi::Error::New(env, "Not enough memory to create LuaState");
+    err.Set("code", "ERR_LUA_STATE_ALLOC");
+    throw err;
+  }
+
+  runtime->StartGcScheduler(env);
+
+  return runtime;
+}
+
+void LuaStatePool::PruneBorrowed() {
+  std::erase_if(borrowed_, [](const auto& borrowed) { return borrowed.expired(); });
+}
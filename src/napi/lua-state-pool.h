@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <napi.h>
+#include <string>
+#include <vector>
+
+#include "runtime/lua-config.h"
+#include "runtime/lua-js-runtime.h"
+
+/**
+ * Pool of pre-initialized states.
+ *
+ * Every pooled runtime runs the prelude once and records its globals as the baseline.
+ * Released states are reset to the baseline in place instead of being rebuilt.
+ */
+class LuaStatePool : public Napi::ObjectWrap<LuaStatePool> {
+public:
+  static constexpr size_t DefaultSize = 4;
+
+  LuaStatePool(const Napi::CallbackInfo&);
+
+  static void NapiInit(Napi::Env, Napi::Object);
+
+private:
+  LuaConfig config_;
+  std::string prelude_;
+  size_t size_ = DefaultSize;
+  bool is_closed_ = false;
+
+  std::vector<std::shared_ptr<LuaJsRuntime>> idle_;
+  // lent runtimes, an entry expires when its LuaState is finalized without a release
+  std::vector<std::weak_ptr<LuaJsRuntime>> borrowed_;
+
+  Napi::Value Acquire(const Napi::CallbackInfo&);
+  Napi::Value Release(const Napi::CallbackInfo&);
+  Napi::Value Close(const Napi::CallbackInfo&);
+  Napi::Value GetStats(const Napi::CallbackInfo&);
+
+  std::shared_ptr<LuaJsRuntime> CreateRuntime(const Napi::Env&);
+  void PruneBorrowed();
+};
@@ -1,13 +1,17 @@
+#include <climits>
 #include <napi.h>
 #include <variant>
 
+#include "core/lua-chunk-cache.h"
 #include "lua-state.h"
+#include "napi/lua-call.h"
+#include "napi/lua-path.h"
 #include "napi/lua-state.h"
 #include "napi/napi-string-buffer.h"
 #include "runtime/lua-config.h"
 
 #define RETURN_IF_CLOSED(env)                                                                                                                                  \
-  if (runtime_->IsClosed()) [[unlikely]] {                                                                                                                     \
+  if (!runtime_ || runtime_->IsClosed()) [[unlikely]] {                                                                                                        \
     auto err = Napi::Error::New(env, "LuaState is closed");                                                                                                    \
     err.Set("code", "ERR_LUA_STATE_CLOSED");                                                                                                                   \
     err.ThrowAsJavaScriptException();                                                                                                                          \
@@ -23,12 +27,28 @@ void LuaState::NapiInit(Napi::Env env, Napi::Object exports) {
     "LuaState",
     {
       InstanceMethod("close", &LuaState::Close),
+      InstanceMethod("compile", &LuaState::CompileLuaString),
+      InstanceMethod("compileBundle", &LuaState::CompileLuaBundle),
+      InstanceMethod("defineShape", &LuaState::DefineRecordShape),
       InstanceMethod("evalFile", &LuaState::EvalLuaFile),
       InstanceMethod("eval", &LuaState::EvalLuaString),
+      InstanceMethod("gc", &LuaState::ControlLuaGc),
       InstanceMethod("getGlobal", &LuaState::GetLuaGlobalValue),
+      InstanceMethod("getGlobalJSON", &LuaState::GetLuaGlobalJson),
+      InstanceMethod("getGlobalPacked", &LuaState::GetLuaGlobalPacked),
       InstanceMethod("getLength", &LuaState::GetLuaValueLength),
+      InstanceMethod("getMemoryStats", &LuaState::GetMemoryStats),
       InstanceMethod("getVersion", &LuaState::GetLuaVersion),
+      InstanceMethod("loadBundle", &LuaState::LoadLuaBundle),
+      InstanceMethod("path", &LuaState::PrepareLuaPath),
+      InstanceMethod("prepareCall", &LuaState::PrepareLuaCall),
+      InstanceMethod("ref", &LuaState::MarkJsObjectRef),
       InstanceMethod("setGlobal", &LuaState::SetLuaGlobalValue),
+      InstanceMethod("setGlobalJSON", &LuaState::SetLuaGlobalJson),
+      InstanceMethod("setGlobalPacked", &LuaState::SetLuaGlobalPacked),
+      StaticMethod("clearChunkCache", &LuaState::ClearChunkCache),
+      StaticMethod("configureChunkCache", &LuaState::ConfigureChunkCache),
+      StaticMethod("getChunkCacheStats", &LuaState::GetChunkCacheStats),
     }
   );
 
@@ -41,13 +61,46 @@ void LuaState::NapiInit(Napi::Env env, Napi::Object exports) {
 /**
  * Constructor
  */
-LuaState::LuaState(const Napi::CallbackInfo& info) : Napi::ObjectWrap<LuaState>(info) { runtime_ = std::make_shared<LuaJsRuntime>(ParseLuaConfig(info)); }
+LuaState::LuaState(const Napi::CallbackInfo& info) : Napi::ObjectWrap<LuaState>(info) {
+  // runtime lent by LuaStatePool
+  if (info.Length() == 1 && info[0].IsExternal()) {
+    runtime_ = *info[0].As<Napi::External<std::shared_ptr<LuaJsRuntime>>>().Data();
+    return;
+  }
+
+  runtime_ = std::make_shared<LuaJsRuntime>(ParseLuaConfig(info.Env(), info[0]));
+
+  if (runtime_->IsClosed()) {
+    auto err = Napi::Error::New(info.Env(), "Not enough memory to create LuaState");
+    err.Set("code", "ERR_LUA_STATE_ALLOC");
+    throw err;
+  }
+
+  runtime_->StartGcScheduler(info.Env());
+}
+
+Napi::Object LuaState::NewInstance(const Napi::Env& env, std::shared_ptr<LuaJsRuntime> runtime) {
+  auto* constructor = env.GetInstanceData<Napi::FunctionReference>();
+  auto external = Napi::External<std::shared_ptr<LuaJsRuntime>>::New(env, &runtime);
+
+  // the constructor copies the runtime pointer synchronously
+  return constructor->New({external});
+}
+
+bool LuaState::IsInstance(const Napi::Env& env, const Napi::Value& value) {
+  auto* constructor = env.GetInstanceData<Napi::FunctionReference>();
+  return value.IsObject() && value.As<Napi::Object>().InstanceOf(constructor->Value());
+}
+
+std::shared_ptr<LuaJsRuntime> LuaState::Detach() { return std::move(runtime_); }
 
 /**
  * Close
  */
 Napi::Value LuaState::Close(const Napi::CallbackInfo& info) {
-  runtime_->Close();
+  if (runtime_) {
+    runtime_->Close();
+  }
   return info.Env().Undefined();
 }
 
@@ -65,7 +118,9 @@ Napi::Value LuaState::EvalLuaFile(const Napi::CallbackInfo& info) {
   }
 
   auto file_path = info[0].ToString().Utf8Value();
-  return runtime_->EvalFile(env, file_path);
+  auto budget = ParseLuaBudget(env, info[1], "options");
+
+  return runtime_->EvalFile(env, file_path, budget);
 }
 
 /**
@@ -82,8 +137,145 @@ Napi::Value LuaState::EvalLuaString(const Napi::CallbackInfo& info) {
   }
 
   auto lua_code = info[0].As<Napi::String>().Utf8Value();
+  auto budget = ParseLuaBudget(env, info[1], "options");
+
+  return runtime_->EvalString(env, lua_code, budget);
+}
+
+/**
+ * CompileLuaString
+ */
+Napi::Value LuaState::CompileLuaString(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "String argument expected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  auto lua_code = info[0].As<Napi::String>().Utf8Value();
+
+  return runtime_->Compile(env, lua_code);
+}
+
+/**
+ * CompileLuaBundle
+ */
+Napi::Value LuaState::CompileLuaBundle(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 2 || !info[0].IsString() || !info[1].IsArray()) {
+    Napi::TypeError::New(env, "String and array arguments expected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  auto path = info[0].As<Napi::String>().Utf8Value();
+  auto chunks = info[1].As<Napi::Array>();
+
+  std::vector<std::pair<std::string, std::string>> files;
+  files.reserve(chunks.Length());
+
+  for (uint32_t i = 0; i < chunks.Length(); i++) {
+    auto chunk = chunks.Get(i);
+    auto name = chunk.IsObject() ? chunk.As<Napi::Object>().Get("name") : env.Undefined();
+    auto file_path = chunk.IsObject() ? chunk.As<Napi::Object>().Get("path") : env.Undefined();
+
+    if (!name.IsString() || !file_path.IsString()) {
+      Napi::TypeError::New(env, "Bundle chunk must be an object with \"name\" and \"path\" strings").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+
+    files.emplace_back(name.As<Napi::String>().Utf8Value(), file_path.As<Napi::String>().Utf8Value());
+  }
+
+  auto strip = false;
+  if (info.Length() > 2 && info[2].IsObject()) {
+    strip = info[2].As<Napi::Object>().Get("strip").ToBoolean();
+  }
+
+  return runtime_->CompileBundle(env, path, files, strip);
+}
+
+/**
+ * LoadLuaBundle
+ */
+Napi::Value LuaState::LoadLuaBundle(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "String argument expected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  auto path = info[0].As<Napi::String>().Utf8Value();
+
+  return runtime_->LoadBundle(env, path);
+}
+
+/**
+ * GetChunkCacheStats
+ */
+Napi::Value LuaState::GetChunkCacheStats(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+  auto stats = LuaChunkCache::Shared().GetStats();
+
+  auto result = Napi::Object::New(env);
+  result.Set("hits", static_cast<double>(stats.hits));
+  result.Set("misses", static_cast<double>(stats.misses));
+  result.Set("evictions", static_cast<double>(stats.evictions));
+  result.Set("entries", static_cast<double>(stats.entries));
+  result.Set("bytes", static_cast<double>(stats.bytes));
+  result.Set("maxBytes", static_cast<double>(stats.max_bytes));
+  result.Set("maxEntries", static_cast<double>(stats.max_entries));
+
+  return result;
+}
+
+/**
+ * ConfigureChunkCache
+ */
+Napi::Value LuaState::ConfigureChunkCache(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    Napi::TypeError::New(env, "Object argument expected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  auto options = info[0].As<Napi::Object>();
+  auto stats = LuaChunkCache::Shared().GetStats();
+
+  LuaChunkCache::Options cache_options{stats.max_bytes, stats.max_entries};
+
+  for (auto [name, target] : {std::pair{"maxBytes", &cache_options.max_bytes}, std::pair{"maxEntries", &cache_options.max_entries}}) {
+    auto value = options.Get(name);
+    if (value.IsUndefined()) {
+      continue;
+    }
+    if (!value.IsNumber() || value.As<Napi::Number>().DoubleValue() < 0) {
+      Napi::TypeError::New(env, std::string("Option \"") + name + "\" must be a non-negative number").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    *target = static_cast<size_t>(value.As<Napi::Number>().DoubleValue());
+  }
 
-  return runtime_->EvalString(env, lua_code);
+  LuaChunkCache::Shared().Configure(cache_options);
+
+  return env.Undefined();
+}
+
+/**
+ * ClearChunkCache
+ */
+Napi::Value LuaState::ClearChunkCache(const Napi::CallbackInfo& info) {
+  LuaChunkCache::Shared().Clear();
+  return info.Env().Undefined();
 }
 
 /**
@@ -99,10 +291,18 @@ Napi::Value LuaState::GetLuaGlobalValue(const Napi::CallbackInfo& info) {
     return env.Undefined();
   }
 
+  std::optional<bool> lazy;
+  if (info[1].IsObject()) {
+    auto lazy_option = info[1].As<Napi::Object>().Get("lazy");
+    if (!lazy_option.IsUndefined()) {
+      lazy = lazy_option.ToBoolean();
+    }
+  }
+
   if (string_buf_.TryFastStringKey(env, info[0])) {
-    return runtime_->GetGlobal(env, string_buf_.GetFastString());
+    return runtime_->GetGlobal(env, string_buf_.GetFastString(), lazy);
   } else {
-    return runtime_->GetGlobal(env, string_buf_.GetSlowString(env, info[0]));
+    return runtime_->GetGlobal(env, string_buf_.GetSlowString(env, info[0]), lazy);
   }
 }
 
@@ -138,6 +338,62 @@ Napi::Value LuaState::GetLuaVersion(const Napi::CallbackInfo& info) {
   return Napi::String::New(env, version);
 }
 
+/**
+ * GetMemoryStats
+ */
+Napi::Value LuaState::GetMemoryStats(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  return runtime_->GetMemoryStats(env);
+}
+
+/**
+ * ControlLuaGc
+ */
+Napi::Value LuaState::ControlLuaGc(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "String argument expected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  auto action = info[0].As<Napi::String>().Utf8Value();
+
+  return runtime_->Gc(env, action, info[1]);
+}
+
+/**
+ * PrepareLuaPath
+ */
+Napi::Value LuaState::PrepareLuaPath(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "String argument expected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  return LuaPath::New(env, runtime_, info[0].As<Napi::String>().Utf8Value());
+}
+
+/**
+ * PrepareLuaCall
+ */
+Napi::Value LuaState::PrepareLuaCall(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  return LuaCall::New(env, runtime_, info[0], info[1]);
+}
+
 /**
  * SetLuaGlobalValue
  */
@@ -151,24 +407,291 @@ Napi::Value LuaState::SetLuaGlobalValue(const Napi::CallbackInfo& info) {
     return info.This();
   }
 
+  bool by_ref = false;
+  std::shared_ptr<const LuaSignature> signature;
+  if (info[2].IsObject()) {
+    by_ref = info[2].As<Napi::Object>().Get("byRef").ToBoolean();
+    signature = LuaSignature::Parse(env, info[2]);
+
+    if (signature && !info[1].IsFunction()) {
+      Napi::TypeError::New(env, "Options \"args\" and \"returns\" require a function").ThrowAsJavaScriptException();
+      return info.This();
+    }
+  }
+
   if (string_buf_.TryFastStringKey(env, info[0])) {
-    runtime_->SetGlobal(string_buf_.GetFastString(), info[1]);
+    runtime_->SetGlobal(string_buf_.GetFastString(), info[1], by_ref, std::move(signature));
   } else {
-    runtime_->SetGlobal(string_buf_.GetSlowString(env, info[0]), info[1]);
+    runtime_->SetGlobal(string_buf_.GetSlowString(env, info[0]), info[1], by_ref, std::move(signature));
   }
 
   return info.This();
 }
 
+/**
+ * GetLuaGlobalPacked
+ */
+Napi::Value LuaState::GetLuaGlobalPacked(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "String argument expected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (string_buf_.TryFastStringKey(env, info[0])) {
+    return runtime_->GetGlobalPacked(env, string_buf_.GetFastString());
+  } else {
+    return runtime_->GetGlobalPacked(env, string_buf_.GetSlowString(env, info[0]));
+  }
+}
+
+/**
+ * SetLuaGlobalPacked
+ */
+Napi::Value LuaState::SetLuaGlobalPacked(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 2 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "First argument expected string").ThrowAsJavaScriptException();
+    return info.This();
+  }
+
+  std::string_view data;
+
+  if (info[1].IsTypedArray()) {
+    auto array = info[1].As<Napi::TypedArray>();
+    data = {static_cast<const char*>(array.ArrayBuffer().Data()) + array.ByteOffset(), array.ByteLength()};
+  } else if (info[1].IsArrayBuffer()) {
+    auto array_buffer = info[1].As<Napi::ArrayBuffer>();
+    data = {static_cast<const char*>(array_buffer.Data()), array_buffer.ByteLength()};
+  } else {
+    Napi::TypeError::New(env, "Second argument expected Buffer, Uint8Array or ArrayBuffer").ThrowAsJavaScriptException();
+    return info.This();
+  }
+
+  if (string_buf_.TryFastStringKey(env, info[0])) {
+    runtime_->SetGlobalPacked(env, string_buf_.GetFastString(), data);
+  } else {
+    runtime_->SetGlobalPacked(env, string_buf_.GetSlowString(env, info[0]), data);
+  }
+
+  return info.This();
+}
+
+/**
+ * GetLuaGlobalJson
+ */
+Napi::Value LuaState::GetLuaGlobalJson(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "String argument expected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (string_buf_.TryFastStringKey(env, info[0])) {
+    return runtime_->GetGlobalJson(env, string_buf_.GetFastString());
+  } else {
+    return runtime_->GetGlobalJson(env, string_buf_.GetSlowString(env, info[0]));
+  }
+}
+
+/**
+ * SetLuaGlobalJson
+ */
+Napi::Value LuaState::SetLuaGlobalJson(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 2 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "First argument expected string").ThrowAsJavaScriptException();
+    return info.This();
+  }
+
+  std::string text;
+  std::string_view json;
+
+  if (info[1].IsString()) {
+    text = info[1].As<Napi::String>().Utf8Value();
+    json = text;
+  } else if (info[1].IsTypedArray()) {
+    // UTF-8 bytes, e.g. a request body
+    auto array = info[1].As<Napi::TypedArray>();
+    json = {static_cast<const char*>(array.ArrayBuffer().Data()) + array.ByteOffset(), array.ByteLength()};
+  } else {
+    Napi::TypeError::New(env, "Second argument expected string or Uint8Array").ThrowAsJavaScriptException();
+    return info.This();
+  }
+
+  if (string_buf_.TryFastStringKey(env, info[0])) {
+    runtime_->SetGlobalJson(env, string_buf_.GetFastString(), json);
+  } else {
+    runtime_->SetGlobalJson(env, string_buf_.GetSlowString(env, info[0]), json);
+  }
+
+  return info.This();
+}
+
+/**
+ * DefineRecordShape
+ */
+Napi::Value LuaState::DefineRecordShape(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 2 || !info[0].IsString() || !info[1].IsArray()) {
+    Napi::TypeError::New(env, "Expected shape name and array of keys").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  auto keys_array = info[1].As<Napi::Array>();
+  std::vector<std::string> keys;
+  keys.reserve(keys_array.Length());
+
+  for (uint32_t i = 0; i < keys_array.Length(); i++) {
+    auto key = keys_array.Get(i);
+
+    if (!key.IsString()) {
+      Napi::TypeError::New(env, "Shape keys must be strings").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+
+    keys.push_back(key.As<Napi::String>().Utf8Value());
+  }
+
+  runtime_->DefineShape(env, info[0].As<Napi::String>().Utf8Value(), keys);
+
+  return info.This();
+}
+
+/**
+ * MarkJsObjectRef
+ */
+Napi::Value LuaState::MarkJsObjectRef(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  RETURN_IF_CLOSED(env)
+
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    Napi::TypeError::New(env, "Object argument expected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  runtime_->MarkJsObjectRef(env, info[0].As<Napi::Object>());
+
+  return info[0];
+}
+
 /**
  * Parse Lua Config
  */
-LuaConfig LuaState::ParseLuaConfig(const Napi::CallbackInfo& info) {
+LuaConfig LuaState::ParseLuaConfig(const Napi::Env& env, const Napi::Value& options_value) {
   auto open_all_libs = true;
+  auto chunk_cache = true;
+  auto sequence_arrays = false;
+  auto binary_strings = false;
+  auto lazy_tables = false;
+  auto error_detail = LuaErrorDetail::Full;
+  auto hook_interval = 1000;
+  auto idle_gc_step_size = 0;
+  LuaBudget budget;
   std::vector<std::string> libs_for_open;
+  LuaAllocatorOptions allocator_options;
+
+  if (options_value.IsObject()) {
+    auto options = options_value.As<Napi::Object>();
+
+    auto allocator_option = options.Get("allocator");
+    if (!allocator_option.IsUndefined()) {
+      auto allocator_type = allocator_option.IsString() ? allocator_option.As<Napi::String>().Utf8Value() : "";
+
+      if (allocator_type == "system") {
+        allocator_options.type = LuaAllocatorType::System;
+      } else if (allocator_type == "pool") {
+        allocator_options.type = LuaAllocatorType::Pool;
+      } else {
+        throw Napi::TypeError::New(env, "Option \"allocator\" must be \"system\" or \"pool\"");
+      }
+    }
+
+    auto chunk_cache_option = options.Get("chunkCache");
+    if (!chunk_cache_option.IsUndefined()) {
+      chunk_cache = chunk_cache_option.ToBoolean();
+    }
 
-  if (info.Length() == 1 && info[0].IsObject()) {
-    auto options = info[0].As<Napi::Object>();
+    auto sequence_arrays_option = options.Get("sequenceArrays");
+    if (!sequence_arrays_option.IsUndefined()) {
+      sequence_arrays = sequence_arrays_option.ToBoolean();
+    }
+
+    auto binary_strings_option = options.Get("binaryStrings");
+    if (!binary_strings_option.IsUndefined()) {
+      binary_strings = binary_strings_option.ToBoolean();
+    }
+
+    auto lazy_tables_option = options.Get("lazyTables");
+    if (!lazy_tables_option.IsUndefined()) {
+      lazy_tables = lazy_tables_option.ToBoolean();
+    }
+
+    auto error_detail_option = options.Get("errorDetail");
+    if (!error_detail_option.IsUndefined()) {
+      auto error_detail_name = error_detail_option.IsString() ? error_detail_option.As<Napi::String>().Utf8Value() : "";
+
+      if (error_detail_name == "none") {
+        error_detail = LuaErrorDetail::None;
+      } else if (error_detail_name == "message") {
+        error_detail = LuaErrorDetail::Message;
+      } else if (error_detail_name == "full") {
+        error_detail = LuaErrorDetail::Full;
+      } else {
+        throw Napi::TypeError::New(env, "Option \"errorDetail\" must be \"none\", \"message\" or \"full\"");
+      }
+    }
+
+    budget = ParseLuaBudget(env, options.Get("budget"), "budget");
+
+    auto hook_interval_option = options.Get("hookInterval");
+    if (!hook_interval_option.IsUndefined()) {
+      if (!hook_interval_option.IsNumber() || hook_interval_option.As<Napi::Number>().DoubleValue() < 1 ||
+          hook_interval_option.As<Napi::Number>().DoubleValue() > INT_MAX) {
+        throw Napi::TypeError::New(env, "Option \"hookInterval\" must be a positive number");
+      }
+      hook_interval = hook_interval_option.As<Napi::Number>().Int32Value();
+    }
+
+    auto idle_gc_option = options.Get("idleGc");
+    if (idle_gc_option.IsBoolean()) {
+      idle_gc_step_size = idle_gc_option.As<Napi::Boolean>().Value() ? 64 : 0;
+    } else if (idle_gc_option.IsObject()) {
+      auto step_size_option = idle_gc_option.As<Napi::Object>().Get("stepSize");
+      idle_gc_step_size = 64;
+      if (!step_size_option.IsUndefined()) {
+        if (!step_size_option.IsNumber() || step_size_option.As<Napi::Number>().DoubleValue() < 1) {
+          throw Napi::TypeError::New(env, "Option \"stepSize\" must be a positive number");
+        }
+        idle_gc_step_size = step_size_option.As<Napi::Number>().Int32Value();
+      }
+    } else if (!idle_gc_option.IsUndefined()) {
+      throw Napi::TypeError::New(env, "Option \"idleGc\" must be a boolean or an object");
+    }
+
+    auto memory_limit_option = options.Get("memoryLimit");
+    if (!memory_limit_option.IsUndefined() && !memory_limit_option.IsNull()) {
+      if (!memory_limit_option.IsNumber() || memory_limit_option.As<Napi::Number>().DoubleValue() < 0) {
+        throw Napi::TypeError::New(env, "Option \"memoryLimit\" must be a non-negative number");
+      }
+      allocator_options.memory_limit = static_cast<size_t>(memory_limit_option.As<Napi::Number>().DoubleValue());
+    }
 
     if (options.Has("libs")) {
       auto libs_option = options.Get("libs");
@@ -188,6 +711,15 @@ LuaConfig LuaState::ParseLuaConfig(const Napi::CallbackInfo& info) {
   }
 
   LuaConfig lua_config;
+  lua_config.allocator = allocator_options;
+  lua_config.chunk_cache = chunk_cache;
+  lua_config.sequence_arrays = sequence_arrays;
+  lua_config.binary_strings = binary_strings;
+  lua_config.lazy_tables = lazy_tables;
+  lua_config.error_detail = error_detail;
+  lua_config.budget = std::move(budget);
+  lua_config.hook_interval = hook_interval;
+  lua_config.idle_gc_step_size = idle_gc_step_size;
 
   if (open_all_libs) {
     lua_config.libs = std::nullopt;
@@ -197,3 +729,43 @@ LuaConfig LuaState::ParseLuaConfig(const Napi::CallbackInfo& info) {
 
   return lua_config;
 }
+
+LuaBudget LuaState::ParseLuaBudget(const Napi::Env& env, const Napi::Value& budget_value, std::string_view option_name) {
+  LuaBudget budget;
+
+  if (budget_value.IsUndefined() || budget_value.IsNull()) {
+    return budget;
+  }
+
+  if (!budget_value.IsObject()) {
+    throw Napi::TypeError::New(env, "Option \"" + std::string(option_name) + "\" must be an object");
+  }
+
+  auto budget_object = budget_value.As<Napi::Object>();
+
+  auto instructions_option = budget_object.Get("instructions");
+  if (!instructions_option.IsUndefined()) {
+    if (!instructions_option.IsNumber() || instructions_option.As<Napi::Number>().DoubleValue() < 1) {
+      throw Napi::TypeError::New(env, "Option \"instructions\" must be a positive number");
+    }
+    budget.instructions = static_cast<uint64_t>(instructions_option.As<Napi::Number>().DoubleValue());
+  }
+
+  auto timeout_option = budget_object.Get("timeout");
+  if (!timeout_option.IsUndefined()) {
+    if (!timeout_option.IsNumber() || timeout_option.As<Napi::Number>().DoubleValue() < 0) {
+      throw Napi::TypeError::New(env, "Option \"timeout\" must be a non-negative number");
+    }
+    budget.timeout = timeout_option.As<Napi::Number>().DoubleValue();
+  }
+
+  auto signal_option = budget_object.Get("signal");
+  if (!signal_option.IsUndefined()) {
+    if (!signal_option.IsObject()) {
+      throw Napi::TypeError::New(env, "Option \"signal\" must be an AbortSignal");
+    }
+    budget.signal = std::make_shared<Napi::ObjectReference>(Napi::Persistent(signal_option.As<Napi::Object>()));
+  }
+
+  return budget;
+}
@@ -10,23 +10,53 @@ public:
   LuaState(const Napi::CallbackInfo&);
 
   static void NapiInit(Napi::Env, Napi::Object);
+  static LuaConfig ParseLuaConfig(const Napi::Env&, const Napi::Value& options);
+
+  // wraps a runtime lent by LuaStatePool
+  static Napi::Object NewInstance(const Napi::Env&, std::shared_ptr<LuaJsRuntime> runtime);
+  static bool IsInstance(const Napi::Env&, const Napi::Value&);
+
+  const std::shared_ptr<LuaJsRuntime>& GetRuntime() const { return runtime_; }
+  // releases the runtime, the instance behaves as closed afterwards
+  std::shared_ptr<LuaJsRuntime> Detach();
 
 private:
   std::shared_ptr<LuaJsRuntime> runtime_;
   NapiStringBuffer<256> string_buf_;
 
+  static LuaBudget ParseLuaBudget(const Napi::Env&, const Napi::Value& budget, std::string_view option_name);
+
   Napi::Value Close(const Napi::CallbackInfo&);
 
   // --- Eval methods
   Napi::Value EvalLuaFile(const Napi::CallbackInfo&);
   Napi::Value EvalLuaString(const Napi::CallbackInfo&);
+  Napi::Value CompileLuaString(const Napi::CallbackInfo&);
+
+  // --- Bundle methods
+  Napi::Value CompileLuaBundle(const Napi::CallbackInfo&);
+  Napi::Value LoadLuaBundle(const Napi::CallbackInfo&);
+
+  // --- Chunk cache methods
+  static Napi::Value GetChunkCacheStats(const Napi::CallbackInfo&);
+  static Napi::Value ConfigureChunkCache(const Napi::CallbackInfo&);
+  static Napi::Value ClearChunkCache(const Napi::CallbackInfo&);
 
   // --- Global methods
   Napi::Value GetLuaGlobalValue(const Napi::CallbackInfo&);
   Napi::Value GetLuaValueLength(const Napi::CallbackInfo&);
   Napi::Value GetLuaVersion(const Napi::CallbackInfo&);
   Napi::Value SetLuaGlobalValue(const Napi::CallbackInfo&);
-
-  // --- Config
-  static LuaConfig ParseLuaConfig(const Napi::CallbackInfo&);
+  Napi::Value GetLuaGlobalPacked(const Napi::CallbackInfo&);
+  Napi::Value SetLuaGlobalPacked(const Napi::CallbackInfo&);
+  Napi::Value GetLuaGlobalJson(const Napi::CallbackInfo&);
+  Napi::Value SetLuaGlobalJson(const Napi::CallbackInfo&);
+  Napi::Value PrepareLuaPath(const Napi::CallbackInfo&);
+  Napi::Value PrepareLuaCall(const Napi::CallbackInfo&);
+  Napi::Value MarkJsObjectRef(const Napi::CallbackInfo&);
+  Napi::Value DefineRecordShape(const Napi::CallbackInfo&);
+
+  // --- Memory methods
+  Napi::Value GetMemoryStats(const Napi::CallbackInfo&);
+  Napi::Value ControlLuaGc(const Napi::CallbackInfo&);
 };
@@ -1,9 +1,41 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <napi.h>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include "core/lua-allocator.h"
+
+// How much of a Lua error is converted into the thrown LuaError
+enum class LuaErrorDetail { None, Message, Full };
+
+// Limits of a single entry into Lua, unset fields are unlimited
+struct LuaBudget {
+  std::optional<uint64_t> instructions;
+  // milliseconds
+  std::optional<double> timeout;
+  // AbortSignal, shared by the states of a pool
+  std::shared_ptr<Napi::ObjectReference> signal;
+};
+
 struct LuaConfig {
   std::optional<std::vector<std::string>> libs;
+  LuaAllocatorOptions allocator;
+  bool chunk_cache = true;
+  // convert 1..n sequences to JS arrays
+  bool sequence_arrays = false;
+  // return Lua strings which are not valid UTF-8 as Buffers
+  bool binary_strings = false;
+  // pass tables to getGlobal and JS callbacks as lazy proxies
+  bool lazy_tables = false;
+  LuaErrorDetail error_detail = LuaErrorDetail::Full;
+  // default budget of every call into Lua
+  LuaBudget budget;
+  // instructions between budget checks
+  int hook_interval = 1000;
+  // KB collected per event loop iteration by LuaGcScheduler, 0 keeps the automatic collector
+  int idle_gc_step_size = 0;
 };
\ No newline at end of file
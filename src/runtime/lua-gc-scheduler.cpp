@@ -0,0 +1,53 @@
+#include "runtime/lua-gc-scheduler.h"
+
+LuaGcScheduler::LuaGcScheduler(const Napi::Env& env, LuaStateCore& core, int step_size, std::function<void()> on_step)
+  : env_(env), core_(core), step_size_(step_size), on_step_(std::move(on_step)), async_context_(env, "LuaGcScheduler"), handle_(new uv_check_t) {
+  uv_loop_t* loop = nullptr;
+  napi_get_uv_event_loop(env, &loop);
+
+  uv_check_init(loop, handle_);
+  handle_->data = this;
+  uv_check_start(handle_, OnCheck);
+  // the handle must not keep the process alive
+  uv_unref(reinterpret_cast<uv_handle_t*>(handle_));
+}
+
+LuaGcScheduler::~LuaGcScheduler() {
+  handle_->data = nullptr;
+  uv_check_stop(handle_);
+  uv_close(reinterpret_cast<uv_handle_t*>(handle_), [](uv_handle_t* handle) { delete reinterpret_cast<uv_check_t*>(handle); });
+}
+
+void LuaGcScheduler::OnCheck(uv_check_t* handle) {
+  if (auto* scheduler = static_cast<LuaGcScheduler*>(handle->data)) {
+    scheduler->Step();
+  }
+}
+
+void LuaGcScheduler::Step() {
+  if (stopped_ || core_.IsClosed()) {
+    return;
+  }
+
+  if (threshold_ && core_.GcCount() < threshold_) {
+    return;
+  }
+
+  // __gc metamethods may call JavaScript functions, which need a callback scope outside of a JS call
+  Napi::CallbackScope callback_scope(env_, async_context_);
+  Napi::HandleScope scope(env_);
+
+  // errors of __gc metamethods are dropped by the protected step
+  bool finished = core_.GcStep(step_size_);
+
+  threshold_ = finished ? core_.GcCount() * 2 : 0;
+
+  if (on_step_) {
+    on_step_();
+  }
+
+  // an exception left pending goes to process 'uncaughtException', like one of any other native callback
+  if (env_.IsExceptionPending()) {
+    napi_fatal_exception(env_, env_.GetAndClearPendingException().Value());
+  }
+}
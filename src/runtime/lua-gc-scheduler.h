@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <napi.h>
+#include <uv.h>
+
+#include "core/lua-state-core.h"
+
+/**
+ * Idle-time garbage collection.
+ *
+ * Bounded LUA_GCSTEP slices run from a libuv check handle, i.e. between event
+ * loop iterations rather than inside the calls which happen to allocate.
+ * After a finished cycle the scheduler waits until the heap doubles before it
+ * starts the next one. The automatic collector keeps its settings and stays on
+ * as a backstop, so a long synchronous call which never yields to the event
+ * loop still collects.
+ */
+class LuaGcScheduler {
+public:
+  LuaGcScheduler(const Napi::Env& env, LuaStateCore& core, int step_size, std::function<void()> on_step);
+  ~LuaGcScheduler();
+
+  LuaGcScheduler(const LuaGcScheduler&) = delete;
+  LuaGcScheduler& operator=(const LuaGcScheduler&) = delete;
+
+  // gc("stop") and gc("restart") stop and resume the idle steps along with the collector
+  void SetStopped(bool stopped) { stopped_ = stopped; }
+
+private:
+  Napi::Env env_;
+  LuaStateCore& core_;
+  int step_size_;
+  std::function<void()> on_step_;
+  // __gc metamethods may call JavaScript functions, the steps run in a callback scope of this context
+  Napi::AsyncContext async_context_;
+  // heap size which starts the next cycle, 0 while a cycle is in progress
+  size_t threshold_ = 0;
+  bool stopped_ = false;
+  // owned by libuv until the close callback
+  uv_check_t* handle_;
+
+  static void OnCheck(uv_check_t*);
+  void Step();
+};
@@ -1,8 +1,19 @@
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <unordered_set>
 
+#include "conversion/js-buffer-view.h"
+#include "conversion/js-object-ref.h"
 #include "conversion/js-to-lua-converter.h"
 #include "conversion/lua-to-js-converter.h"
+#include "core/lua-bundle.h"
+#include "core/lua-chunk-cache.h"
+#include "core/lua-json.h"
 #include "napi/lua-error.h"
 #include "runtime/lua-config.h"
 #include "runtime/lua-js-runtime.h"
@@ -13,35 +24,226 @@ extern "C" {
 }
 
 namespace {
-  int CallJsFunctionFromLuaCb(lua_State* L);
+  int CallJsFunctionLuaCb(lua_State* L);
   int GcJsFunctionFromLuaCb(lua_State* L);
+  int IndexJsObjectRefLuaCb(lua_State* L);
+  int NewIndexJsObjectRefLuaCb(lua_State* L);
+  int LenJsObjectRefLuaCb(lua_State* L);
+  int PairsJsObjectRefLuaCb(lua_State* L);
+  int NextJsObjectRefLuaCb(lua_State* L);
+  int CallJsObjectRefLuaCb(lua_State* L);
+  int CallJsMethodFromLuaCb(lua_State* L);
+  int GcJsObjectRefLuaCb(lua_State* L);
+  int GcJsObjectRefIteratorLuaCb(lua_State* L);
+  Napi::Error CreateBundleError(const Napi::Env& env, const LuaBundle::Error& error);
+  Napi::Error CreatePackError(const Napi::Env& env, const LuaPack::Error& error);
+  Napi::Error CreateJsonError(const Napi::Env& env, const LuaJson::Error& error);
+  Napi::Error CreateMemoryError(const Napi::Env& env);
+  std::optional<double> ParseNumericKey(std::string_view key);
+  std::string GetNumericKeyName(const Napi::Env& env, double key);
+
+  // calls into JS from Lua on this thread, a batch re-reads its columns after a call which ran JS
+  thread_local uint64_t JsCallsCount = 0;
 } // namespace
 
-LuaJsRuntime::LuaJsRuntime(const LuaConfig& config) : lua_to_js_(*this), js_to_lua_(this->core_) {
-  core_.OpenLibs(config.libs);
+LuaJsRuntime::LuaJsRuntime(const LuaConfig& config) : config_(config), core_(config.allocator), shapes_(core_), lua_to_js_(*this, shapes_, config.sequence_arrays, config.binary_strings), js_to_lua_(*this, core_, shapes_) {
+  if (core_.IsClosed()) {
+    return;
+  }
+
+  try {
+    core_.OpenLibs(config.libs);
+  } catch (const LuaStateCore::MemoryException&) {
+    // the libraries do not fit in the memory limit, reported as a state that could not be allocated
+    core_.Close();
+    return;
+  } catch (const LuaStateCore::LuaException&) {
+    core_.Close();
+    return;
+  }
 
+  // JS functions are C closures, the metatable of their holder upvalue releases the reference
   core_.NewMetaTable(LuaJsRuntime::MetaTableName);
-  core_.PushLightUserData(this);
-  core_.PushCClosure(CallJsFunctionFromLuaCb, 1);
-  core_.SetField(-2, "__call");
   core_.PushCClosure(GcJsFunctionFromLuaCb, 0);
   core_.SetField(-2, "__gc");
   core_.Pop(1);
+
+  const std::pair<const char*, lua_CFunction> js_object_ref_meta_methods[] = {
+    {"__index", IndexJsObjectRefLuaCb},
+    {"__newindex", NewIndexJsObjectRefLuaCb},
+    {"__len", LenJsObjectRefLuaCb},
+    {"__pairs", PairsJsObjectRefLuaCb},
+    {"__call", CallJsObjectRefLuaCb},
+  };
+
+  core_.NewMetaTable(JsObjectRef::MetaTableName);
+  for (const auto& [name, fn] : js_object_ref_meta_methods) {
+    core_.PushLightUserData(this);
+    core_.PushCClosure(fn, 1);
+    core_.SetField(-2, name);
+  }
+  core_.PushCClosure(GcJsObjectRefLuaCb, 0);
+  core_.SetField(-2, "__gc");
+  core_.Pop(1);
+
+  core_.NewMetaTable(JsObjectRef::IteratorMetaTableName);
+  core_.PushCClosure(GcJsObjectRefIteratorLuaCb, 0);
+  core_.SetField(-2, "__gc");
+  core_.Pop(1);
+
+  JsBufferView::RegisterMetaTable(core_);
 }
 
 LuaJsRuntime::~LuaJsRuntime() {
   lua_fn_proxies_.clear();
+  lazy_tables_.clear();
+  js_object_ref_marks_.Clear();
+  gc_scheduler_.reset();
   core_.Close();
+  ReleaseExternalMemory();
 }
 
-void LuaJsRuntime::Close() { core_.Close(); }
+void LuaJsRuntime::Close() {
+  gc_scheduler_.reset();
+  js_object_ref_marks_.Clear();
+  lua_to_js_.ClearStringCache();
+  shapes_.Clear();
+  core_.Close();
+  ReleaseExternalMemory();
+}
+
+void LuaJsRuntime::StartGcScheduler(const Napi::Env& env) {
+  if (config_.idle_gc_step_size > 0 && !gc_scheduler_ && !core_.IsClosed()) {
+    gc_scheduler_ = std::make_unique<LuaGcScheduler>(env, core_, config_.idle_gc_step_size, [this, env]() { ReportExternalMemory(env); });
+  }
+}
+
+Napi::Value LuaJsRuntime::Gc(const Napi::Env& env, std::string_view action, const Napi::Value& options_value) {
+  auto options = options_value.IsObject() ? options_value.As<Napi::Object>() : Napi::Object::New(env);
+
+  auto get_int_option = [&](const char* name) -> std::optional<int> {
+    auto value = options.Get(name);
+    if (value.IsUndefined()) {
+      return std::nullopt;
+    }
+    if (!value.IsNumber() || value.As<Napi::Number>().DoubleValue() < 0) {
+      throw Napi::TypeError::New(env, std::string("Option \"") + name + "\" must be a non-negative number");
+    }
+    return value.As<Napi::Number>().Int32Value();
+  };
+
+  if (action == "collect") {
+    core_.GcCollect();
+  } else if (action == "stop") {
+    core_.GcStop();
+    if (gc_scheduler_) {
+      gc_scheduler_->SetStopped(true);
+    }
+  } else if (action == "restart") {
+    core_.GcRestart();
+    if (gc_scheduler_) {
+      gc_scheduler_->SetStopped(false);
+    }
+  } else if (action == "step") {
+    auto finished = core_.GcStep(get_int_option("size").value_or(0));
+    ReportExternalMemory(env);
+    return Napi::Boolean::New(env, finished);
+  } else if (action == "count") {
+    return Napi::Number::New(env, static_cast<double>(core_.GcCount()));
+  } else if (action == "isRunning") {
+    return Napi::Boolean::New(env, core_.GcIsRunning());
+  } else if (action == "incremental") {
+    core_.GcSetIncremental({get_int_option("pause"), get_int_option("stepMul"), get_int_option("stepSize")});
+  } else if (action == "generational") {
+    if (!core_.GcSetGenerational({get_int_option("minorMul"), get_int_option("majorMul")})) {
+      auto err = Napi::Error::New(env, "Generational garbage collection is not supported by " + core_.GetLuaVersion());
+      err.Set("code", "ERR_LUA_GC_UNSUPPORTED");
+      throw err;
+    }
+  } else {
+    throw Napi::TypeError::New(env, "Unknown gc action \"" + std::string(action) + "\"");
+  }
+
+  ReportExternalMemory(env);
+
+  return env.Undefined();
+}
 
 bool LuaJsRuntime::IsClosed() { return core_.IsClosed(); }
 
+bool LuaJsRuntime::SaveBaseline() {
+  try {
+    core_.SaveBaseline();
+  } catch (const LuaStateCore::MemoryException&) {
+    return false;
+  } catch (const LuaStateCore::LuaException&) {
+    return false;
+  }
+
+  return true;
+}
+
+bool LuaJsRuntime::ResetToBaseline() {
+  try {
+    core_.RestoreBaseline();
+  } catch (const LuaStateCore::MemoryException&) {
+    return false;
+  } catch (const LuaStateCore::LuaException&) {
+    return false;
+  }
+
+  lua_fn_proxies_.clear();
+  lazy_tables_.clear();
+  js_object_ref_marks_.Clear();
+  generation_++;
+
+  return true;
+}
+
 std::string LuaJsRuntime::GetLuaVersion() { return core_.GetLuaVersion(); }
 
-Napi::Value LuaJsRuntime::EvalFile(const Napi::Env& env, std::string_view path) {
+Napi::Value LuaJsRuntime::GetMemoryStats(const Napi::Env& env) {
+  auto* allocator = core_.GetAllocator();
+
+  // the Lua build does not accept custom allocators (64-bit LuaJIT without GC64)
+  if (!allocator) {
+    return env.Null();
+  }
+
+  const auto& stats = allocator->GetStats();
+
+  auto to_js_size_class = [&](size_t size, const LuaAllocator::SizeClassStats& size_class_stats) {
+    auto size_class = Napi::Object::New(env);
+    size_class.Set("size", static_cast<double>(size));
+    size_class.Set("allocations", static_cast<double>(size_class_stats.allocations));
+    size_class.Set("live", static_cast<double>(size_class_stats.live));
+    return size_class;
+  };
+
+  auto size_classes = Napi::Array::New(env, stats.size_classes.size());
+  for (size_t i = 0; i < stats.size_classes.size(); i++) {
+    size_classes.Set(i, to_js_size_class((i + 1) * LuaAllocator::SizeClassStep, stats.size_classes[i]));
+  }
+
+  auto large = Napi::Object::New(env);
+  large.Set("allocations", static_cast<double>(stats.large.allocations));
+  large.Set("live", static_cast<double>(stats.large.live));
+
+  auto result = Napi::Object::New(env);
+  result.Set("allocator", allocator->GetType() == LuaAllocatorType::Pool ? "pool" : "system");
+  result.Set("used", static_cast<double>(stats.used));
+  result.Set("peak", static_cast<double>(stats.peak));
+  result.Set("limit", stats.limit ? Napi::Value(Napi::Number::New(env, static_cast<double>(stats.limit))) : env.Null());
+  result.Set("allocations", static_cast<double>(stats.allocations));
+  result.Set("sizeClasses", size_classes);
+  result.Set("large", large);
+
+  return result;
+}
+
+Napi::Value LuaJsRuntime::EvalFile(const Napi::Env& env, std::string_view path, const LuaBudget& budget) {
   LuaStateCore::StackGuard guard(core_);
+  LuaStateCore::BudgetGuard budget_guard(core_, MakeBudget(env, budget));
 
   try {
     core_.LoadFile(path);
@@ -55,11 +257,12 @@ Napi::Value LuaJsRuntime::EvalFile(const Napi::Env& env, std::string_view path)
   }
 }
 
-Napi::Value LuaJsRuntime::EvalString(const Napi::Env& env, std::string_view source) {
+Napi::Value LuaJsRuntime::EvalString(const Napi::Env& env, std::string_view source, const LuaBudget& budget) {
   LuaStateCore::StackGuard guard(core_);
+  LuaStateCore::BudgetGuard budget_guard(core_, MakeBudget(env, budget));
 
   try {
-    core_.LoadString(source);
+    LoadString(source);
     return CallLuaFunction(env, 0);
   } catch (const LuaStateCore::LuaException&) {
     auto error = ExtractError(env);
@@ -70,16 +273,14 @@ Napi::Value LuaJsRuntime::EvalString(const Napi::Env& env, std::string_view sour
   }
 }
 
-Napi::Value LuaJsRuntime::GetGlobal(const Napi::Env& env, std::string_view path) {
+Napi::Value LuaJsRuntime::Compile(const Napi::Env& env, std::string_view source) {
   LuaStateCore::StackGuard guard(core_);
 
-  auto push_status = core_.PushValueByPath(path);
-
-  if (push_status == LuaStateCore::PushValueByPathStatus::NotFound) {
-    return env.Null();
-  }
-
-  if (push_status == LuaStateCore::PushValueByPathStatus::BrokenPath) {
+  try {
+    LoadString(source);
+  } catch (const LuaStateCore::LuaException&) {
+    auto error = ExtractError(env);
+    error.ThrowAsJavaScriptException();
     return env.Undefined();
   }
 
@@ -90,240 +291,1858 @@ Napi::Value LuaJsRuntime::GetGlobal(const Napi::Env& env, std::string_view path)
   return lua_to_js_.BuildResult();
 }
 
-Napi::Value LuaJsRuntime::GetLength(const Napi::Env& env, std::string_view path) {
+Napi::Value LuaJsRuntime::CompileBundle(
+  const Napi::Env& env, const std::string& path, const std::vector<std::pair<std::string, std::string>>& files, bool strip
+) {
   LuaStateCore::StackGuard guard(core_);
 
-  auto push_status = core_.PushValueByPath(path);
+  std::vector<LuaBundle::Source> sources;
+  sources.reserve(files.size());
 
-  if (push_status == LuaStateCore::PushValueByPathStatus::NotFound) {
-    return env.Null();
-  }
+  for (const auto& [name, file_path] : files) {
+    try {
+      core_.LoadFile(file_path);
+    } catch (const LuaStateCore::LuaException&) {
+      auto error = ExtractError(env);
+      error.ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
 
-  if (push_status == LuaStateCore::PushValueByPathStatus::BrokenPath) {
-    return env.Undefined();
+    sources.push_back(LuaBundle::Source{name, core_.Dump(-1, strip)});
+    core_.Pop(1);
   }
 
-  auto length = core_.GetLength(-1);
-
-  if (!length) {
-    return env.Undefined();
+  try {
+    LuaBundle::Write(path, sources);
+  } catch (const LuaBundle::Error& e) {
+    CreateBundleError(env, e).ThrowAsJavaScriptException();
   }
 
-  return Napi::Number::New(env, length.value());
+  return env.Undefined();
 }
 
-void LuaJsRuntime::SetGlobal(std::string_view name, const Napi::Value& value) {
-  LuaStateCore::StackGuard guard(core_);
-  auto scope = js_to_lua_.CreateScope();
-  js_to_lua_.PushValue(value);
-  core_.SetGlobal(name);
-}
+Napi::Value LuaJsRuntime::LoadBundle(const Napi::Env& env, const std::string& path) {
+  std::shared_ptr<const LuaBundle> bundle;
 
-Napi::Function LuaJsRuntime::CreateJsProxyFunction(const Napi::Env& env, const LuaFunction& lua_fn) {
-  {
-    // fast return cached function
-    auto it = lua_fn_proxies_.find(lua_fn.identity);
-    if (it != lua_fn_proxies_.end()) {
-      return it->second.Value();
-    }
+  try {
+    bundle = LuaBundle::Open(path);
+  } catch (const LuaBundle::Error& e) {
+    CreateBundleError(env, e).ThrowAsJavaScriptException();
+    return env.Undefined();
   }
 
-  // lock function identity through registry
-  auto lua_fn_ref = core_.CopyRef(lua_fn.index);
-  // weak ptr to this runtime
-  auto weak_runtime = weak_from_this();
-
-  // create javascript function
-  auto js_fn = Napi::Function::New(env, [weak_runtime, lua_fn_ref](const Napi::CallbackInfo& info) {
-    auto runtime = weak_runtime.lock();
-    if (!runtime || runtime->IsClosed()) {
-      return info.Env().Undefined();
-    }
+  if (!core_.RegisterBundle(bundle)) {
+    Napi::Error::New(env, "Bundles require the \"package\" library").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
 
-    return runtime->InvokeLuaFunction(info, lua_fn_ref);
-  });
+  const auto& chunks = bundle->GetChunks();
 
-  struct FinalizerCtx {
-    std::weak_ptr<LuaJsRuntime> weak_runtime;
-    const void* fn_identity;
-    LuaRegistryRef fn_ref;
-  };
+  auto names = Napi::Array::New(env, chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++) {
+    names.Set(i, chunks[i].name);
+  }
 
-  auto* finalizer_ctx = new FinalizerCtx{weak_runtime, lua_fn.identity, lua_fn_ref};
+  return names;
+}
 
-  // add javascritp funtion finalizer
-  js_fn.AddFinalizer(
-    [](Napi::Env, FinalizerCtx* finalizer_ctx) {
-      auto runtime = finalizer_ctx->weak_runtime.lock();
-      // if runtime destroyed then LuaStateCore also destroyed with Lua VM and all refs
-      if (runtime && !runtime->IsClosed()) {
-        runtime->FinalizeFunctionProxy(finalizer_ctx->fn_identity, finalizer_ctx->fn_ref);
-      }
-      delete finalizer_ctx;
-    },
-    finalizer_ctx
-  );
+template <typename Fn> auto LuaJsRuntime::RunProtected(const Napi::Env& env, Fn&& fn) {
+  try {
+    return fn();
+  } catch (const LuaStateCore::MemoryException&) {
+    throw CreateMemoryError(env);
+  } catch (const LuaStateCore::LuaException&) {
+    throw ExtractError(env);
+  }
+}
 
-  // insert crated function to cache
-  lua_fn_proxies_.emplace(lua_fn.identity, std::move(Napi::Weak(js_fn)));
+void LuaJsRuntime::CheckMemoryLimit(const Napi::Env& env) {
+  if (core_.CheckMemoryLimit()) {
+    return;
+  }
 
-  return js_fn;
+  // the value is dropped and collected right away, the state stays usable
+  core_.Pop(1);
+  core_.GcCollect();
+  throw CreateMemoryError(env);
 }
 
-/**
- * ================= Private =========================
- */
+Napi::Value LuaJsRuntime::GetGlobal(const Napi::Env& env, std::string_view path, std::optional<bool> lazy) {
+  LuaStateCore::StackGuard guard(core_);
+  return BuildGlobalResult(env, RunProtected(env, [&] { return core_.PushValueByPath(path); }), lazy.value_or(config_.lazy_tables));
+}
 
-Napi::Value LuaJsRuntime::InvokeLuaFunction(const Napi::CallbackInfo& info, const LuaRegistryRef& fn_ref) {
+Napi::Value LuaJsRuntime::GetGlobalPacked(const Napi::Env& env, std::string_view path) {
   LuaStateCore::StackGuard guard(core_);
-  core_.PushRef(fn_ref);
 
-  auto env = info.Env();
+  auto push_status = RunProtected(env, [&] { return core_.PushValueByPath(path); });
 
-  auto args_count = info.Length();
+  if (push_status == LuaStateCore::PushValueByPathStatus::NotFound) {
+    return env.Null();
+  }
 
-  if (args_count > 0) {
-    auto scope = js_to_lua_.CreateScope();
+  if (push_status == LuaStateCore::PushValueByPathStatus::BrokenPath) {
+    return env.Undefined();
+  }
 
-    for (size_t i = 0; i < args_count; ++i) {
-      js_to_lua_.PushValue(info[i]);
-    }
+  auto packed = std::make_unique<std::string>();
+
+  try {
+    core_.Pack(-1, config_.sequence_arrays, *packed);
+  } catch (const LuaPack::Error& e) {
+    throw CreatePackError(env, e);
+  } catch (const std::bad_alloc&) {
+    throw CreateMemoryError(env);
   }
 
+  // the buffer takes the packed bytes over, unless the runtime forbids external buffers
+  auto* data = packed.release();
+  return Napi::Buffer<char>::NewOrCopy(env, data->data(), data->size(), [data](Napi::Env, char*) { delete data; });
+}
+
+void LuaJsRuntime::SetGlobalPacked(const Napi::Env& env, std::string_view name, std::string_view data) {
+  LuaStateCore::StackGuard guard(core_);
+
   try {
-    return CallLuaFunction(env, args_count);
-  } catch (const LuaStateCore::LuaException&) {
-    auto error = ExtractError(env);
-    error.ThrowAsJavaScriptException();
-    return env.Undefined();
-  } catch (...) {
-    return env.Undefined();
+    RunProtected(env, [&] { core_.Unpack(data); });
+  } catch (const LuaPack::Error& e) {
+    throw CreatePackError(env, e);
   }
+
+  RunProtected(env, [&] { core_.SetGlobal(name); });
+  ReportExternalMemory(env);
 }
 
-Napi::Value LuaJsRuntime::CallLuaFunction(const Napi::Env& env, int args_count) {
-  auto results_count = core_.PCall(args_count);
+Napi::Value LuaJsRuntime::GetGlobalJson(const Napi::Env& env, std::string_view path) {
+  LuaStateCore::StackGuard guard(core_);
 
-  if (results_count == 0) {
+  auto push_status = RunProtected(env, [&] { return core_.PushValueByPath(path); });
+
+  if (push_status == LuaStateCore::PushValueByPathStatus::NotFound) {
+    return env.Null();
+  }
+
+  if (push_status == LuaStateCore::PushValueByPathStatus::BrokenPath) {
     return env.Undefined();
   }
 
-  auto scope = lua_to_js_.CreateScope(env);
+  std::string json;
 
-  int base_index = -results_count;
-  for (int i = 0; i < results_count; i++) {
-    core_.Traverse(base_index + i, lua_to_js_);
+  try {
+    if (!core_.ToJson(-1, config_.sequence_arrays, json)) {
+      return env.Undefined();
+    }
+  } catch (const LuaJson::Error& e) {
+    throw CreateJsonError(env, e);
   }
 
-  return lua_to_js_.BuildResult();
+  return Napi::String::New(env, json);
 }
 
-Napi::Error LuaJsRuntime::ExtractError(const Napi::Env& env) {
-  auto scope = lua_to_js_.CreateScope(env);
+void LuaJsRuntime::SetGlobalJson(const Napi::Env& env, std::string_view name, std::string_view json) {
+  LuaStateCore::StackGuard guard(core_);
 
-  core_.Traverse(-1, lua_to_js_);
-  core_.Pop(1);
+  try {
+    RunProtected(env, [&] { core_.FromJson(json); });
+  } catch (const LuaJson::Error& e) {
+    throw CreateJsonError(env, e);
+  }
+
+  RunProtected(env, [&] { core_.SetGlobal(name); });
+  ReportExternalMemory(env);
+}
 
-  auto value = lua_to_js_.BuildResult();
+Napi::Value LuaJsRuntime::GetLength(const Napi::Env& env, std::string_view path) {
+  LuaStateCore::StackGuard guard(core_);
+  return BuildLengthResult(env, RunProtected(env, [&] { return core_.PushValueByPath(path); }));
+}
 
-  if (value.IsObject()) {
-    return LuaError::New(env, value.As<Napi::Object>());
+void LuaJsRuntime::SetGlobal(std::string_view name, const Napi::Value& value, bool by_ref, std::shared_ptr<const LuaSignature> signature) {
+  auto env = value.Env();
+  LuaStateCore::StackGuard guard(core_);
+  auto scope = js_to_lua_.CreateScope();
+  if (signature && value.IsFunction()) {
+    PushJsFunction(value.As<Napi::Function>(), std::move(signature));
+  } else if (by_ref && value.IsObject()) {
+    JsObjectRef::Push(core_, value.As<Napi::Object>());
   } else {
-    auto error_obj = Napi::Object::New(env);
-    error_obj.Set("message", value.ToString());
-    return LuaError::New(env, error_obj);
+    js_to_lua_.PushValue(value);
   }
+  CheckMemoryLimit(env);
+  RunProtected(env, [&] { core_.SetGlobal(name); });
+  ReportExternalMemory(env);
 }
 
-void LuaJsRuntime::FinalizeFunctionProxy(const void* identity, const LuaRegistryRef& ref) {
-  lua_fn_proxies_.erase(identity);
-  core_.ReleaseRef(ref);
+void LuaJsRuntime::DefineShape(const Napi::Env& env, const std::string& name, const std::vector<std::string>& keys) {
+  shapes_.Define(env, name, keys);
 }
 
-int LuaJsRuntime::InvokeJsFunction(const Napi::FunctionReference& js_fn) {
-  auto env = js_fn.Env();
+std::vector<LuaRegistryRef> LuaJsRuntime::PreparePath(std::string_view path) { return core_.PreparePath(path); }
 
-  Napi::HandleScope scope(env);
+void LuaJsRuntime::ReleasePath(const std::vector<LuaRegistryRef>& segments) { core_.ReleasePath(segments); }
 
-  auto top_index = core_.GetTop();
+Napi::Value LuaJsRuntime::GetGlobal(const Napi::Env& env, const std::vector<LuaRegistryRef>& segments) {
+  LuaStateCore::StackGuard guard(core_);
+  return BuildGlobalResult(env, RunProtected(env, [&] { return core_.PushValueByPath(segments); }), config_.lazy_tables);
+}
 
-  std::vector<napi_value> args;
+Napi::Value LuaJsRuntime::GetLength(const Napi::Env& env, const std::vector<LuaRegistryRef>& segments) {
+  LuaStateCore::StackGuard guard(core_);
+  return BuildLengthResult(env, RunProtected(env, [&] { return core_.PushValueByPath(segments); }));
+}
 
-  if (top_index >= 2) {
-    args.reserve(top_index - 1);
+bool LuaJsRuntime::SetGlobal(const std::vector<LuaRegistryRef>& segments, const Napi::Value& value) {
+  auto env = value.Env();
+  LuaStateCore::StackGuard guard(core_);
+  auto scope = js_to_lua_.CreateScope();
+  js_to_lua_.PushValue(value);
+  CheckMemoryLimit(env);
+  auto is_set = RunProtected(env, [&] { return core_.SetValueByPath(segments); });
+  ReportExternalMemory(env);
+  return is_set;
+}
 
-    auto lua_to_js_scope = lua_to_js_.CreateScope(env);
+LuaRegistryRef LuaJsRuntime::PrepareCall(const Napi::Env& env, const Napi::Value& path_or_fn) {
+  LuaStateCore::StackGuard guard(core_);
 
-    for (auto i = 2; i <= top_index; i++) {
-      core_.Traverse(i, lua_to_js_);
+  if (path_or_fn.IsFunction()) {
+    if (auto* fn_ctx = LuaFunctionCtx::Unwrap(env, path_or_fn); fn_ctx && fn_ctx->weak_runtime.lock().get() == this && fn_ctx->generation == generation_) {
+      core_.PushRef(fn_ctx->ref);
+      return core_.CopyRef(-1);
     }
 
-    auto& results = lua_to_js_.results;
+    throw Napi::TypeError::New(env, "Function is not a Lua function of this state");
+  }
 
-    for (size_t i = 0; i < results.size(); i++) {
-      args.push_back(results[i]);
-    }
+  if (!path_or_fn.IsString()) {
+    throw Napi::TypeError::New(env, "First argument expected string or Lua function");
   }
 
-  Napi::Value call_result = js_fn.Call(args);
+  auto path = path_or_fn.As<Napi::String>().Utf8Value();
 
-  if (call_result.IsUndefined()) {
-    return 0;
+  if (RunProtected(env, [&] { return core_.PushValueByPath(path); }) != LuaStateCore::PushValueByPathStatus::Found || core_.GetType(-1) != LUA_TFUNCTION) {
+    throw Napi::TypeError::New(env, "Global \"" + path + "\" is not a function");
   }
 
-  auto js_to_lua_scope = js_to_lua_.CreateScope();
+  return core_.CopyRef(-1);
+}
 
-  if (call_result.IsArray()) {
-    auto call_results = call_result.As<Napi::Array>();
-    auto results_count = call_results.Length();
-    for (uint32_t i = 0; i < results_count; ++i) {
-      js_to_lua_.PushValue(call_results.Get(i));
-    }
-    return results_count;
+void LuaJsRuntime::ReleaseCall(const LuaRegistryRef& fn_ref) { core_.ReleaseRef(fn_ref); }
+
+int LuaJsRuntime::CallPrepared(const Napi::Env& env, const LuaRegistryRef& fn_ref, std::span<const double> args, const Napi::Reference<Napi::Float64Array>& results) {
+  LuaStateCore::StackGuard guard(core_);
+  LuaStateCore::BudgetGuard budget_guard(core_, MakeBudget(env, {}));
+  core_.PushRef(fn_ref);
+
+  for (auto arg : args) {
+    core_.PushNumber(arg);
   }
 
-  js_to_lua_.PushValue(call_result);
+  int results_count;
 
-  return 1;
-}
+  try {
+    results_count = core_.PCall(static_cast<int>(args.size()), config_.error_detail == LuaErrorDetail::Full);
+  } catch (const LuaStateCore::LuaException&) {
+    throw ExtractError(env);
+  }
 
-namespace {
-  int CallJsFunctionFromLuaCb(lua_State* L) {
-    LuaJsRuntime* runtime = static_cast<LuaJsRuntime*>(lua_touserdata(L, lua_upvalueindex(1)));
-    auto* holder = static_cast<JsToLuaConverter::JsFunctionHolder*>(lua_touserdata(L, 1));
+  ReportExternalMemory(env);
 
-    if (!holder || !holder->ref) {
-      return luaL_error(L, "Invalid js-function reference");
-    }
+  if (results.IsEmpty()) {
+    return results_count;
+  }
 
-    try {
-      return runtime->InvokeJsFunction(holder->ref);
-    } catch (const Napi::Error& e) {
-      std::string msg;
-      auto stack_value = e.Get("stack");
+  // a detached buffer has no elements
+  auto results_array = results.Value();
+  std::span<double> results_span(results_array.Data(), results_array.ElementLength());
+  int first_index = core_.GetTop() - results_count + 1;
 
-      if (stack_value.IsString()) {
-        msg = stack_value.As<Napi::String>().Utf8Value();
-      } else {
-        auto name_value = e.Get("name");
-        std::string name = name_value.IsString() ? name_value.As<Napi::String>().Utf8Value() : "Error";
-        msg = name + ": " + e.Message();
-      }
+  for (size_t i = 0; i < results_span.size(); i++) {
+    results_span[i] = static_cast<int>(i) < results_count ? ToNumericResult(env, first_index + static_cast<int>(i), i + 1) : std::numeric_limits<double>::quiet_NaN();
+  }
 
-      return luaL_error(L, msg.c_str());
-    } catch (const std::exception& e) {
-      return luaL_error(L, e.what());
-    } catch (...) {
-      return luaL_error(L, "Unknown error from JS function");
-    }
+  return results_count;
+}
+
+Napi::Function LuaJsRuntime::CreateJsProxyFunction(const Napi::Env& env, const LuaFunction& lua_fn) {
+  // JS functions passed to Lua come back as themselves
+  if (auto* holder = static_cast<JsToLuaConverter::JsFunctionHolder*>(core_.GetCClosureUserData(lua_fn.index, CallJsFunctionLuaCb, 2))) {
+    return holder->ref.Value();
   }
 
-  int GcJsFunctionFromLuaCb(lua_State* L) {
-    auto* holder = static_cast<JsToLuaConverter::JsFunctionHolder*>(lua_touserdata(L, 1));
+  {
+    // fast return cached function
+    auto it = lua_fn_proxies_.find(lua_fn.identity);
+    if (it != lua_fn_proxies_.end()) {
+      return it->second.Value();
+    }
+  }
+
+  // lock function identity through registry
+  auto lua_fn_ref = core_.CopyRef(lua_fn.index);
+  // weak ptr to this runtime
+  auto weak_runtime = weak_from_this();
+  auto generation = generation_;
+
+  // create javascript function
+  auto js_fn = Napi::Function::New(env, [weak_runtime, lua_fn_ref, generation](const Napi::CallbackInfo& info) {
+    auto runtime = weak_runtime.lock();
+    if (!runtime || runtime->IsClosed() || runtime->generation_ != generation) {
+      return info.Env().Undefined();
+    }
+
+    return runtime->InvokeLuaFunction(info, lua_fn_ref);
+  });
+
+  if (lua_fn_with_signature_.IsEmpty()) {
+    lua_fn_with_signature_ = Napi::Persistent(Napi::Function::New(env, LuaFunctionWithSignature, "withSignature"));
+    lua_fn_batch_ = Napi::Persistent(Napi::Function::New(env, LuaFunctionBatch, "batch"));
+    lua_fn_batch_columns_ = Napi::Persistent(Napi::Function::New(env, LuaFunctionBatchColumns, "batchColumns"));
+  }
+
+  js_fn.DefineProperties({
+    Napi::PropertyDescriptor::Value("withSignature", lua_fn_with_signature_.Value(), napi_default),
+    Napi::PropertyDescriptor::Value("batch", lua_fn_batch_.Value(), napi_default),
+    Napi::PropertyDescriptor::Value("batchColumns", lua_fn_batch_columns_.Value(), napi_default),
+  });
+
+  if (napi_type_tag_object(env, js_fn, &LuaFunctionCtx::TypeTag) != napi_ok) {
+    core_.ReleaseRef(lua_fn_ref);
+    throw Napi::Error::New(env);
+  }
+
+  // the wrapped context finds the Lua function from the proxy and releases it when the proxy is collected
+  auto* fn_ctx = new LuaFunctionCtx{weak_runtime, lua_fn.identity, lua_fn_ref, generation};
+
+  napi_status status = napi_wrap(
+    env,
+    js_fn,
+    fn_ctx,
+    [](napi_env, void* data, void*) {
+      auto* fn_ctx = static_cast<LuaFunctionCtx*>(data);
+      auto runtime = fn_ctx->weak_runtime.lock();
+      // if runtime destroyed then LuaStateCore also destroyed with Lua VM and all refs
+      if (runtime && !runtime->IsClosed()) {
+        runtime->FinalizeFunctionProxy(fn_ctx->identity, fn_ctx->ref, fn_ctx->generation);
+      }
+      delete fn_ctx;
+    },
+    nullptr,
+    nullptr
+  );
+
+  if (status != napi_ok) {
+    delete fn_ctx;
+    core_.ReleaseRef(lua_fn_ref);
+    throw Napi::Error::New(env);
+  }
+
+  // insert crated function to cache
+  lua_fn_proxies_.emplace(lua_fn.identity, Napi::Weak(js_fn));
+
+  return js_fn;
+}
+
+Napi::Function LuaJsRuntime::CreateTypedJsProxyFunction(
+  const Napi::Env& env, const LuaRegistryRef& lua_fn_ref, std::shared_ptr<const LuaSignature> signature
+) {
+  // typed functions are not cached, each one holds its own ref
+  core_.PushRef(lua_fn_ref);
+  auto fn_ref = core_.CopyRef(-1);
+  core_.Pop(1);
+
+  auto weak_runtime = weak_from_this();
+  auto generation = generation_;
+
+  auto js_fn = Napi::Function::New(env, [weak_runtime, fn_ref, generation, signature](const Napi::CallbackInfo& info) {
+    auto runtime = weak_runtime.lock();
+    if (!runtime || runtime->IsClosed() || runtime->generation_ != generation) {
+      return info.Env().Undefined();
+    }
+
+    return runtime->InvokeTypedLuaFunction(info, fn_ref, *signature);
+  });
+
+  struct FinalizerCtx {
+    std::weak_ptr<LuaJsRuntime> weak_runtime;
+    LuaRegistryRef fn_ref;
+  };
+
+  js_fn.AddFinalizer(
+    [](Napi::Env, FinalizerCtx* finalizer_ctx) {
+      auto runtime = finalizer_ctx->weak_runtime.lock();
+      if (runtime && !runtime->IsClosed()) {
+        runtime->core_.ReleaseRef(finalizer_ctx->fn_ref);
+      }
+      delete finalizer_ctx;
+    },
+    new FinalizerCtx{weak_runtime, fn_ref}
+  );
+
+  return js_fn;
+}
+
+const LuaJsRuntime::LuaFunctionCtx* LuaJsRuntime::LuaFunctionCtx::Unwrap(const Napi::Env& env, const Napi::Value& value) {
+  bool is_proxy = false;
+  if (!value.IsFunction() || napi_check_object_type_tag(env, value, &TypeTag, &is_proxy) != napi_ok || !is_proxy) {
+    return nullptr;
+  }
+
+  void* data = nullptr;
+  if (napi_unwrap(env, value, &data) != napi_ok) {
+    return nullptr;
+  }
+
+  return static_cast<const LuaFunctionCtx*>(data);
+}
+
+/**
+ * Function proxy methods
+ *
+ * Shared by all proxies of a runtime, the Lua function is found through the LuaFunctionCtx wrapped into this.
+ */
+std::shared_ptr<LuaJsRuntime> LuaJsRuntime::LockLuaFunction(const Napi::CallbackInfo& info, const LuaFunctionCtx*& ctx) {
+  ctx = LuaFunctionCtx::Unwrap(info.Env(), info.This());
+  if (!ctx) {
+    throw Napi::TypeError::New(info.Env(), "Method called on a function which is not a Lua function");
+  }
+
+  auto runtime = ctx->weak_runtime.lock();
+  if (!runtime || runtime->IsClosed() || runtime->generation_ != ctx->generation) {
+    return nullptr;
+  }
+
+  return runtime;
+}
+
+Napi::Value LuaJsRuntime::LuaFunctionWithSignature(const Napi::CallbackInfo& info) {
+  const LuaFunctionCtx* ctx = nullptr;
+  auto runtime = LockLuaFunction(info, ctx);
+  if (!runtime) {
+    return info.Env().Undefined();
+  }
+
+  // typed variant of the same Lua function, see LuaSignature
+  auto signature = LuaSignature::Parse(info.Env(), info[0]);
+  if (!signature) {
+    throw Napi::TypeError::New(info.Env(), "Signature must declare args or returns");
+  }
+
+  return runtime->CreateTypedJsProxyFunction(info.Env(), ctx->ref, std::move(signature));
+}
+
+Napi::Value LuaJsRuntime::LuaFunctionBatch(const Napi::CallbackInfo& info) {
+  const LuaFunctionCtx* ctx = nullptr;
+  auto runtime = LockLuaFunction(info, ctx);
+  if (!runtime) {
+    return info.Env().Undefined();
+  }
+
+  return runtime->BatchLuaFunction(info.Env(), ctx->ref, info[0]);
+}
+
+Napi::Value LuaJsRuntime::LuaFunctionBatchColumns(const Napi::CallbackInfo& info) {
+  const LuaFunctionCtx* ctx = nullptr;
+  auto runtime = LockLuaFunction(info, ctx);
+  if (!runtime) {
+    return info.Env().Undefined();
+  }
+
+  return runtime->BatchLuaFunctionColumns(info.Env(), ctx->ref, info[0], info[1]);
+}
+
+Napi::Value LuaJsRuntime::BatchLuaFunction(const Napi::Env& env, const LuaRegistryRef& fn_ref, const Napi::Value& args_list_value) {
+  if (!args_list_value.IsArray()) {
+    throw Napi::TypeError::New(env, "First argument expected array of argument lists");
+  }
+
+  auto args_list = args_list_value.As<Napi::Array>();
+  auto calls_count = args_list.Length();
+  auto results = Napi::Array::New(env, calls_count);
+
+  // the budget covers the whole batch
+  LuaStateCore::StackGuard guard(core_);
+  LuaStateCore::BudgetGuard budget_guard(core_, MakeBudget(env, {}));
+
+  for (uint32_t i = 0; i < calls_count; i++) {
+    Napi::HandleScope scope(env);
+    LuaStateCore::StackGuard call_guard(core_);
+    core_.PushRef(fn_ref);
+
+    // an argument list which is not an array is a single argument
+    auto args = args_list.Get(i);
+    int args_count = 1;
+
+    {
+      auto js_to_lua_scope = js_to_lua_.CreateScope();
+
+      if (args.IsArray()) {
+        auto args_array = args.As<Napi::Array>();
+        args_count = static_cast<int>(args_array.Length());
+
+        for (int j = 0; j < args_count; j++) {
+          js_to_lua_.PushValue(args_array.Get(j));
+        }
+      } else {
+        js_to_lua_.PushValue(args);
+      }
+    }
+
+    int results_count;
+
+    try {
+      results_count = core_.PCall(args_count, config_.error_detail == LuaErrorDetail::Full);
+    } catch (const LuaStateCore::LuaException&) {
+      auto error = ExtractError(env);
+      error.Set("index", Napi::Number::New(env, i));
+      throw error;
+    }
+
+    results.Set(i, BuildCallResult(env, results_count));
+  }
+
+  ReportExternalMemory(env);
+
+  return results;
+}
+
+Napi::Value LuaJsRuntime::BatchLuaFunctionColumns(const Napi::Env& env, const LuaRegistryRef& fn_ref, const Napi::Value& columns_value, const Napi::Value& options) {
+  if (!columns_value.IsArray() || columns_value.As<Napi::Array>().Length() == 0) {
+    throw Napi::TypeError::New(env, "First argument expected array of Float64Array columns");
+  }
+
+  auto columns = columns_value.As<Napi::Array>();
+  std::vector<Napi::Float64Array> arrays;
+  arrays.reserve(columns.Length());
+
+  for (uint32_t i = 0; i < columns.Length(); i++) {
+    auto column = columns.Get(i);
+
+    if (!column.IsTypedArray() || column.As<Napi::TypedArray>().TypedArrayType() != napi_float64_array) {
+      throw Napi::TypeError::New(env, "First argument expected array of Float64Array columns");
+    }
+
+    arrays.push_back(column.As<Napi::Float64Array>());
+
+    if (arrays.back().ElementLength() != arrays.front().ElementLength()) {
+      throw Napi::RangeError::New(env, "Columns must have the same length");
+    }
+  }
+
+  size_t results_count = 1;
+
+  if (options.IsObject()) {
+    auto results_option = options.As<Napi::Object>().Get("results");
+
+    if (!results_option.IsUndefined()) {
+      auto value = results_option.IsNumber() ? results_option.As<Napi::Number>().DoubleValue() : 0;
+      if (!(value >= 1 && value <= MaxBatchResults) || value != std::trunc(value)) {
+        throw Napi::TypeError::New(env, "Option \"results\" must be an integer from 1 to " + std::to_string(MaxBatchResults));
+      }
+      results_count = static_cast<size_t>(value);
+    }
+  }
+
+  auto rows_count = arrays.front().ElementLength();
+  std::vector<std::span<const double>> args(arrays.size());
+
+  // JS called from Lua may detach or resize a column, the spans are read again after such a call
+  auto resolve_args = [&]() {
+    for (size_t i = 0; i < arrays.size(); i++) {
+      Napi::Float64Array array(env, arrays[i]);
+      if (array.ElementLength() != rows_count) {
+        throw Napi::RangeError::New(env, "Column " + std::to_string(i) + " was detached or resized during the batch");
+      }
+      args[i] = {array.Data(), rows_count};
+    }
+  };
+
+  resolve_args();
+
+  auto output = Napi::Array::New(env, results_count);
+  std::vector<std::span<double>> results;
+  results.reserve(results_count);
+
+  for (size_t i = 0; i < results_count; i++) {
+    auto column = Napi::Float64Array::New(env, rows_count);
+    output.Set(static_cast<uint32_t>(i), column);
+    results.emplace_back(column.Data(), rows_count);
+  }
+
+  // the budget covers the whole batch
+  LuaStateCore::StackGuard guard(core_);
+  LuaStateCore::BudgetGuard budget_guard(core_, MakeBudget(env, {}));
+  auto traceback = config_.error_detail == LuaErrorDetail::Full;
+
+  for (size_t row = 0; row < rows_count; row++) {
+    LuaStateCore::StackGuard call_guard(core_);
+    core_.PushRef(fn_ref);
+
+    for (const auto& column : args) {
+      core_.PushNumber(column[row]);
+    }
+
+    int row_results_count;
+    auto js_calls_count = JsCallsCount;
+
+    try {
+      row_results_count = core_.PCall(static_cast<int>(args.size()), traceback);
+    } catch (const LuaStateCore::LuaException&) {
+      auto error = ExtractError(env);
+      error.Set("index", Napi::Number::New(env, static_cast<double>(row)));
+      throw error;
+    }
+
+    if (js_calls_count != JsCallsCount && row + 1 < rows_count) {
+      resolve_args();
+    }
+
+    int first_index = core_.GetTop() - row_results_count + 1;
+
+    for (size_t i = 0; i < results_count; i++) {
+      results[i][row] = static_cast<int>(i) < row_results_count ? ToNumericResult(env, first_index + static_cast<int>(i), i + 1) : std::numeric_limits<double>::quiet_NaN();
+    }
+  }
+
+  ReportExternalMemory(env);
+
+  return output;
+}
+
+/**
+ * Lazy tables
+ *
+ * The proxy target is an empty object wrapped with the registry ref of the table, every trap reads or writes the
+ * Lua table directly with raw access. Nested tables are returned as lazy tables as well. Like function proxies, lazy
+ * tables are cached by table identity and detached when the state is closed or reset.
+ */
+Napi::Object LuaJsRuntime::CreateLazyTable(const Napi::Env& env, int index) {
+  auto identity = core_.ToPointer(index);
+
+  if (auto it = lazy_tables_.find(identity); it != lazy_tables_.end()) {
+    auto proxy = it->second.proxy.Value();
+    // the proxy may be collected before its finalizer has run
+    if (!proxy.IsEmpty()) {
+      return proxy;
+    }
+  }
+
+  if (lazy_table_handler_.IsEmpty()) {
+    auto handler = Napi::Object::New(env);
+    handler.Set("get", Napi::Function::New(env, LazyTableGetTrap, "get"));
+    handler.Set("has", Napi::Function::New(env, LazyTableHasTrap, "has"));
+    handler.Set("set", Napi::Function::New(env, LazyTableSetTrap, "set"));
+    handler.Set("deleteProperty", Napi::Function::New(env, LazyTableDeleteTrap, "deleteProperty"));
+    handler.Set("ownKeys", Napi::Function::New(env, LazyTableOwnKeysTrap, "ownKeys"));
+    handler.Set("getOwnPropertyDescriptor", Napi::Function::New(env, LazyTableDescriptorTrap, "getOwnPropertyDescriptor"));
+
+    lazy_table_handler_ = Napi::Persistent(handler);
+    proxy_ctor_ = Napi::Persistent(env.Global().Get("Proxy").As<Napi::Function>());
+  }
+
+  auto* ctx = new LazyTableCtx{weak_from_this(), identity, core_.CopyRef(index), generation_};
+  auto target = Napi::Object::New(env);
+
+  auto finalize = [](napi_env, void* data, void*) {
+    auto* ctx = static_cast<LazyTableCtx*>(data);
+    auto runtime = ctx->weak_runtime.lock();
+    // if runtime destroyed then LuaStateCore also destroyed with Lua VM and all refs
+    if (runtime && !runtime->IsClosed()) {
+      runtime->FinalizeLazyTable(ctx);
+    }
+    delete ctx;
+  };
+
+  if (napi_wrap(env, target, ctx, finalize, nullptr, nullptr) != napi_ok) {
+    core_.ReleaseRef(ctx->ref);
+    delete ctx;
+    throw Napi::Error::New(env, "Cannot create lazy table");
+  }
+
+  auto proxy = proxy_ctor_.New({target, lazy_table_handler_.Value()});
+
+  lazy_tables_.insert_or_assign(identity, LazyTableEntry{Napi::Weak(proxy), ctx});
+
+  return proxy;
+}
+
+/**
+ * ================= Private =========================
+ */
+
+Napi::Value LuaJsRuntime::InvokeTypedLuaFunction(const Napi::CallbackInfo& info, const LuaRegistryRef& fn_ref, const LuaSignature& signature) {
+  auto env = info.Env();
+
+  LuaStateCore::StackGuard guard(core_);
+  LuaStateCore::BudgetGuard budget_guard(core_, MakeBudget(env, {}));
+  core_.PushRef(fn_ref);
+
+  size_t args_count = info.Length();
+
+  if (signature.args) {
+    auto& types = *signature.args;
+
+    if (args_count > types.size()) {
+      throw LuaSignature::CreateArgsCountError(env, types.size(), args_count);
+    }
+
+    // missing arguments are undefined, which only "any" accepts
+    for (size_t i = 0; i < types.size(); ++i) {
+      PushTypedValue(info[i], types[i], i + 1);
+    }
+
+    args_count = types.size();
+  } else if (args_count > 0) {
+    auto scope = js_to_lua_.CreateScope();
+
+    for (size_t i = 0; i < args_count; ++i) {
+      js_to_lua_.PushValue(info[i]);
+    }
+  }
+
+  if (!signature.returns) {
+    try {
+      return CallLuaFunction(env, static_cast<int>(args_count));
+    } catch (const LuaStateCore::LuaException&) {
+      auto error = ExtractError(env);
+      error.ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+
+  int results_count;
+
+  try {
+    results_count = core_.PCall(static_cast<int>(args_count), config_.error_detail == LuaErrorDetail::Full);
+  } catch (const LuaStateCore::LuaException&) {
+    auto error = ExtractError(env);
+    error.ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  ReportExternalMemory(env);
+
+  if (results_count == 0 && signature.returns == LuaSignature::Type::Any) {
+    return env.Undefined();
+  }
+
+  // the first result is converted, like a single assignment in Lua
+  return ToTypedJsValue(env, core_.GetTop() - results_count + 1, *signature.returns, 0);
+}
+
+Napi::Value LuaJsRuntime::InvokeLuaFunction(const Napi::CallbackInfo& info, const LuaRegistryRef& fn_ref) {
+  auto env = info.Env();
+
+  LuaStateCore::StackGuard guard(core_);
+  LuaStateCore::BudgetGuard budget_guard(core_, MakeBudget(env, {}));
+  core_.PushRef(fn_ref);
+
+  auto args_count = info.Length();
+
+  if (args_count > 0) {
+    auto scope = js_to_lua_.CreateScope();
+
+    for (size_t i = 0; i < args_count; ++i) {
+      js_to_lua_.PushValue(info[i]);
+    }
+  }
+
+  try {
+    return CallLuaFunction(env, args_count);
+  } catch (const LuaStateCore::LuaException&) {
+    auto error = ExtractError(env);
+    error.ThrowAsJavaScriptException();
+    return env.Undefined();
+  } catch (...) {
+    return env.Undefined();
+  }
+}
+
+void LuaJsRuntime::LoadString(std::string_view source) {
+  if (!config_.chunk_cache) {
+    core_.LoadString(source);
+    return;
+  }
+
+  auto& cache = LuaChunkCache::Shared();
+
+  if (auto bytecode = cache.Find(source)) {
+    try {
+      core_.LoadBinary(*bytecode, "=(chunk cache)");
+      return;
+    } catch (const LuaStateCore::LuaException&) {
+      // unloadable entry, drop the error message and compile from source
+      core_.Pop(1);
+    }
+  }
+
+  core_.LoadString(source);
+  cache.Insert(source, core_.Dump(-1));
+}
+
+Napi::Value LuaJsRuntime::BuildGlobalResult(const Napi::Env& env, LuaStateCore::PushValueByPathStatus push_status, bool lazy) {
+  if (push_status == LuaStateCore::PushValueByPathStatus::NotFound) {
+    return env.Null();
+  }
+
+  if (push_status == LuaStateCore::PushValueByPathStatus::BrokenPath) {
+    return env.Undefined();
+  }
+
+  if (lazy && core_.IsTable(-1)) {
+    return CreateLazyTable(env, -1);
+  }
+
+  auto scope = lua_to_js_.CreateScope(env);
+
+  core_.Traverse(-1, lua_to_js_);
+
+  return lua_to_js_.BuildResult();
+}
+
+Napi::Value LuaJsRuntime::BuildLengthResult(const Napi::Env& env, LuaStateCore::PushValueByPathStatus push_status) {
+  if (push_status == LuaStateCore::PushValueByPathStatus::NotFound) {
+    return env.Null();
+  }
+
+  if (push_status == LuaStateCore::PushValueByPathStatus::BrokenPath) {
+    return env.Undefined();
+  }
+
+  auto length = core_.GetLength(-1);
+
+  if (!length) {
+    return env.Undefined();
+  }
+
+  return Napi::Number::New(env, length.value());
+}
+
+Napi::Value LuaJsRuntime::CallLuaFunction(const Napi::Env& env, int args_count) {
+  auto results_count = core_.PCall(args_count, config_.error_detail == LuaErrorDetail::Full);
+  ReportExternalMemory(env);
+
+  return BuildCallResult(env, results_count);
+}
+
+Napi::Value LuaJsRuntime::BuildCallResult(const Napi::Env& env, int results_count) {
+  if (results_count == 0) {
+    return env.Undefined();
+  }
+
+  auto scope = lua_to_js_.CreateScope(env);
+
+  int base_index = -results_count;
+  for (int i = 0; i < results_count; i++) {
+    core_.Traverse(base_index + i, lua_to_js_);
+  }
+
+  return lua_to_js_.BuildResult();
+}
+
+double LuaJsRuntime::ToNumericResult(const Napi::Env& env, int index, size_t position) {
+  auto lua_type = core_.GetType(index);
+
+  if (lua_type == LUA_TNUMBER) {
+    return core_.ToNumber(index);
+  }
+
+  if (lua_type == LUA_TNIL) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  throw LuaSignature::CreateMismatchError(env, "Result " + std::to_string(position), LuaSignature::Type::Number, core_.GetTypeName(index));
+}
+
+LuaStateCore::ExecutionBudget LuaJsRuntime::MakeBudget(const Napi::Env& env, const LuaBudget& call_budget) {
+  LuaStateCore::ExecutionBudget budget;
+  budget.hook_interval = config_.hook_interval;
+
+  auto instructions = call_budget.instructions ? call_budget.instructions : config_.budget.instructions;
+  if (instructions) {
+    budget.instructions = *instructions;
+  }
+
+  auto timeout = call_budget.timeout ? call_budget.timeout : config_.budget.timeout;
+  if (timeout) {
+    auto duration = std::chrono::duration<double, std::milli>(*timeout);
+    budget.deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+  }
+
+  auto signal = call_budget.signal ? call_budget.signal : config_.budget.signal;
+  if (signal) {
+    budget.is_aborted = [env, signal]() {
+      try {
+        Napi::HandleScope scope(env);
+        return signal->Value().Get("aborted").ToBoolean().Value();
+      } catch (const Napi::Error&) {
+        return false;
+      }
+    };
+  }
+
+  return budget;
+}
+
+Napi::Error LuaJsRuntime::ExtractError(const Napi::Env& env) {
+  auto error = ExtractLuaError(env);
+  ReportExternalMemory(env);
+
+  switch (core_.GetBudgetStatus()) {
+    case LuaStateCore::BudgetStatus::InstructionsExceeded:
+    case LuaStateCore::BudgetStatus::TimedOut:
+      error.Set("code", "ERR_LUA_BUDGET_EXCEEDED");
+      break;
+    case LuaStateCore::BudgetStatus::Aborted:
+      error.Set("code", "ERR_LUA_ABORTED");
+      break;
+    default:
+      break;
+  }
+
+  return error;
+}
+
+Napi::Error LuaJsRuntime::ExtractLuaError(const Napi::Env& env) {
+  if (config_.error_detail == LuaErrorDetail::None) {
+    core_.Pop(1);
+    return LuaError::New(env, Napi::String::New(env, ""), env.Undefined(), {});
+  }
+
+  auto info = core_.ReadError(-1, config_.error_detail == LuaErrorDetail::Full);
+
+  Napi::Value cause = env.Undefined();
+  if (info.has_cause) {
+    auto scope = lua_to_js_.CreateScope(env);
+
+    core_.Traverse(-1, lua_to_js_);
+    core_.Pop(1);
+
+    cause = lua_to_js_.BuildResult();
+  }
+
+  core_.Pop(1);
+
+  return LuaError::New(env, Napi::String::New(env, info.message), cause, std::move(info.traceback));
+}
+
+void LuaJsRuntime::ReportExternalMemory(const Napi::Env& env) {
+  if (core_.IsClosed()) {
+    return;
+  }
+
+  auto used = static_cast<int64_t>(core_.GcCount());
+  auto delta = used - external_memory_;
+
+  // batch small changes, every adjustment is a call into V8
+  if (delta > -ExternalMemoryStep && delta < ExternalMemoryStep) {
+    return;
+  }
+
+  int64_t adjusted;
+  napi_adjust_external_memory(env, delta, &adjusted);
+
+  external_memory_env_ = env;
+  external_memory_ = used;
+}
+
+void LuaJsRuntime::ReleaseExternalMemory() {
+  if (!external_memory_) {
+    return;
+  }
+
+  int64_t adjusted;
+  napi_adjust_external_memory(external_memory_env_, -external_memory_, &adjusted);
+
+  external_memory_ = 0;
+}
+
+void LuaJsRuntime::FinalizeFunctionProxy(const void* identity, const LuaRegistryRef& ref, uint64_t generation) {
+  // the cache entry of an older generation is already gone, the same identity may belong to a newer proxy
+  if (generation == generation_) {
+    lua_fn_proxies_.erase(identity);
+  }
+  core_.ReleaseRef(ref);
+}
+
+void LuaJsRuntime::FinalizeLazyTable(const LazyTableCtx* ctx) {
+  // a newer proxy of the same table may have replaced the cache entry
+  if (ctx->generation == generation_) {
+    if (auto it = lazy_tables_.find(ctx->identity); it != lazy_tables_.end() && it->second.ctx == ctx) {
+      lazy_tables_.erase(it);
+    }
+  }
+  core_.ReleaseRef(ctx->ref);
+}
+
+std::shared_ptr<LuaJsRuntime> LuaJsRuntime::LockLazyTable(const Napi::CallbackInfo& info, const LazyTableCtx*& ctx) {
+  void* data = nullptr;
+  if (napi_unwrap(info.Env(), info[0], &data) != napi_ok || !data) {
+    return nullptr;
+  }
+
+  ctx = static_cast<const LazyTableCtx*>(data);
+
+  auto runtime = ctx->weak_runtime.lock();
+  if (!runtime || runtime->IsClosed() || runtime->generation_ != ctx->generation) {
+    return nullptr;
+  }
+
+  return runtime;
+}
+
+Napi::Value LuaJsRuntime::LazyTableGetTrap(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  const LazyTableCtx* ctx = nullptr;
+  auto runtime = LockLazyTable(info, ctx);
+  if (!runtime || !info[1].IsString()) {
+    return env.Undefined();
+  }
+
+  LuaStateCore::StackGuard guard(runtime->core_);
+  runtime->core_.PushRef(ctx->ref);
+
+  if (!runtime->PushLazyTableField(runtime->core_.GetTop(), info[1].As<Napi::String>().Utf8Value())) {
+    return env.Undefined();
+  }
+
+  return runtime->ToJsValue(env, -1, true);
+}
+
+Napi::Value LuaJsRuntime::LazyTableHasTrap(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  const LazyTableCtx* ctx = nullptr;
+  auto runtime = LockLazyTable(info, ctx);
+  if (!runtime || !info[1].IsString()) {
+    return Napi::Boolean::New(env, false);
+  }
+
+  LuaStateCore::StackGuard guard(runtime->core_);
+  runtime->core_.PushRef(ctx->ref);
+
+  return Napi::Boolean::New(env, runtime->PushLazyTableField(runtime->core_.GetTop(), info[1].As<Napi::String>().Utf8Value()));
+}
+
+Napi::Value LuaJsRuntime::LazyTableSetTrap(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  const LazyTableCtx* ctx = nullptr;
+  auto runtime = LockLazyTable(info, ctx);
+  if (!runtime || !info[1].IsString()) {
+    return Napi::Boolean::New(env, false);
+  }
+
+  auto& core = runtime->core_;
+  LuaStateCore::StackGuard guard(core);
+  core.PushRef(ctx->ref);
+  int table_index = core.GetTop();
+
+  runtime->PushLazyTableKey(table_index, info[1].As<Napi::String>().Utf8Value());
+
+  auto scope = runtime->js_to_lua_.CreateScope();
+  runtime->js_to_lua_.PushValue(info[2]);
+  core.RawSet(table_index);
+
+  runtime->ReportExternalMemory(env);
+
+  return Napi::Boolean::New(env, true);
+}
+
+Napi::Value LuaJsRuntime::LazyTableDeleteTrap(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  const LazyTableCtx* ctx = nullptr;
+  auto runtime = LockLazyTable(info, ctx);
+  if (!runtime || !info[1].IsString()) {
+    return Napi::Boolean::New(env, true);
+  }
+
+  auto& core = runtime->core_;
+  LuaStateCore::StackGuard guard(core);
+  core.PushRef(ctx->ref);
+  int table_index = core.GetTop();
+
+  auto key = info[1].As<Napi::String>().Utf8Value();
+
+  // both the number and the string key map to the same property name
+  if (auto number = ParseNumericKey(key)) {
+    core.PushNumber(*number);
+    core.PushNil();
+    core.RawSet(table_index);
+  }
+
+  core.PushString(key);
+  core.PushNil();
+  core.RawSet(table_index);
+
+  return Napi::Boolean::New(env, true);
+}
+
+Napi::Value LuaJsRuntime::LazyTableOwnKeysTrap(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  const LazyTableCtx* ctx = nullptr;
+  auto runtime = LockLazyTable(info, ctx);
+  if (!runtime) {
+    return Napi::Array::New(env);
+  }
+
+  LuaStateCore::StackGuard guard(runtime->core_);
+  runtime->core_.PushRef(ctx->ref);
+
+  std::vector<LuaTableKey> keys;
+  runtime->core_.GetTableKeys(-1, keys);
+
+  // 1 and "1" are the same property name, a trap result with duplicates throws
+  std::vector<std::string> names;
+  std::unordered_set<std::string> seen;
+  names.reserve(keys.size());
+
+  for (const auto& key : keys) {
+    auto name = std::visit(
+      [&](auto&& k) -> std::string {
+        if constexpr (std::is_same_v<std::decay_t<decltype(k)>, LuaString>) {
+          return std::string(k.ptr, k.len);
+        } else {
+          return GetNumericKeyName(env, k.value);
+        }
+      },
+      key
+    );
+
+    if (seen.insert(name).second) {
+      names.push_back(std::move(name));
+    }
+  }
+
+  auto result = Napi::Array::New(env, names.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    result.Set(i, names[i]);
+  }
+
+  return result;
+}
+
+Napi::Value LuaJsRuntime::LazyTableDescriptorTrap(const Napi::CallbackInfo& info) {
+  auto env = info.Env();
+
+  const LazyTableCtx* ctx = nullptr;
+  auto runtime = LockLazyTable(info, ctx);
+  if (!runtime || !info[1].IsString()) {
+    return env.Undefined();
+  }
+
+  LuaStateCore::StackGuard guard(runtime->core_);
+  runtime->core_.PushRef(ctx->ref);
+
+  if (!runtime->PushLazyTableField(runtime->core_.GetTop(), info[1].As<Napi::String>().Utf8Value())) {
+    return env.Undefined();
+  }
+
+  auto descriptor = Napi::Object::New(env);
+  descriptor.Set("value", runtime->ToJsValue(env, -1, true));
+  descriptor.Set("writable", true);
+  descriptor.Set("enumerable", true);
+  descriptor.Set("configurable", true);
+
+  return descriptor;
+}
+
+bool LuaJsRuntime::PushLazyTableField(int table_index, const std::string& key) {
+  if (auto number = ParseNumericKey(key)) {
+    core_.PushNumber(*number);
+    core_.RawGet(table_index);
+
+    if (!core_.IsNil(-1)) {
+      return true;
+    }
+
+    core_.Pop(1);
+  }
+
+  core_.PushString(key);
+  core_.RawGet(table_index);
+
+  return !core_.IsNil(-1);
+}
+
+void LuaJsRuntime::PushLazyTableKey(int table_index, const std::string& key) {
+  // numeric names go to the number key, unless the table already has them as a string key
+  if (auto number = ParseNumericKey(key)) {
+    core_.PushString(key);
+    core_.RawGet(table_index);
+    bool has_string_key = !core_.IsNil(-1);
+    core_.Pop(1);
+
+    if (!has_string_key) {
+      core_.PushNumber(*number);
+      return;
+    }
+  }
+
+  core_.PushString(key);
+}
+
+Napi::Value LuaJsRuntime::ToJsValue(const Napi::Env& env, int index, bool lazy) {
+  if (lazy && core_.IsTable(index)) {
+    return CreateLazyTable(env, index);
+  }
+
+  auto scope = lua_to_js_.CreateScope(env);
+  core_.Traverse(index, lua_to_js_);
+  return lua_to_js_.BuildResult();
+}
+
+int LuaJsRuntime::InvokeJsFunction(const JsToLuaConverter::JsFunctionHolder& holder) {
+  auto env = holder.ref.Env();
+
+  Napi::HandleScope scope(env);
+
+  if (holder.signature) {
+    return CallTypedJsFunction(env, holder.ref.Value(), *holder.signature);
+  }
+
+  return CallJsFunction(env, holder.ref.Value(), env.Undefined(), 1);
+}
+
+void LuaJsRuntime::PushJsFunction(const Napi::Function& fn, std::shared_ptr<const LuaSignature> signature) {
+  core_.PushLightUserData(this);
+
+  auto* holder = static_cast<JsToLuaConverter::JsFunctionHolder*>(core_.NewUserData(sizeof(JsToLuaConverter::JsFunctionHolder)));
+  new (holder) JsToLuaConverter::JsFunctionHolder{Napi::Persistent(fn), std::move(signature)};
+  core_.PushMetaTable(LuaJsRuntime::MetaTableName);
+  core_.SetMetaTable(-2);
+
+  core_.PushCClosure(CallJsFunctionLuaCb, 2);
+}
+
+int LuaJsRuntime::CallJsFunction(const Napi::Env& env, const Napi::Function& js_fn, const Napi::Value& receiver, int first_arg_index) {
+  auto top_index = core_.GetTop();
+  auto args_count = top_index >= first_arg_index ? top_index - first_arg_index + 1 : 0;
+
+  // the common fn(i) call needs neither a converter scope nor a heap allocated argument list
+  if (args_count <= MaxFastCallArgs) {
+    napi_value args[MaxFastCallArgs];
+
+    if (ToPrimitiveArgs(env, first_arg_index, args_count, args)) {
+      return PushJsCallResult(js_fn.Call(receiver, static_cast<size_t>(args_count), args));
+    }
+  }
+
+  std::vector<napi_value> args;
+
+  if (args_count > 0) {
+    args.reserve(args_count);
+
+    auto lua_to_js_scope = lua_to_js_.CreateScope(env);
+
+    for (auto i = first_arg_index; i <= top_index; i++) {
+      if (config_.lazy_tables && core_.IsTable(i)) {
+        lua_to_js_.results.emplace_back(CreateLazyTable(env, i));
+      } else {
+        core_.Traverse(i, lua_to_js_);
+      }
+    }
+
+    auto& results = lua_to_js_.results;
+
+    for (size_t i = 0; i < results.size(); i++) {
+      args.push_back(results[i]);
+    }
+  }
+
+  return PushJsCallResult(js_fn.Call(receiver, args));
+}
+
+int LuaJsRuntime::CallTypedJsFunction(const Napi::Env& env, const Napi::Function& js_fn, const LuaSignature& signature) {
+  auto top_index = core_.GetTop();
+
+  if (signature.args && static_cast<size_t>(top_index) > signature.args->size()) {
+    throw LuaSignature::CreateArgsCountError(env, signature.args->size(), top_index);
+  }
+
+  std::vector<napi_value> args;
+
+  if (signature.args) {
+    auto& types = *signature.args;
+    args.reserve(types.size());
+
+    // missing arguments are nil, which only "any" accepts
+    for (size_t i = 0; i < types.size(); i++) {
+      args.push_back(ToTypedJsValue(env, static_cast<int>(i + 1), types[i], i + 1));
+    }
+  } else {
+    args.reserve(top_index);
+
+    for (int i = 1; i <= top_index; i++) {
+      args.push_back(ToJsArg(env, i));
+    }
+  }
+
+  auto call_result = js_fn.Call(env.Undefined(), args);
+
+  if (!signature.returns) {
+    return PushJsCallResult(call_result);
+  }
+
+  PushTypedValue(call_result, *signature.returns, 0);
+  return 1;
+}
+
+Napi::Value LuaJsRuntime::ToJsArg(const Napi::Env& env, int index) {
+  napi_value arg;
+
+  if (ToPrimitiveArgs(env, index, 1, &arg)) {
+    return Napi::Value(env, arg);
+  }
+
+  if (config_.lazy_tables && core_.IsTable(index)) {
+    return CreateLazyTable(env, index);
+  }
+
+  auto lua_to_js_scope = lua_to_js_.CreateScope(env);
+  core_.Traverse(index, lua_to_js_);
+  return lua_to_js_.results[0];
+}
+
+Napi::Value LuaJsRuntime::ToTypedJsValue(const Napi::Env& env, int index, LuaSignature::Type type, size_t position) {
+  // index is absolute, past the top it is a missing argument or result
+  auto lua_type = index > core_.GetTop() ? LUA_TNONE : core_.GetType(index);
+
+  switch (type) {
+    case LuaSignature::Type::Number:
+      if (lua_type == LUA_TNUMBER) {
+        return Napi::Number::New(env, core_.ToNumber(index));
+      }
+      break;
+    case LuaSignature::Type::String:
+      if (lua_type == LUA_TSTRING) {
+        auto str = core_.ToString(index);
+        return lua_to_js_.ToJsString(env, LuaString{str.data(), str.size(), index});
+      }
+      break;
+    case LuaSignature::Type::Boolean:
+      if (lua_type == LUA_TBOOLEAN) {
+        return Napi::Boolean::New(env, core_.ToBool(index));
+      }
+      break;
+    default:
+      return lua_type == LUA_TNONE ? env.Null() : ToJsArg(env, index);
+  }
+
+  throw LuaSignature::CreateMismatchError(env, LuaSignature::GetPositionName(position), type, lua_type == LUA_TNONE ? "no value" : core_.GetTypeName(index));
+}
+
+void LuaJsRuntime::PushTypedValue(const Napi::Value& value, LuaSignature::Type type, size_t position) {
+  auto value_type = value.Type();
+
+  switch (type) {
+    case LuaSignature::Type::Number:
+      if (value_type == napi_number) {
+        core_.PushNumber(value.As<Napi::Number>().DoubleValue());
+        return;
+      }
+      break;
+    case LuaSignature::Type::String:
+      if (value_type == napi_string) {
+        js_to_lua_.PushValue(value);
+        return;
+      }
+      break;
+    case LuaSignature::Type::Boolean:
+      if (value_type == napi_boolean) {
+        core_.PushBool(value.As<Napi::Boolean>().Value());
+        return;
+      }
+      break;
+    default: {
+      auto scope = js_to_lua_.CreateScope();
+      js_to_lua_.PushValue(value);
+      return;
+    }
+  }
+
+  throw LuaSignature::CreateMismatchError(value.Env(), LuaSignature::GetPositionName(position), type, LuaSignature::GetJsTypeName(value_type));
+}
+
+bool LuaJsRuntime::ToPrimitiveArgs(const Napi::Env& env, int first_index, int count, napi_value* args) {
+  for (int i = 0; i < count; i++) {
+    int index = first_index + i;
+
+    switch (core_.GetType(index)) {
+      case LUA_TNIL:
+        args[i] = env.Null();
+        break;
+      case LUA_TBOOLEAN:
+        args[i] = Napi::Boolean::New(env, core_.ToBool(index));
+        break;
+      case LUA_TNUMBER:
+        args[i] = Napi::Number::New(env, core_.ToNumber(index));
+        break;
+      case LUA_TSTRING: {
+        auto str = core_.ToString(index);
+        args[i] = lua_to_js_.ToJsString(env, LuaString{str.data(), str.size(), index});
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+int LuaJsRuntime::PushJsCallResult(const Napi::Value& call_result) {
+  if (call_result.IsUndefined()) {
+    return 0;
+  }
+
+  // primitives are pushed without a converter scope
+  if (!call_result.IsObject()) {
+    js_to_lua_.PushValue(call_result);
+    return 1;
+  }
+
+  auto js_to_lua_scope = js_to_lua_.CreateScope();
+
+  if (call_result.IsArray()) {
+    auto call_results = call_result.As<Napi::Array>();
+    auto results_count = call_results.Length();
+    for (uint32_t i = 0; i < results_count; ++i) {
+      js_to_lua_.PushValue(call_results.Get(i));
+    }
+    return results_count;
+  }
+
+  js_to_lua_.PushValue(call_result);
+
+  return 1;
+}
+
+int LuaJsRuntime::IndexJsObjectRef(JsObjectRef& ref, const LuaTableKey& key) {
+  const auto* name = std::get_if<LuaString>(&key);
+
+  if (name) {
+    if (auto it = ref.methods.find(std::string_view(name->ptr, name->len)); it != ref.methods.end()) {
+      core_.PushRef(it->second);
+      return 1;
+    }
+  }
+
+  auto env = ref.object.Env();
+  Napi::HandleScope scope(env);
+
+  auto object = ref.object.Value();
+  auto value = object.Get(ToJsObjectRefKey(env, object, key));
+
+  if (value.IsFunction()) {
+    core_.PushLightUserData(this);
+    JsObjectRef::Push(core_, value.As<Napi::Object>(), object);
+    core_.PushCClosure(CallJsMethodFromLuaCb, 2);
+
+    if (name) {
+      ref.methods.emplace(std::string(name->ptr, name->len), core_.CopyRef(-1));
+    }
+
+    return 1;
+  }
+
+  // nested objects stay live as well
+  if (value.IsObject() && !value.IsDate() && !JsBufferView::IsBufferLike(value)) {
+    JsObjectRef::Push(core_, value.As<Napi::Object>());
+    return 1;
+  }
+
+  auto js_to_lua_scope = js_to_lua_.CreateScope();
+  js_to_lua_.PushValue(value);
+
+  return 1;
+}
+
+void LuaJsRuntime::NewIndexJsObjectRef(JsObjectRef& ref, const LuaTableKey& key, int value_index) {
+  auto env = ref.object.Env();
+  Napi::HandleScope scope(env);
+
+  auto object = ref.object.Value();
+  auto js_key = ToJsObjectRefKey(env, object, key);
+
+  if (core_.IsNil(value_index)) {
+    object.Delete(js_key);
+  } else {
+    object.Set(js_key, ToJsValue(env, value_index, config_.lazy_tables));
+  }
+
+  if (const auto* name = std::get_if<LuaString>(&key)) {
+    if (auto it = ref.methods.find(std::string_view(name->ptr, name->len)); it != ref.methods.end()) {
+      core_.ReleaseRef(it->second);
+      ref.methods.erase(it);
+    }
+  }
+}
+
+size_t LuaJsRuntime::GetJsObjectRefLength(JsObjectRef& ref) {
+  auto env = ref.object.Env();
+  Napi::HandleScope scope(env);
+
+  auto object = ref.object.Value();
+  if (object.IsArray()) {
+    return object.As<Napi::Array>().Length();
+  }
+
+  auto length = object.Get("length");
+  return length.IsNumber() ? static_cast<size_t>(length.As<Napi::Number>().Int64Value()) : 0;
+}
+
+void LuaJsRuntime::GetJsObjectRefKeys(JsObjectRef& ref, std::vector<std::string>& keys, uint32_t& length) {
+  auto env = ref.object.Env();
+  Napi::HandleScope scope(env);
+
+  auto object = ref.object.Value();
+  if (object.IsArray()) {
+    length = object.As<Napi::Array>().Length();
+    return;
+  }
+
+  auto names = object.GetPropertyNames();
+  auto names_count = names.Length();
+  keys.reserve(names_count);
+
+  for (uint32_t i = 0; i < names_count; i++) {
+    keys.push_back(names.Get(i).ToString().Utf8Value());
+  }
+}
+
+int LuaJsRuntime::CallJsObjectRef(JsObjectRef& ref) {
+  auto env = ref.object.Env();
+  Napi::HandleScope scope(env);
+
+  auto object = ref.object.Value();
+  if (!object.IsFunction()) {
+    throw Napi::TypeError::New(env, "JS object is not callable");
+  }
+
+  return CallJsFunction(env, object.As<Napi::Function>(), env.Undefined(), 2);
+}
+
+int LuaJsRuntime::CallJsObjectRefMethod(JsObjectRef& fn) {
+  auto env = fn.object.Env();
+  Napi::HandleScope scope(env);
+
+  // other references in the first slot are plain arguments, only obj:method() passes the object as this
+  if (auto* self = JsObjectRef::Test(core_, 1); self && self->object.Value().StrictEquals(fn.owner.Value())) {
+    return CallJsFunction(env, fn.object.Value().As<Napi::Function>(), self->object.Value(), 2);
+  }
+
+  return CallJsFunction(env, fn.object.Value().As<Napi::Function>(), env.Undefined(), 1);
+}
+
+Napi::Value LuaJsRuntime::ToJsObjectRefKey(const Napi::Env& env, const Napi::Object& object, const LuaTableKey& key) {
+  return std::visit(
+    [&](auto&& k) -> Napi::Value {
+      using T = std::decay_t<decltype(k)>;
+
+      if constexpr (std::is_same_v<T, LuaString>) {
+        return Napi::String::New(env, k.ptr, k.len);
+      } else {
+        // Lua indexes 1..n to array indexes 0..n-1
+        if (k.value >= 1 && k.value == std::trunc(k.value) && object.IsArray()) {
+          return Napi::Number::New(env, k.value - 1);
+        }
+        return Napi::Number::New(env, k.value);
+      }
+    },
+    key
+  );
+}
+
+namespace {
+  // runs a call into JS and raises its exception as a Lua error
+  template <typename Fn> int CallJs(lua_State* L, Fn&& fn) {
+    JsCallsCount++;
+
+    int results_count = 0;
+    bool is_failed = true;
+
+    {
+      // values are converted with C++ frames alive, a memory error must not unwind them
+      LuaStateCore::MemoryLimitSuspension suspension(L);
+      std::string msg;
+
+      try {
+        results_count = fn();
+        is_failed = false;
+      } catch (const Napi::Error& e) {
+        auto stack_value = e.Get("stack");
+
+        if (stack_value.IsString()) {
+          msg = stack_value.As<Napi::String>().Utf8Value();
+        } else {
+          auto name_value = e.Get("name");
+          std::string name = name_value.IsString() ? name_value.As<Napi::String>().Utf8Value() : "Error";
+          msg = name + ": " + e.Message();
+        }
+      } catch (const std::exception& e) {
+        msg = e.what();
+      } catch (...) {
+        msg = "Unknown error from JS function";
+      }
+
+      if (is_failed) {
+        lua_pushlstring(L, msg.data(), msg.size());
+      }
+    }
+
+    if (is_failed) {
+      return lua_error(L);
+    }
+
+    // values that took the state past its memory limit fail as their allocation would have
+    if (auto* allocator = LuaStateCore::GetAllocator(L); allocator && allocator->IsOverLimit()) {
+      lua_gc(L, LUA_GCCOLLECT, 0);
+      if (allocator->IsOverLimit()) {
+        lua_pushliteral(L, "not enough memory");
+        return lua_error(L);
+      }
+    }
+
+    return results_count;
+  }
+
+  // key argument of a metamethod, only numbers and strings map to JS properties
+  std::optional<LuaTableKey> ToLuaTableKey(lua_State* L, int index) {
+    if (lua_type(L, index) == LUA_TNUMBER) {
+      return LuaNumber{lua_tonumber(L, index)};
+    }
+
+    if (lua_type(L, index) == LUA_TSTRING) {
+      size_t len;
+      const char* ptr = lua_tolstring(L, index, &len);
+      return LuaString{ptr, len, index};
+    }
+
+    return std::nullopt;
+  }
+
+  int IndexJsObjectRefLuaCb(lua_State* L) {
+    auto* runtime = static_cast<LuaJsRuntime*>(lua_touserdata(L, lua_upvalueindex(1)));
+    auto* ref = static_cast<JsObjectRef*>(lua_touserdata(L, 1));
+    auto key = ToLuaTableKey(L, 2);
+
+    if (!key) {
+      lua_pushnil(L);
+      return 1;
+    }
+
+    return CallJs(L, [&] { return runtime->IndexJsObjectRef(*ref, *key); });
+  }
+
+  int NewIndexJsObjectRefLuaCb(lua_State* L) {
+    auto* runtime = static_cast<LuaJsRuntime*>(lua_touserdata(L, lua_upvalueindex(1)));
+    auto* ref = static_cast<JsObjectRef*>(lua_touserdata(L, 1));
+    auto key = ToLuaTableKey(L, 2);
+
+    if (!key) {
+      return luaL_error(L, "JS object keys must be strings or numbers");
+    }
+
+    return CallJs(L, [&] {
+      runtime->NewIndexJsObjectRef(*ref, *key, 3);
+      return 0;
+    });
+  }
+
+  int LenJsObjectRefLuaCb(lua_State* L) {
+    auto* runtime = static_cast<LuaJsRuntime*>(lua_touserdata(L, lua_upvalueindex(1)));
+    auto* ref = static_cast<JsObjectRef*>(lua_touserdata(L, 1));
+
+    return CallJs(L, [&] {
+      lua_pushinteger(L, static_cast<lua_Integer>(runtime->GetJsObjectRefLength(*ref)));
+      return 1;
+    });
+  }
+
+  int PairsJsObjectRefLuaCb(lua_State* L) {
+    auto* runtime = static_cast<LuaJsRuntime*>(lua_touserdata(L, lua_upvalueindex(1)));
+    auto* ref = static_cast<JsObjectRef*>(lua_touserdata(L, 1));
+
+    auto* iterator = static_cast<JsObjectRef::Iterator*>(lua_newuserdata(L, sizeof(JsObjectRef::Iterator)));
+    new (iterator) JsObjectRef::Iterator{};
+    luaL_getmetatable(L, JsObjectRef::IteratorMetaTableName);
+    lua_setmetatable(L, -2);
+
+    return CallJs(L, [&] {
+      runtime->GetJsObjectRefKeys(*ref, iterator->keys, iterator->length);
+
+      // next(runtime, ref, iterator) as upvalues, the generic for arguments are ignored
+      lua_pushlightuserdata(L, runtime);
+      lua_pushvalue(L, 1);
+      lua_pushvalue(L, -3);
+      lua_pushcclosure(L, NextJsObjectRefLuaCb, 3);
+      lua_pushvalue(L, 1);
+      lua_pushnil(L);
+      return 3;
+    });
+  }
+
+  int NextJsObjectRefLuaCb(lua_State* L) {
+    auto* runtime = static_cast<LuaJsRuntime*>(lua_touserdata(L, lua_upvalueindex(1)));
+    auto* ref = static_cast<JsObjectRef*>(lua_touserdata(L, lua_upvalueindex(2)));
+    auto* iterator = static_cast<JsObjectRef::Iterator*>(lua_touserdata(L, lua_upvalueindex(3)));
+
+    return CallJs(L, [&] {
+      if (iterator->length) {
+        if (iterator->position >= iterator->length) {
+          return 0;
+        }
+
+        auto index = static_cast<double>(++iterator->position);
+        lua_pushnumber(L, index);
+        runtime->IndexJsObjectRef(*ref, LuaNumber{index});
+        return 2;
+      }
+
+      if (iterator->position >= iterator->keys.size()) {
+        return 0;
+      }
+
+      const auto& key = iterator->keys[iterator->position++];
+      lua_pushlstring(L, key.data(), key.size());
+      runtime->IndexJsObjectRef(*ref, LuaString{key.data(), key.size(), lua_gettop(L)});
+      return 2;
+    });
+  }
+
+  int CallJsObjectRefLuaCb(lua_State* L) {
+    auto* runtime = static_cast<LuaJsRuntime*>(lua_touserdata(L, lua_upvalueindex(1)));
+    auto* ref = static_cast<JsObjectRef*>(lua_touserdata(L, 1));
+
+    return CallJs(L, [&] { return runtime->CallJsObjectRef(*ref); });
+  }
+
+  int CallJsMethodFromLuaCb(lua_State* L) {
+    auto* runtime = static_cast<LuaJsRuntime*>(lua_touserdata(L, lua_upvalueindex(1)));
+    auto* fn = static_cast<JsObjectRef*>(lua_touserdata(L, lua_upvalueindex(2)));
+
+    return CallJs(L, [&] { return runtime->CallJsObjectRefMethod(*fn); });
+  }
+
+  int GcJsObjectRefLuaCb(lua_State* L) {
+    auto* ref = static_cast<JsObjectRef*>(lua_touserdata(L, 1));
+    if (ref) {
+      for (const auto& [name, method_ref] : ref->methods) {
+        luaL_unref(L, LUA_REGISTRYINDEX, method_ref.value);
+      }
+      ref->~JsObjectRef();
+    }
+    return 0;
+  }
+
+  int GcJsObjectRefIteratorLuaCb(lua_State* L) {
+    auto* iterator = static_cast<JsObjectRef::Iterator*>(lua_touserdata(L, 1));
+    if (iterator) {
+      iterator->~Iterator();
+    }
+    return 0;
+  }
+
+  int CallJsFunctionLuaCb(lua_State* L) {
+    auto* runtime = static_cast<LuaJsRuntime*>(lua_touserdata(L, lua_upvalueindex(1)));
+    auto* holder = static_cast<JsToLuaConverter::JsFunctionHolder*>(lua_touserdata(L, lua_upvalueindex(2)));
+
+    return CallJs(L, [&] { return runtime->InvokeJsFunction(*holder); });
+  }
+
+  int GcJsFunctionFromLuaCb(lua_State* L) {
+    auto* holder = static_cast<JsToLuaConverter::JsFunctionHolder*>(lua_touserdata(L, 1));
     if (holder) {
       holder->~JsFunctionHolder();
     }
     return 0;
   }
 
+  Napi::Error CreateBundleError(const Napi::Env& env, const LuaBundle::Error& error) {
+    auto err = Napi::Error::New(env, error.what());
+
+    switch (error.GetCode()) {
+      case LuaBundle::Error::Code::Io:
+        err.Set("code", "ERR_LUA_BUNDLE_IO");
+        break;
+      case LuaBundle::Error::Code::Invalid:
+        err.Set("code", "ERR_LUA_BUNDLE_INVALID");
+        break;
+      case LuaBundle::Error::Code::Mismatch:
+        err.Set("code", "ERR_LUA_BUNDLE_MISMATCH");
+        break;
+    }
+
+    return err;
+  }
+
+  Napi::Error CreatePackError(const Napi::Env& env, const LuaPack::Error& error) {
+    auto err = Napi::Error::New(env, error.what());
+
+    switch (error.GetCode()) {
+      case LuaPack::Error::Code::Invalid:
+        err.Set("code", "ERR_LUA_PACK_INVALID");
+        break;
+      case LuaPack::Error::Code::TooDeep:
+        err.Set("code", "ERR_LUA_PACK_TOO_DEEP");
+        break;
+    }
+
+    return err;
+  }
+
+  Napi::Error CreateJsonError(const Napi::Env& env, const LuaJson::Error& error) {
+    auto err = Napi::Error::New(env, error.what());
+
+    switch (error.GetCode()) {
+      case LuaJson::Error::Code::Invalid:
+        err.Set("code", "ERR_LUA_JSON_INVALID");
+        break;
+      case LuaJson::Error::Code::Circular:
+        err.Set("code", "ERR_LUA_JSON_CIRCULAR");
+        break;
+      case LuaJson::Error::Code::TooDeep:
+        err.Set("code", "ERR_LUA_JSON_TOO_DEEP");
+        break;
+    }
+
+    return err;
+  }
+
+  Napi::Error CreateMemoryError(const Napi::Env& env) {
+    auto err = Napi::Error::New(env, "Not enough memory in LuaState (memory limit reached)");
+    err.Set("code", "ERR_LUA_MEMORY");
+    return err;
+  }
+
+  // JS property name to a Lua number key, "1" and "2.5" are numbers while "01" or "1e3" stay strings
+  std::optional<double> ParseNumericKey(std::string_view key) {
+    // longer keys are never the JS notation of a number
+    if (key.empty() || key.size() > 32 || !(key[0] == '-' || (key[0] >= '0' && key[0] <= '9'))) {
+      return std::nullopt;
+    }
+
+    double value = LuaJson::ParseNumber(key);
+
+    // like a JS property key, the string is a number only if ToString(ToNumber(key)) gives it back ("1.50" and "1e0" are not)
+    std::string canonical;
+    if (!LuaJson::AppendNumber(canonical, value) || canonical != key) {
+      return std::nullopt;
+    }
+
+    return value;
+  }
+
+  std::string GetNumericKeyName(const Napi::Env& env, double key) {
+    if (key == std::trunc(key) && std::abs(key) < 0x1p53) {
+      return std::to_string(static_cast<int64_t>(key));
+    }
+
+    return Napi::Number::New(env, key).ToString().Utf8Value();
+  }
+
 } // namespace
\ No newline at end of file
@@ -2,18 +2,29 @@
 
 #include <memory>
 #include <napi.h>
+#include <span>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "conversion/js-object-ref.h"
 #include "conversion/js-to-lua-converter.h"
+#include "conversion/lua-signature.h"
 #include "conversion/lua-to-js-converter.h"
+#include "conversion/record-shapes.h"
 #include "core/lua-state-core.h"
 #include "core/lua-visitor-concept.h"
 #include "runtime/lua-config.h"
+#include "runtime/lua-gc-scheduler.h"
 
 class LuaJsRuntime : public std::enable_shared_from_this<LuaJsRuntime> {
 public:
   static constexpr const char* MetaTableName = "meta";
+  // heap growth or shrink reported to V8 at once
+  static constexpr int64_t ExternalMemoryStep = 1024 * 1024;
+  // calls of JS functions with up to this many primitive arguments skip the converter
+  static constexpr int MaxFastCallArgs = 4;
 
   explicit LuaJsRuntime(const LuaConfig& cfg);
   ~LuaJsRuntime();
@@ -21,35 +32,196 @@ public:
   void Close();
   bool IsClosed();
 
+  // Baseline for pooled states, reset drops everything created after SaveBaseline. Both fail only on the memory limit
+  bool SaveBaseline();
+  bool ResetToBaseline();
+  uint64_t GetGeneration() const { return generation_; }
+
+  // Starts LuaGcScheduler if the config asks for idle-time collection
+  void StartGcScheduler(const Napi::Env& env);
+
+  // Garbage collector
+  Napi::Value Gc(const Napi::Env& env, std::string_view action, const Napi::Value& options);
+
   std::string GetLuaVersion();
+  Napi::Value GetMemoryStats(const Napi::Env& env);
 
   // Evaluation
-  Napi::Value EvalFile(const Napi::Env& env, std::string_view path);
-  Napi::Value EvalString(const Napi::Env& env, std::string_view source);
+  Napi::Value EvalFile(const Napi::Env& env, std::string_view path, const LuaBudget& budget = {});
+  Napi::Value EvalString(const Napi::Env& env, std::string_view source, const LuaBudget& budget = {});
+  Napi::Value Compile(const Napi::Env& env, std::string_view source);
+
+  // Bytecode bundles
+  Napi::Value CompileBundle(const Napi::Env& env, const std::string& path, const std::vector<std::pair<std::string, std::string>>& files, bool strip);
+  Napi::Value LoadBundle(const Napi::Env& env, const std::string& path);
 
-  // Global variables
-  Napi::Value GetGlobal(const Napi::Env& env, std::string_view path);
+  // Global variables, lazy overrides LuaConfig::lazy_tables
+  Napi::Value GetGlobal(const Napi::Env& env, std::string_view path, std::optional<bool> lazy = std::nullopt);
   Napi::Value GetLength(const Napi::Env& env, std::string_view path);
 
-  void SetGlobal(std::string_view name, const Napi::Value& value);
+  // by_ref passes an object as JsObjectRef instead of a copy, a signature types the calls of a function
+  void SetGlobal(std::string_view name, const Napi::Value& value, bool by_ref = false, std::shared_ptr<const LuaSignature> signature = nullptr);
+
+  // Packed transfers in the LuaPack format
+  Napi::Value GetGlobalPacked(const Napi::Env& env, std::string_view path);
+  void SetGlobalPacked(const Napi::Env& env, std::string_view name, std::string_view data);
+
+  // JSON text written and parsed in C++, see LuaJson
+  Napi::Value GetGlobalJson(const Napi::Env& env, std::string_view path);
+  void SetGlobalJson(const Napi::Env& env, std::string_view name, std::string_view json);
+
+  // Record shapes, see RecordShapes
+  void DefineShape(const Napi::Env& env, const std::string& name, const std::vector<std::string>& keys);
+
+  // Prepared paths
+  std::vector<LuaRegistryRef> PreparePath(std::string_view path);
+  void ReleasePath(const std::vector<LuaRegistryRef>& segments);
+  Napi::Value GetGlobal(const Napi::Env& env, const std::vector<LuaRegistryRef>& segments);
+  Napi::Value GetLength(const Napi::Env& env, const std::vector<LuaRegistryRef>& segments);
+  bool SetGlobal(const std::vector<LuaRegistryRef>& segments, const Napi::Value& value);
+
+  // Prepared calls, the function at a global path or behind a Lua function proxy is kept in the registry
+  LuaRegistryRef PrepareCall(const Napi::Env& env, const Napi::Value& path_or_fn);
+  void ReleaseCall(const LuaRegistryRef& fn_ref);
+  // numeric arguments and results, missing and nil results are NaN, returns the number of results of the function.
+  // The results array is resolved once the call returns, JS callbacks may detach its buffer in between
+  int CallPrepared(const Napi::Env& env, const LuaRegistryRef& fn_ref, std::span<const double> args, const Napi::Reference<Napi::Float64Array>& results);
 
   // Function management
   Napi::Function CreateJsProxyFunction(const Napi::Env& env, const LuaFunction& lua_fn);
 
-  int InvokeJsFunction(const Napi::FunctionReference& fn_ref);
+  int InvokeJsFunction(const JsToLuaConverter::JsFunctionHolder& holder);
+  // Pushes a JS function as a C closure, which calls it without metamethod dispatch
+  void PushJsFunction(const Napi::Function& fn, std::shared_ptr<const LuaSignature> signature = nullptr);
+  // calls fn with the Lua arguments from first_arg_index to the top of the stack, returns the number of pushed results
+  int CallJsFunction(const Napi::Env& env, const Napi::Function& fn, const Napi::Value& receiver, int first_arg_index);
+
+  // LuaState#ref marks, see JsObjectRef::Marks
+  void MarkJsObjectRef(const Napi::Env& env, const Napi::Object& object) { js_object_ref_marks_.Add(env, object); }
+  bool IsJsObjectRefMarked(const Napi::Value& value) const { return js_object_ref_marks_.Has(value); }
+
+  // Metamethods of JS objects passed by reference, push their results and return the count
+  int IndexJsObjectRef(JsObjectRef& ref, const LuaTableKey& key);
+  void NewIndexJsObjectRef(JsObjectRef& ref, const LuaTableKey& key, int value_index);
+  size_t GetJsObjectRefLength(JsObjectRef& ref);
+  void GetJsObjectRefKeys(JsObjectRef& ref, std::vector<std::string>& keys, uint32_t& length);
+  int CallJsObjectRef(JsObjectRef& ref);
+  // method read through a reference, called with a colon on that reference the first argument is the object itself
+  int CallJsObjectRefMethod(JsObjectRef& fn);
+
+  // Lazy tables, a JS Proxy which reads and writes the Lua table at index on access
+  Napi::Object CreateLazyTable(const Napi::Env& env, int index);
 
 private:
   friend class LuaToJsConverter;
 
+  struct LazyTableCtx {
+    std::weak_ptr<LuaJsRuntime> weak_runtime;
+    const void* identity;
+    LuaRegistryRef ref;
+    uint64_t generation;
+  };
+
+  // wrapped into every Lua function proxy, its methods and prepareCall find the Lua function through it
+  struct LuaFunctionCtx {
+    // tells proxies apart from the other wrapped objects (states, paths, prepared calls)
+    static constexpr napi_type_tag TypeTag = {0x6c75612d73746174, 0x652e666e2e637478};
+
+    std::weak_ptr<LuaJsRuntime> weak_runtime;
+    const void* identity;
+    LuaRegistryRef ref;
+    uint64_t generation;
+
+    // nullptr if the value is not a Lua function proxy
+    static const LuaFunctionCtx* Unwrap(const Napi::Env& env, const Napi::Value& value);
+  };
+
+  struct LazyTableEntry {
+    Napi::ObjectReference proxy;
+    const LazyTableCtx* ctx;
+  };
+
+  LuaConfig config_;
   LuaStateCore core_;
+  RecordShapes shapes_;
   LuaToJsConverter lua_to_js_;
   JsToLuaConverter js_to_lua_;
+  std::unique_ptr<LuaGcScheduler> gc_scheduler_;
+  JsObjectRef::Marks js_object_ref_marks_;
 
   std::unordered_map<const void*, Napi::FunctionReference> lua_fn_proxies_;
+  // withSignature, batch and batchColumns, shared by the function proxies of this runtime
+  Napi::FunctionReference lua_fn_with_signature_;
+  Napi::FunctionReference lua_fn_batch_;
+  Napi::FunctionReference lua_fn_batch_columns_;
+  std::unordered_map<const void*, LazyTableEntry> lazy_tables_;
+  // Proxy constructor and the handler shared by the lazy tables of this runtime
+  Napi::FunctionReference proxy_ctor_;
+  Napi::ObjectReference lazy_table_handler_;
+  // bumped on reset, proxies of an older generation are detached
+  uint64_t generation_ = 0;
+
+  // Lua heap size reported through napi_adjust_external_memory
+  napi_env external_memory_env_ = nullptr;
+  int64_t external_memory_ = 0;
+
+  void ReportExternalMemory(const Napi::Env& env);
+  void ReleaseExternalMemory();
 
   Napi::Value InvokeLuaFunction(const Napi::CallbackInfo& info, const LuaRegistryRef& fn_ref);
-  void FinalizeFunctionProxy(const void* identity, const LuaRegistryRef& ref);
-
+  // Typed calls, see LuaSignature
+  Napi::Function CreateTypedJsProxyFunction(const Napi::Env& env, const LuaRegistryRef& lua_fn_ref, std::shared_ptr<const LuaSignature> signature);
+  Napi::Value InvokeTypedLuaFunction(const Napi::CallbackInfo& info, const LuaRegistryRef& fn_ref, const LuaSignature& signature);
+  int CallTypedJsFunction(const Napi::Env& env, const Napi::Function& fn, const LuaSignature& signature);
+  Napi::Value ToJsArg(const Napi::Env& env, int index);
+  // position is the 1-based argument, 0 for the result
+  Napi::Value ToTypedJsValue(const Napi::Env& env, int index, LuaSignature::Type type, size_t position);
+  void PushTypedValue(const Napi::Value& value, LuaSignature::Type type, size_t position);
+  // Batches, every argument list or row is a call of the Lua function in one native call
+  static constexpr size_t MaxBatchResults = 64;
+  Napi::Value BatchLuaFunction(const Napi::Env& env, const LuaRegistryRef& fn_ref, const Napi::Value& args_list);
+  Napi::Value BatchLuaFunctionColumns(const Napi::Env& env, const LuaRegistryRef& fn_ref, const Napi::Value& columns, const Napi::Value& options);
+  void FinalizeFunctionProxy(const void* identity, const LuaRegistryRef& ref, uint64_t generation);
+  void FinalizeLazyTable(const LazyTableCtx* ctx);
+
+  // Proxy traps, the target is wrapped with its LazyTableCtx
+  static Napi::Value LazyTableGetTrap(const Napi::CallbackInfo& info);
+  static Napi::Value LazyTableHasTrap(const Napi::CallbackInfo& info);
+  static Napi::Value LazyTableSetTrap(const Napi::CallbackInfo& info);
+  static Napi::Value LazyTableDeleteTrap(const Napi::CallbackInfo& info);
+  static Napi::Value LazyTableOwnKeysTrap(const Napi::CallbackInfo& info);
+  static Napi::Value LazyTableDescriptorTrap(const Napi::CallbackInfo& info);
+  // the runtime of a trap call, null if the table belongs to a closed or reset state
+  static std::shared_ptr<LuaJsRuntime> LockLazyTable(const Napi::CallbackInfo& info, const LazyTableCtx*& ctx);
+
+  // Methods of function proxies, this is the proxy wrapped with its LuaFunctionCtx
+  static Napi::Value LuaFunctionWithSignature(const Napi::CallbackInfo& info);
+  static Napi::Value LuaFunctionBatch(const Napi::CallbackInfo& info);
+  static Napi::Value LuaFunctionBatchColumns(const Napi::CallbackInfo& info);
+  // the runtime of a method call, null if the function belongs to a closed or reset state
+  static std::shared_ptr<LuaJsRuntime> LockLuaFunction(const Napi::CallbackInfo& info, const LuaFunctionCtx*& ctx);
+
+  // pushes the field of the table at table_index for a JS property name, returns false if it is nil
+  bool PushLazyTableField(int table_index, const std::string& key);
+  void PushLazyTableKey(int table_index, const std::string& key);
+  Napi::Value ToJsValue(const Napi::Env& env, int index, bool lazy);
+  Napi::Value ToJsObjectRefKey(const Napi::Env& env, const Napi::Object& object, const LuaTableKey& key);
+
+  void LoadString(std::string_view source);
+  Napi::Value BuildGlobalResult(const Napi::Env& env, LuaStateCore::PushValueByPathStatus push_status, bool lazy = false);
+  Napi::Value BuildLengthResult(const Napi::Env& env, LuaStateCore::PushValueByPathStatus push_status);
   Napi::Value CallLuaFunction(const Napi::Env& env, int args_count);
+  Napi::Value BuildCallResult(const Napi::Env& env, int results_count);
+  // a numeric result at index, NaN for nil, position is 1-based
+  double ToNumericResult(const Napi::Env& env, int index, size_t position);
+  // converts the arguments if all of them are nil, booleans, numbers or strings
+  bool ToPrimitiveArgs(const Napi::Env& env, int first_index, int count, napi_value* args);
+  int PushJsCallResult(const Napi::Value& result);
+  LuaStateCore::ExecutionBudget MakeBudget(const Napi::Env& env, const LuaBudget& call_budget);
   Napi::Error ExtractError(const Napi::Env& env);
+  Napi::Error ExtractLuaError(const Napi::Env& env);
+  // runs a protected core operation, its Lua errors throw as JS errors
+  template <typename Fn> auto RunProtected(const Napi::Env& env, Fn&& fn);
+  // drops the value on top of the stack and throws if it took the state past its memory limit
+  void CheckMemoryLimit(const Napi::Env& env);
 };
@@ -0,0 +1,178 @@
+const { afterEach, beforeEach, describe, it } = require('node:test')
+const {
+  deepStrictEqual,
+  notStrictEqual,
+  ok,
+  strictEqual,
+  throws,
+} = require('node:assert/strict')
+const { setImmediate } = require('node:timers/promises')
+const { setFlagsFromString } = require('node:v8')
+const { runInNewContext } = require('node:vm')
+const { LuaError, LuaState, LuaStatePool } = require('../js')
+
+setFlagsFromString('--expose-gc')
+const gc = runInNewContext('gc')
+
+describe(LuaStatePool.name, () => {
+  let pool
+
+  beforeEach(() => {
+    pool = new LuaStatePool({
+      size: 2,
+      prelude: `
+        config = { mode = 'prod', db = { pool = { max = 4 } } }
+        function greet(name) return 'hello ' .. name end
+      `,
+    })
+  })
+
+  afterEach(() => {
+    pool.close()
+  })
+
+  it('should warm states up front', () => {
+    deepStrictEqual(pool.getStats(), { size: 2, idle: 2, borrowed: 0 })
+  })
+
+  it('should lend states with prelude applied', () => {
+    const lua = pool.acquire()
+
+    ok(lua instanceof LuaState, 'is LuaState instance')
+    strictEqual(lua.eval(`return greet('lua')`), 'hello lua')
+    deepStrictEqual(pool.getStats(), { size: 2, idle: 1, borrowed: 1 })
+
+    pool.release(lua)
+  })
+
+  it('should reset globals on release', () => {
+    const lua = pool.acquire()
+    lua.eval(`
+      tenant = 'a'
+      greet = nil
+      config.mode = 'dev'
+      string.custom = function() end
+      setmetatable(_G, { __index = function() return 1 end })
+    `)
+    pool.release(lua)
+
+    const next = pool.acquire()
+    notStrictEqual(next, lua)
+    strictEqual(next.getGlobal('tenant'), null)
+    strictEqual(next.eval(`return greet('again')`), 'hello again')
+    strictEqual(next.getGlobal('config.mode'), 'prod')
+    strictEqual(next.eval(`return string.custom`), undefined)
+    strictEqual(next.eval(`return getmetatable(_G)`), undefined)
+    pool.release(next)
+  })
+
+  it('should reset nested tables on release', () => {
+    const lua = pool.acquire()
+    lua.eval(`
+      config.db.pool.max = 100
+      config.db.pool.min = 1
+      setmetatable(config.db, { __index = function() return 1 end })
+    `)
+    pool.release(lua)
+
+    const next = pool.acquire()
+    deepStrictEqual(next.getGlobal('config.db'), { pool: { max: 4 } })
+    strictEqual(next.eval(`return getmetatable(config.db)`), undefined)
+    pool.release(next)
+  })
+
+  it('should reset loaded modules on release', () => {
+    const lua = pool.acquire()
+    lua.eval(`package.preload.tenant = function() return 1 end; require('tenant')`)
+    pool.release(lua)
+
+    const next = pool.acquire()
+    strictEqual(next.eval(`return package.loaded.tenant`), undefined)
+    strictEqual(next.eval(`return package.preload.tenant`), undefined)
+    pool.release(next)
+  })
+
+  it('should behave as closed after release', () => {
+    const lua = pool.acquire()
+    const greet = lua.getGlobal('greet')
+    pool.release(lua)
+
+    throws(() => lua.eval(`return 1`), /closed/i)
+    strictEqual(greet('stale'), undefined)
+  })
+
+  it('should grow beyond size and drop surplus states', () => {
+    const states = [pool.acquire(), pool.acquire(), pool.acquire()]
+    deepStrictEqual(pool.getStats(), { size: 2, idle: 0, borrowed: 3 })
+
+    for (const lua of states) {
+      pool.release(lua)
+    }
+    deepStrictEqual(pool.getStats(), { size: 2, idle: 2, borrowed: 0 })
+  })
+
+  it('should drop states closed by the borrower', () => {
+    const lua = pool.acquire()
+    lua.close()
+    pool.release(lua)
+
+    deepStrictEqual(pool.getStats(), { size: 2, idle: 1, borrowed: 0 })
+  })
+
+  it('should throws on foreign state', () => {
+    throws(
+      () => pool.release(new LuaState()),
+      (error) => error.code === 'ERR_LUA_STATE_NOT_BORROWED',
+    )
+    throws(() => pool.release({}), TypeError)
+  })
+
+  it('should forget states finalized without release', async () => {
+    pool.acquire()
+
+    for (let i = 0; i < 10 && pool.getStats().borrowed; i++) {
+      gc()
+      await setImmediate()
+    }
+
+    deepStrictEqual(pool.getStats(), { size: 2, idle: 1, borrowed: 0 })
+    throws(
+      () => pool.release(new LuaState()),
+      (error) => error.code === 'ERR_LUA_STATE_NOT_BORROWED',
+    )
+  })
+
+  it('should throws on double release', () => {
+    const lua = pool.acquire()
+    pool.release(lua)
+
+    throws(
+      () => pool.release(lua),
+      (error) => error.code === 'ERR_LUA_STATE_NOT_BORROWED',
+    )
+  })
+
+  it('should throws on acquire after close', () => {
+    pool.close()
+    throws(
+      () => pool.acquire(),
+      (error) => error.code === 'ERR_LUA_STATE_POOL_CLOSED',
+    )
+  })
+
+  describe('with invalid options', () => {
+    it('should throws an LuaError on prelude error', () => {
+      throws(
+        () => new LuaStatePool({ size: 1, prelude: `error('boom')` }),
+        (luaError) => {
+          ok(luaError instanceof LuaError, 'is LuaError instance')
+          return true
+        },
+      )
+    })
+
+    it('should throws on invalid size', () => {
+      throws(() => new LuaStatePool({ size: 0 }), TypeError)
+    })
+  })
+})
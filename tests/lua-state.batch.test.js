@@ -0,0 +1,149 @@
+const { describe, it } = require('node:test')
+const {
+  deepStrictEqual,
+  ok,
+  strictEqual,
+  throws,
+} = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} batch calls`, () => {
+  describe('batch', () => {
+    it('should return the result of every call', () => {
+      const luaState = new LuaState()
+      const fn = luaState.eval(`return function(a, b) return a + (b or 0) end`)
+
+      deepStrictEqual(fn.batch([[1, 2], [3, 4], 5]), [3, 7, 5])
+      deepStrictEqual(fn.batch([]), [])
+    })
+
+    it('should convert table arguments and multiple results', () => {
+      const luaState = new LuaState()
+      const fn = luaState.eval(`
+        return function(record) return record.id, record.points * 2 end
+      `)
+
+      const records = [{ id: 'a', points: 1 }, { id: 'b', points: 2 }]
+
+      deepStrictEqual(
+        fn.batch(records.map((record) => [record])),
+        [
+          ['a', 2],
+          ['b', 4],
+        ],
+      )
+    })
+
+    it('should report the index of a failed call', () => {
+      const luaState = new LuaState()
+      const fn = luaState.eval(`
+        return function(x) if x < 0 then error('negative') end return x end
+      `)
+
+      throws(() => fn.batch([1, 2, -1, 3]), (err) => {
+        strictEqual(err.index, 2)
+        ok(/negative/.test(err.message))
+        return true
+      })
+    })
+
+    it('should reject a non-array argument', () => {
+      const luaState = new LuaState()
+      const fn = luaState.eval(`return function() end`)
+      throws(() => fn.batch(1), TypeError)
+    })
+  })
+
+  describe('batchColumns', () => {
+    it('should return result columns', () => {
+      const luaState = new LuaState()
+      const fn = luaState.eval(`
+        return function(x, v) return x + v, v * 0.5 end
+      `)
+      const columns = [new Float64Array([0, 1, 2]), new Float64Array([2, 4, 6])]
+
+      const [x, v] = fn.batchColumns(columns, { results: 2 })
+      ok(x instanceof Float64Array)
+      deepStrictEqual([...x], [2, 5, 8])
+      deepStrictEqual([...v], [1, 2, 3])
+      deepStrictEqual([...fn.batchColumns(columns)[0]], [2, 5, 8])
+    })
+
+    it('should write NaN for missing and nil results', () => {
+      const luaState = new LuaState()
+      const fn = luaState.eval(`
+        return function(x) if x > 0 then return x end end
+      `)
+      const [result, extra] = fn.batchColumns([new Float64Array([1, -1])], {
+        results: 2,
+      })
+
+      deepStrictEqual([...result], [1, NaN])
+      deepStrictEqual([...extra], [NaN, NaN])
+    })
+
+    it('should reject invalid columns and results', () => {
+      const luaState = new LuaState()
+      const fn = luaState.eval(`return function(x) return tostring(x) end`)
+
+      throws(() => fn.batchColumns([]), TypeError)
+      throws(() => fn.batchColumns([[1, 2]]), TypeError)
+      throws(
+        () => fn.batchColumns([new Float64Array(1), new Float64Array(2)]),
+        RangeError,
+      )
+      throws(() => fn.batchColumns([new Float64Array(1)]), {
+        code: 'ERR_LUA_SIGNATURE_MISMATCH',
+      })
+
+      for (const results of [0, 1.5, 65, 1e9, Infinity, NaN, '2']) {
+        throws(
+          () => fn.batchColumns([new Float64Array(1)], { results }),
+          TypeError,
+        )
+      }
+    })
+
+    it('should fail when a JS callback detaches a column', () => {
+      const luaState = new LuaState()
+      const column = new Float64Array(1024)
+      luaState.setGlobal('detach', () => {
+        structuredClone(column.buffer, { transfer: [column.buffer] })
+      })
+      const fn = luaState.eval(`
+        return function(x) if x == 0 then detach() end return x end
+      `)
+
+      throws(() => fn.batchColumns([column]), RangeError)
+      strictEqual(column.length, 0)
+    })
+  })
+
+  it('should be shared by all Lua functions', () => {
+    const luaState = new LuaState()
+    const a = luaState.eval(`return function() end`)
+    const b = luaState.eval(`return function() end`)
+
+    strictEqual(a.batch, b.batch)
+    strictEqual(luaState.prepareCall(a).call(), 0)
+  })
+
+  it('should reject receivers which are not Lua functions', () => {
+    const luaState = new LuaState()
+    const fn = luaState.eval(`return function() end`)
+    luaState.setGlobal('f', fn)
+
+    for (const receiver of [
+      luaState,
+      luaState.path('f'),
+      luaState.prepareCall('f'),
+      () => {},
+    ]) {
+      const columns = [new Float64Array(1)]
+
+      throws(() => fn.batch.call(receiver, []), TypeError)
+      throws(() => fn.batchColumns.call(receiver, columns), TypeError)
+      throws(() => fn.withSignature.call(receiver, { args: [] }), TypeError)
+    }
+  })
+})
@@ -0,0 +1,69 @@
+const { describe, it } = require('node:test')
+const { deepStrictEqual, ok, strictEqual } = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+const BINARY_LUA = `return string.char(0, 1, 255, 128, 65)`
+const LARGE_SIZE = 256 * 1024
+
+describe(`${LuaState.name} binaryStrings option`, () => {
+  describe('when disabled', () => {
+    it('should replace invalid UTF-8 in strings', () => {
+      const luaState = new LuaState()
+      strictEqual(luaState.eval(BINARY_LUA), '\x00\x01��A')
+    })
+
+    it('should keep large strings readable after close', () => {
+      const luaState = new LuaState()
+      const large = luaState.eval(`return string.rep('abc', ${LARGE_SIZE})`)
+      luaState.close()
+
+      strictEqual(large.length, LARGE_SIZE * 3)
+      strictEqual(large.slice(0, 6), 'abcabc')
+    })
+  })
+
+  describe('when enabled', () => {
+    it('should return byte strings as buffers', () => {
+      const luaState = new LuaState({ binaryStrings: true })
+      const result = luaState.eval(BINARY_LUA)
+
+      ok(Buffer.isBuffer(result))
+      deepStrictEqual([...result], [0, 1, 255, 128, 65])
+    })
+
+    it('should keep valid UTF-8 as strings', () => {
+      const luaState = new LuaState({ binaryStrings: true })
+      strictEqual(luaState.eval(`return 'plain'`), 'plain')
+      strictEqual(luaState.eval(`return 'héllo 😀'`), 'héllo 😀')
+    })
+
+    it('should convert table values but keep keys as strings', () => {
+      const luaState = new LuaState({ binaryStrings: true })
+      const result = luaState.eval(`return { [string.char(200)] = string.char(201), name = 'a' }`)
+
+      strictEqual(result.name, 'a')
+      deepStrictEqual([...result['�']], [201])
+    })
+
+    it('should keep large buffers readable after close', () => {
+      const luaState = new LuaState({ binaryStrings: true })
+      const large = luaState.eval(`return string.rep(string.char(255, 0), ${LARGE_SIZE})`)
+      luaState.close()
+
+      strictEqual(large.length, LARGE_SIZE * 2)
+      strictEqual(large[0], 255)
+      strictEqual(large[large.length - 1], 0)
+    })
+
+    it('should not share buffer memory with the Lua string', () => {
+      const luaState = new LuaState({ binaryStrings: true })
+      luaState.eval(`value = string.rep(string.char(255, 0), ${LARGE_SIZE})`)
+
+      const buffer = luaState.getGlobal('value')
+      buffer[0] = 1
+
+      strictEqual(luaState.eval(`return value:byte(1)`), 255)
+      strictEqual(luaState.getGlobal('value')[0], 255)
+    })
+  })
+})
@@ -0,0 +1,104 @@
+const { describe, it } = require('node:test')
+const { ok, strictEqual, throws } = require('node:assert/strict')
+const { LuaState, LuaError } = require('../js')
+
+const isBudgetError = (code) => (luaError) => {
+  ok(luaError instanceof LuaError, 'is LuaError instance')
+  strictEqual(luaError.code, code)
+  return true
+}
+
+describe(`${LuaState.name} budgets`, () => {
+  describe('per call', () => {
+    const luaState = new LuaState()
+
+    it('should stop endless loop by instructions', () => {
+      throws(
+        () => luaState.eval(`while true do end`, { instructions: 10000 }),
+        isBudgetError('ERR_LUA_BUDGET_EXCEEDED'),
+      )
+    })
+
+    it('should stop endless loop by timeout', () => {
+      throws(
+        () => luaState.eval(`while true do end`, { timeout: 20 }),
+        isBudgetError('ERR_LUA_BUDGET_EXCEEDED'),
+      )
+    })
+
+    it('should not be swallowed by pcall', () => {
+      throws(
+        () =>
+          luaState.eval(`while true do pcall(function() while true do end end) end`, {
+            instructions: 10000,
+          }),
+        isBudgetError('ERR_LUA_BUDGET_EXCEEDED'),
+      )
+    })
+
+    it('should return result within budget', () => {
+      strictEqual(luaState.eval(`local n = 0 for i = 1, 100 do n = n + i end return n`, { instructions: 100000 }), 5050)
+    })
+
+    it('should not keep budget after call', () => {
+      throws(() => luaState.eval(`while true do end`, { instructions: 1000 }), LuaError)
+      strictEqual(luaState.eval(`local n = 0 for i = 1, 100000 do n = n + 1 end return n`), 100000)
+    })
+
+    it('should keep plain errors without code', () => {
+      throws(
+        () => luaState.eval(`error("foo")`, { instructions: 100000 }),
+        (luaError) => luaError instanceof LuaError && luaError.code === undefined,
+      )
+    })
+
+    it('should throws TypeError for invalid options', () => {
+      throws(() => luaState.eval(`return 1`, { instructions: 0 }), TypeError)
+      throws(() => luaState.eval(`return 1`, { timeout: -1 }), TypeError)
+      throws(() => luaState.eval(`return 1`, { signal: 1 }), TypeError)
+    })
+  })
+
+  describe('with AbortSignal', () => {
+    const luaState = new LuaState()
+
+    it('should not run with aborted signal', () => {
+      luaState.setGlobal('counter', 0)
+      throws(
+        () => luaState.eval(`counter = counter + 1`, { signal: AbortSignal.abort() }),
+        isBudgetError('ERR_LUA_ABORTED'),
+      )
+      strictEqual(luaState.getGlobal('counter'), 0)
+    })
+
+    it('should stop when aborted from callback', () => {
+      const controller = new AbortController()
+      luaState.setGlobal('abort', () => controller.abort())
+      throws(
+        () => luaState.eval(`abort() while true do end`, { signal: controller.signal }),
+        isBudgetError('ERR_LUA_ABORTED'),
+      )
+    })
+  })
+
+  describe('per state', () => {
+    const luaState = new LuaState({ budget: { instructions: 10000 }, hookInterval: 100 })
+
+    it('should apply to eval', () => {
+      throws(() => luaState.eval(`while true do end`), isBudgetError('ERR_LUA_BUDGET_EXCEEDED'))
+    })
+
+    it('should apply to function proxies', () => {
+      const spin = luaState.eval(`return function() while true do end end`)
+      throws(() => spin(), isBudgetError('ERR_LUA_BUDGET_EXCEEDED'))
+    })
+
+    it('should be overridden per call', () => {
+      strictEqual(luaState.eval(`local n = 0 for i = 1, 10000 do n = n + 1 end return n`, { instructions: 1e6 }), 10000)
+    })
+
+    it('should throws TypeError for invalid hookInterval', () => {
+      throws(() => new LuaState({ hookInterval: 0 }), TypeError)
+    })
+  })
+})
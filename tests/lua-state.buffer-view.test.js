@@ -0,0 +1,116 @@
+const { describe, it } = require('node:test')
+const { deepStrictEqual, strictEqual, throws } = require('node:assert/strict')
+const { LuaState, LuaError } = require('../js')
+
+describe(`${LuaState.name} buffer views`, () => {
+  const luaState = new LuaState()
+
+  it('should expose Buffer as userdata', () => {
+    luaState.setGlobal('buf', Buffer.from('hello'))
+    strictEqual(luaState.eval(`return type(buf)`), 'userdata')
+    strictEqual(luaState.eval(`return #buf`), 5)
+    strictEqual(luaState.eval(`return buf[1]`), 104)
+  })
+
+  it('should share memory with JS', () => {
+    const buf = Buffer.alloc(4)
+    luaState.setGlobal('buf', buf)
+    luaState.eval(`buf[1] = 65 buf[4] = 300`)
+    deepStrictEqual([...buf], [65, 0, 0, 44])
+
+    buf[2] = 7
+    strictEqual(luaState.eval(`return buf[3]`), 7)
+  })
+
+  it('should respect Buffer offset', () => {
+    const buf = Buffer.from('abcdef').subarray(2, 4)
+    luaState.setGlobal('buf', buf)
+    strictEqual(luaState.eval(`return buf:tostring()`), 'cd')
+  })
+
+  it('should read typed array elements', () => {
+    luaState.setGlobal('arr', new Float64Array([1.5, -2.25]))
+    deepStrictEqual(luaState.eval(`return #arr, arr[1], arr[2]`), [2, 1.5, -2.25])
+
+    luaState.setGlobal('arr', new Int16Array([-1, 300]))
+    deepStrictEqual(luaState.eval(`return arr[1], arr[2]`), [-1, 300])
+  })
+
+  it('should write typed array elements', () => {
+    const arr = new Uint8ClampedArray(2)
+    luaState.setGlobal('arr', arr)
+    luaState.eval(`arr[1] = 300 arr[2] = -5`)
+    deepStrictEqual([...arr], [255, 0])
+  })
+
+  it('should expose ArrayBuffer and DataView as bytes', () => {
+    const ab = new Uint8Array([1, 2, 3]).buffer
+    luaState.setGlobal('ab', ab)
+    luaState.setGlobal('dv', new DataView(ab, 1))
+    deepStrictEqual(luaState.eval(`return #ab, #dv, dv[1]`), [3, 2, 2])
+  })
+
+  it('should copy range with tostring', () => {
+    luaState.setGlobal('buf', Buffer.from('hello world'))
+    deepStrictEqual(luaState.eval(`return buf:tostring(1, 5), buf:tostring(-5), tostring(buf)`), [
+      'hello',
+      'world',
+      'hello world',
+    ])
+  })
+
+  it('should create views with sub', () => {
+    const buf = Buffer.from('hello world')
+    luaState.setGlobal('buf', buf)
+    deepStrictEqual(luaState.eval(`local s = buf:sub(7) s[1] = 87 return #s, s:tostring()`), [5, 'World'])
+    strictEqual(buf.toString(), 'hello World')
+  })
+
+  it('should convert nested buffers', () => {
+    luaState.setGlobal('frame', { payload: Buffer.from([1, 2]) })
+    strictEqual(luaState.eval(`return frame.payload[2]`), 2)
+  })
+
+  it('should throws LuaError for index out of range', () => {
+    luaState.setGlobal('buf', Buffer.alloc(2))
+    throws(() => luaState.eval(`return buf[3]`), LuaError)
+    throws(() => luaState.eval(`buf[0] = 1`), LuaError)
+  })
+
+  it('should throws LuaError once the buffer is detached', () => {
+    const arr = new Float64Array([1, 2])
+    luaState.setGlobal('arr', arr)
+    luaState.eval(`sub = arr:sub(2)`)
+
+    structuredClone(arr.buffer, { transfer: [arr.buffer] })
+
+    strictEqual(luaState.eval(`return #arr`), 0)
+    throws(() => luaState.eval(`return arr[1]`), /detached/)
+    throws(() => luaState.eval(`arr[1] = 3`), /detached/)
+    throws(() => luaState.eval(`return sub[1]`), /detached/)
+  })
+
+  it('should follow resized buffers', { skip: typeof ArrayBuffer.prototype.resize !== 'function' }, () => {
+    const ab = new ArrayBuffer(4, { maxByteLength: 8 })
+    luaState.setGlobal('bytes', new Uint8Array(ab))
+    luaState.eval(`head = bytes:sub(1, 2) tail = bytes:sub(3, 4)`)
+
+    ab.resize(8)
+    strictEqual(luaState.eval(`bytes[8] = 1 return #bytes`), 8)
+
+    ab.resize(2)
+    deepStrictEqual(luaState.eval(`return #bytes, #head`), [2, 2])
+    throws(() => luaState.eval(`return tail[1]`), /out of bounds/)
+  })
+
+  it('should store NaN and out of range numbers like JS', () => {
+    const ints = new Int32Array(4)
+    const bigs = new BigUint64Array(1)
+    luaState.setGlobal('ints', ints)
+    luaState.setGlobal('bigs', bigs)
+    luaState.eval(`ints[1] = 0/0 ints[2] = 1/0 ints[3] = 2^32 + 5 ints[4] = -1e300 bigs[1] = -1`)
+
+    deepStrictEqual([...ints], [0, 0, 5, 0])
+    strictEqual(bigs[0], 2n ** 64n - 1n)
+  })
+})
@@ -0,0 +1,74 @@
+const { beforeEach, describe, it } = require('node:test')
+const { ok, strictEqual, throws } = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} chunk cache`, () => {
+  beforeEach(() => {
+    LuaState.configureChunkCache({
+      maxBytes: 32 * 1024 * 1024,
+      maxEntries: 1024,
+    })
+    LuaState.clearChunkCache()
+  })
+
+  it('should reuse compiled chunk between states', () => {
+    const code = `return 'cached-' .. 1`
+
+    strictEqual(new LuaState().eval(code), 'cached-1')
+    strictEqual(new LuaState().eval(code), 'cached-1')
+
+    const stats = LuaState.getChunkCacheStats()
+    strictEqual(stats.misses, 1)
+    strictEqual(stats.hits, 1)
+    strictEqual(stats.entries, 1)
+    ok(stats.bytes > code.length, 'bytes include bytecode')
+  })
+
+  it('should keep error locations for cached chunks', () => {
+    const luaState = new LuaState()
+    const code = `local x = nil\nreturn x.y`
+
+    throws(() => luaState.eval(code), /:2:/)
+    throws(() => luaState.eval(code), /:2:/)
+  })
+
+  it('should evict least recently used entries', () => {
+    LuaState.configureChunkCache({ maxEntries: 2 })
+    const luaState = new LuaState()
+
+    luaState.eval(`return 1`)
+    luaState.eval(`return 2`)
+    luaState.eval(`return 1`)
+    luaState.eval(`return 3`)
+
+    const stats = LuaState.getChunkCacheStats()
+    strictEqual(stats.entries, 2)
+    strictEqual(stats.evictions, 1)
+
+    luaState.eval(`return 1`)
+    strictEqual(LuaState.getChunkCacheStats().hits, 2)
+  })
+
+  it('should clear entries and counters', () => {
+    new LuaState().eval(`return 1`)
+    LuaState.clearChunkCache()
+
+    const stats = LuaState.getChunkCacheStats()
+    strictEqual(stats.entries, 0)
+    strictEqual(stats.bytes, 0)
+    strictEqual(stats.misses, 0)
+  })
+
+  it('should bypass cache when disabled', () => {
+    new LuaState({ chunkCache: false }).eval(`return 1`)
+
+    const stats = LuaState.getChunkCacheStats()
+    strictEqual(stats.entries, 0)
+    strictEqual(stats.misses, 0)
+  })
+
+  it('should throws on invalid options', () => {
+    throws(() => LuaState.configureChunkCache(), TypeError)
+    throws(() => LuaState.configureChunkCache({ maxBytes: -1 }), TypeError)
+  })
+})
@@ -32,6 +32,18 @@ describe(`${LuaState.name}#${LuaState.prototype.close.name}`, () => {
       })
     })
 
+    describe('on compile', () => {
+      it('should throw error', () => {
+        throws(() => luaState.compile(`return 1`), /closed/i)
+      })
+    })
+
+    describe('on compileBundle', () => {
+      it('should throw error', () => {
+        throws(() => luaState.compileBundle('out.luab', []), /closed/i)
+      })
+    })
+
     describe('on eval', () => {
       it('should throw error', () => {
         throws(() => luaState.eval(`foo = 1`), /closed/i)
@@ -50,12 +62,36 @@ describe(`${LuaState.name}#${LuaState.prototype.close.name}`, () => {
       })
     })
 
+    describe('on gc', () => {
+      it('should throw error', () => {
+        throws(() => luaState.gc('collect'), /closed/i)
+      })
+    })
+
+    describe('on getMemoryStats', () => {
+      it('should throw error', () => {
+        throws(() => luaState.getMemoryStats(), /closed/i)
+      })
+    })
+
     describe('on getVersion', () => {
       it('should throw error', () => {
         throws(() => luaState.getVersion(), /closed/i)
       })
     })
 
+    describe('on loadBundle', () => {
+      it('should throw error', () => {
+        throws(() => luaState.loadBundle('app.luab'), /closed/i)
+      })
+    })
+
+    describe('on path', () => {
+      it('should throw error', () => {
+        throws(() => luaState.path('foo'), /closed/i)
+      })
+    })
+
     describe('on setGlobal', () => {
       it('should throw error', () => {
         throws(() => luaState.setGlobal('foo', 'bar'), /closed/i)
@@ -0,0 +1,52 @@
+const { beforeEach, describe, it } = require('node:test')
+const { ok, strictEqual, throws } = require('node:assert/strict')
+const { LuaState, LuaError } = require('../js')
+
+describe(`${LuaState.name}#${LuaState.prototype.compile.name}`, () => {
+  let luaState
+
+  beforeEach(() => {
+    luaState = new LuaState()
+  })
+
+  it('should returns a function', () => {
+    strictEqual(typeof luaState.compile(`return 1`), 'function')
+  })
+
+  it('should not run the chunk on compile', () => {
+    luaState.compile(`foo = 'bar'`)
+    strictEqual(luaState.getGlobal('foo'), undefined)
+  })
+
+  it('should pass arguments as varargs', () => {
+    const add = luaState.compile(`local a, b = ... return a + b`)
+    strictEqual(add(1, 2), 3)
+    strictEqual(add(40, 2), 42)
+  })
+
+  it('should share globals with the state', () => {
+    const inc = luaState.compile(`counter = (counter or 0) + 1 return counter`)
+    inc()
+    inc()
+    strictEqual(luaState.getGlobal('counter'), 2)
+  })
+
+  it('should throws an LuaError on syntax error', () => {
+    throws(
+      () => luaState.compile(`return +`),
+      (luaError) => {
+        ok(luaError instanceof LuaError, 'is LuaError instance')
+        return true
+      },
+    )
+  })
+
+  it('should throws an LuaError on runtime error', () => {
+    const fn = luaState.compile(`error('boom')`)
+    throws(() => fn(), /boom/)
+  })
+
+  it('should throws on non-string argument', () => {
+    throws(() => luaState.compile(1), TypeError)
+  })
+})
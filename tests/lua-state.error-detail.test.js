@@ -0,0 +1,114 @@
+const { describe, it } = require('node:test')
+const { deepStrictEqual, match, ok, strictEqual, throws } = require('node:assert/strict')
+const { LuaState, LuaError } = require('../js')
+
+describe(`${LuaState.name} errorDetail option`, () => {
+  it('should throws TypeError for unknown level', () => {
+    throws(() => new LuaState({ errorDetail: 'all' }), TypeError)
+  })
+
+  describe('with "full"', () => {
+    const luaState = new LuaState({ errorDetail: 'full' })
+
+    it('should format stack from current message', () => {
+      throws(
+        () => luaState.eval(`error("foo")`),
+        (luaError) => {
+          ok(luaError instanceof LuaError, 'is LuaError instance')
+          match(luaError.stack, /^LuaError: .*foo\n {4}stack traceback:/)
+          luaError.message = 'bar'
+          match(luaError.stack, /^LuaError: bar\n/)
+          return true
+        },
+      )
+    })
+
+    it('should allow to overwrite stack', () => {
+      throws(
+        () => luaState.eval(`error("foo")`),
+        (luaError) => {
+          luaError.stack = 'custom'
+          strictEqual(luaError.stack, 'custom')
+          return true
+        },
+      )
+    })
+
+    // path lookups with a memory limit run without the traceback handler
+    it('should keep error tables shaped like a traceback as cause', { skip: new LuaState().getMemoryStats() === null }, () => {
+      const limited = new LuaState({ errorDetail: 'full', memoryLimit: 1e7 })
+      limited.eval(`
+        t = setmetatable({}, {
+          __index = function() error({ message = "spoof", stack = "fake" }) end,
+        })
+      `)
+
+      throws(
+        () => limited.getGlobal('t.x'),
+        (luaError) => {
+          ok(luaError instanceof LuaError, 'is LuaError instance')
+          deepStrictEqual(luaError.cause, { message: 'spoof', stack: 'fake' })
+          ok(!luaError.stack.includes('fake'), 'stack is not taken from the table')
+          return true
+        },
+      )
+    })
+  })
+
+  describe('with "message"', () => {
+    const luaState = new LuaState({ errorDetail: 'message' })
+
+    it('should keep message without stack', () => {
+      throws(
+        () => luaState.eval(`error("foo")`),
+        (luaError) => {
+          ok(luaError instanceof LuaError, 'is LuaError instance')
+          match(luaError.message, /foo/)
+          strictEqual(luaError.stack, undefined)
+          return true
+        },
+      )
+    })
+
+    it('should keep table cause', () => {
+      throws(
+        () => luaState.eval(`error({ foo = "bar" })`),
+        (luaError) => {
+          strictEqual(luaError.message, '')
+          deepStrictEqual(luaError.cause, { foo: 'bar' })
+          return true
+        },
+      )
+    })
+
+    it('should convert non-string values to message', () => {
+      throws(() => luaState.eval(`error(42)`), { message: '42' })
+      throws(() => luaState.eval(`error(true)`), { message: 'true' })
+      throws(() => luaState.eval(`error()`), { message: '' })
+    })
+  })
+
+  describe('with "none"', () => {
+    const luaState = new LuaState({ errorDetail: 'none' })
+
+    it('should throws an empty LuaError', () => {
+      throws(
+        () => luaState.eval(`error({ foo = "bar" })`),
+        (luaError) => {
+          ok(luaError instanceof LuaError, 'is LuaError instance')
+          strictEqual(luaError.message, '')
+          strictEqual(luaError.cause, undefined)
+          strictEqual(luaError.stack, undefined)
+          return true
+        },
+      )
+    })
+
+    it('should keep the state usable', () => {
+      for (let i = 0; i < 100; i++) {
+        throws(() => luaState.eval(`error("foo")`), LuaError)
+      }
+      strictEqual(luaState.eval(`return 1`), 1)
+    })
+  })
+})
@@ -0,0 +1,46 @@
+const { describe, it } = require('node:test')
+const { ok } = require('node:assert/strict')
+const { setImmediate } = require('node:timers/promises')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} external memory`, () => {
+  it('should report the Lua heap to V8 until close', () => {
+    const chunkSize = 16 * 1024 * 1024
+    const luaState = new LuaState()
+    const before = process.memoryUsage().external
+
+    luaState.eval(`data = string.rep('x', ${chunkSize})`)
+    const allocated = process.memoryUsage().external
+    ok(allocated - before >= chunkSize / 2, 'external memory rises')
+
+    luaState.close()
+    ok(
+      allocated - process.memoryUsage().external >= chunkSize / 2,
+      'external memory falls',
+    )
+  })
+
+  // slow and sensitive to GC timing, run with `npm run test:stress`
+  it(
+    'should keep RSS bounded for unreachable states',
+    { skip: !process.env.LUA_STATE_STRESS && 'set LUA_STATE_STRESS=1' },
+    async () => {
+      const chunkSize = 8 * 1024 * 1024
+      const iterations = 200
+      const baseline = process.memoryUsage().rss
+
+      for (let i = 0; i < iterations; i++) {
+        // never closed, the Lua heap is freed only when V8 collects the wrapper
+        const luaState = new LuaState()
+        luaState.eval(`data = string.rep('x', ${chunkSize})`)
+        await setImmediate()
+      }
+
+      const growth = process.memoryUsage().rss - baseline
+      ok(
+        growth < (chunkSize * iterations) / 2,
+        `RSS grew by ${Math.round(growth / 1024 / 1024)} MB`,
+      )
+    },
+  )
+})
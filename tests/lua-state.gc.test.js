@@ -0,0 +1,96 @@
+const { describe, it } = require('node:test')
+const { ok, strictEqual, throws } = require('node:assert/strict')
+const { setImmediate } = require('node:timers/promises')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name}#${LuaState.prototype.gc.name}`, () => {
+  it('should return heap size in bytes', () => {
+    const luaState = new LuaState()
+    const count = luaState.gc('count')
+    ok(Number.isInteger(count) && count > 0)
+  })
+
+  it('should collect garbage', () => {
+    const luaState = new LuaState()
+    luaState.eval(`local t = {} for i = 1, 10000 do t[i] = { i } end`)
+    const before = luaState.gc('count')
+    luaState.gc('collect')
+    ok(luaState.gc('count') < before)
+  })
+
+  it('should stop and restart collector', () => {
+    const luaState = new LuaState()
+    luaState.gc('stop')
+    strictEqual(luaState.gc('isRunning'), false)
+    luaState.gc('restart')
+    strictEqual(luaState.gc('isRunning'), true)
+  })
+
+  it('should finish cycle with steps', () => {
+    const luaState = new LuaState()
+    luaState.gc('stop')
+    let finished = false
+    for (let i = 0; i < 1000 && !finished; i++) {
+      finished = luaState.gc('step', { size: 64 })
+    }
+    strictEqual(finished, true)
+  })
+
+  it('should switch to incremental mode', () => {
+    const luaState = new LuaState()
+    strictEqual(luaState.gc('incremental', { pause: 150, stepMul: 200 }), undefined)
+  })
+
+  it('should switch to generational mode or throws unsupported error', () => {
+    const luaState = new LuaState()
+    try {
+      strictEqual(luaState.gc('generational'), undefined)
+    } catch (err) {
+      strictEqual(err.code, 'ERR_LUA_GC_UNSUPPORTED')
+    }
+  })
+
+  it('should throws TypeError for unknown action', () => {
+    const luaState = new LuaState()
+    throws(() => luaState.gc('compact'), TypeError)
+    throws(() => luaState.gc(), TypeError)
+  })
+
+  describe('with idleGc option', () => {
+    it('should keep automatic collector as a backstop', () => {
+      const luaState = new LuaState({ idleGc: true })
+      strictEqual(luaState.gc('isRunning'), true)
+
+      luaState.eval(`for i = 1, 1000000 do local t = { i } end`)
+      ok(luaState.gc('count') < 16 * 1024 * 1024)
+    })
+
+    it('should collect between event loop iterations', async () => {
+      const luaState = new LuaState({ idleGc: { stepSize: 1024 } })
+      luaState.eval(`local t = {} for i = 1, 10000 do t[i] = { i } end`)
+      const before = luaState.gc('count')
+
+      for (let i = 0; i < 100; i++) {
+        await setImmediate()
+      }
+
+      ok(luaState.gc('count') < before)
+      luaState.close()
+    })
+
+    it('should not collect after stop', async () => {
+      const luaState = new LuaState({ idleGc: { stepSize: 1024 } })
+      luaState.gc('stop')
+      luaState.eval(`local t = {} for i = 1, 10000 do t[i] = { i } end`)
+      const before = luaState.gc('count')
+
+      for (let i = 0; i < 100; i++) {
+        await setImmediate()
+      }
+
+      strictEqual(luaState.gc('isRunning'), false)
+      strictEqual(luaState.gc('count'), before)
+      luaState.close()
+    })
+  })
+})
@@ -151,6 +151,60 @@ describe(`${LuaState.name}#${LuaState.prototype.getGlobal.name}`, () => {
         strictEqual(tbl, tbl.next.root)
       })
     })
+
+    describe('with wide table', () => {
+      beforeEach(() => {
+        luaState.eval(`
+          tbl = {}
+          for i = 1, 10000 do tbl['k' .. i] = { id = i, shared = tbl } end
+        `)
+      })
+
+      it('should get every nested table', () => {
+        const tbl = luaState.getGlobal('tbl')
+        strictEqual(Object.keys(tbl).length, 10000)
+        strictEqual(tbl.k1.id, 1)
+        strictEqual(tbl.k10000.id, 10000)
+        strictEqual(tbl.k5000.shared, tbl)
+      })
+
+      it('should not leak registry references', () => {
+        const countRefs = `
+          local count = 0
+          for _ in pairs(debug.getregistry()) do count = count + 1 end
+          return count
+        `
+        luaState.getGlobal('tbl')
+        const before = luaState.eval(countRefs)
+        luaState.getGlobal('tbl')
+        luaState.getGlobal('tbl')
+        strictEqual(luaState.eval(countRefs), before)
+      })
+    })
+
+    describe('with mixed keys', () => {
+      beforeEach(() => {
+        luaState.eval(`tbl = { [1] = 'one', [2.5] = 'half', name = 'name', __proto__ = 'proto' }`)
+      })
+
+      it('should define plain data properties', () => {
+        const tbl = luaState.getGlobal('tbl')
+        deepStrictEqual(Object.getOwnPropertyDescriptor(tbl, 'name'), {
+          value: 'name',
+          writable: true,
+          enumerable: true,
+          configurable: true,
+        })
+        strictEqual(tbl[1], 'one')
+        strictEqual(tbl['2.5'], 'half')
+      })
+
+      it('should keep __proto__ as own property', () => {
+        const tbl = luaState.getGlobal('tbl')
+        strictEqual(Object.getPrototypeOf(tbl), Object.prototype)
+        strictEqual(Object.getOwnPropertyDescriptor(tbl, '__proto__').value, 'proto')
+      })
+    })
   })
 
   describe('of array', () => {
@@ -0,0 +1,129 @@
+const { beforeEach, describe, it } = require('node:test')
+const {
+  deepStrictEqual,
+  doesNotThrow,
+  ok,
+  strictEqual,
+  throws,
+} = require('node:assert/strict')
+const { LuaState, LuaError } = require('../js')
+
+describe(`${LuaState.name}#${LuaState.prototype.getMemoryStats.name}`, () => {
+  describe('with default allocator', () => {
+    let luaState
+
+    beforeEach(() => {
+      luaState = new LuaState()
+    })
+
+    it('should returns live and peak bytes', () => {
+      const stats = luaState.getMemoryStats()
+
+      strictEqual(stats.allocator, 'system')
+      strictEqual(stats.limit, null)
+      ok(stats.used > 0, 'used is positive')
+      ok(stats.peak >= stats.used, 'peak is not less than used')
+      ok(stats.allocations > 0, 'allocations is positive')
+    })
+
+    it('should track heap growth', () => {
+      const before = luaState.getMemoryStats().used
+      luaState.eval(`
+        tbl = {}
+        for i = 1, 10000 do tbl[i] = { i } end
+      `)
+      ok(luaState.getMemoryStats().used > before)
+    })
+  })
+
+  describe('with pool allocator', () => {
+    let luaState
+
+    beforeEach(() => {
+      luaState = new LuaState({ allocator: 'pool' })
+    })
+
+    it('should returns allocations by size class', () => {
+      const stats = luaState.getMemoryStats()
+
+      strictEqual(stats.allocator, 'pool')
+      deepStrictEqual(
+        stats.sizeClasses.map(({ size }) => size),
+        Array.from({ length: 16 }, (_, i) => (i + 1) * 16),
+      )
+      ok(stats.sizeClasses.some(({ live }) => live > 0))
+    })
+
+    it('should evaluate code', () => {
+      luaState.eval(`
+        tbl = {}
+        for i = 1, 1000 do tbl[i] = 'item' .. i end
+      `)
+      strictEqual(luaState.getLength('tbl'), 1000)
+      strictEqual(luaState.eval('return tbl[1000]'), 'item1000')
+    })
+  })
+
+  describe('with memory limit', () => {
+    let luaState
+
+    beforeEach(() => {
+      luaState = new LuaState({ memoryLimit: 4 * 1024 * 1024 })
+    })
+
+    it('should returns limit', () => {
+      strictEqual(luaState.getMemoryStats().limit, 4 * 1024 * 1024)
+    })
+
+    it('should throws an LuaError when limit is exceeded', () => {
+      throws(
+        () => luaState.eval(`return string.rep('x', 8 * 1024 * 1024)`),
+        (luaError) => {
+          ok(luaError instanceof LuaError, 'is LuaError instance')
+          return true
+        },
+      )
+      ok(luaState.getMemoryStats().used <= 4 * 1024 * 1024)
+    })
+
+    it('should stay usable after limit is exceeded', () => {
+      throws(() => luaState.eval(`return string.rep('x', 8 * 1024 * 1024)`))
+      doesNotThrow(() => luaState.eval(`return 1`))
+      strictEqual(luaState.eval(`return 1 + 1`), 2)
+    })
+
+    it('should throws ERR_LUA_MEMORY when setGlobal exceeds the limit', () => {
+      const items = Array.from({ length: 100_000 }, (_, i) => ({
+        i,
+        name: `item${i}`,
+      }))
+
+      throws(() => luaState.setGlobal('items', items), {
+        code: 'ERR_LUA_MEMORY',
+      })
+      throws(() => luaState.setGlobal('str', 'x'.repeat(8 * 1024 * 1024)), {
+        code: 'ERR_LUA_MEMORY',
+      })
+      strictEqual(luaState.getGlobal('items'), null)
+      ok(luaState.getMemoryStats().used <= 4 * 1024 * 1024)
+      strictEqual(luaState.eval(`return 1 + 1`), 2)
+    })
+
+    it('should raise a Lua error when a JS function result exceeds the limit', () => {
+      luaState.setGlobal('make', () => 'x'.repeat(8 * 1024 * 1024))
+
+      throws(() => luaState.eval(`return make()`), /not enough memory/)
+      strictEqual(luaState.eval(`return 1 + 1`), 2)
+    })
+  })
+
+  describe('with invalid options', () => {
+    it('should throws on unknown allocator', () => {
+      throws(() => new LuaState({ allocator: 'foo' }), TypeError)
+    })
+
+    it('should throws on negative memory limit', () => {
+      throws(() => new LuaState({ memoryLimit: -1 }), TypeError)
+    })
+  })
+})
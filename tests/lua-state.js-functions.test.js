@@ -0,0 +1,68 @@
+const { describe, it } = require('node:test')
+const { deepStrictEqual, strictEqual, throws } = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} JS functions in Lua`, () => {
+  it('should be Lua functions', () => {
+    const luaState = new LuaState()
+    luaState.setGlobal('fn', () => {})
+    strictEqual(luaState.eval(`return type(fn)`), 'function')
+  })
+
+  it('should pass primitive arguments', () => {
+    const luaState = new LuaState()
+    const calls = []
+    luaState.setGlobal('fn', (...args) => {
+      calls.push(args)
+      return args.length
+    })
+
+    strictEqual(luaState.eval(`return fn()`), 0)
+    strictEqual(luaState.eval(`return fn(1, 'héllo', true, nil)`), 4)
+    deepStrictEqual(calls, [[], [1, 'héllo', true, null]])
+  })
+
+  it('should pass more and non-primitive arguments', () => {
+    const luaState = new LuaState()
+    luaState.setGlobal('fn', (...args) => args)
+
+    deepStrictEqual(luaState.eval(`return fn(1, 2, 3, 4, 5)`), [1, 2, 3, 4, 5])
+    deepStrictEqual(luaState.eval(`return { fn('a', { x = 1 }) }`), {
+      1: 'a',
+      2: { x: 1 },
+    })
+  })
+
+  it('should return primitives and multiple values', () => {
+    const luaState = new LuaState()
+    luaState.setGlobal('inc', (x) => x + 1)
+    luaState.setGlobal('pair', (x) => [x, `${x}!`])
+    luaState.setGlobal('none', () => undefined)
+
+    strictEqual(luaState.eval(`return inc(41)`), 42)
+    deepStrictEqual(luaState.eval(`return { pair('a') }`), { 1: 'a', 2: 'a!' })
+    strictEqual(luaState.eval(`return select('#', none())`), 0)
+  })
+
+  it('should convert back to the same JS function', () => {
+    const luaState = new LuaState()
+    const fn = () => 1
+    luaState.setGlobal('fn', fn)
+
+    strictEqual(luaState.getGlobal('fn'), fn)
+    strictEqual(luaState.eval(`return fn`), fn)
+  })
+
+  it('should raise JS errors in Lua', () => {
+    const luaState = new LuaState()
+    luaState.setGlobal('fail', () => {
+      throw new Error('boom')
+    })
+
+    strictEqual(
+      luaState.eval(`local ok, err = pcall(fail, 1) return ok`),
+      false,
+    )
+    throws(() => luaState.eval(`fail('x')`), /boom/)
+  })
+})
@@ -0,0 +1,195 @@
+const { describe, it } = require('node:test')
+const { deepStrictEqual, ok, strictEqual, throws } = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} JSON`, () => {
+  describe('getGlobalJSON', () => {
+    it('should write tables like JSON.stringify of getGlobal', () => {
+      const luaState = new LuaState()
+      luaState.eval(`
+        value = {
+          name = 'a "quoted" name\\n',
+          n = 1.5,
+          big = 2^60,
+          small = 1e-7,
+          flag = true,
+          nested = { [1] = 'x', [2.5] = 'y' },
+          empty = {},
+        }
+      `)
+
+      const json = luaState.getGlobalJSON('value')
+      deepStrictEqual(JSON.parse(json), luaState.getGlobal('value'))
+    })
+
+    it('should write sequences as arrays with sequenceArrays', () => {
+      const luaState = new LuaState({ sequenceArrays: true })
+      luaState.eval(`value = { 'a', 'b', { 1, 2 }, function() end }`)
+      strictEqual(luaState.getGlobalJSON('value'), '["a","b",[1,2],null]')
+    })
+
+    it('should write tables with other keys as objects with sequenceArrays', () => {
+      const luaState = new LuaState({ sequenceArrays: true })
+      luaState.eval(`
+        mixed = { 1, 2, n = 2 }
+        holes = { 1, nil, 3 }
+        functions = { print, 'b', x = 1 }
+        shuffled = { [1] = 'a', [2] = 'b', [3] = 'c', [4] = 'd' }
+      `)
+      deepStrictEqual(JSON.parse(luaState.getGlobalJSON('mixed')), { 1: 1, 2: 2, n: 2 })
+      deepStrictEqual(JSON.parse(luaState.getGlobalJSON('holes')), { 1: 1, 3: 3 })
+      deepStrictEqual(JSON.parse(luaState.getGlobalJSON('functions')), { 2: 'b', x: 1 })
+      strictEqual(luaState.getGlobalJSON('shuffled'), '["a","b","c","d"]')
+    })
+
+    it('should leave out functions and write null for NaN', () => {
+      const luaState = new LuaState()
+      luaState.eval(`value = { f = print, nan = 0/0, inf = math.huge }`)
+      deepStrictEqual(JSON.parse(luaState.getGlobalJSON('value')), {
+        nan: null,
+        inf: null,
+      })
+      strictEqual(luaState.getGlobalJSON('print'), undefined)
+    })
+
+    it('should escape strings and replace invalid UTF-8', () => {
+      const luaState = new LuaState()
+      luaState.eval(`value = 'tab\\there "q" \\\\ \\1 héllo \\255 end of a longer string'`)
+      strictEqual(
+        luaState.getGlobalJSON('value'),
+        '"tab\\there \\"q\\" \\\\ \\u0001 héllo � end of a longer string"',
+      )
+    })
+
+    it('should write primitives and numbers like JS', () => {
+      const luaState = new LuaState()
+      for (const value of [0, -1, 0.1, 1e21, 5e-324, 123456789012345680]) {
+        luaState.setGlobal('value', value)
+        strictEqual(luaState.getGlobalJSON('value'), JSON.stringify(value))
+      }
+    })
+
+    it('should write integers above 2^53 with the shortest digits like JS', () => {
+      const luaState = new LuaState()
+      luaState.eval('big = 2^60; keys = { [2^60] = true }')
+
+      strictEqual(luaState.getGlobalJSON('big'), '1152921504606847000')
+      strictEqual(
+        luaState.getGlobalJSON('keys'),
+        '{"1152921504606847000":true}',
+      )
+      for (const value of [2 ** 60, -(2 ** 64), 1e20 + 2 ** 20]) {
+        luaState.setGlobal('value', value)
+        strictEqual(luaState.getGlobalJSON('value'), JSON.stringify(value))
+      }
+    })
+
+    it('should write shared tables but reject cycles', () => {
+      const luaState = new LuaState()
+      luaState.eval(`
+        shared = { id = 1 }
+        value = { a = shared, b = shared }
+        cyclic = {}
+        cyclic.self = cyclic
+      `)
+
+      deepStrictEqual(JSON.parse(luaState.getGlobalJSON('value')), {
+        a: { id: 1 },
+        b: { id: 1 },
+      })
+      throws(() => luaState.getGlobalJSON('cyclic'), {
+        code: 'ERR_LUA_JSON_CIRCULAR',
+      })
+    })
+
+    it('should return null for missing globals', () => {
+      const luaState = new LuaState()
+      strictEqual(luaState.getGlobalJSON('missing'), null)
+      strictEqual(luaState.getGlobalJSON('missing.field'), undefined)
+    })
+  })
+
+  describe('setGlobalJSON', () => {
+    it('should parse into Lua tables', () => {
+      const luaState = new LuaState()
+      luaState.setGlobalJSON(
+        'value',
+        '{"users":[{"id":1,"name":"ann"},{"id":2,"name":"b\\u00f6b \\ud83d\\ude00"}],"ok":true,"none":null}',
+      )
+
+      strictEqual(luaState.eval(`return #value.users`), 2)
+      strictEqual(luaState.eval(`return value.users[2].name`), 'böb 😀')
+      ok(luaState.eval(`return value.ok == true and value.none == nil`))
+    })
+
+    it('should accept UTF-8 bytes', () => {
+      const luaState = new LuaState()
+      luaState.setGlobalJSON('value', Buffer.from('[1.5, -2e3, "é"]'))
+      deepStrictEqual(luaState.getGlobal('value'), {
+        1: 1.5,
+        2: -2000,
+        3: 'é',
+      })
+    })
+
+    it('should parse numbers like JSON.parse', () => {
+      const luaState = new LuaState()
+      const numbers = [
+        '0.1',
+        '-2.5E+3',
+        '1e400',
+        '-1e400',
+        '1e-400',
+        '123456789012345678901234567890',
+        `0.${'1'.repeat(100)}`,
+      ]
+
+      luaState.setGlobalJSON('value', `[${numbers.join(',')}]`)
+      deepStrictEqual(
+        Object.values(luaState.getGlobal('value')),
+        numbers.map((number) => JSON.parse(number)),
+      )
+    })
+
+    it('should round trip through Lua', () => {
+      const luaState = new LuaState({ sequenceArrays: true })
+      const value = { a: [1, 2, 3], b: { c: 'd', e: [] }, f: 'x\ny' }
+      luaState.setGlobalJSON('value', JSON.stringify(value))
+      deepStrictEqual(JSON.parse(luaState.getGlobalJSON('value')), {
+        ...value,
+        b: { c: 'd', e: {} },
+      })
+    })
+
+    it('should reject malformed JSON', () => {
+      const luaState = new LuaState()
+      const invalid = ['', '{', '[1,]', '{"a" 1}', '01', '"a', 'nul', '1 2']
+
+      for (const json of invalid) {
+        throws(() => luaState.setGlobalJSON('value', json), {
+          code: 'ERR_LUA_JSON_INVALID',
+        })
+      }
+      throws(() => luaState.setGlobalJSON('value', {}), TypeError)
+      strictEqual(luaState.getGlobal('value'), null)
+    })
+
+    it('should throw ERR_LUA_MEMORY when the value exceeds the memory limit', () => {
+      const luaState = new LuaState({ memoryLimit: 4 * 1024 * 1024 })
+      const items = Array.from({ length: 200_000 }, (_, i) => `item${i}`)
+
+      throws(() => luaState.setGlobalJSON('value', JSON.stringify(items)), {
+        code: 'ERR_LUA_MEMORY',
+      })
+      strictEqual(luaState.getGlobal('value'), null)
+      strictEqual(luaState.eval(`return 1 + 1`), 2)
+    })
+
+    it('should reject deeply nested JSON', () => {
+      const luaState = new LuaState()
+      throws(() => luaState.setGlobalJSON('value', '['.repeat(2000)), {
+        code: 'ERR_LUA_JSON_TOO_DEEP',
+      })
+    })
+  })
+})
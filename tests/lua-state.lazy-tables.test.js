@@ -0,0 +1,123 @@
+const { describe, it, mock } = require('node:test')
+const { deepStrictEqual, ok, strictEqual } = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} lazy tables`, () => {
+  describe('getGlobal with lazy option', () => {
+    const luaState = new LuaState()
+    luaState.eval(`
+      config = { name = 'app', limits = { rps = 100 }, list = { 'a', 'b' } }
+      config.self = config
+    `)
+
+    it('should read fields', () => {
+      const config = luaState.getGlobal('config', { lazy: true })
+      strictEqual(config.name, 'app')
+      strictEqual(config.limits.rps, 100)
+      strictEqual(config.list[2], 'b')
+      strictEqual(config.missing, undefined)
+    })
+
+    it('should keep identity of tables', () => {
+      const config = luaState.getGlobal('config', { lazy: true })
+      strictEqual(config.self, config)
+      strictEqual(config.limits, config.limits)
+    })
+
+    it('should list keys', () => {
+      const list = luaState.getGlobal('config.list', { lazy: true })
+      deepStrictEqual(Object.keys(list).sort(), ['1', '2'])
+      ok('1' in list)
+      ok(!('3' in list))
+    })
+
+    it('should spread and serialize', () => {
+      const limits = luaState.getGlobal('config.limits', { lazy: true })
+      deepStrictEqual({ ...limits }, { rps: 100 })
+      strictEqual(JSON.stringify(limits), '{"rps":100}')
+    })
+
+    it('should write fields to the Lua table', () => {
+      const limits = luaState.getGlobal('config.limits', { lazy: true })
+      limits.rps = 200
+      limits.burst = { size: 10 }
+      strictEqual(luaState.eval(`return config.limits.rps`), 200)
+      strictEqual(luaState.eval(`return config.limits.burst.size`), 10)
+    })
+
+    it('should write sequence elements to number keys', () => {
+      const list = luaState.getGlobal('config.list', { lazy: true })
+      list[3] = 'c'
+      strictEqual(luaState.eval(`return #config.list`), 3)
+    })
+
+    it('should keep non-canonical number names as string keys', () => {
+      luaState.eval(`numbers = { [1.5] = 'number', [1] = 'one' }`)
+      const numbers = luaState.getGlobal('numbers', { lazy: true })
+
+      strictEqual(numbers['1.5'], 'number')
+      strictEqual(numbers['1.50'], undefined)
+      strictEqual(numbers['1e0'], undefined)
+      strictEqual(numbers['01'], undefined)
+
+      numbers['1.50'] = 'string'
+      strictEqual(luaState.eval(`return numbers['1.50']`), 'string')
+      strictEqual(luaState.eval(`return numbers[1.5]`), 'number')
+    })
+
+    it('should delete fields', () => {
+      luaState.eval(`config.temp = 1`)
+      const config = luaState.getGlobal('config', { lazy: true })
+      delete config.temp
+      strictEqual(luaState.eval(`return config.temp`), null)
+    })
+
+    it('should return primitives as is', () => {
+      strictEqual(luaState.getGlobal('config.name', { lazy: true }), 'app')
+    })
+
+    it('should copy tables without the option', () => {
+      deepStrictEqual(luaState.getGlobal('config.limits'), {
+        rps: 200,
+        burst: { size: 10 },
+      })
+    })
+  })
+
+  describe('lazyTables option', () => {
+    it('should pass tables to callbacks lazily', () => {
+      const luaState = new LuaState({ lazyTables: true })
+      const fn = mock.fn((tbl, n) => tbl.items[n].id)
+      luaState.setGlobal('fn', fn)
+
+      const result = luaState.eval(`
+        local tbl = { items = {} }
+        for i = 1, 1000 do tbl.items[i] = { id = i } end
+        return fn(tbl, 500)
+      `)
+
+      strictEqual(result, 500)
+      strictEqual(fn.mock.callCount(), 1)
+    })
+
+    it('should return lazy tables from getGlobal', () => {
+      const luaState = new LuaState({ lazyTables: true })
+      luaState.eval(`tbl = { value = 1 }`)
+      luaState.getGlobal('tbl').value = 2
+      strictEqual(luaState.eval(`return tbl.value`), 2)
+      deepStrictEqual(luaState.getGlobal('tbl', { lazy: false }), { value: 2 })
+    })
+  })
+
+  describe('after close', () => {
+    it('should be detached', () => {
+      const luaState = new LuaState()
+      luaState.eval(`tbl = { value = 1 }`)
+      const tbl = luaState.getGlobal('tbl', { lazy: true })
+      luaState.close()
+
+      strictEqual(tbl.value, undefined)
+      deepStrictEqual(Object.keys(tbl), [])
+    })
+  })
+})
@@ -0,0 +1,166 @@
+const { after, before, beforeEach, describe, it } = require('node:test')
+const {
+  deepStrictEqual,
+  ok,
+  strictEqual,
+  throws,
+} = require('node:assert/strict')
+const fs = require('node:fs')
+const os = require('node:os')
+const path = require('node:path')
+const { LuaError, LuaState } = require('../js')
+
+describe(`${LuaState.name}#${LuaState.prototype.loadBundle.name}`, () => {
+  let tmpDir
+  let bundlePath
+  let luaState
+
+  before(() => {
+    tmpDir = fs.mkdtempSync(path.join(os.tmpdir(), 'lua-state-bundle-'))
+    bundlePath = path.join(tmpDir, 'app.luab')
+
+    new LuaState().compileBundle(bundlePath, [
+      {
+        name: 'return-table',
+        path: `${__dirname}/fixtures/return-table.lua`,
+      },
+      {
+        name: 'without-return',
+        path: `${__dirname}/fixtures/without-return.lua`,
+      },
+    ])
+  })
+
+  after(() => {
+    fs.rmSync(tmpDir, { recursive: true, force: true })
+  })
+
+  beforeEach(() => {
+    luaState = new LuaState()
+  })
+
+  it('should returns chunk names', () => {
+    deepStrictEqual(luaState.loadBundle(bundlePath), [
+      'return-table',
+      'without-return',
+    ])
+  })
+
+  it('should not run chunks on load', () => {
+    luaState.loadBundle(bundlePath)
+    strictEqual(luaState.getGlobal('str'), null)
+  })
+
+  it('should load chunks with require', () => {
+    luaState.loadBundle(bundlePath)
+
+    deepStrictEqual(luaState.eval(`return require('return-table')`), {
+      str: 'foo',
+      num: 1,
+      bool: true,
+    })
+
+    luaState.eval(`require('without-return')`)
+    strictEqual(luaState.getGlobal('str'), 'foo')
+  })
+
+  it('should throws on missing file', () => {
+    throws(
+      () => luaState.loadBundle(path.join(tmpDir, 'missing.luab')),
+      (error) => error.code === 'ERR_LUA_BUNDLE_IO',
+    )
+  })
+
+  it('should throws on non-bundle file', () => {
+    throws(
+      () => luaState.loadBundle(`${__dirname}/fixtures/return-table.lua`),
+      (error) => error.code === 'ERR_LUA_BUNDLE_INVALID',
+    )
+  })
+
+  it('should throws on corrupted chunk table', () => {
+    const corruptedPath = path.join(tmpDir, 'corrupted-table.luab')
+    const bytes = fs.readFileSync(bundlePath)
+    // first byte of the first chunk name (after the ABI tag, chunk count and name length)
+    bytes[24 + bytes.readUInt32LE(12)] ^= 0xff
+    fs.writeFileSync(corruptedPath, bytes)
+
+    throws(
+      () => luaState.loadBundle(corruptedPath),
+      (error) => error.code === 'ERR_LUA_BUNDLE_INVALID',
+    )
+  })
+
+  it('should throws on require of corrupted chunk', () => {
+    const corruptedPath = path.join(tmpDir, 'corrupted-chunk.luab')
+    const bytes = fs.readFileSync(bundlePath)
+    // last byte of the last chunk
+    bytes[bytes.length - 1] ^= 0xff
+    fs.writeFileSync(corruptedPath, bytes)
+
+    luaState.loadBundle(corruptedPath)
+
+    deepStrictEqual(luaState.eval(`return require('return-table')`), {
+      str: 'foo',
+      num: 1,
+      bool: true,
+    })
+    throws(
+      () => luaState.eval(`require('without-return')`),
+      (error) =>
+        error instanceof LuaError && /checksum mismatch/.test(error.message),
+    )
+  })
+
+  it('should throws on tampered chunk count', () => {
+    const tamperedPath = path.join(tmpDir, 'tampered.luab')
+    const bytes = fs.readFileSync(bundlePath)
+    // chunk count follows the ABI tag
+    bytes.writeUInt32LE(0xffffffff, 16 + bytes.readUInt32LE(12))
+    fs.writeFileSync(tamperedPath, bytes)
+
+    throws(
+      () => luaState.loadBundle(tamperedPath),
+      (error) => error.code === 'ERR_LUA_BUNDLE_INVALID',
+    )
+  })
+
+  it('should throws on bundle from another Lua build', () => {
+    const mismatchedPath = path.join(tmpDir, 'mismatched.luab')
+    const bytes = fs.readFileSync(bundlePath)
+    // first byte of the ABI tag (after magic, format version and tag length)
+    bytes[16] ^= 0xff
+    fs.writeFileSync(mismatchedPath, bytes)
+
+    throws(
+      () => luaState.loadBundle(mismatchedPath),
+      (error) => error.code === 'ERR_LUA_BUNDLE_MISMATCH',
+    )
+  })
+
+  it('should throws without package library', () => {
+    throws(() => new LuaState({ libs: ['base'] }).loadBundle(bundlePath))
+  })
+})
+
+describe(`${LuaState.name}#${LuaState.prototype.compileBundle.name}`, () => {
+  it('should throws an LuaError on syntax error', () => {
+    throws(
+      () =>
+        new LuaState().compileBundle(path.join(os.tmpdir(), 'never.luab'), [
+          { name: 'broken', path: `${__dirname}/fixtures/syntax-error.lua` },
+        ]),
+      (luaError) => {
+        ok(luaError instanceof LuaError, 'is LuaError instance')
+        return true
+      },
+    )
+  })
+
+  it('should throws on invalid chunks', () => {
+    throws(
+      () => new LuaState().compileBundle('out.luab', [{ name: 'foo' }]),
+      TypeError,
+    )
+  })
+})
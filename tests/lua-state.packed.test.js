@@ -0,0 +1,136 @@
+const { describe, it } = require('node:test')
+const { deepStrictEqual, ok, strictEqual, throws } = require('node:assert/strict')
+const { LuaState, pack, unpack } = require('../js')
+
+describe(`${LuaState.name} packed transfers`, () => {
+  describe('pack and unpack', () => {
+    it('should round trip values', () => {
+      const value = {
+        int: 1,
+        float: 1.5,
+        negative: -2147483648,
+        large: 2 ** 40,
+        str: 'héllo',
+        long: 'x'.repeat(100),
+        yes: true,
+        no: false,
+        nil: null,
+        list: [1, 'a', { b: 2 }],
+      }
+
+      deepStrictEqual(unpack(pack(value)), value)
+    })
+
+    it('should keep shared and cyclic objects', () => {
+      const shared = { id: 1 }
+      const value = { a: shared, b: shared }
+      value.self = value
+
+      const result = unpack(pack(value))
+      strictEqual(result.a, result.b)
+      strictEqual(result.self, result)
+    })
+
+    it('should reject malformed data', () => {
+      throws(() => unpack(Buffer.from('nope')), { code: 'ERR_LUA_PACK_INVALID' })
+      throws(() => unpack(pack({ a: 1 }).subarray(0, 6)), {
+        code: 'ERR_LUA_PACK_INVALID',
+      })
+    })
+  })
+
+  describe('getGlobalPacked', () => {
+    it('should pack tables', () => {
+      const luaState = new LuaState()
+      luaState.eval(`
+        shared = { id = 1 }
+        value = { name = 'a', n = 1.5, flag = true, items = { shared, shared } }
+        value.self = value
+      `)
+
+      const result = unpack(luaState.getGlobalPacked('value'))
+      strictEqual(result.name, 'a')
+      strictEqual(result.n, 1.5)
+      strictEqual(result.flag, true)
+      strictEqual(result.self, result)
+      strictEqual(result.items[1], result.items[2])
+      deepStrictEqual(result.items[1], { id: 1 })
+    })
+
+    it('should pack sequences as arrays with sequenceArrays', () => {
+      const luaState = new LuaState({ sequenceArrays: true })
+      luaState.eval(`value = { 'a', 'b', { 'c' } }`)
+      deepStrictEqual(unpack(luaState.getGlobalPacked('value')), ['a', 'b', ['c']])
+    })
+
+    it('should pack tables with other keys as maps with sequenceArrays', () => {
+      const luaState = new LuaState({ sequenceArrays: true })
+      luaState.eval(`
+        shared = { 'x' }
+        mixed = { shared, 'a', shared, n = 3 }
+        shuffled = { [1] = 'a', [2] = 'b', [3] = 'c', [4] = 'd' }
+      `)
+      const mixed = unpack(luaState.getGlobalPacked('mixed'))
+      deepStrictEqual(mixed, { 1: ['x'], 2: 'a', 3: ['x'], n: 3 })
+      strictEqual(mixed[1], mixed[3])
+      deepStrictEqual(unpack(luaState.getGlobalPacked('shuffled')), ['a', 'b', 'c', 'd'])
+    })
+
+    it('should pack primitives and skip functions', () => {
+      const luaState = new LuaState()
+      luaState.eval(`value = 'str' fn = { f = function() end }`)
+      strictEqual(unpack(luaState.getGlobalPacked('value')), 'str')
+      deepStrictEqual(unpack(luaState.getGlobalPacked('fn')), { f: null })
+    })
+
+    it('should return null for missing globals', () => {
+      const luaState = new LuaState()
+      strictEqual(luaState.getGlobalPacked('missing'), null)
+    })
+  })
+
+  describe('setGlobalPacked', () => {
+    it('should unpack into Lua tables', () => {
+      const luaState = new LuaState()
+      const users = [{ id: 1, name: 'ann' }, { id: 2, name: 'bob' }]
+      const value = { users, first: users[0] }
+      value.self = value
+
+      luaState.setGlobalPacked('value', pack(value))
+
+      strictEqual(luaState.eval(`return #value.users`), 2)
+      strictEqual(luaState.eval(`return value.users[2].name`), 'bob')
+      ok(luaState.eval(`return value.first == value.users[1] and value.self == value`))
+    })
+
+    it('should round trip through Lua', () => {
+      const luaState = new LuaState()
+      const value = { a: [1, 2, 3], b: { c: 'd' } }
+      luaState.setGlobalPacked('value', pack(value))
+      deepStrictEqual(unpack(luaState.getGlobalPacked('value')), {
+        a: { 1: 1, 2: 2, 3: 3 },
+        b: { c: 'd' },
+      })
+    })
+
+    it('should reject malformed data', () => {
+      const luaState = new LuaState()
+      throws(() => luaState.setGlobalPacked('value', Buffer.from('LP\x01\x09')), {
+        code: 'ERR_LUA_PACK_INVALID',
+      })
+      throws(() => luaState.setGlobalPacked('value', 'LP'), TypeError)
+      strictEqual(luaState.getGlobal('value'), null)
+    })
+
+    it('should throw ERR_LUA_MEMORY when data exceeds the memory limit', () => {
+      const luaState = new LuaState({ memoryLimit: 4 * 1024 * 1024 })
+      const items = Array.from({ length: 200_000 }, (_, i) => `item${i}`)
+
+      throws(() => luaState.setGlobalPacked('value', pack(items)), {
+        code: 'ERR_LUA_MEMORY',
+      })
+      strictEqual(luaState.getGlobal('value'), null)
+      strictEqual(luaState.eval(`return 1 + 1`), 2)
+    })
+  })
+})
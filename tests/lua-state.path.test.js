@@ -0,0 +1,86 @@
+const { beforeEach, describe, it } = require('node:test')
+const { deepStrictEqual, strictEqual, throws } = require('node:assert/strict')
+const { LuaState, LuaStatePool } = require('../js')
+
+describe(`${LuaState.name}#${LuaState.prototype.path.name}`, () => {
+  let luaState
+
+  beforeEach(() => {
+    luaState = new LuaState()
+    luaState.eval(`
+      config = { name = 'app', limits = { rps = 100 }, list = { 1, 2, 3 } }
+    `)
+  })
+
+  describe('get', () => {
+    it('should returns value by path', () => {
+      strictEqual(luaState.path('config.limits.rps').get(), 100)
+      deepStrictEqual(luaState.path('config.limits').get(), { rps: 100 })
+    })
+
+    it('should follow value changes', () => {
+      const rps = luaState.path('config.limits.rps')
+      luaState.eval(`config.limits.rps = 200`)
+      strictEqual(rps.get(), 200)
+    })
+
+    it('should returns null on missing global', () => {
+      strictEqual(luaState.path('missing').get(), null)
+    })
+
+    it('should returns undefined on broken path', () => {
+      strictEqual(luaState.path('config.missing').get(), undefined)
+      strictEqual(luaState.path('config.name.foo').get(), undefined)
+    })
+  })
+
+  describe('length', () => {
+    it('should returns length of table', () => {
+      strictEqual(luaState.path('config.list').length(), 3)
+    })
+
+    it('should returns undefined for non-table value', () => {
+      strictEqual(luaState.path('config.limits.rps').length(), undefined)
+    })
+  })
+
+  describe('set', () => {
+    it('should assign nested value', () => {
+      strictEqual(luaState.path('config.limits.rps').set(5), true)
+      strictEqual(luaState.eval(`return config.limits.rps`), 5)
+    })
+
+    it('should assign global', () => {
+      strictEqual(luaState.path('flag').set(true), true)
+      strictEqual(luaState.getGlobal('flag'), true)
+    })
+
+    it('should returns false on broken path', () => {
+      strictEqual(luaState.path('config.missing.rps').set(1), false)
+    })
+  })
+
+  it('should returns source path from toString', () => {
+    strictEqual(String(luaState.path('config.name')), 'config.name')
+  })
+
+  it('should throws on non-string argument', () => {
+    throws(() => luaState.path(1), TypeError)
+  })
+
+  it('should throw error after close', () => {
+    const name = luaState.path('config.name')
+    luaState.close()
+    throws(() => name.get(), /closed/i)
+  })
+
+  it('should throw error after release to pool', () => {
+    const pool = new LuaStatePool({ size: 1 })
+    const lua = pool.acquire()
+    const version = lua.path('_VERSION')
+    pool.release(lua)
+
+    throws(() => version.get(), /closed/i)
+    pool.close()
+  })
+})
@@ -0,0 +1,102 @@
+const { describe, it } = require('node:test')
+const { deepStrictEqual, strictEqual, throws } = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} prepareCall`, () => {
+  it('should pass numbers through typed arrays', () => {
+    const luaState = new LuaState()
+    luaState.eval(`sim = { step = function(x, v) return x + v, v * 2 end }`)
+    const args = new Float64Array(2)
+    const results = new Float64Array(2)
+    const step = luaState.prepareCall('sim.step', { args, results })
+
+    for (let i = 0; i < 3; i++) {
+      args[0] = i
+      args[1] = 1.5
+      strictEqual(step.call(), 2)
+      deepStrictEqual([...results], [i + 1.5, 3])
+    }
+  })
+
+  it('should prepare a Lua function', () => {
+    const luaState = new LuaState()
+    const fn = luaState.eval(`return function(a) return a * a end`)
+    const args = new Float64Array([3])
+    const results = new Float64Array(1)
+
+    luaState.prepareCall(fn, { args, results }).call()
+    strictEqual(results[0], 9)
+  })
+
+  it('should keep the resolved function', () => {
+    const luaState = new LuaState()
+    luaState.eval(`function answer() return 42 end`)
+    const results = new Float64Array(1)
+    const answer = luaState.prepareCall('answer', { results })
+
+    luaState.eval(`answer = nil`)
+    answer.call()
+    strictEqual(results[0], 42)
+  })
+
+  it('should write NaN for missing and nil results', () => {
+    const luaState = new LuaState()
+    luaState.eval(`function fn() return nil, 1 end`)
+    const results = new Float64Array(3)
+
+    strictEqual(luaState.prepareCall('fn', { results }).call(), 2)
+    deepStrictEqual([...results], [NaN, 1, NaN])
+  })
+
+  it('should reject non-numeric results', () => {
+    const luaState = new LuaState()
+    luaState.eval(`function fn() return 'x' end`)
+    const call = luaState.prepareCall('fn', { results: new Float64Array(1) })
+
+    throws(() => call.call(), {
+      name: 'TypeError',
+      code: 'ERR_LUA_SIGNATURE_MISMATCH',
+      message: 'Result 1 expected number, got string',
+    })
+  })
+
+  it('should throw Lua errors', () => {
+    const luaState = new LuaState()
+    luaState.eval(`function fail() error('boom') end`)
+    throws(() => luaState.prepareCall('fail').call(), /boom/)
+  })
+
+  it('should reject invalid targets and options', () => {
+    const luaState = new LuaState()
+    luaState.eval(`value = 1 function fn() end`)
+
+    throws(() => luaState.prepareCall('value'), TypeError)
+    throws(() => luaState.prepareCall('missing.fn'), TypeError)
+    throws(() => luaState.prepareCall(() => {}), TypeError)
+    throws(
+      () => luaState.prepareCall('fn', { args: new Float32Array(1) }),
+      TypeError,
+    )
+  })
+
+  it('should not write results into a buffer detached during the call', () => {
+    const luaState = new LuaState()
+    const results = new Float64Array(2)
+    luaState.setGlobal('detach', () => {
+      structuredClone(results.buffer, { transfer: [results.buffer] })
+    })
+    luaState.eval(`function fn() detach() return 1, 2 end`)
+
+    strictEqual(luaState.prepareCall('fn', { results }).call(), 2)
+    strictEqual(results.length, 0)
+  })
+
+  it('should throw after close', () => {
+    const luaState = new LuaState()
+    luaState.eval(`function fn() end`)
+    const call = luaState.prepareCall('fn')
+    luaState.close()
+
+    throws(() => call.call(), { code: 'ERR_LUA_STATE_CLOSED' })
+  })
+})
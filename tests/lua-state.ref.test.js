@@ -0,0 +1,165 @@
+const { describe, it, mock } = require('node:test')
+const { deepStrictEqual, strictEqual, throws } = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} objects by reference`, () => {
+  describe('setGlobal with byRef option', () => {
+    it('should read fields of the live object', () => {
+      const luaState = new LuaState()
+      const state = { hits: 1, nested: { name: 'a' }, list: [10, 20, 30] }
+      luaState.setGlobal('state', state, { byRef: true })
+
+      strictEqual(luaState.eval(`return state.hits`), 1)
+      state.hits = 2
+      strictEqual(luaState.eval(`return state.hits`), 2)
+      strictEqual(luaState.eval(`return state.nested.name`), 'a')
+      strictEqual(luaState.eval(`return state.list[2]`), 20)
+      strictEqual(luaState.eval(`return #state.list`), 3)
+      strictEqual(luaState.eval(`return state.missing`), null)
+    })
+
+    it('should write fields to the live object', () => {
+      const luaState = new LuaState()
+      const state = { hits: 1, temp: true, list: [1, 2] }
+      luaState.setGlobal('state', state, { byRef: true })
+
+      luaState.eval(`
+        state.hits = state.hits + 1
+        state.temp = nil
+        state.list[3] = 3
+        state.data = { a = 1 }
+      `)
+
+      deepStrictEqual(state, { hits: 2, list: [1, 2, 3], data: { a: 1 } })
+    })
+
+    it('should call methods with the object as this', () => {
+      const luaState = new LuaState()
+      const counter = {
+        value: 0,
+        add(n) {
+          this.value += n
+          return this.value
+        },
+      }
+      luaState.setGlobal('counter', counter, { byRef: true })
+
+      strictEqual(luaState.eval(`counter:add(2) return counter:add(3)`), 5)
+      strictEqual(luaState.eval(`return counter.add == counter.add`), true)
+    })
+
+    it('should pass other references as arguments', () => {
+      const luaState = new LuaState()
+      const calls = []
+      const first = {
+        check(...args) {
+          calls.push({ self: this, args })
+        },
+      }
+      const second = { name: 'second' }
+      luaState.setGlobal('first', first, { byRef: true })
+      luaState.setGlobal('second', second, { byRef: true })
+
+      luaState.eval(`first.check(second, 1) first:check(2)`)
+      deepStrictEqual(calls, [
+        { self: undefined, args: [second, 1] },
+        { self: first, args: [2] },
+      ])
+    })
+
+    it('should iterate with pairs', () => {
+      const luaState = new LuaState()
+      if (luaState.getVersion().startsWith('Lua 5.1') || luaState.getVersion().startsWith('LuaJIT')) {
+        return
+      }
+      luaState.setGlobal('obj', { a: 1, b: 2 }, { byRef: true })
+      luaState.setGlobal('arr', ['x', 'y'], { byRef: true })
+
+      strictEqual(luaState.eval(`local s = 0 for k, v in pairs(obj) do s = s + v end return s`), 3)
+      strictEqual(luaState.eval(`local s = '' for i, v in pairs(arr) do s = s .. i .. v end return s`), '1x2y')
+    })
+
+    it('should call functions', () => {
+      const luaState = new LuaState()
+      const fn = mock.fn((a, b) => a + b)
+      luaState.setGlobal('obj', { fn }, { byRef: true })
+
+      strictEqual(luaState.eval(`return obj.fn(1, 2)`), 3)
+      strictEqual(fn.mock.callCount(), 1)
+    })
+
+    it('should convert back to the same object', () => {
+      const luaState = new LuaState()
+      const obj = { a: 1 }
+      luaState.setGlobal('obj', obj, { byRef: true })
+
+      strictEqual(luaState.getGlobal('obj'), obj)
+    })
+
+    it('should raise JS errors in Lua', () => {
+      const luaState = new LuaState()
+      luaState.setGlobal(
+        'obj',
+        {
+          fail() {
+            throw new Error('boom')
+          },
+        },
+        { byRef: true },
+      )
+
+      strictEqual(luaState.eval(`return pcall(obj.fail)`)[0], false)
+      throws(() => luaState.eval(`obj()`))
+    })
+  })
+
+  describe('ref', () => {
+    it('should pass marked objects by reference', () => {
+      const luaState = new LuaState()
+      const obj = luaState.ref({ value: 1 })
+      luaState.setGlobal('holder', { obj })
+      luaState.eval(`holder.obj.value = 2`)
+
+      strictEqual(obj.value, 2)
+    })
+
+    it('should pass marked objects to callbacks', () => {
+      const luaState = new LuaState()
+      const obj = luaState.ref({ value: 1 })
+      luaState.setGlobal('fn', (value) => value)
+      luaState.setGlobal('obj', obj)
+
+      strictEqual(luaState.eval(`return fn(obj)`), obj)
+    })
+
+    it('should mark objects for the state only', () => {
+      const luaState = new LuaState()
+      const other = new LuaState()
+      const obj = luaState.ref({ value: 1 })
+      luaState.setGlobal('obj', obj)
+      other.setGlobal('obj', obj)
+
+      strictEqual(luaState.eval(`return type(obj)`), 'userdata')
+      strictEqual(other.eval(`return type(obj)`), 'table')
+    })
+
+    it('should mark objects for several states without visible keys', () => {
+      const luaState = new LuaState()
+      const other = new LuaState()
+      const obj = other.ref(luaState.ref({ value: 1 }))
+      luaState.setGlobal('obj', obj)
+      other.setGlobal('obj', obj)
+
+      strictEqual(luaState.eval(`return type(obj)`), 'userdata')
+      strictEqual(other.eval(`return type(obj)`), 'userdata')
+      deepStrictEqual(Object.keys(obj), ['value'])
+      strictEqual(JSON.stringify(obj), '{"value":1}')
+    })
+
+    it('should reject primitives and frozen objects', () => {
+      const luaState = new LuaState()
+      throws(() => luaState.ref(1), TypeError)
+      throws(() => luaState.ref(Object.freeze({})), TypeError)
+    })
+  })
+})
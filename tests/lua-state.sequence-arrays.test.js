@@ -0,0 +1,84 @@
+const { describe, it } = require('node:test')
+const { deepStrictEqual, ok, strictEqual } = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} sequenceArrays option`, () => {
+  describe('when disabled', () => {
+    const luaState = new LuaState()
+
+    it('should convert sequence to object', () => {
+      deepStrictEqual(luaState.eval(`return { 'a', 'b' }`), { 1: 'a', 2: 'b' })
+    })
+  })
+
+  describe('when enabled', () => {
+    const luaState = new LuaState({ sequenceArrays: true })
+
+    it('should convert sequence to array', () => {
+      const result = luaState.eval(`return { 'a', 'b', 'c' }`)
+      ok(Array.isArray(result))
+      deepStrictEqual(result, ['a', 'b', 'c'])
+    })
+
+    it('should convert nested sequences', () => {
+      deepStrictEqual(luaState.eval(`return { list = { { 1, 2 }, { 3 } } }`), {
+        list: [[1, 2], [3]],
+      })
+    })
+
+    it('should keep string keys as array properties', () => {
+      const result = luaState.eval(`return { 'a', 'b', n = 2 }`)
+      ok(Array.isArray(result))
+      strictEqual(result.length, 2)
+      strictEqual(result.n, 2)
+    })
+
+    it('should convert empty table to object', () => {
+      deepStrictEqual(luaState.eval(`return {}`), {})
+    })
+
+    it('should convert table with holes to object', () => {
+      deepStrictEqual(luaState.eval(`local t = { 1, 2, 3, 4 } t[2] = nil return t`), {
+        1: 1,
+        3: 3,
+        4: 4,
+      })
+    })
+
+    it('should convert table with other numeric keys to object', () => {
+      deepStrictEqual(luaState.eval(`return { 'a', [0] = 'z' }`), { 0: 'z', 1: 'a' })
+      deepStrictEqual(luaState.eval(`return { 'a', [1.5] = 'x' }`), { 1: 'a', 1.5: 'x' })
+    })
+
+    it('should convert sequences with keys out of order', () => {
+      deepStrictEqual(luaState.eval(`return { [1] = 'a', [2] = 'b', [3] = 'c', [4] = 'd' }`), [
+        'a',
+        'b',
+        'c',
+        'd',
+      ])
+    })
+
+    it('should convert a shared table with other numeric keys to one object', () => {
+      const result = luaState.eval(`local t = { 'a', [5] = 'e' } return { t, t, first = t }`)
+      ok(Array.isArray(result))
+      deepStrictEqual(result[0], { 1: 'a', 5: 'e' })
+      strictEqual(result[1], result[0])
+      strictEqual(result.first, result[0])
+    })
+
+    it('should preserve circular references', () => {
+      const result = luaState.eval(`local t = { 1 } t[2] = t return t`)
+      ok(Array.isArray(result))
+      strictEqual(result[1], result)
+    })
+
+    it('should convert large sequence', () => {
+      const result = luaState.eval(`local t = {} for i = 1, 100000 do t[i] = i end return t`)
+      ok(Array.isArray(result))
+      strictEqual(result.length, 100000)
+      strictEqual(result[0], 1)
+      strictEqual(result[99999], 100000)
+    })
+  })
+})
@@ -93,6 +93,54 @@ describe(`${LuaState.name}#${LuaState.prototype.setGlobal.name}`, () => {
         strictEqual(luaState.eval(`return tbl.next.next.next.next.value`), 3)
       })
     })
+
+    describe('large shared obj', () => {
+      function makeSharedObject(size) {
+        const shared = { value: 'shared' }
+        const items = []
+        for (let i = 0; i < size; i++) {
+          items.push(Object.freeze({ id: i, shared }))
+        }
+        return { items, shared, native: new LuaState(), again: items }
+      }
+
+      it('should keep identity of shared objects', () => {
+        luaState.setGlobal('tbl', makeSharedObject(100))
+        strictEqual(
+          luaState.eval(`return rawequal(tbl.shared, tbl.items[100].shared)`),
+          true,
+        )
+        strictEqual(
+          luaState.eval(`return rawequal(tbl.items, tbl.again)`),
+          true,
+        )
+        strictEqual(luaState.eval(`return tbl.items[100].id`), 99)
+      })
+
+      it('should set the same obj again', () => {
+        const obj = makeSharedObject(100)
+        luaState.setGlobal('a', obj)
+        luaState.setGlobal('b', obj)
+        strictEqual(
+          luaState.eval(`
+            return rawequal(b.shared, b.items[1].shared)
+              and not rawequal(a.shared, b.shared)
+          `),
+          true,
+        )
+      })
+
+      it('should set objects wrapped by native classes', () => {
+        const native = new LuaState()
+        const obj = makeSharedObject(20)
+        obj.items.push(native, native)
+        luaState.setGlobal('tbl', obj)
+        strictEqual(
+          luaState.eval(`return rawequal(tbl.items[21], tbl.items[22])`),
+          true,
+        )
+      })
+    })
   })
 
   describe('with array', () => {
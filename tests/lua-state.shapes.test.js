@@ -0,0 +1,85 @@
+const { describe, it, mock } = require('node:test')
+const { deepStrictEqual, strictEqual, throws } = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} record shapes`, () => {
+  describe('defineShape', () => {
+    it('should accept the same shape twice', () => {
+      const luaState = new LuaState()
+      strictEqual(luaState.defineShape('user', ['id', 'name']), luaState)
+      luaState.defineShape('user', ['id', 'name'])
+    })
+
+    it('should reject another shape with the same name', () => {
+      const luaState = new LuaState()
+      luaState.defineShape('user', ['id', 'name'])
+      throws(() => luaState.defineShape('user', ['id']), { code: 'ERR_LUA_SHAPE_EXISTS' })
+    })
+
+    it('should reject invalid keys', () => {
+      const luaState = new LuaState()
+      throws(() => luaState.defineShape('empty', []), RangeError)
+      throws(() => luaState.defineShape('dup', ['id', 'id']), TypeError)
+      throws(() => luaState.defineShape('num', ['id', 1]), TypeError)
+    })
+  })
+
+  describe('JS to Lua', () => {
+    const luaState = new LuaState()
+    luaState.defineShape('user', ['id', 'name', 'active'])
+
+    it('should convert matching objects', () => {
+      luaState.setGlobal('user', { id: 1, name: 'ann', active: true })
+      deepStrictEqual(luaState.eval(`return { user.id, user.name, user.active }`), { 1: 1, 2: 'ann', 3: true })
+    })
+
+    it('should convert nested and repeated objects', () => {
+      const user = { id: 2, name: 'bob', active: false }
+      luaState.setGlobal('list', { a: user, b: user, c: { id: 3, name: { first: 'c' }, active: null } })
+      strictEqual(luaState.eval(`return list.a == list.b`), true)
+      strictEqual(luaState.eval(`return list.c.name.first`), 'c')
+      strictEqual(luaState.eval(`return list.c.active`), null)
+    })
+
+    it('should convert objects with other keys or order', () => {
+      luaState.setGlobal('other', { name: 'ann', id: 1, active: true })
+      luaState.setGlobal('extra', { id: 1, name: 'ann', active: true, role: 'admin' })
+      strictEqual(luaState.eval(`return other.id`), 1)
+      strictEqual(luaState.eval(`return extra.role`), 'admin')
+    })
+  })
+
+  describe('Lua to JS', () => {
+    const luaState = new LuaState()
+    luaState.defineShape('user', ['id', 'name', 'active'])
+
+    it('should convert tables with shape keys', () => {
+      for (let i = 0; i < 3; i++) {
+        const user = luaState.eval(`return { active = true, name = 'ann', id = ${i} }`)
+        deepStrictEqual(Object.keys(user).sort(), ['active', 'id', 'name'])
+        deepStrictEqual(user, { id: i, name: 'ann', active: true })
+      }
+    })
+
+    it('should convert tables with missing or other keys', () => {
+      deepStrictEqual(luaState.eval(`return { id = 1, name = 'ann' }`), { id: 1, name: 'ann' })
+      deepStrictEqual(luaState.eval(`return { id = 1, name = 'ann', role = 'x' }`), {
+        id: 1,
+        name: 'ann',
+        role: 'x',
+      })
+      deepStrictEqual(luaState.eval(`return { id = 1, name = 'ann', [1] = true }`), {
+        1: true,
+        id: 1,
+        name: 'ann',
+      })
+    })
+
+    it('should pass matching tables to callbacks', () => {
+      const fn = mock.fn((user) => user.name)
+      luaState.setGlobal('fn', fn)
+      strictEqual(luaState.eval(`return fn({ id = 1, name = 'ann', active = { nested = true } })`), 'ann')
+      deepStrictEqual(fn.mock.calls[0].arguments[0], { id: 1, name: 'ann', active: { nested: true } })
+    })
+  })
+})
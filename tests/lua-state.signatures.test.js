@@ -0,0 +1,116 @@
+const { describe, it } = require('node:test')
+const {
+  deepStrictEqual,
+  match,
+  strictEqual,
+  throws,
+} = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+const MISMATCH = { name: 'TypeError', code: 'ERR_LUA_SIGNATURE_MISMATCH' }
+
+describe(`${LuaState.name} function signatures`, () => {
+  describe('setGlobal with a signature', () => {
+    it('should call with declared types', () => {
+      const luaState = new LuaState()
+      const score = (points, name, bonus) => `${name}:${points * 2}:${bonus}`
+      luaState.setGlobal('score', score, {
+        args: ['number', 'string', 'boolean'],
+        returns: 'string',
+      })
+
+      strictEqual(
+        luaState.eval(`return score(21, 'ann', true)`),
+        'ann:42:true',
+      )
+    })
+
+    it('should raise a Lua error for mismatched arguments', () => {
+      const luaState = new LuaState()
+      luaState.setGlobal('inc', (x) => x + 1, {
+        args: ['number'],
+        returns: 'number',
+      })
+
+      const [ok, err] = luaState.eval(`return pcall(inc, '1')`)
+      strictEqual(ok, false)
+      match(err, /Argument 1 expected number, got string/)
+      match(luaState.eval(`return select(2, pcall(inc))`), /got no value/)
+      match(
+        luaState.eval(`return select(2, pcall(inc, 1, 2))`),
+        /at most 1 arguments, got 2/,
+      )
+    })
+
+    it('should raise a Lua error for a mismatched result', () => {
+      const luaState = new LuaState()
+      luaState.setGlobal('fn', () => 'x', { returns: 'number' })
+      match(
+        luaState.eval(`return select(2, pcall(fn))`),
+        /Result expected number, got string/,
+      )
+    })
+
+    it('should convert "any" and undeclared positions as usual', () => {
+      const luaState = new LuaState()
+      luaState.setGlobal('first', (value) => value, { args: ['any'] })
+      luaState.setGlobal('pair', (a, b) => [a, b], { returns: 'any' })
+
+      deepStrictEqual(luaState.eval(`return first({ x = 1 })`), { x: 1 })
+      strictEqual(luaState.eval(`return first()`), null)
+      deepStrictEqual(luaState.eval(`return { pair(1, 'b') }`), {
+        1: 1,
+        2: 'b',
+      })
+    })
+
+    it('should reject signatures for non-functions and unknown types', () => {
+      const luaState = new LuaState()
+      throws(() => luaState.setGlobal('x', 1, { args: ['number'] }), TypeError)
+      const fn = () => {}
+      throws(() => luaState.setGlobal('fn', fn, { args: ['int'] }), TypeError)
+      throws(() => luaState.setGlobal('fn', fn, { returns: 1 }), TypeError)
+    })
+  })
+
+  describe('withSignature', () => {
+    it('should call the Lua function with declared types', () => {
+      const luaState = new LuaState()
+      luaState.eval(`function greet(name, n) return name .. n end`)
+      const greet = luaState.getGlobal('greet').withSignature({
+        args: ['string', 'number'],
+        returns: 'string',
+      })
+
+      strictEqual(greet('a', 1), 'a1')
+      strictEqual(luaState.getGlobal('greet')('a', 1), 'a1')
+    })
+
+    it('should throw for mismatched arguments and results', () => {
+      const luaState = new LuaState()
+      const fn = luaState.eval(`return function(x) return x end`)
+      const typed = fn.withSignature({ args: ['number'], returns: 'number' })
+
+      strictEqual(typed(1.5), 1.5)
+      throws(() => typed('1'), MISMATCH)
+      throws(() => typed(), MISMATCH)
+      throws(() => typed(1, 2), MISMATCH)
+      throws(() => fn.withSignature({ returns: 'boolean' })(1), {
+        ...MISMATCH,
+        message: 'Result expected boolean, got number',
+      })
+    })
+
+    it('should propagate Lua errors', () => {
+      const luaState = new LuaState()
+      const fn = luaState.eval(`return function() error('boom') end`)
+      throws(() => fn.withSignature({ args: [] })(), /boom/)
+    })
+
+    it('should require a signature', () => {
+      const luaState = new LuaState()
+      const fn = luaState.eval(`return function() end`)
+      throws(() => fn.withSignature({}), TypeError)
+    })
+  })
+})
@@ -0,0 +1,74 @@
+const { describe, it } = require('node:test')
+const { deepStrictEqual, strictEqual } = require('node:assert/strict')
+const { LuaState } = require('../js')
+
+describe(`${LuaState.name} string conversion cache`, () => {
+  it('should convert repeated keys and values', () => {
+    const luaState = new LuaState()
+    luaState.eval(`item = { id = 1, name = 'name', status = 'status' }`)
+
+    for (let i = 0; i < 3; i++) {
+      deepStrictEqual(luaState.getGlobal('item'), { id: 1, name: 'name', status: 'status' })
+    }
+  })
+
+  it('should convert short strings in results, keys and callback arguments', () => {
+    const luaState = new LuaState()
+    const calls = []
+    luaState.setGlobal('fn', (name, record) => calls.push([name, record]))
+
+    for (let i = 0; i < 3; i++) {
+      strictEqual(luaState.eval(`return 'name'`), 'name')
+      deepStrictEqual(luaState.eval(`return { name = 'name' }`), { name: 'name' })
+      luaState.eval(`fn('name', { name = 'name' })`)
+    }
+
+    deepStrictEqual(calls, Array(3).fill(['name', { name: 'name' }]))
+  })
+
+  it('should convert more distinct strings than the cache holds', () => {
+    const luaState = new LuaState()
+    luaState.eval(`
+      wide = {}
+      for i = 1, 10000 do wide['key' .. i] = 'value' .. i end
+    `)
+
+    for (let i = 0; i < 2; i++) {
+      const wide = luaState.getGlobal('wide')
+      strictEqual(Object.keys(wide).length, 10000)
+      strictEqual(wide.key1, 'value1')
+      strictEqual(wide.key10000, 'value10000')
+    }
+  })
+
+  it('should not reuse strings after they are collected', () => {
+    const luaState = new LuaState()
+
+    for (let i = 0; i < 20; i++) {
+      const result = luaState.eval(`
+        local t = {}
+        for j = 1, 50 do t['k' .. ${i} .. '_' .. j] = 's' .. ${i} .. '_' .. j end
+        collectgarbage()
+        return t
+      `)
+      strictEqual(result[`k${i}_1`], `s${i}_1`)
+      strictEqual(result[`k${i}_50`], `s${i}_50`)
+      strictEqual(Object.keys(result).length, 50)
+    }
+  })
+
+  it('should convert long strings', () => {
+    const luaState = new LuaState()
+    const long = 'x'.repeat(100)
+    luaState.setGlobal('long', long)
+
+    strictEqual(luaState.eval(`return long`), long)
+    deepStrictEqual(luaState.eval(`return { [long] = long }`), { [long]: long })
+  })
+
+  it('should release cached strings on close', () => {
+    const luaState = new LuaState()
+    strictEqual(luaState.eval(`return 'name'`), 'name')
+    luaState.close()
+  })
+})
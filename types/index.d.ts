@@ -1,2 +1,9 @@
 import './lua-state-native.module'
+import type { LuaValue } from 'lua-state.node'
+
 export * from 'lua-state.node'
+
+export declare function pack(value: LuaValue): Buffer
+export declare function unpack<T extends LuaValue = LuaValue>(
+  data: Uint8Array | ArrayBuffer,
+): T
@@ -1,24 +1,177 @@
 declare module '*lua-state.node' {
   export class LuaState {
+    static clearChunkCache(): undefined
+    static configureChunkCache(opts: Partial<LuaChunkCacheOptions>): undefined
+    static getChunkCacheStats(): LuaChunkCacheStats
+
     constructor(opts?: LuaStateOptions)
     close(): undefined
-    evalFile(path: string): LuaValue | undefined
-    evalFile<T extends LuaValue>(path: string): T
-    eval(code: string): LuaValue | undefined
-    eval<T extends LuaValue>(code: string): T
-    getGlobal(path: string): LuaValue | null | undefined
-    getGlobal<T extends LuaValue>(path: string): T
+    compile(code: string): LuaFunction
+    compileBundle(
+      path: string,
+      chunks: LuaBundleChunk[],
+      opts?: LuaBundleOptions,
+    ): undefined
+    defineShape(name: string, keys: string[]): this
+    evalFile(path: string, budget?: LuaBudget): LuaValue | undefined
+    evalFile<T extends LuaValue>(path: string, budget?: LuaBudget): T
+    eval(code: string, budget?: LuaBudget): LuaValue | undefined
+    eval<T extends LuaValue>(code: string, budget?: LuaBudget): T
+    gc(action: 'collect' | 'stop' | 'restart'): undefined
+    gc(action: 'step', opts?: { size?: number }): boolean
+    gc(action: 'count'): number
+    gc(action: 'isRunning'): boolean
+    gc(action: 'incremental', opts?: LuaGcIncrementalOptions): undefined
+    gc(action: 'generational', opts?: LuaGcGenerationalOptions): undefined
+    getGlobal(path: string, opts?: LuaGetGlobalOptions): LuaValue | null | undefined
+    getGlobal<T extends LuaValue>(path: string, opts?: LuaGetGlobalOptions): T
+    getGlobalJSON(path: string): string | null | undefined
+    getGlobalPacked(path: string): Buffer | null | undefined
     getLength(path: string): number | null | undefined
+    getMemoryStats(): LuaMemoryStats | null
     getVersion(): string
-    setGlobal(name: string, value: LuaValue): this
+    loadBundle(path: string): string[]
+    path(path: string): LuaPath
+    prepareCall(
+      pathOrFn: string | LuaFunction,
+      opts?: LuaPrepareCallOptions,
+    ): LuaCall
+    ref<T extends object>(obj: T): T
+    setGlobal(name: string, value: LuaValue, opts?: LuaSetGlobalOptions): this
+    setGlobalJSON(name: string, json: string | Uint8Array): this
+    setGlobalPacked(name: string, data: Uint8Array | ArrayBuffer): this
+  }
+
+  export class LuaStatePool {
+    constructor(opts?: LuaStatePoolOptions)
+    acquire(): LuaState
+    release(lua: LuaState): undefined
+    close(): undefined
+    getStats(): LuaStatePoolStats
   }
 
-  export class LuaError extends Error {}
+  export class LuaError extends Error {
+    code?: string
+  }
 
   export type LuaStateOptions = Partial<{
     libs: LuaLibName[] | null
+    allocator: LuaAllocatorType
+    memoryLimit: number | null
+    chunkCache: boolean
+    sequenceArrays: boolean
+    binaryStrings: boolean
+    lazyTables: boolean
+    errorDetail: LuaErrorDetail
+    budget: LuaBudget
+    hookInterval: number
+    idleGc: boolean | { stepSize?: number }
+  }>
+
+  export type LuaGcIncrementalOptions = Partial<{
+    pause: number
+    stepMul: number
+    stepSize: number
+  }>
+
+  export type LuaGcGenerationalOptions = Partial<{
+    minorMul: number
+    majorMul: number
+  }>
+
+  export type LuaBudget = Partial<{
+    instructions: number
+    timeout: number
+    signal: AbortSignal
+  }>
+
+  export type LuaGetGlobalOptions = Partial<{
+    lazy: boolean
+  }>
+
+  export type LuaSetGlobalOptions = LuaSignature &
+    Partial<{
+      byRef: boolean
+    }>
+
+  export type LuaSignatureType = 'number' | 'string' | 'boolean' | 'any'
+
+  export type LuaSignature = Partial<{
+    args: LuaSignatureType[]
+    returns: LuaSignatureType
+  }>
+
+  export type LuaErrorDetail = 'none' | 'message' | 'full'
+
+  export type LuaPath = {
+    get(): LuaValue | null | undefined
+    get<T extends LuaValue>(): T
+    length(): number | null | undefined
+    set(value: LuaValue): boolean
+    toString(): string
+  }
+
+  export type LuaPrepareCallOptions = Partial<{
+    args: Float64Array
+    results: Float64Array
   }>
 
+  export type LuaCall = {
+    call(): number
+  }
+
+  export type LuaStatePoolOptions = LuaStateOptions &
+    Partial<{
+      size: number
+      prelude: string
+    }>
+
+  export type LuaStatePoolStats = {
+    size: number
+    idle: number
+    borrowed: number
+  }
+
+  export type LuaChunkCacheOptions = {
+    maxBytes: number
+    maxEntries: number
+  }
+
+  export type LuaChunkCacheStats = LuaChunkCacheOptions & {
+    hits: number
+    misses: number
+    evictions: number
+    entries: number
+    bytes: number
+  }
+
+  export type LuaBundleChunk = {
+    name: string
+    path: string
+  }
+
+  export type LuaBundleOptions = Partial<{
+    strip: boolean
+  }>
+
+  export type LuaAllocatorType = 'system' | 'pool'
+
+  export type LuaMemoryStats = {
+    allocator: LuaAllocatorType
+    used: number
+    peak: number
+    limit: number | null
+    allocations: number
+    sizeClasses: LuaMemorySizeClassStats[]
+    large: Omit<LuaMemorySizeClassStats, 'size'>
+  }
+
+  export type LuaMemorySizeClassStats = {
+    size: number
+    allocations: number
+    live: number
+  }
+
   export type LuaLibName =
     | 'base'
     | 'bit32'
@@ -34,7 +187,19 @@ declare module '*lua-state.node' {
 
   export type LuaValue = LuaPrimitive | LuaTable | LuaFunction | LuaValue[]
   export type LuaPrimitive = string | number | boolean | Date | bigint | null
-  export type LuaFunction = (...args: LuaValue[]) => LuaValue | void
+  export type LuaFunction = ((...args: LuaValue[]) => LuaValue | void) & {
+    // set on functions returned from Lua
+    withSignature?(signature: LuaSignature): LuaFunction
+    batch?(argsList: (LuaValue[] | LuaValue)[]): (LuaValue | undefined)[]
+    batchColumns?(
+      columns: Float64Array[],
+      opts?: LuaBatchColumnsOptions,
+    ): Float64Array[]
+  }
+
+  export type LuaBatchColumnsOptions = Partial<{
+    results: number
+  }>
   export type LuaTable = {
     [index: string]: LuaValue | undefined
   }